@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <sys/stat.h>
+#include "../source/libs/tree.hpp"
+#include "../source/libs/ident.hpp"
+#include "../source/input-output.hpp"
+
+
+/// Amount of runs of every measure, the fastest one is printed
+const int BENCH_RUNS = 3;
+
+
+/// Max depth of random expressions
+const int EXPRESSION_DEPTH = 9;
+
+
+/// Path to temporary AST file
+const char *const BENCH_TREE_PATH = "bench_tree.ast";
+
+
+/**
+ * \brief Creates program-like tree of variable declarations with random expressions
+ * \param [in] statements Amount of statements
+ * \return Root of sequence of statements
+*/
+Node *get_random_program(int statements);
+
+
+/**
+ * \brief Creates random arithmetic expression
+ * \param [in] depth Max depth of expression
+ * \return Expression tree
+*/
+Node *get_random_expression(int depth);
+
+
+/// Returns current time in seconds
+double get_bench_time();
+
+
+/**
+ * \brief Writes, reads and reads flat tree in one format several times
+ * \param [in] tree   Tree to write
+ * \param [in] binary Non zero value means binary format
+*/
+void bench_format(Tree *tree, int binary);
+
+
+
+
+int main(int argc, char *argv[]) {
+    // Text AST indents every statement deeper than previous one, so its size grows as square of statements amount
+    int statements = (argc > 1)? atoi(argv[1]) : 500;
+
+    if (statements < 1) {
+        printf("Usage: %s [statements]\n", argv[0]);
+        return 1;
+    }
+
+    srand(1);
+
+    Tree tree = {get_random_program(statements), 0};
+
+    bench_format(&tree, 0);
+    bench_format(&tree, 1);
+
+    remove(BENCH_TREE_PATH);
+
+    tree_destructor(&tree);
+
+    free_ident_table();
+
+    return 0;
+}
+
+
+Node *get_random_program(int statements) {
+    Node *program = nullptr, **tail = &program;
+
+    for (int i = 0; i < statements; i++, tail = &(*tail) -> right) {
+        NodeValue name = {0};
+        name.id = intern_ident_name((rand() % 2)? "VAR_22B14C_00E5384E" : "VAR_22B14C_0052F49D");
+
+        *tail = create_node(TYPE_SEQ, {0}, create_node(TYPE_NVAR, name, nullptr, get_random_expression(EXPRESSION_DEPTH)));
+    }
+
+    return program;
+}
+
+
+Node *get_random_expression(int depth) {
+    if (depth == 0 || rand() % 4 == 0) {
+        NodeValue value = {0};
+
+        if (rand() % 2) {
+            value.dbl = (double) (rand() % 100000) / 1000;
+            return create_node(TYPE_NUM, value);
+        }
+
+        value.id = intern_ident_name((rand() % 2)? "VAR_22B14C_00E5384E" : "VAR_22B14C_0052F49D");
+        return create_node(TYPE_VAR, value);
+    }
+
+    NodeValue op = {0};
+    op.op = rand() % 4 + OP_ADD;
+
+    return create_node(TYPE_OP, op, get_random_expression(depth - 1), get_random_expression(depth - 1));
+}
+
+
+double get_bench_time() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+void bench_format(Tree *tree, int binary) {
+    double write_time = 0, read_time = 0, flat_time = 0;
+
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        double start = get_bench_time();
+
+        write_tree(tree, BENCH_TREE_PATH, binary);
+
+        double written = get_bench_time();
+
+        // Read tree gets its own arena, so freeing it doesn't free the tree that is written
+        NodeArena arena = {};
+        NodeArena *previous = set_node_arena(&arena);
+
+        Tree copy = {};
+        read_tree(&copy, BENCH_TREE_PATH);
+
+        set_node_arena(previous);
+
+        double read = get_bench_time();
+
+        FlatTree flat = {};
+        read_flat_tree(&flat, BENCH_TREE_PATH);
+
+        double flat_read = get_bench_time();
+
+        if (!run || written - start < write_time) write_time = written - start;
+        if (!run || read - written < read_time) read_time = read - written;
+        if (!run || flat_read - read < flat_time) flat_time = flat_read - read;
+
+        free_node_arena(&arena);
+        flat_tree_destructor(&flat);
+    }
+
+    struct stat file_stat = {};
+    stat(BENCH_TREE_PATH, &file_stat);
+
+    double size = (double) file_stat.st_size / 1e6;
+
+    printf("%s AST %.1f MB\n", (binary)? "Binary" : "Text", size);
+    printf("    write_tree     %8.1f ms %8.0f MB/s\n", write_time * 1000, size / write_time);
+    printf("    read_tree      %8.1f ms %8.0f MB/s\n", read_time * 1000, size / read_time);
+    printf("    read_flat_tree %8.1f ms %8.0f MB/s\n", flat_time * 1000, size / flat_time);
+}
@@ -0,0 +1,264 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include "../source/libs/tree.hpp"
+#include "../source/libs/ident.hpp"
+#include "../source/image_parser.hpp"
+#include "../source/symbol_parser.hpp"
+
+
+/// Amount of runs of every measure, the fastest one is printed
+const int BENCH_RUNS = 5;
+
+
+/// Shape classifier that is compared
+typedef int (*ShapeClassifier)(unsigned int shape);
+
+
+/// Shapes that are lexems themselves
+const unsigned int TOKEN_SHAPES[] = {
+    SHAPE_SEQ, SHAPE_CONT, SHAPE_BLOCK_BEGIN, SHAPE_BLOCK_END, SHAPE_BRACKET_BEGIN, SHAPE_BRACKET_END,
+    SHAPE_IF, SHAPE_WHILE, SHAPE_NVAR, SHAPE_DEF, SHAPE_RET, SHAPE_ELSE,
+    SHAPE_ADD, SHAPE_SUB, SHAPE_MUL, SHAPE_DIV, SHAPE_AND, SHAPE_OR, SHAPE_NOT, SHAPE_ASS,
+    SHAPE_EQ, SHAPE_NEQ, SHAPE_GRE, SHAPE_LES, SHAPE_GEQ, SHAPE_LEQ, SHAPE_DIF,
+};
+
+
+/// Shapes of digits from zero to nine
+const unsigned int DIGIT_SHAPES[] = {
+    SHAPE_ZERO, SHAPE_ONE, SHAPE_TWO, SHAPE_THREE, SHAPE_FOUR, SHAPE_FIVE, SHAPE_SIX, SHAPE_SEVEN, SHAPE_EIGHT, SHAPE_NINE,
+};
+
+
+/**
+ * \brief Creates program-like stream of shapes, lexems are separated by empty shapes
+ * \param [in]  lexems Amount of lexems
+ * \param [out] size   Amount of shapes
+ * \return Array of shapes that ends with TERMINATOR
+*/
+unsigned int *get_random_shapes(int lexems, int *size);
+
+
+/// Gives digit of shape with switch like lexer did before shape table
+int switch_to_digit(unsigned int shape);
+
+
+/// Tells if shape is reserved with switch like lexer did before shape table
+int switch_is_reserved_shape(unsigned int shape);
+
+
+/**
+ * \brief Classifies every shape of stream several times
+ * \param [in]  shapes     Shapes to classify
+ * \param [in]  size       Amount of shapes
+ * \param [in]  digit      Function that gives digit of shape
+ * \param [in]  reserved   Function that tells if shape is reserved
+ * \param [out] checksum   Sum of all classification results
+ * \return Time of the fastest run in milliseconds
+*/
+double time_classifier(const unsigned int *shapes, int size, ShapeClassifier digit, ShapeClassifier reserved, long long *checksum);
+
+
+/**
+ * \brief Lexes stream of shapes several times
+ * \param [in]  shapes Shapes to lex
+ * \param [in]  size   Amount of shapes
+ * \param [out] tokens Amount of lexems
+ * \return Time of the fastest run in milliseconds
+*/
+double time_lexer(const unsigned int *shapes, int size, int *tokens);
+
+
+
+
+int main(int argc, char *argv[]) {
+    int lexems = (argc > 1)? atoi(argv[1]) : 1 << 20;
+
+    if (lexems < 1) {
+        printf("Usage: %s [lexems]\n", argv[0]);
+        return 1;
+    }
+
+    srand(1);
+
+    int size = 0;
+    unsigned int *shapes = get_random_shapes(lexems, &size);
+
+    long long table_sum = 0, switch_sum = 0;
+
+    double table_time = time_classifier(shapes, size, &to_digit, &is_reserved_shape, &table_sum);
+    double switch_time = time_classifier(shapes, size, &switch_to_digit, &switch_is_reserved_shape, &switch_sum);
+
+    printf("Classification of %i shapes\n", size);
+    printf("switch %9.2f ms\n", switch_time);
+    printf("table  %9.2f ms %7.2fx\n", table_time, switch_time / table_time);
+
+    int tokens = 0;
+    double lexer_time = time_lexer(shapes, size, &tokens);
+
+    printf("lex_symbol %.2f ms, %i lexems, %.1f M shapes/s\n", lexer_time, tokens, size / lexer_time / 1000);
+
+    free(shapes);
+
+    free_ident_table();
+
+    if (table_sum != switch_sum) {
+        printf("Table and switch classify shapes differently!\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+
+unsigned int *get_random_shapes(int lexems, int *size) {
+    const int MAX_LEXEM_SIZE = 10;
+
+    unsigned int *shapes = (unsigned int *) calloc((size_t) lexems * MAX_LEXEM_SIZE + 1, sizeof(unsigned int));
+
+    int count = 0;
+
+    for (int i = 0; i < lexems; i++) {
+        switch (rand() % 3) {
+            case 0:
+                shapes[count++] = TOKEN_SHAPES[rand() % (int) (sizeof(TOKEN_SHAPES) / sizeof(TOKEN_SHAPES[0]))];
+                break;
+            case 1: {
+                for (int digits = rand() % 4 + 1; digits > 0; digits--) shapes[count++] = DIGIT_SHAPES[rand() % 10];
+
+                if (rand() % 2) {
+                    shapes[count++] = SHAPE_DOT;
+                    shapes[count++] = DIGIT_SHAPES[rand() % 10];
+                }
+
+                break;
+            }
+            default: {
+                // Identificators use few shapes, so table is interned the same way as in real programs
+                for (int length = rand() % 4 + 1; length > 0; length--) {
+                    unsigned int shape = 0;
+
+                    do shape = (unsigned int) (rand() % 64 + 1) << 10; while (is_reserved_shape(shape) || to_digit(shape) != -1);
+
+                    shapes[count++] = shape;
+                }
+
+                break;
+            }
+        }
+
+        shapes[count++] = 0;
+    }
+
+    shapes[count++] = TERMINATOR;
+
+    *size = count;
+
+    return shapes;
+}
+
+
+int switch_to_digit(unsigned int shape) {
+    switch (shape & SHAPE_BTIMASK) {
+        case SHAPE_ZERO:      return 0;
+        case SHAPE_ONE:       return 1;
+        case SHAPE_TWO:       return 2;
+        case SHAPE_THREE:     return 3;
+        case SHAPE_FOUR:      return 4;
+        case SHAPE_FIVE:      return 5;
+        case SHAPE_SIX:       return 6;
+        case SHAPE_SEVEN:     return 7;
+        case SHAPE_EIGHT:     return 8;
+        case SHAPE_NINE:      return 9;
+        default:              return -1;
+    }
+}
+
+
+#define RETURN_ONE(shape_name) case shape_name: return 1;
+
+int switch_is_reserved_shape(unsigned int shape) {
+    switch (shape & SHAPE_BTIMASK) {
+        RETURN_ONE(SHAPE_SEQ)
+        RETURN_ONE(SHAPE_CONT)
+        RETURN_ONE(SHAPE_RET)
+        RETURN_ONE(SHAPE_BLOCK_BEGIN)
+        RETURN_ONE(SHAPE_BLOCK_END)
+        RETURN_ONE(SHAPE_BRACKET_BEGIN)
+        RETURN_ONE(SHAPE_BRACKET_END)
+        RETURN_ONE(SHAPE_IF)
+        RETURN_ONE(SHAPE_WHILE)
+        RETURN_ONE(SHAPE_NVAR)
+        RETURN_ONE(SHAPE_DEF)
+        RETURN_ONE(SHAPE_ADD)
+        RETURN_ONE(SHAPE_SUB)
+        RETURN_ONE(SHAPE_MUL)
+        RETURN_ONE(SHAPE_DIV)
+        RETURN_ONE(SHAPE_AND)
+        RETURN_ONE(SHAPE_OR)
+        RETURN_ONE(SHAPE_NOT)
+        RETURN_ONE(SHAPE_ASS)
+        RETURN_ONE(SHAPE_DOT)
+        RETURN_ONE(SHAPE_EQ)
+        RETURN_ONE(SHAPE_NEQ)
+        RETURN_ONE(SHAPE_GRE)
+        RETURN_ONE(SHAPE_LES)
+        RETURN_ONE(SHAPE_GEQ)
+        RETURN_ONE(SHAPE_LEQ)
+        RETURN_ONE(SHAPE_ELSE)
+        RETURN_ONE(SHAPE_DIF)
+        RETURN_ONE(SHAPE_COM)
+        RETURN_ONE(TERMINATOR)
+        default: return 0;
+    }
+}
+
+#undef RETURN_ONE
+
+
+double time_classifier(const unsigned int *shapes, int size, ShapeClassifier digit, ShapeClassifier reserved, long long *checksum) {
+    double best = 0;
+
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        long long sum = 0;
+
+        auto start = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < size; i++) sum += (*digit)(shapes[i]) * 2 + (*reserved)(shapes[i]);
+
+        double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if (!run || time < best) best = time;
+
+        *checksum = sum;
+    }
+
+    return best;
+}
+
+
+double time_lexer(const unsigned int *shapes, int size, int *tokens) {
+    const Pixel COLOR = {0, 0, 0, 255};
+
+    double best = 0;
+
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        Lexer lexer = {};
+        lexer.tokens = (Token *) calloc((size_t) size + LEX_SYMBOL_TOKENS, sizeof(Token));
+
+        auto start = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < size; i++) lex_symbol(&lexer, shapes[i], &COLOR);
+
+        double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if (!run || time < best) best = time;
+
+        *tokens = lexer.size;
+
+        free(lexer.tokens);
+        free(lexer.numbers);
+    }
+
+    return best;
+}
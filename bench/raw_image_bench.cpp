@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "../source/image_parser.hpp"
+
+
+/// Amount of reads of every file, the fastest one is printed
+const int BENCH_RUNS = 5;
+
+
+/// Image format that is compared
+typedef struct {
+    const char *path = nullptr;                                             ///< Path to temporary file
+    void (*write)(const char *path, int width, int height, const Pixel *pixels) = nullptr;    ///< Function that writes file
+} BenchFormat;
+
+
+/**
+ * \brief Creates random program-like symbols grid
+ * \param [in] width  Grid width in symbols
+ * \param [in] height Grid height in symbols
+ * \return Array of width * height symbols
+*/
+Symbol *get_random_symbols(int width, int height);
+
+
+/// Writes binary PPM (P6)
+void write_ppm(const char *path, int width, int height, const Pixel *pixels);
+
+
+/// Writes PAM (P7) with alpha channel
+void write_pam(const char *path, int width, int height, const Pixel *pixels);
+
+
+/// Writes QOI with runs and full RGBA chunks only
+void write_qoi(const char *path, int width, int height, const Pixel *pixels);
+
+
+/// Writes value in big endian order
+void put_big_endian(FILE *file, unsigned int value);
+
+
+/**
+ * \brief Reads symbols of file several times
+ * \param [in]  path    Path to image
+ * \param [out] symbols Symbols from the last read, they must be freed
+ * \return Time of the fastest read in milliseconds
+*/
+double time_read_symbols(const char *path, SymbolBuffer *symbols);
+
+
+
+
+int main(int argc, char *argv[]) {
+    int width = (argc > 1)? atoi(argv[1]) : 600, height = (argc > 2)? atoi(argv[2]) : 600;
+
+    if (width < 1 || height < 1) {
+        printf("Usage: %s [width height] in symbols\n", argv[0]);
+        return 1;
+    }
+
+    const BenchFormat FORMATS[] = {
+        {"bench_image.png", &write_image},
+        {"bench_image.qoi", &write_qoi},
+        {"bench_image.ppm", &write_ppm},
+        {"bench_image.pam", &write_pam},
+    };
+
+    const int FORMAT_COUNT = (int) (sizeof(FORMATS) / sizeof(BenchFormat));
+
+    srand(1);
+
+    Symbol *grid = get_random_symbols(width, height);
+    Pixel *pixels = symbols_to_pixels(width, height, grid);
+
+    printf("Symbols grid %ix%i, image %ix%i\n", width, height, width * (SYMBOL_SIZE + 1), height * (SYMBOL_SIZE + 1));
+
+    SymbolBuffer reference = {};
+    double png_time = 0;
+    int error = 0;
+
+    for (int i = 0; i < FORMAT_COUNT; i++) {
+        (*FORMATS[i].write)(FORMATS[i].path, width * (SYMBOL_SIZE + 1), height * (SYMBOL_SIZE + 1), pixels);
+
+        SymbolBuffer symbols = {};
+        double time = time_read_symbols(FORMATS[i].path, &symbols);
+
+        if (!i) png_time = time;
+
+        printf("%-16s %9.2f ms %7.2fx\n", FORMATS[i].path, time, png_time / time);
+
+        // Every format must give the same grid
+        if (!i) reference = symbols;
+        else {
+            if (symbols.size != reference.size || memcmp(symbols.shapes, reference.shapes, symbols.size * sizeof(unsigned int))) {
+                printf("%s gives another symbols grid!\n", FORMATS[i].path);
+                error = 1;
+            }
+
+            free_symbol_buffer(&symbols);
+        }
+
+        remove(FORMATS[i].path);
+    }
+
+    free_symbol_buffer(&reference);
+    free(pixels);
+    free(grid);
+
+    return error;
+}
+
+
+Symbol *get_random_symbols(int width, int height) {
+    const Pixel COLORS[] = {{0, 0, 0, 255}, {34, 177, 76, 255}, {237, 28, 36, 255}, {63, 72, 204, 255}};
+
+    Symbol *symbols = (Symbol *) calloc((size_t) width * height, sizeof(Symbol));
+
+    // Code has lines of different length and blank lines
+    for (int y = 0; y < height; y++) {
+        int length = (rand() % 4)? rand() % width : 0;
+
+        for (int x = 0; x < length; x++) {
+            symbols[(size_t) y * width + x].shape = (unsigned int) rand() % TERMINATOR;
+            symbols[(size_t) y * width + x].color = COLORS[rand() % 4];
+        }
+    }
+
+    return symbols;
+}
+
+
+void write_ppm(const char *path, int width, int height, const Pixel *pixels) {
+    FILE *file = fopen(path, "wb");
+
+    fprintf(file, "P6\n%i %i\n255\n", width, height);
+
+    for (size_t i = 0; i < (size_t) width * height; i++) {
+        fputc(pixels[i].r, file);
+        fputc(pixels[i].g, file);
+        fputc(pixels[i].b, file);
+    }
+
+    fclose(file);
+}
+
+
+void write_pam(const char *path, int width, int height, const Pixel *pixels) {
+    FILE *file = fopen(path, "wb");
+
+    fprintf(file, "P7\nWIDTH %i\nHEIGHT %i\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n", width, height);
+
+    fwrite(pixels, sizeof(Pixel), (size_t) width * height, file);
+
+    fclose(file);
+}
+
+
+void write_qoi(const char *path, int width, int height, const Pixel *pixels) {
+    const int MAX_RUN = 62;
+
+    FILE *file = fopen(path, "wb");
+
+    fwrite("qoif", 1, 4, file);
+    put_big_endian(file, (unsigned int) width);
+    put_big_endian(file, (unsigned int) height);
+    fputc(4, file);
+    fputc(0, file);
+
+    Pixel prev = {0, 0, 0, 255};
+    int run = 0;
+
+    for (size_t i = 0; i < (size_t) width * height; i++) {
+        if (!memcmp(pixels + i, &prev, sizeof(Pixel)) && run < MAX_RUN) {
+            run++;
+            continue;
+        }
+
+        if (run) fputc(0xC0 | (run - 1), file);
+        run = 0;
+
+        if (!memcmp(pixels + i, &prev, sizeof(Pixel))) {
+            run = 1;
+            continue;
+        }
+
+        fputc(0xFF, file);
+        fwrite(pixels + i, sizeof(Pixel), 1, file);
+
+        prev = pixels[i];
+    }
+
+    if (run) fputc(0xC0 | (run - 1), file);
+
+    fwrite("\0\0\0\0\0\0\0\1", 1, 8, file);
+
+    fclose(file);
+}
+
+
+void put_big_endian(FILE *file, unsigned int value) {
+    for (int shift = 24; shift >= 0; shift -= 8) fputc((int) (value >> shift) & 0xFF, file);
+}
+
+
+double time_read_symbols(const char *path, SymbolBuffer *symbols) {
+    double best = 0;
+
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        auto start = std::chrono::steady_clock::now();
+
+        SymbolBuffer buffer = read_symbols(path);
+
+        double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if (!run || time < best) best = time;
+
+        if (run < BENCH_RUNS - 1) free_symbol_buffer(&buffer);
+        else *symbols = buffer;
+    }
+
+    return best;
+}
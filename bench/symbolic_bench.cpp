@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include "../source/libs/tree.hpp"
+#include "../source/libs/ident.hpp"
+#include "../source/symbolic.hpp"
+
+
+/// Amount of runs of every measure, the fastest one is printed
+const int BENCH_RUNS = 3;
+
+
+/// Expression that is differentiated, its denominators are near one at bench points, so derivatives of high orders don't overflow
+const char *const BENCH_EXPRESSION = "x * x * y / (x - 1) + y * y / (x * y - 1)";
+
+
+/// Orders of derivatives that are measured
+const int BENCH_ORDERS[] = {2, 4, 6, 8, 10};
+
+
+/// Variables of expression in order of point arrays
+const char *const BENCH_VARS[] = {"x", "y"};
+
+
+/// Returns current time in milliseconds
+double get_bench_time();
+
+
+/**
+ * \brief Compiles expression and evaluates it in every point several times
+ * \param [in]  expression Expression to evaluate
+ * \param [in]  points     Arrays of x and y values
+ * \param [out] results    Values in every point
+ * \param [in]  count      Amount of points
+ * \param [out] size       Amount of program instructions
+ * \return Time of the fastest run in milliseconds
+*/
+double time_evaluation(const Node *expression, const double *const *points, double *results, size_t count, int *size);
+
+
+
+
+int main(int argc, char *argv[]) {
+    int count = (argc > 1)? atoi(argv[1]) : 1 << 14;
+
+    if (count < 1) {
+        printf("Usage: %s [points]\n", argv[0]);
+        return 1;
+    }
+
+    double *xs = (double *) calloc((size_t) count, sizeof(double));
+    double *ys = (double *) calloc((size_t) count, sizeof(double));
+    double *raw = (double *) calloc((size_t) count, sizeof(double));
+    double *simple = (double *) calloc((size_t) count, sizeof(double));
+
+    for (int i = 0; i < count; i++) {
+        xs[i] = 2 + 0.001 * sin(i);
+        ys[i] = 1 + 0.001 * cos(3 * i);
+    }
+
+    const double *points[] = {xs, ys};
+
+    printf("Derivatives of %s in %i points\n", BENCH_EXPRESSION, count);
+    printf("order | diff ms | simplify ms | raw code | raw Mpts/s | simple code | simple Mpts/s | max difference\n");
+
+    for (int i = 0; i < (int) (sizeof(BENCH_ORDERS) / sizeof(BENCH_ORDERS[0])); i++) {
+        SymbolContext context = {};
+
+        Node *expression = parse_symbolic(&context, BENCH_EXPRESSION);
+
+        double start = get_bench_time();
+
+        for (int order = 0; order < BENCH_ORDERS[i]; order++) expression = diff_symbolic(&context, expression, (order % 3 == 2)? "y" : "x");
+
+        double diff_time = get_bench_time() - start;
+
+        int raw_size = 0, simple_size = 0;
+        double raw_time = time_evaluation(expression, points, raw, (size_t) count, &raw_size);
+
+        start = get_bench_time();
+
+        Node *simplified = simplify_symbolic(&context, expression);
+
+        double simplify_time = get_bench_time() - start;
+
+        double simple_time = time_evaluation(simplified, points, simple, (size_t) count, &simple_size);
+
+        double difference = 0;
+
+        for (int j = 0; j < count; j++) difference = fmax(difference, fabs(simple[j] - raw[j]) / fmax(1, fabs(raw[j])));
+
+        printf("%5i | %7.2f | %11.2f | %8i | %10.2f | %11i | %13.2f | %.1e\n", BENCH_ORDERS[i], diff_time, simplify_time,
+               raw_size, count / raw_time / 1000, simple_size, count / simple_time / 1000, difference);
+
+        free_symbol_context(&context);
+    }
+
+    free(xs);
+    free(ys);
+    free(raw);
+    free(simple);
+
+    free_ident_table();
+
+    return 0;
+}
+
+
+double get_bench_time() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+double time_evaluation(const Node *expression, const double *const *points, double *results, size_t count, int *size) {
+    SymbolProgram program = {};
+
+    if (compile_symbolic(&program, expression, BENCH_VARS, 2)) {
+        printf("Expression is not compiled!\n");
+        return NAN;
+    }
+
+    *size = program.size;
+
+    double best = 0;
+
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        double start = get_bench_time();
+
+        eval_symbolic(&program, points, results, count);
+
+        double time = get_bench_time() - start;
+
+        if (!run || time < best) best = time;
+    }
+
+    free_symbolic_program(&program);
+
+    return best;
+}
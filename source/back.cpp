@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include "libs/parser.hpp"
 #include "libs/tree.hpp"
+#include "libs/ident.hpp"
 #include "input-output.hpp"
 #include "program.hpp"
 
@@ -36,15 +37,17 @@ int main(int argc, char *argv[]) {
 
     parse_args(argc, argv, command_list, sizeof(command_list) / sizeof(Command));
 
-    Tree tree = {};
+    FlatTree tree = {};
 
-    if (read_tree(&tree, ast_path)) return 1;
+    NodeIndex root = read_flat_tree(&tree, ast_path);
 
-    // graphic_dump(&tree);
+    if (!root) return 1;
 
-    print_program(&tree, asm_source_path);
+    print_program(&tree, root, asm_source_path);
 
-    tree_destructor(&tree);
+    flat_tree_destructor(&tree);
+
+    free_ident_table();
 
     printf("Backend!\n");
 
@@ -0,0 +1,743 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "libs/tree.hpp"
+#include "libs/ident.hpp"
+#include "canon.hpp"
+
+
+/// Max amount of different atoms in one product
+const int TERM_FACTORS = 8;
+
+
+
+/// Atom of product raised to integer power
+typedef struct {
+    int atom = 0;                       ///< Index of atom in atom table
+    int power = 0;                      ///< Power of atom, negative one means that atom is in denominator
+} Factor;
+
+
+/// Product of rational coefficient and atoms
+typedef struct {
+    double num = 1;                     ///< Coefficient numerator
+    double den = 1;                     ///< Coefficient denominator
+    Factor factors[TERM_FACTORS] = {};  ///< Factors sorted by atoms
+    int size = 0;                       ///< Amount of factors
+} Term;
+
+
+/// Sum of products
+typedef struct {
+    Term *terms = nullptr;              ///< Terms, empty sum is zero
+    int size = 0;                       ///< Amount of terms
+    int capacity = 0;                   ///< Size of terms array
+} Poly;
+
+
+/// Variables and subtrees that are not expanded, they are stored once and compared by index
+typedef struct {
+    Node **atoms = nullptr;             ///< Canonical atom nodes
+    int size = 0;                       ///< Amount of atoms
+    int capacity = 0;                   ///< Size of atoms array
+} AtomTable;
+
+
+/// Open addressing table that links nodes to numbers by their addresses
+typedef struct {
+    const Node **keys = nullptr;        ///< Linked nodes or nullptr for empty cells
+    int *values = nullptr;              ///< Numbers that nodes are linked to
+    int size = 0;                       ///< Amount of links
+    int capacity = 0;                   ///< Amount of cells, power of two
+} NodeTable;
+
+
+/// Sums of arithmetic nodes that several parents share, so every one of them is expanded once
+typedef struct {
+    NodeTable parents = {};             ///< Arithmetic nodes linked to amounts of their parents
+    NodeTable indices = {};             ///< Shared nodes linked to indices of their sums
+    Poly *sums = nullptr;               ///< Normalized sums of shared nodes
+    int size = 0;                       ///< Amount of sums
+    int capacity = 0;                   ///< Size of sums array
+} SumTable;
+
+
+
+
+/// Atoms of the expression that is being canonized
+AtomTable atom_table = {};
+
+
+/// Sums of shared nodes of the expression that is being canonized
+SumTable sum_table = {};
+
+
+/// Nodes that canonization has already visited
+NodeTable canonized = {};
+
+
+/// Nodes linked to non zero value if their subtrees contain function call
+NodeTable calls = {};
+
+
+/// Nodes of the whole expression linked to amounts of their parents, it is empty if shared nodes are expanded
+NodeTable uses = {};
+
+
+/// Canonizes branch, nodes that several parents share are canonized once
+void canonize_node(Node *node);
+
+
+/// Non zero value means that node is addition, subtraction, multiplication or division
+int is_arithmetic(const Node *node);
+
+
+/// Non zero value means that subtree contains function call
+int has_call(const Node *node);
+
+
+/**
+ * \brief Adds arithmetic subtree to sum of products, sums of shared nodes are taken from sum table
+ * \param [in]  node Arithmetic subtree without calls
+ * \param [out] poly Sum to add terms to, they are not normalized
+ * \param [in]  sign Terms are multiplied by it
+*/
+void get_poly(Node *node, Poly *poly, double sign);
+
+
+/// Expands node to sum of products, its operands are added by get_poly()
+void expand_poly(Node *node, Poly *poly, double sign);
+
+
+/// Counts parents of arithmetic nodes that get_poly() expands
+void count_parents(const Node *node);
+
+
+/// Counts parents of every node of expression
+void count_uses(const Node *node);
+
+
+/// Gives index of normalized sum of shared node in sum table, sum is expanded on the first call
+int get_shared_sum(Node *node);
+
+
+/**
+ * \brief Builds minimal tree of sum
+ * \param [in] poly Normalized sum
+ * \return New tree
+*/
+Node *build_poly(const Poly *poly);
+
+
+/**
+ * \brief Builds product
+ * \param [in] term      Term to build
+ * \param [in] with_sign Non zero value means that negative coefficient keeps its sign, otherwise its abs value is used
+ * \return New tree
+*/
+Node *build_term(const Term *term, int with_sign);
+
+
+/// Gives index of atom that is equal to node
+int get_atom(Node *node);
+
+
+/// Adds term to the end of sum
+void add_term(Poly *poly, const Term *term);
+
+
+/**
+ * \brief Multiplies terms, atoms in equal powers are merged
+ * \param [out] result Product
+ * \param [in]  a      First term
+ * \param [in]  b      Second term
+ * \return Non zero value means that product has too many factors
+*/
+int mul_terms(Term *result, const Term *a, const Term *b);
+
+
+/**
+ * \brief Multiplies sums expanding brackets
+ * \param [out] result Empty sum for product
+ * \param [in]  a      First sum
+ * \param [in]  b      Second sum
+ * \return Non zero value means that product has more terms than sums or too many factors, result stays empty
+*/
+int mul_poly(Poly *result, const Poly *a, const Poly *b);
+
+
+/// Replaces normalized sum with one atom of its tree
+void wrap_poly(Poly *poly);
+
+
+/// Replaces normalized monomial with its inverse
+void invert_term(Term *term);
+
+
+/// Sorts terms and collects like ones, zero terms are removed
+void normalize_poly(Poly *poly);
+
+
+/// Compares subtrees, variables are ordered by their names
+int compare_nodes(const Node *a, const Node *b);
+
+
+/// Compares factors of terms, coefficients are ignored
+int compare_terms(const void *a, const void *b);
+
+
+/// Frees terms of sum
+void free_poly(Poly *poly);
+
+
+/// Gives number that node is linked to or -1
+int find_node_value(const NodeTable *table, const Node *node);
+
+
+/// Links node to number
+void set_node_value(NodeTable *table, const Node *node, int value);
+
+
+/// Frees cells of table
+void free_node_table(NodeTable *table);
+
+
+/// Frees sums of sum table
+void free_sum_table(SumTable *table);
+
+
+/// Abs value of double
+#define ABS(value) (((value) < 0)? -(value) : (value))
+
+/// Non zero value means that double is equal to number exactly
+#define IS_EXACTLY(value, number) (!((value) < (number)) && !((value) > (number)))
+
+/// Creates operator node
+#define OP_NODE(op, left, right) create_node(NODE_TYPES::TYPE_OP, {OPERATORS::OP_##op}, left, right)
+
+/// First cell of node in node table, nodes are hashed by their addresses
+#define NODE_CELL(node, table) ((int) ((size_t) (node) >> 4) & ((table) -> capacity - 1))
+
+
+
+
+void canonize(Node *node, int keep_shared) {
+    if (keep_shared) count_uses(node);
+
+    canonize_node(node);
+
+    free_node_table(&canonized);
+    free_node_table(&calls);
+    free_node_table(&uses);
+}
+
+
+void canonize_node(Node *node) {
+    if (!node || find_node_value(&canonized, node) != -1) return;
+
+    set_node_value(&canonized, node, 1);
+
+    if (!is_arithmetic(node) || has_call(node)) {
+        canonize_node(node -> left);
+        canonize_node(node -> right);
+        return;
+    }
+
+    // Operands of atoms are canonized with their own atoms
+    AtomTable outer_table = atom_table;
+    atom_table = {};
+
+    SumTable outer_sums = sum_table;
+    sum_table = {};
+
+    count_parents(node);
+
+    Poly poly = {};
+
+    get_poly(node, &poly, 1);
+    normalize_poly(&poly);
+
+    Node *result = build_poly(&poly);
+
+    node -> type = result -> type;
+    node -> value = result -> value;
+    node -> left = result -> left;
+    node -> right = result -> right;
+
+    free_poly(&poly);
+
+    free_sum_table(&sum_table);
+    sum_table = outer_sums;
+
+    free(atom_table.atoms);
+    atom_table = outer_table;
+}
+
+
+int is_arithmetic(const Node *node) {
+    if (node -> type != NODE_TYPES::TYPE_OP) return 0;
+
+    switch (node -> value.op) {
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: return 1;
+        default: return 0;
+    }
+}
+
+
+int has_call(const Node *node) {
+    if (!node) return 0;
+
+    int result = find_node_value(&calls, node);
+
+    if (result == -1) {
+        result = node -> type == NODE_TYPES::TYPE_CALL || has_call(node -> left) || has_call(node -> right);
+        set_node_value(&calls, node, result);
+    }
+
+    return result;
+}
+
+
+void get_poly(Node *node, Poly *poly, double sign) {
+    if (is_arithmetic(node) && find_node_value(&uses, node) > 1) {
+        // Shared sum or product is canonized in its own place, so all its parents use the same atom
+        canonize_node(node);
+
+        Term term = {};
+        term.num = sign;
+        term.factors[0] = {get_atom(node), 1};
+        term.size = 1;
+
+        add_term(poly, &term);
+        return;
+    }
+
+    if (find_node_value(&sum_table.parents, node) < 2) {
+        expand_poly(node, poly, sign);
+        return;
+    }
+
+    int sum = get_shared_sum(node);
+
+    for (int i = 0; i < sum_table.sums[sum].size; i++) {
+        Term term = sum_table.sums[sum].terms[i];
+        term.num *= sign;
+
+        add_term(poly, &term);
+    }
+}
+
+
+void expand_poly(Node *node, Poly *poly, double sign) {
+    Term term = {};
+
+    if (node -> type == NODE_TYPES::TYPE_NUM) {
+        term.num = sign * node -> value.dbl;
+        add_term(poly, &term);
+        return;
+    }
+
+    if (!is_arithmetic(node) || !node -> left || !node -> right) {
+        // Comparisons, memory access and other operations are atoms, but their operands are canonized
+        canonize_node(node -> left);
+        canonize_node(node -> right);
+
+        term.num = sign;
+        term.factors[0] = {get_atom(node), 1};
+        term.size = 1;
+
+        add_term(poly, &term);
+        return;
+    }
+
+    if (node -> value.op == OP_ADD || node -> value.op == OP_SUB) {
+        get_poly(node -> left, poly, sign);
+        get_poly(node -> right, poly, (node -> value.op == OP_ADD)? sign : -sign);
+        return;
+    }
+
+    Poly left = {}, right = {}, product = {};
+
+    get_poly(node -> left, &left, sign);
+    get_poly(node -> right, &right, 1);
+
+    normalize_poly(&left);
+    normalize_poly(&right);
+
+    if (node -> value.op == OP_DIV) {
+        // Only monomials are inverted, other divisors stay atoms in denominator
+        if (right.size != 1) {
+            if (left.size > 1) wrap_poly(&left);
+            wrap_poly(&right);
+        }
+
+        invert_term(right.terms);
+    }
+
+    // Product of two atoms always fits
+    if (mul_poly(&product, &left, &right)) {
+        wrap_poly(&left);
+        wrap_poly(&right);
+
+        mul_poly(&product, &left, &right);
+    }
+
+    for (int i = 0; i < product.size; i++) add_term(poly, product.terms + i);
+
+    free_poly(&left);
+    free_poly(&right);
+    free_poly(&product);
+}
+
+
+void count_parents(const Node *node) {
+    // Numbers and atoms are not expanded, so their parents are not counted
+    if (!is_arithmetic(node) || !node -> left || !node -> right) return;
+
+    int parents = find_node_value(&sum_table.parents, node);
+
+    set_node_value(&sum_table.parents, node, (parents == -1)? 1 : parents + 1);
+
+    if (parents != -1) return;
+
+    count_parents(node -> left);
+    count_parents(node -> right);
+}
+
+
+void count_uses(const Node *node) {
+    if (!node) return;
+
+    int parents = find_node_value(&uses, node);
+
+    set_node_value(&uses, node, (parents == -1)? 1 : parents + 1);
+
+    if (parents != -1) return;
+
+    count_uses(node -> left);
+    count_uses(node -> right);
+}
+
+
+int get_shared_sum(Node *node) {
+    int index = find_node_value(&sum_table.indices, node);
+
+    if (index != -1) return index;
+
+    Poly sum = {};
+
+    expand_poly(node, &sum, 1);
+    normalize_poly(&sum);
+
+    if (sum_table.size == sum_table.capacity) {
+        sum_table.capacity = (sum_table.capacity)? 2 * sum_table.capacity : 16;
+        sum_table.sums = (Poly *) realloc(sum_table.sums, (size_t) sum_table.capacity * sizeof(Poly));
+    }
+
+    sum_table.sums[sum_table.size] = sum;
+    set_node_value(&sum_table.indices, node, sum_table.size);
+
+    return sum_table.size++;
+}
+
+
+Node *build_poly(const Poly *poly) {
+    if (poly -> size == 0) {
+        NodeValue value = {0};
+        value.dbl = 0;
+        return create_node(NODE_TYPES::TYPE_NUM, value);
+    }
+
+    Node *result = build_term(poly -> terms, 1);
+
+    for (int i = 1; i < poly -> size; i++) {
+        if (poly -> terms[i].num < 0) result = OP_NODE(SUB, result, build_term(poly -> terms + i, 0));
+        else result = OP_NODE(ADD, result, build_term(poly -> terms + i, 0));
+    }
+
+    return result;
+}
+
+
+Node *build_term(const Term *term, int with_sign) {
+    Node *numerator = nullptr, *denominator = nullptr;
+
+    NodeValue value = {0};
+    value.dbl = (with_sign)? term -> num : ABS(term -> num);
+
+    if (!IS_EXACTLY(value.dbl, 1.0)) numerator = create_node(NODE_TYPES::TYPE_NUM, value);
+
+    if (!IS_EXACTLY(term -> den, 1.0)) {
+        value.dbl = term -> den;
+        denominator = create_node(NODE_TYPES::TYPE_NUM, value);
+    }
+
+    for (int i = 0; i < term -> size; i++) {
+        Node *atom = atom_table.atoms[term -> factors[i].atom];
+
+        for (int j = 0; j < ABS(term -> factors[i].power); j++) {
+            Node **part = (term -> factors[i].power > 0)? &numerator : &denominator;
+
+            *part = (*part)? OP_NODE(MUL, *part, atom) : atom;
+        }
+    }
+
+    if (!numerator) {
+        value.dbl = 1;
+        numerator = create_node(NODE_TYPES::TYPE_NUM, value);
+    }
+
+    return (denominator)? OP_NODE(DIV, numerator, denominator) : numerator;
+}
+
+
+int get_atom(Node *node) {
+    for (int i = 0; i < atom_table.size; i++)
+        if (!compare_nodes(atom_table.atoms[i], node)) return i;
+
+    if (atom_table.size == atom_table.capacity) {
+        atom_table.capacity = (atom_table.capacity)? 2 * atom_table.capacity : 16;
+        atom_table.atoms = (Node **) realloc(atom_table.atoms, (size_t) atom_table.capacity * sizeof(Node *));
+    }
+
+    atom_table.atoms[atom_table.size] = node;
+
+    return atom_table.size++;
+}
+
+
+void add_term(Poly *poly, const Term *term) {
+    if (poly -> size == poly -> capacity) {
+        poly -> capacity = (poly -> capacity)? 2 * poly -> capacity : 4;
+        poly -> terms = (Term *) realloc(poly -> terms, (size_t) poly -> capacity * sizeof(Term));
+    }
+
+    poly -> terms[poly -> size++] = *term;
+}
+
+
+int mul_terms(Term *result, const Term *a, const Term *b) {
+    *result = {};
+
+    result -> num = a -> num * b -> num;
+    result -> den = a -> den * b -> den;
+
+    int i = 0, j = 0;
+
+    while (i < a -> size || j < b -> size) {
+        Factor factor = {};
+
+        if (j == b -> size) factor = a -> factors[i++];
+        else if (i == a -> size) factor = b -> factors[j++];
+        else {
+            int order = compare_nodes(atom_table.atoms[a -> factors[i].atom], atom_table.atoms[b -> factors[j].atom]);
+
+            if (order < 0) factor = a -> factors[i++];
+            else if (order > 0) factor = b -> factors[j++];
+            else {
+                factor = {a -> factors[i].atom, a -> factors[i].power + b -> factors[j].power};
+                i++, j++;
+            }
+        }
+
+        if (factor.power == 0) continue;
+
+        if (result -> size == TERM_FACTORS) return 1;
+
+        result -> factors[result -> size++] = factor;
+    }
+
+    return 0;
+}
+
+
+int mul_poly(Poly *result, const Poly *a, const Poly *b) {
+    // Expansion of big sums only makes tree bigger
+    if (a -> size * b -> size > a -> size + b -> size) return 1;
+
+    for (int i = 0; i < a -> size; i++) {
+        for (int j = 0; j < b -> size; j++) {
+            Term term = {};
+
+            if (mul_terms(&term, a -> terms + i, b -> terms + j)) {
+                free_poly(result);
+                return 1;
+            }
+
+            add_term(result, &term);
+        }
+    }
+
+    normalize_poly(result);
+
+    return 0;
+}
+
+
+void wrap_poly(Poly *poly) {
+    Term term = {};
+    term.factors[0] = {get_atom(build_poly(poly)), 1};
+    term.size = 1;
+
+    poly -> size = 0;
+    add_term(poly, &term);
+}
+
+
+void invert_term(Term *term) {
+    double num = term -> num;
+
+    term -> num = term -> den;
+    term -> den = num;
+
+    // Sign is kept in numerator
+    if (term -> den < 0) {
+        term -> num = -term -> num;
+        term -> den = -term -> den;
+    }
+
+    for (int i = 0; i < term -> size; i++) term -> factors[i].power = -term -> factors[i].power;
+}
+
+
+void normalize_poly(Poly *poly) {
+    qsort(poly -> terms, (size_t) poly -> size, sizeof(Term), &compare_terms);
+
+    int size = 0;
+
+    for (int i = 0; i < poly -> size; i++) {
+        Term *last = poly -> terms + size - 1;
+
+        if (size > 0 && !compare_terms(last, poly -> terms + i)) {
+            const Term *term = poly -> terms + i;
+
+            if (IS_EXACTLY(last -> den, term -> den)) {
+                last -> num += term -> num;
+            }
+            else {
+                last -> num = last -> num * term -> den + term -> num * last -> den;
+                last -> den *= term -> den;
+            }
+        }
+        else {
+            if (size > 0 && IS_EXACTLY(last -> num, 0.0)) size--;
+
+            poly -> terms[size++] = poly -> terms[i];
+        }
+    }
+
+    if (size > 0 && IS_EXACTLY(poly -> terms[size - 1].num, 0.0)) size--;
+
+    poly -> size = size;
+}
+
+
+int compare_nodes(const Node *a, const Node *b) {
+    // Shared subtree is equal to itself, so it is not walked for every its parent
+    if (a == b) return 0;
+
+    if (!a || !b) return (a)? 1 : (b)? -1 : 0;
+
+    if (a -> type != b -> type) return a -> type - b -> type;
+
+    switch (a -> type) {
+        case NODE_TYPES::TYPE_NUM: {
+            if (a -> value.dbl < b -> value.dbl) return -1;
+            if (a -> value.dbl > b -> value.dbl) return 1;
+            break;
+        }
+        case NODE_TYPES::TYPE_VAR: {
+            int order = strcmp(get_ident_name(a -> value.id), get_ident_name(b -> value.id));
+            if (order) return order;
+            break;
+        }
+        default: {
+            if (a -> value.op != b -> value.op) return a -> value.op - b -> value.op;
+            break;
+        }
+    }
+
+    int order = compare_nodes(a -> left, b -> left);
+
+    return (order)? order : compare_nodes(a -> right, b -> right);
+}
+
+
+int compare_terms(const void *a, const void *b) {
+    const Term *first = (const Term *) a, *second = (const Term *) b;
+
+    int first_degree = 0, second_degree = 0;
+
+    for (int i = 0; i < first -> size; i++) first_degree += ABS(first -> factors[i].power);
+    for (int i = 0; i < second -> size; i++) second_degree += ABS(second -> factors[i].power);
+
+    // Higher degrees go first and constant goes last
+    if (first_degree != second_degree) return second_degree - first_degree;
+
+    for (int i = 0; i < first -> size && i < second -> size; i++) {
+        const Factor *x = first -> factors + i, *y = second -> factors + i;
+
+        if (x -> atom != y -> atom) return compare_nodes(atom_table.atoms[x -> atom], atom_table.atoms[y -> atom]);
+        if (x -> power != y -> power) return y -> power - x -> power;
+    }
+
+    return first -> size - second -> size;
+}
+
+
+void free_poly(Poly *poly) {
+    free(poly -> terms);
+    *poly = {};
+}
+
+
+int find_node_value(const NodeTable *table, const Node *node) {
+    if (!table -> capacity) return -1;
+
+    for (int cell = NODE_CELL(node, table); table -> keys[cell]; cell = (cell + 1) & (table -> capacity - 1))
+        if (table -> keys[cell] == node) return table -> values[cell];
+
+    return -1;
+}
+
+
+void set_node_value(NodeTable *table, const Node *node, int value) {
+    if (2 * (table -> size + 1) > table -> capacity) {
+        NodeTable grown = {};
+
+        grown.capacity = (table -> capacity)? 2 * table -> capacity : 64;
+        grown.keys = (const Node **) calloc((size_t) grown.capacity, sizeof(const Node *));
+        grown.values = (int *) calloc((size_t) grown.capacity, sizeof(int));
+
+        for (int i = 0; i < table -> capacity; i++)
+            if (table -> keys[i]) set_node_value(&grown, table -> keys[i], table -> values[i]);
+
+        free_node_table(table);
+        *table = grown;
+    }
+
+    int cell = NODE_CELL(node, table);
+    while (table -> keys[cell] && table -> keys[cell] != node) cell = (cell + 1) & (table -> capacity - 1);
+
+    if (!table -> keys[cell]) table -> size++;
+
+    table -> keys[cell] = node;
+    table -> values[cell] = value;
+}
+
+
+void free_node_table(NodeTable *table) {
+    free(table -> keys);
+    free(table -> values);
+    *table = {};
+}
+
+
+void free_sum_table(SumTable *table) {
+    for (int i = 0; i < table -> size; i++) free_poly(table -> sums + i);
+
+    free(table -> sums);
+    free_node_table(&table -> parents);
+    free_node_table(&table -> indices);
+    *table = {};
+}
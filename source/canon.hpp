@@ -0,0 +1,9 @@
+/**
+ * \brief Rewrites arithmetic subtrees to sums of products with collected like terms and combined constants
+ * \param [in] node        Canonization will start from this branch
+ * \param [in] keep_shared Non zero value means that nodes with several parents are not expanded in them,
+ * every such node is canonized once and stays one atom, so DAG doesn't grow
+ * \note Terms and their factors are ordered deterministically, so equal expressions get equal trees.
+ * Subtrees with function calls are not rewritten, because calls order and count must stay the same
+*/
+void canonize(Node *node, int keep_shared = 0);
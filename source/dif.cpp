@@ -1,34 +1,310 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <assert.h>
 #include "libs/tree.hpp"
+#include "libs/ident.hpp"
 #include "dif.hpp"
 #include "dsl.hpp"
 
 
-///Copies origin parameters in destination and then destroys the origin
+/// Open addressing table that links nodes to other nodes by their addresses
+typedef struct {
+    const Node **keys = nullptr;        ///< Linked nodes or nullptr for empty cells
+    Node **values = nullptr;            ///< Nodes that keys are linked to
+    size_t size = 0;                    ///< Amount of links
+    size_t capacity = 0;                ///< Amount of cells, power of two
+} NodeMap;
+
+
+/// Hash-consed expression DAG, structurally identical subexpressions are stored in it once
+typedef struct {
+    Node **nodes = nullptr;             ///< Open addressing table of unique nodes
+    size_t size = 0;                    ///< Amount of unique nodes
+    size_t capacity = 0;                ///< Amount of cells, power of two
+    NodeMap copies = {};                ///< Nodes of original tree linked to their unique nodes
+    NodeMap derivatives = {};           ///< Unique nodes linked to their derivatives
+    int dif_var = 0;                    ///< Identificator of variable to differentiate for
+} ExpressionDag;
+
+
+/// State of reverse mode differentiation of one expression
+typedef struct {
+    ExpressionDag dag = {};             ///< DAG of expression
+    NodeMap values = {};                ///< Unique nodes linked to leaves or temporary variables with their values
+    NodeMap adjoints = {};              ///< Unique nodes linked to sums of their adjoints
+    NodeMap depends = {};               ///< Unique nodes that depend on differentiation variables linked to themselves
+    Node **order = nullptr;             ///< Unique nodes with temporary variables, children go before parents
+    int size = 0;                       ///< Amount of nodes in order
+    int capacity = 0;                   ///< Size of order array
+    const Node *vars = nullptr;         ///< Chain of argument nodes with differentiation variables
+    Node *statements = nullptr;         ///< Generated sequence of statements
+    Node **tail = nullptr;              ///< Place for the next statement
+} GradientSweep;
+
+
+///Copies origin parameters in destination, origin stays in arena until tree is destructed
 void copy_node(Node *origin, Node *destination);
 
 
+/**
+ * \brief Calculates hash of node by its type, value and children addresses
+ * \param [in] type  Node type
+ * \param [in] value Node value
+ * \param [in] left  Unique left child
+ * \param [in] right Unique right child
+ * \return Node hash
+*/
+size_t get_node_hash(int type, NodeValue value, const Node *left, const Node *right);
+
+
+/// Non zero value means that node has the same type, value and children
+int is_same_node(const Node *node, int type, NodeValue value, const Node *left, const Node *right);
+
+
+/**
+ * \brief Gives unique node with such type, value and children or creates it
+ * \param [in] dag   Expression DAG
+ * \param [in] type  Node type
+ * \param [in] value Node value
+ * \param [in] left  Unique left child
+ * \param [in] right Unique right child
+ * \return Unique node
+*/
+Node *cons_node(ExpressionDag *dag, int type, NodeValue value, Node *left, Node *right);
+
+
+/// Gives unique number node
+Node *cons_num(ExpressionDag *dag, double num);
+
+
+/**
+ * \brief Adds every node of tree to DAG
+ * \param [in] dag  Expression DAG
+ * \param [in] node Original tree or DAG
+ * \return Unique node that is equal to original one
+*/
+Node *cons_tree(ExpressionDag *dag, const Node *node);
+
+
+/**
+ * \brief Differentiates unique node, derivatives of already seen nodes are not calculated again
+ * \param [in] dag  Expression DAG
+ * \param [in] node Unique node
+ * \return Unique node of derivative
+*/
+Node *diff_node(ExpressionDag *dag, Node *node);
+
+
+/// Gives node that key is linked to or nullptr
+Node *find_node_link(const NodeMap *map, const Node *key);
+
+
+/// Links key to value, returns non zero value in case of error
+int add_node_link(NodeMap *map, const Node *key, Node *value);
+
+
+/// Frees DAG tables, nodes stay in arena
+void free_expression_dag(ExpressionDag *dag);
+
+
+/**
+ * \brief Gives temporary variables to operations of DAG in order of evaluation
+ * \param [in] sweep State of differentiation
+ * \param [in] node  Unique node
+*/
+void sort_gradient_nodes(GradientSweep *sweep, Node *node);
+
+
+/// Non zero value means that node is a call of library square root
+int is_sqrt_call(const Node *node);
+
+
+/// Gives new node with value of unique node
+Node *use_value(GradientSweep *sweep, const Node *node);
+
+
+/// Creates variable with new name for gradient code
+Node *create_temp_variable();
+
+
+/// Adds statement to the end of generated sequence
+void add_gradient_statement(GradientSweep *sweep, Node *statement);
+
+
+/**
+ * \brief Adds term to adjoint of node if node depends on differentiation variables
+ * \param [in] sweep    State of differentiation
+ * \param [in] node     Unique node
+ * \param [in] term     Term to add
+ * \param [in] negative Non zero value means that term is subtracted
+*/
+void add_adjoint(GradientSweep *sweep, Node *node, Node *term, int negative);
+
+
+/// Multiplies adjoint by factor, adjoint equal to one is skipped
+Node *scale_adjoint(const Node *adjoint, Node *factor);
+
+
+/// Adds terms of node adjoint to adjoints of its children
+void propagate_adjoint(GradientSweep *sweep, Node *node, const Node *adjoint);
+
+
+/**
+ * \brief Calculates constant expressions of DAG, every shared node is optimized once
+ * \param [in] node    Check will start from this branch
+ * \param [in] visited Already optimized nodes linked to themselves
+*/
+void optimize_node(Node *node, NodeMap *visited);
+
+
 #define PRINT(...) fprintf(file, __VA_ARGS__)
 
 
+/// Initial amount of cells in DAG tables
+const size_t DAG_TABLE_SIZE = 64;
+
+
+/// Name of library square root function, it's the only call that is differentiated by gradient
+const char *const SQRT_FUNCTION_NAME = "VAR_22B14C_0062909C";
+
+
+/// Amount of temporary variables that were created by gradient code
+int gradient_temps = 0;
+
+
+/// Address hash for node maps
+#define PTR_HASH(ptr) ((size_t)(ptr) >> 4)
+
+
+Node *diff(const Node *node, int dif_var) {
+    ExpressionDag dag = {};
+    dag.dif_var = dif_var;
+
+    Node *result = diff_node(&dag, cons_tree(&dag, node));
+
+    free_expression_dag(&dag);
+
+    return result;
+}
+
+
+Node *share_expression(const Node *node) {
+    ExpressionDag dag = {};
+
+    Node *result = cons_tree(&dag, node);
+
+    free_expression_dag(&dag);
+
+    return result;
+}
+
+
+size_t get_node_hash(int type, NodeValue value, const Node *left, const Node *right) {
+    unsigned long long bits = (unsigned int) value.id;
+
+    // Numbers are equal only if all their bits are
+    if (type == NODE_TYPES::TYPE_NUM) memcpy(&bits, &value.dbl, sizeof(bits));
+
+    size_t hash = 5381;
+
+    hash = hash * 33 + (size_t) type;
+    hash = hash * 33 + (size_t) bits;
+    hash = hash * 33 + PTR_HASH(left);
+    hash = hash * 33 + PTR_HASH(right);
+
+    return hash ^ (hash >> 17);
+}
+
+
+int is_same_node(const Node *node, int type, NodeValue value, const Node *left, const Node *right) {
+    if (node -> type != type || node -> left != left || node -> right != right) return 0;
+
+    if (type == NODE_TYPES::TYPE_NUM) return !memcmp(&node -> value.dbl, &value.dbl, sizeof(double));
+
+    return node -> value.id == value.id;
+}
+
+
+Node *cons_node(ExpressionDag *dag, int type, NodeValue value, Node *left, Node *right) {
+    if (2 * (dag -> size + 1) > dag -> capacity) {
+        size_t capacity = (dag -> capacity)? 2 * dag -> capacity : DAG_TABLE_SIZE;
+
+        Node **nodes = (Node **) calloc(capacity, sizeof(Node *));
+        if (!nodes) return nullptr;
+
+        for (size_t i = 0; i < dag -> capacity; i++) {
+            Node *iter = dag -> nodes[i];
+            if (!iter) continue;
+
+            size_t cell = get_node_hash(iter -> type, iter -> value, iter -> left, iter -> right) & (capacity - 1);
+            while (nodes[cell]) cell = (cell + 1) & (capacity - 1);
+
+            nodes[cell] = iter;
+        }
+
+        free(dag -> nodes);
+
+        dag -> nodes = nodes;
+        dag -> capacity = capacity;
+    }
+
+    size_t cell = get_node_hash(type, value, left, right) & (dag -> capacity - 1);
+
+    for (; dag -> nodes[cell]; cell = (cell + 1) & (dag -> capacity - 1))
+        if (is_same_node(dag -> nodes[cell], type, value, left, right)) return dag -> nodes[cell];
+
+    Node *node = create_node(type, value, left, right);
+    if (!node) return nullptr;
+
+    dag -> nodes[cell] = node;
+    dag -> size++;
+
+    return node;
+}
+
+
+Node *cons_num(ExpressionDag *dag, double num) {
+    NodeValue value = {0};
+    value.dbl = num;
+    return cons_node(dag, NODE_TYPES::TYPE_NUM, value, nullptr, nullptr);
+}
+
+
+Node *cons_tree(ExpressionDag *dag, const Node *node) {
+    if (!node) return nullptr;
+
+    // Input can be DAG itself after previous differentiation, so every node is added once
+    Node *unique = find_node_link(&dag -> copies, node);
+    if (unique) return unique;
+
+    unique = cons_node(dag, node -> type, node -> value, cons_tree(dag, node -> left), cons_tree(dag, node -> right));
+
+    add_node_link(&dag -> copies, node, unique);
+
+    return unique;
+}
+
+
 #define DEF_GEN(op, create_node, ...)               \
     case OP_##op:                                   \
         result = create_node;                       \
         break;
 
 
-Node *diff(const Node *node, const char *dif_var) {
-    Node *result = nullptr;
+Node *diff_node(ExpressionDag *dag, Node *node) {
+    if (!node) return nullptr;
+
+    Node *result = find_node_link(&dag -> derivatives, node);
+    if (result) return result;
 
     switch(node -> type) {
         case NODE_TYPES::TYPE_NUM:
-            result = create_num(0);
+            result = cons_num(dag, 0);
             break;
         case NODE_TYPES::TYPE_VAR:
-            if (strcmp(node -> value.var, dif_var)) result = create_num(1);
-            else result = create_num(0);
+            if (node -> value.id == dag -> dif_var) result = cons_num(dag, 1);
+            else result = cons_num(dag, 0);
             break;
         case NODE_TYPES::TYPE_OP:
             switch (node -> value.op) {
@@ -40,6 +316,8 @@ Node *diff(const Node *node, const char *dif_var) {
         default:
             return nullptr;
     }
+
+    add_node_link(&dag -> derivatives, node, result);
     
     return result;
 }
@@ -47,9 +325,328 @@ Node *diff(const Node *node, const char *dif_var) {
 #undef DEF_GEN
 
 
+Node *find_node_link(const NodeMap *map, const Node *key) {
+    if (!map -> capacity) return nullptr;
+
+    for (size_t cell = PTR_HASH(key) & (map -> capacity - 1); map -> keys[cell]; cell = (cell + 1) & (map -> capacity - 1))
+        if (map -> keys[cell] == key) return map -> values[cell];
+
+    return nullptr;
+}
+
+
+int add_node_link(NodeMap *map, const Node *key, Node *value) {
+    if (2 * (map -> size + 1) > map -> capacity) {
+        size_t capacity = (map -> capacity)? 2 * map -> capacity : DAG_TABLE_SIZE;
+
+        const Node **keys = (const Node **) calloc(capacity, sizeof(const Node *));
+        Node **values = (Node **) calloc(capacity, sizeof(Node *));
+
+        if (!keys || !values) {
+            free(keys);
+            free(values);
+            return ALLOC_FAIL;
+        }
+
+        for (size_t i = 0; i < map -> capacity; i++) {
+            if (!map -> keys[i]) continue;
+
+            size_t cell = PTR_HASH(map -> keys[i]) & (capacity - 1);
+            while (keys[cell]) cell = (cell + 1) & (capacity - 1);
+
+            keys[cell] = map -> keys[i];
+            values[cell] = map -> values[i];
+        }
+
+        free(map -> keys);
+        free(map -> values);
+
+        map -> keys = keys;
+        map -> values = values;
+        map -> capacity = capacity;
+    }
+
+    size_t cell = PTR_HASH(key) & (map -> capacity - 1);
+    while (map -> keys[cell] && map -> keys[cell] != key) cell = (cell + 1) & (map -> capacity - 1);
+
+    if (!map -> keys[cell]) map -> size++;
+
+    map -> keys[cell] = key;
+    map -> values[cell] = value;
+
+    return 0;
+}
+
+
+void free_expression_dag(ExpressionDag *dag) {
+    free(dag -> nodes);
+    dag -> nodes = nullptr;
+    dag -> size = dag -> capacity = 0;
+
+    NodeMap *maps[] = {&dag -> copies, &dag -> derivatives};
+
+    for (int i = 0; i < (int)(sizeof(maps) / sizeof(NodeMap *)); i++) {
+        free(maps[i] -> keys);
+        free(maps[i] -> values);
+        *maps[i] = {};
+    }
+}
+
+Node *get_gradient(const Node *expression, const Node *vars, const Node *targets) {
+    assert(expression && "Can't differentiate null expression!");
+
+    GradientSweep sweep = {};
+    sweep.vars = vars;
+    sweep.tail = &sweep.statements;
+
+    Node *root = cons_tree(&sweep.dag, expression);
+
+    // Forward sweep calculates every unique operation once
+    sort_gradient_nodes(&sweep, root);
+
+    for (int i = 0; i < sweep.size; i++) {
+        Node *node = sweep.order[i], *value = nullptr;
+
+        if (node -> type == NODE_TYPES::TYPE_CALL) {
+            Node *args = nullptr, **tail = &args;
+
+            for (const Node *arg = node -> left; arg; arg = arg -> right, tail = &(*tail) -> right)
+                *tail = create_node(NODE_TYPES::TYPE_ARG, arg -> value, use_value(&sweep, arg -> left));
+
+            value = create_node(node -> type, node -> value, args);
+        }
+        else {
+            value = create_node(node -> type, node -> value, use_value(&sweep, node -> left), use_value(&sweep, node -> right));
+        }
+
+        Node *temp = find_node_link(&sweep.values, node);
+
+        add_gradient_statement(&sweep, create_node(NODE_TYPES::TYPE_NVAR, temp -> value, nullptr, value));
+    }
+
+    // Backward sweep visits parents before children, so adjoint of every node is complete when it is visited
+    add_adjoint(&sweep, root, cons_num(&sweep.dag, 1), 0);
+
+    for (int i = sweep.size - 1; i >= 0; i--) {
+        Node *node = sweep.order[i], *adjoint = find_node_link(&sweep.adjoints, node);
+
+        if (!adjoint) continue;
+
+        if (adjoint -> left || adjoint -> right) {
+            Node *temp = create_temp_variable();
+
+            add_gradient_statement(&sweep, create_node(NODE_TYPES::TYPE_NVAR, temp -> value, nullptr, adjoint));
+
+            adjoint = temp;
+        }
+
+        propagate_adjoint(&sweep, node, adjoint);
+    }
+
+    int var_count = 0;
+    for (const Node *var = vars; var; var = var -> right) var_count++;
+
+    // Targets can be used by adjoints of other targets, so every adjoint is saved before the first assignment
+    Node **results = (Node **) calloc((size_t) var_count + 1, sizeof(Node *));
+
+    for (int i = 0; i < var_count; i++, vars = vars -> right) {
+        Node *var = cons_node(&sweep.dag, NODE_TYPES::TYPE_VAR, vars -> left -> value, nullptr, nullptr);
+        Node *adjoint = find_node_link(&sweep.adjoints, var);
+
+        if (!adjoint) {
+            results[i] = cons_num(&sweep.dag, 0);
+            continue;
+        }
+
+        results[i] = create_temp_variable();
+
+        add_gradient_statement(&sweep, create_node(NODE_TYPES::TYPE_NVAR, results[i] -> value, nullptr, adjoint));
+    }
+
+    int index = 0;
+
+    for (; index < var_count && targets; index++, targets = targets -> right) {
+        Node *target = create_node(NODE_TYPES::TYPE_VAR, targets -> left -> value);
+        Node *result = create_node(results[index] -> type, results[index] -> value);
+
+        add_gradient_statement(&sweep, create_node(NODE_TYPES::TYPE_OP, {OPERATORS::OP_ASS}, target, result));
+    }
+
+    assert(index == var_count && !targets && "Amounts of gradient variables and targets are different!");
+
+    free(results);
+
+    free_expression_dag(&sweep.dag);
+
+    NodeMap *maps[] = {&sweep.values, &sweep.adjoints, &sweep.depends};
+
+    for (int i = 0; i < (int)(sizeof(maps) / sizeof(NodeMap *)); i++) {
+        free(maps[i] -> keys);
+        free(maps[i] -> values);
+    }
+
+    free(sweep.order);
+
+    return sweep.statements;
+}
+
+
+void sort_gradient_nodes(GradientSweep *sweep, Node *node) {
+    if (!node || find_node_link(&sweep -> values, node)) return;
+
+    int depends = 0;
+
+    switch (node -> type) {
+        case NODE_TYPES::TYPE_NUM:
+            add_node_link(&sweep -> values, node, node);
+            return;
+        case NODE_TYPES::TYPE_VAR:
+            for (const Node *var = sweep -> vars; var; var = var -> right)
+                if (var -> left -> value.id == node -> value.id) depends = 1;
+
+            add_node_link(&sweep -> values, node, node);
+            if (depends) add_node_link(&sweep -> depends, node, node);
+            return;
+        case NODE_TYPES::TYPE_CALL:
+            for (Node *arg = node -> left; arg; arg = arg -> right) {
+                sort_gradient_nodes(sweep, arg -> left);
+
+                if (find_node_link(&sweep -> depends, arg -> left)) depends = 1;
+            }
+
+            // Other library functions are constants for gradient
+            depends = depends && is_sqrt_call(node);
+            break;
+        case NODE_TYPES::TYPE_OP:
+            // Address of variable is not its value
+            if (node -> value.op != OP_LOC) sort_gradient_nodes(sweep, node -> left);
+            if (node -> value.op != OP_LOC) sort_gradient_nodes(sweep, node -> right);
+
+            switch (node -> value.op) {
+                case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV:
+                    depends = find_node_link(&sweep -> depends, node -> left) || find_node_link(&sweep -> depends, node -> right);
+                    break;
+                default:
+                    // Comparisons and memory loads are constants for gradient
+                    break;
+            }
+            break;
+        default:
+            assert(0 && "Unexpected node in gradient expression!");
+    }
+
+    if (sweep -> size == sweep -> capacity) {
+        sweep -> capacity = (sweep -> capacity)? 2 * sweep -> capacity : 16;
+        sweep -> order = (Node **) realloc(sweep -> order, (size_t) sweep -> capacity * sizeof(Node *));
+    }
+
+    sweep -> order[sweep -> size++] = node;
+
+    add_node_link(&sweep -> values, node, create_temp_variable());
+    if (depends) add_node_link(&sweep -> depends, node, node);
+}
+
+
+int is_sqrt_call(const Node *node) {
+    return node -> type == NODE_TYPES::TYPE_CALL && node -> left && !node -> left -> right &&
+           !strcmp(get_ident_name(node -> value.id), SQRT_FUNCTION_NAME);
+}
+
+
+Node *use_value(GradientSweep *sweep, const Node *node) {
+    if (!node) return nullptr;
+
+    // Variables of operand of locate operation are used as they are
+    const Node *value = find_node_link(&sweep -> values, node);
+    if (!value) value = node;
+
+    return create_node(value -> type, value -> value);
+}
+
+
+Node *create_temp_variable() {
+    char name[32] = "";
+    snprintf(name, sizeof(name), "GRAD_%d", gradient_temps++);
+
+    NodeValue value = {0};
+    value.id = intern_ident_name(name);
+
+    return create_node(NODE_TYPES::TYPE_VAR, value);
+}
+
+
+void add_gradient_statement(GradientSweep *sweep, Node *statement) {
+    *sweep -> tail = create_node(NODE_TYPES::TYPE_SEQ, {0}, statement);
+    sweep -> tail = &(*sweep -> tail) -> right;
+}
+
+
+void add_adjoint(GradientSweep *sweep, Node *node, Node *term, int negative) {
+    if (!find_node_link(&sweep -> depends, node)) return;
+
+    Node *sum = find_node_link(&sweep -> adjoints, node);
+
+    if (sum) sum = create_node(NODE_TYPES::TYPE_OP, {(negative)? OPERATORS::OP_SUB : OPERATORS::OP_ADD}, sum, term);
+    else if (negative) sum = create_node(NODE_TYPES::TYPE_OP, {OPERATORS::OP_SUB}, create_num(0), term);
+    else sum = term;
+
+    add_node_link(&sweep -> adjoints, node, sum);
+}
+
+
+Node *scale_adjoint(const Node *adjoint, Node *factor) {
+    if (adjoint -> type == NODE_TYPES::TYPE_NUM && is_equal(adjoint -> value.dbl, 1)) return factor;
+
+    return create_node(NODE_TYPES::TYPE_OP, {OPERATORS::OP_MUL}, create_node(adjoint -> type, adjoint -> value), factor);
+}
+
+
+#define ADJOINT create_node(adjoint -> type, adjoint -> value)
+#define VALUE(node) use_value(sweep, node)
+
+void propagate_adjoint(GradientSweep *sweep, Node *node, const Node *adjoint) {
+    ExpressionDag *dag = &sweep -> dag;
+
+    Node *left = node -> left, *right = node -> right;
+
+    if (is_sqrt_call(node)) {
+        add_adjoint(sweep, left -> left, Div(ADJOINT, Mul(create_num(2), VALUE(node))), 0);
+        return;
+    }
+
+    if (node -> type != NODE_TYPES::TYPE_OP) return;
+
+    switch (node -> value.op) {
+        case OP_ADD:
+            add_adjoint(sweep, left, ADJOINT, 0);
+            add_adjoint(sweep, right, ADJOINT, 0);
+            break;
+        case OP_SUB:
+            add_adjoint(sweep, left, ADJOINT, 0);
+            add_adjoint(sweep, right, ADJOINT, 1);
+            break;
+        case OP_MUL:
+            add_adjoint(sweep, left, scale_adjoint(adjoint, VALUE(right)), 0);
+            add_adjoint(sweep, right, scale_adjoint(adjoint, VALUE(left)), 0);
+            break;
+        case OP_DIV:
+            add_adjoint(sweep, left, Div(ADJOINT, VALUE(right)), 0);
+            add_adjoint(sweep, right, Div(scale_adjoint(adjoint, VALUE(node)), VALUE(right)), 1);
+            break;
+        default:
+            break;
+    }
+}
+
+#undef ADJOINT
+#undef VALUE
+
+#undef PTR_HASH
+
+
 #define TEMPLATE(num_child, origin_child, num)      \
 if (IS_NUM(num_child, num)) {                       \
-    FREE(node -> num_child);                        \
+    DROP(node -> num_child);                        \
     copy_node(node -> origin_child, node);          \
 }
 
@@ -58,8 +655,8 @@ if (IS_NUM(num_child, num)) {                       \
 if (IS_TYPE(node -> left, NUM) && IS_TYPE(node -> right, NUM)) {    \
     node -> value.dbl = calc_value(node, 1.0);                      \
     node -> type = TYPE_NUM;                                        \
-    FREE(node -> left);                                             \
-    FREE(node -> right);                                            \
+    DROP(node -> left);                                             \
+    DROP(node -> right);                                            \
 }
 
 
@@ -68,8 +665,6 @@ void copy_node(Node *origin, Node *destination) {
     destination -> value = origin -> value;
     destination -> left = origin -> left;
     destination -> right = origin -> right;
-
-    free(origin);
 }
 
 
@@ -80,11 +675,24 @@ case OP_##op:                                       \
 
 
 void optimize(Node *node) {
-    if (node -> type != NODE_TYPES::TYPE_OP)
+    NodeMap visited = {};
+
+    optimize_node(node, &visited);
+
+    free(visited.keys);
+    free(visited.values);
+}
+
+
+void optimize_node(Node *node, NodeMap *visited) {
+    if (node -> type != NODE_TYPES::TYPE_OP || find_node_link(visited, node))
         return;
 
-    if (node -> left) optimize(node -> left);
-    if (node -> right) optimize(node -> right);
+    // Node that is not linked because of allocation fail is just optimized again
+    add_node_link(visited, node, node);
+
+    if (node -> left) optimize_node(node -> left, visited);
+    if (node -> right) optimize_node(node -> right, visited);
 
     switch (node -> value.op) {
         #include "gen.hpp"
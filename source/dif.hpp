@@ -1,14 +1,22 @@
 /**
  * \brief Differentiates expression tree
  * \param [in] node         Pointer to expression tree
- * \param [in] dif_var      Variable to differentiate for
- * \return New tree
+ * \param [in] dif_var      Identificator of variable to differentiate for
+ * \return Hash-consed DAG, its equal subexpressions are the same nodes and some of them are shared with original tree
 */
-Node *diff(const Node *node, const char *dif_var);
+Node *diff(const Node *node, int dif_var);
 
 
 /**
- * \brief Calculates constant expressions
+ * \brief Merges equal subexpressions
+ * \param [in] node Expression tree or DAG
+ * \return New hash-consed DAG, its equal subexpressions are the same nodes
+*/
+Node *share_expression(const Node *node);
+
+
+/**
+ * \brief Calculates constant expressions, shared nodes of DAG are optimized once
  * \param [in]  node Check will start from this branch
 */
 void optimize(Node *node);
@@ -21,3 +29,14 @@ void optimize(Node *node);
  * \return Function value
 */
 double calc_value(const Node *node, double x);
+
+
+/**
+ * \brief Generates reverse mode code that assigns partial derivatives of expression to variables
+ * \param [in] expression Expression without calls of user functions
+ * \param [in] vars       Chain of argument nodes with variables to differentiate for
+ * \param [in] targets    Chain of argument nodes with variables to assign derivatives to
+ * \return Sequence of statements, it calculates every unique subexpression once and then all derivatives in one backward sweep
+ * \note Square root is the only call that is differentiated, other calls, comparisons and memory loads are constants
+*/
+Node *get_gradient(const Node *expression, const Node *vars, const Node *targets);
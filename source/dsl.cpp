@@ -13,13 +13,6 @@ Node *create_num(double num) {
 }
 
 
-Node *create_copy(const Node *node) {
-    if (!node) return nullptr;
-    
-    return create_node(node -> type, node -> value, create_copy(node -> left), create_copy(node -> right));
-}
-
-
 int is_equal(double a, double b) {
     return fabs(a - b) < 1e-5;
 }
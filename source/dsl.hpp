@@ -5,7 +5,7 @@ const double _PI = 3.14159;
 
 // Ultimate tools
 
-#define FREE(ptr) free(ptr); ptr = nullptr
+#define DROP(ptr) ptr = nullptr     ///< Unlinks child node, it is freed with the whole node arena
 
 
 /// Compares two doubles
@@ -22,26 +22,18 @@ int is_equal(double a, double b);
 Node *create_num(double num);
 
 
-/**
- * \brief Creates copy of existing node
- * \param [in] node Original node
- * \return New allocated copy
-*/
-Node *create_copy(const Node *node);
-
-
-#define Add(left, right) create_node(NODE_TYPES::TYPE_OP, {OPERATORS::OP_ADD}, left, right)
-#define Sub(left, right) create_node(NODE_TYPES::TYPE_OP, {OPERATORS::OP_SUB}, left, right)
-#define Mul(left, right) create_node(NODE_TYPES::TYPE_OP, {OPERATORS::OP_MUL}, left, right)
-#define Div(left, right) create_node(NODE_TYPES::TYPE_OP, {OPERATORS::OP_DIV}, left, right)
+// Derivative process builds hash-consed DAG, so nodes are shared instead of being copied
 
-// Derivative process
+#define Add(left, right) cons_node(dag, NODE_TYPES::TYPE_OP, {OPERATORS::OP_ADD}, left, right)
+#define Sub(left, right) cons_node(dag, NODE_TYPES::TYPE_OP, {OPERATORS::OP_SUB}, left, right)
+#define Mul(left, right) cons_node(dag, NODE_TYPES::TYPE_OP, {OPERATORS::OP_MUL}, left, right)
+#define Div(left, right) cons_node(dag, NODE_TYPES::TYPE_OP, {OPERATORS::OP_DIV}, left, right)
 
-#define L create_copy(node -> left)
-#define R create_copy(node -> right)
+#define L node -> left
+#define R node -> right
 
-#define dL diff(node -> left, dif_var)
-#define dR diff(node -> right, dif_var)
+#define dL diff_node(dag, node -> left)
+#define dR diff_node(dag, node -> right)
 
 #define IS_TYPE(_node, _type) _node -> type == TYPE_##_type
 
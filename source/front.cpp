@@ -3,19 +3,29 @@
 #include <string.h>
 #include "libs/tree.hpp"
 #include "libs/parser.hpp"
+#include "libs/queue.hpp"
+#include "libs/ident.hpp"
 #include "image_parser.hpp"
 #include "symbol_parser.hpp"
 #include "grammar.hpp"
+#include "stream.hpp"
 #include "input-output.hpp"
 
 
 void enable_graphic_dump(char *argv[], void *data);     ///< -gd parser
+void set_jobs(char *argv[], void *data);                ///< -j parser
+void enable_stream(char *argv[], void *data);           ///< -s parser
+void set_tolerance(char *argv[], void *data);           ///< -t parser
+void set_tile_rows(char *argv[], void *data);           ///< -T parser
+void enable_lazy(char *argv[], void *data);             ///< -l parser
+void enable_binary(char *argv[], void *data);           ///< -b parser
+void set_scale(char *argv[], void *data);               ///< -k parser
 
 
 
 int main(int argc, char *argv[]) {
     char *image_path = nullptr, *ast_path = nullptr;
-    int graphic_dump_on = 0;
+    int graphic_dump_on = 0, jobs = 1, stream_on = 0, tolerance = 0, tile_rows = 0, lazy_on = 0, binary_on = 0, scale = 0;
 
     Command command_list[] = {
         {
@@ -39,6 +49,55 @@ int main(int argc, char *argv[]) {
             &graphic_dump_on,
             "Creates graphic representation of AST using GraphWiz"
         },
+        {
+            "-j", "--jobs", 
+            0, 
+            &set_jobs, 
+            &jobs,
+            "<count> Sets amount of threads for image parsing, lexing and parsing"
+        },
+        {
+            "-s", "--stream", 
+            0, 
+            &enable_stream, 
+            &stream_on,
+            "Decodes, lexes and parses png image at the same time band by band"
+        },
+        {
+            "-t", "--tolerance", 
+            0, 
+            &set_tolerance, 
+            &tolerance,
+            "<count> Matches reserved shapes with up to count wrong pixels"
+        },
+        {
+            "-T", "--tile", 
+            0, 
+            &set_tile_rows, 
+            &tile_rows,
+            "<rows> Reads image by tiles of rows symbol rows, so huge images fit in memory"
+        },
+        {
+            "-l", "--lazy", 
+            0, 
+            &enable_lazy, 
+            &lazy_on,
+            "Parses only functions that can be called from main, the others are removed from AST"
+        },
+        {
+            "-b", "--binary", 
+            0, 
+            &enable_binary, 
+            &binary_on,
+            "Saves AST in binary format that is read without parsing"
+        },
+        {
+            "-k", "--scale", 
+            0, 
+            &set_scale, 
+            &scale,
+            "<scale> Reads image upscaled by integer scale, zero means that scale is detected"
+        },
         {
             "-h", "--help", 
             0, 
@@ -50,27 +109,51 @@ int main(int argc, char *argv[]) {
 
     parse_args(argc, argv, command_list, sizeof(command_list) / sizeof(Command));
 
-    Image img = read_image(image_path);
+    Node *program = nullptr;
 
-    int size = 0;    
+    if (stream_on && stream_program(image_path, &program, tolerance, scale)) {
+        printf("Image can't be decoded band by band, it will be read whole!\n");
+        stream_on = 0;
+    }
 
-    Symbol *symbols = parse_image(&img, &size);
+    TokenStream tokens = {};
 
-    free_image(&img);
-    
-    Node *tokens = parse_symbols(symbols, size, &size);
+    if (!stream_on && tile_rows && !(tokens = parse_symbol_tiles(image_path, tile_rows, jobs, tolerance, scale)).tokens)
+        printf("Image can't be read by tiles, it will be read whole!\n");
 
-    free(symbols);
-    
-    Tree tree = {get_program(tokens), 0};
+    if (!stream_on) {
+        if (!tokens.tokens) {
+            SymbolBuffer symbols = read_symbols(image_path, jobs, scale);
+
+            tokens = parse_symbols(&symbols, tolerance, jobs);
+
+            free_symbol_buffer(&symbols);
+        }
+
+        program = (lazy_on)? get_program(&tokens, lazy_on) : get_program_jobs(&tokens, jobs);
+
+        if (lazy_on) program = parse_called_functions(program);
+
+        free_token_stream(&tokens);
+    }
+
+    Tree tree = {program, 0};
+
+    if (expand_gradients(program)) {
+        tree_destructor(&tree);
 
-    free(tokens); // Remember that char * type values in nodes are not free yet
+        free_ident_table();
+
+        return 1;
+    }
 
     if (graphic_dump_on) graphic_dump(&tree);
 
-    write_tree(&tree, ast_path);
+    write_tree(&tree, ast_path, binary_on);
 
     tree_destructor(&tree);
+
+    free_ident_table();
     
     printf("Frontend!\n");
 
@@ -83,3 +166,78 @@ int main(int argc, char *argv[]) {
 void enable_graphic_dump(char *argv[], void *data) {
     *((int *) data) = 1;
 }
+
+
+void set_jobs(char *argv[], void *data) {
+    if (*(++argv)) {
+        *((int *) data) = atoi(*argv);
+
+        if (*((int *) data) < 1) {
+            printf("Wrong count after -j, one thread will be used!\n");
+            *((int *) data) = 1;
+        }
+    }
+    else {
+        printf("No count after -j, argument ignored!\n");
+    }
+}
+
+
+void enable_stream(char *argv[], void *data) {
+    *((int *) data) = 1;
+}
+
+
+void enable_lazy(char *argv[], void *data) {
+    *((int *) data) = 1;
+}
+
+
+void set_tile_rows(char *argv[], void *data) {
+    if (*(++argv)) {
+        *((int *) data) = atoi(*argv);
+
+        if (*((int *) data) < 0) {
+            printf("Wrong rows after -T, image will be read whole!\n");
+            *((int *) data) = 0;
+        }
+    }
+    else {
+        printf("No rows after -T, argument ignored!\n");
+    }
+}
+
+
+void set_tolerance(char *argv[], void *data) {
+    if (*(++argv)) {
+        *((int *) data) = atoi(*argv);
+
+        if (*((int *) data) < 0) {
+            printf("Wrong count after -t, shapes will be matched exactly!\n");
+            *((int *) data) = 0;
+        }
+    }
+    else {
+        printf("No count after -t, argument ignored!\n");
+    }
+}
+
+
+void enable_binary(char *argv[], void *data) {
+    *((int *) data) = 1;
+}
+
+
+void set_scale(char *argv[], void *data) {
+    if (*(++argv)) {
+        *((int *) data) = atoi(*argv);
+
+        if (*((int *) data) < 0) {
+            printf("Wrong scale after -k, it will be detected!\n");
+            *((int *) data) = 0;
+        }
+    }
+    else {
+        printf("No scale after -k, argument ignored!\n");
+    }
+}
@@ -20,8 +20,8 @@ DEF_GEN(MUL, Add(Mul(dL, R), Mul(dR, L)),
         node -> type = NODE_TYPES::TYPE_NUM;
         node -> value.dbl = 0;
 
-        FREE(node -> left);
-        FREE(node -> right);
+        DROP(node -> left);
+        DROP(node -> right);
     }
     else TEMPLATE(right, left, 1)
     else TEMPLATE(left, right, 1),
@@ -33,12 +33,12 @@ DEF_GEN(DIV, Div(Sub(Mul(dL, R), Mul(dR, L)), Mul(R, R)),
     CONST_CHECK()
     else TEMPLATE(right, left, 1)
     else if (IS_TYPE(node -> left, VAR) && IS_TYPE(node -> right, VAR)) {
-        if (node -> left -> value.var == node -> right -> value.var) {
+        if (node -> left -> value.id == node -> right -> value.id) {
             node -> type = NODE_TYPES::TYPE_NUM;
             node -> value.dbl = 1;
 
-            FREE(node -> left);
-            FREE(node -> right);
+            DROP(node -> left);
+            DROP(node -> right);
         }
     },
 
@@ -1,7 +1,12 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
+#include <atomic>
+#include <thread>
 #include "libs/tree.hpp"
+#include "libs/queue.hpp"
+#include "libs/ident.hpp"
 #include "image_parser.hpp"
 #include "symbol_parser.hpp"
 #include "grammar.hpp"
@@ -11,32 +16,355 @@
 
 
 #define IS_TYPE(_type) ((*s) -> type == TYPE_##_type)
-#define IS_OP(_op) ((*s) -> type == TYPE_OP && (*s) -> value.op == OP_##_op)
+#define IS_OP(_op) ((*s) -> type == TYPE_OP && (*s) -> op == OP_##_op)
 
 
-/// Increments node pointer
-void next(Node **s);
+/// Increments token pointer
+void next(const Token **s);
 
 
-Node *copy_node(const Node *origin) {
-    Node *copy = (Node *) calloc(1, sizeof(Node));
-    *copy = *origin;
-    return copy;
+/// Amount of binary operator precedence levels in expression
+const int BINARY_LEVELS = 2;
+
+
+/**
+ * \brief Gives binding power of binary operator of expression
+ * \param [in] token Token after operand
+ * \return Precedence level from 1 to BINARY_LEVELS or zero if token doesn't continue expression
+*/
+int get_binding_power(const Token *token);
+
+
+/// Queue of token chunks if program is parsed from stream
+Queue *token_stream = nullptr;
+
+/// End of the current token chunk if program is parsed from stream
+const Token *token_chunk_end = nullptr;
+
+/// Values of number tokens of the program or the current token chunk, every parsing thread has its own
+thread_local const double *token_numbers = nullptr;
+
+
+/// Function definition whose body can be parsed later
+typedef struct {
+    Node *definition = nullptr;     ///< DEF_SEQ node of function
+    int body = -1;                  ///< Index of the first body token or -1 if body is already parsed
+    int next = -1;                  ///< Index of the next function with the same name
+} LazyFunction;
+
+
+/// Identificators of called functions that are not visited yet and nodes to search calls in
+typedef struct {
+    int *ids = nullptr;             ///< Stack of function identificators
+    int id_count = 0;               ///< Amount of identificators
+    int id_capacity = 0;            ///< Size of identificators stack
+    const Node **nodes = nullptr;   ///< Stack of nodes for tree walk
+    int node_capacity = 0;          ///< Size of nodes stack
+} CallList;
+
+
+/// Tokens of the program if function bodies are parsed lazily
+const TokenStream *lazy_tokens = nullptr;
+
+/// Index of matching closing bracket for every opening one if bodies are parsed lazily
+int *bracket_index = nullptr;
+
+/// Functions of the program if bodies are parsed lazily
+LazyFunction *lazy_functions = nullptr;
+
+/// Amount of lazy functions
+int lazy_count = 0;
+
+/// Size of lazy functions array
+int lazy_capacity = 0;
+
+
+/// Part of top-level definitions that is parsed by one job
+typedef struct {
+    const TokenStream *tokens = nullptr;    ///< Lexems of the program
+    int begin = 0;                          ///< Index of the first lexem of the first definition
+    int end = 0;                            ///< Index of the lexem after the last definition
+    Node *first = nullptr;                  ///< The first DEF_SEQ node of part
+    Node *last = nullptr;                   ///< The last DEF_SEQ node of part
+    NodeArena arena = {};                   ///< Arena that nodes of part are allocated from
+} DefinitionRange;
+
+
+/**
+ * \brief Finds the end of top-level definition without parsing it
+ * \param [in] tokens Lexems of the program
+ * \param [in] index  Bracket index of lexems
+ * \param [in] begin  Index of the first lexem of definition
+ * \return Index of the lexem after definition or -1 if its end can't be found without parsing
+*/
+int skip_definition(const TokenStream *tokens, const int *index, int begin);
+
+
+/// Parses all definitions of part allocating nodes from its own arena
+void parse_definition_range(DefinitionRange *range);
+
+
+/**
+ * \brief Adds function definition to lazy functions
+ * \param [in] definition DEF_SEQ node of function
+ * \param [in] body       Index of the first body token or -1 if body is already parsed
+*/
+void add_lazy_function(Node *definition, int body);
+
+
+/// Parses body of lazy function that was skipped
+void parse_lazy_body(LazyFunction *function);
+
+
+/**
+ * \brief Adds identificators of all functions that are called in subtree to call list
+ * \param [in] calls  Call list
+ * \param [in] node   Subtree to walk
+ * \param [in] called Non zero value for every function that is already visited
+ * \param [in] max_id Max identificator of defined function
+*/
+void add_called_functions(CallList *calls, const Node *node, const unsigned char *called, int max_id);
+
+
+/// Max depth of inlined calls in gradient expression
+const int MAX_INLINE_DEPTH = 64;
+
+
+/// Functions that can be inlined in gradient expression and function that has gradient statement
+typedef struct {
+    Node *const *functions = nullptr;   ///< Function definitions by their identificators
+    int max_id = -1;                    ///< Max identificator of defined function
+    const Node *caller = nullptr;       ///< Definition of function that has gradient statement
+    int error = 0;                      ///< Non zero value means that expression can't be inlined
+} InlineContext;
+
+
+/**
+ * \brief Copies expression replacing calls of user functions with their return expressions
+ * \param [in] context Functions to inline, error is set if some call can't be inlined
+ * \param [in] node    Expression to copy
+ * \param [in] params  Parameters and local variables of function that expression belongs to or nullptr
+ * \param [in] args    Inlined values of parameters and local variables
+ * \param [in] depth   Amount of calls that are already inlined
+ * \return Expression without calls of user functions
+*/
+Node *inline_calls(InlineContext *context, const Node *node, const Node *params, const Node *args, int depth);
+
+
+/**
+ * \brief Inlines body of called function, body must be variable declarations followed by return
+ * \param [in] context  Functions to inline, error is set if function can't be inlined
+ * \param [in] function Definition of called function
+ * \param [in] args     Inlined call arguments
+ * \param [in] depth    Amount of calls that are already inlined
+ * \return Return expression of function with parameters and local variables replaced by their values
+*/
+Node *inline_function(InlineContext *context, const Node *function, Node *args, int depth);
+
+
+/// Non zero value means that variable is parameter of function or declared somewhere in subtree
+int is_declared(const Node *node, int id);
+
+
+/// Non zero value means that statement is gradient assign that was not expanded yet
+int is_gradient_statement(const Node *statement);
+
+
+/// Non zero value means that node is a part of expression and has no statements in it
+int is_expression_node(const Node *node);
+
+
+Node *get_token_node(const Token *token) {
+    NodeValue value = {0};
+
+    switch (token -> type) {
+        case TYPE_NUM:  value.dbl = token_numbers[token -> value]; break;
+        case TYPE_VAR:  value.id = (int) token -> value; break;
+        default:        value.op = token -> op; break;
+    }
+
+    return create_node(token -> type, value);
 }
 
 
-Node *get_program(Node *str) {
-    Node *s = str;
+Node *get_program(const TokenStream *tokens, int lazy) {
+    assert(tokens && "Can't parse null tokens!");
+
+    if (lazy) {
+        lazy_tokens = tokens;
+        bracket_index = get_bracket_index(tokens);
+    }
+
+    token_numbers = tokens -> numbers;
+
+    const Token *s = tokens -> tokens;
     
-    Node *value = get_definition(&s);
+    Node *value = get_definitions(&s);
     
     assert(s -> type == TYPE_ESC && "No TERMINATOR at the end of program!");
 
+    token_numbers = nullptr;
+
+    return value;
+}
+
+
+Node *get_program_jobs(const TokenStream *tokens, int jobs) {
+    assert(tokens && "Can't parse null tokens!");
+
+    if (jobs < 2) return get_program(tokens);
+
+    int *index = get_bracket_index(tokens);
+
+    // Definitions are split until the first one whose end can't be found without parsing
+    int split = 0;
+
+    for (int end = 0; (end = skip_definition(tokens, index, split)) != -1;) split = end;
+
+    DefinitionRange *ranges = (DefinitionRange *) calloc(jobs, sizeof(DefinitionRange));
+    std::thread *workers = new std::thread[jobs];
+
+    // Every job gets about the same amount of lexems
+    int count = 0;
+
+    for (int begin = 0, end = 0; end < split;) {
+        end = skip_definition(tokens, index, end);
+
+        if ((long) end * jobs >= (long) split * (count + 1) || end == split) {
+            ranges[count] = {};
+
+            ranges[count].tokens = tokens;
+            ranges[count].begin = begin;
+            ranges[count].end = end;
+
+            begin = end;
+            count++;
+        }
+    }
+
+    for (int i = 1; i < count; i++) workers[i] = std::thread(&parse_definition_range, ranges + i);
+
+    if (count) parse_definition_range(ranges);
+
+    for (int i = 1; i < count; i++) workers[i].join();
+
+    // Definition sequence is linked in source order and nodes of all jobs become nodes of the common arena
+    Node *value = nullptr, **tail = &value;
+
+    for (int i = 0; i < count; i++) {
+        *tail = ranges[i].first;
+        tail = &ranges[i].last -> right;
+
+        merge_node_arena(get_node_arena(), &ranges[i].arena);
+    }
+
+    const Token *s = tokens -> tokens + split;
+
+    token_numbers = tokens -> numbers;
+
+    *tail = get_definitions(&s);
+
+    assert(s -> type == TYPE_ESC && "No TERMINATOR at the end of program!");
+
+    token_numbers = nullptr;
+
+    delete[] workers;
+    free(ranges);
+    free(index);
+
+    return value;
+}
+
+
+int skip_definition(const TokenStream *tokens, const int *index, int begin) {
+    const Token *token = tokens -> tokens;
+
+    int i = begin;
+
+    if (token[i].type == TYPE_NVAR) {
+        // Expression can't contain ';' outside of brackets
+        for (i++; i < tokens -> size && token[i].type != TYPE_SEQ && token[i].type != TYPE_ESC; i++)
+            if ((token[i].type == TYPE_BRACKET || token[i].type == TYPE_BLOCK) && token[i].op == 1) i = index[i];
+
+        return (i < tokens -> size && token[i].type == TYPE_SEQ)? i + 1 : -1;
+    }
+
+    if (token[i].type != TYPE_DEF) return -1;
+
+    i += 2;     // skip def and function name
+
+    if (i >= tokens -> size || token[i].type != TYPE_BRACKET || token[i].op != 1) return -1;
+
+    i = index[i] + 1;
+
+    // Body that is not block is parsed by the main thread
+    if (i >= tokens -> size || token[i].type != TYPE_BLOCK || token[i].op != 1) return -1;
+
+    return index[i] + 1;
+}
+
+
+void parse_definition_range(DefinitionRange *range) {
+    NodeArena *previous = set_node_arena(&range -> arena);
+
+    token_numbers = range -> tokens -> numbers;
+
+    const Token *s = range -> tokens -> tokens + range -> begin, *end = range -> tokens -> tokens + range -> end;
+
+    Node **tail = &range -> first;
+
+    while (s < end) {
+        *tail = get_definition(&s);
+
+        assert(*tail && "Wrong top-level definition!");
+
+        range -> last = *tail;
+        tail = &(*tail) -> right;
+    }
+
+    assert(s == end && "Definition ends in the wrong place!");
+
+    token_numbers = nullptr;
+
+    set_node_arena(previous);
+}
+
+
+Node *get_program_stream(Queue *tokens) {
+    assert(tokens && "Can't parse null stream!");
+
+    TokenChunk *chunk = (TokenChunk *) queue_front(tokens);
+
+    token_stream = tokens;
+    token_chunk_end = chunk -> tokens + chunk -> size;
+    token_numbers = chunk -> numbers;
+
+    const Token *s = chunk -> tokens;
+
+    Node *value = get_definitions(&s);
+
+    assert(s -> type == TYPE_ESC && "No TERMINATOR at the end of program!");
+
+    queue_pop(tokens);
+
+    token_stream = nullptr;
+    token_chunk_end = nullptr;
+    token_numbers = nullptr;
+
+    return value;
+}
+
+
+Node *get_definitions(const Token **s) {
+    Node *value = nullptr, **tail = &value;
+
+    while ((*tail = get_definition(s))) tail = &(*tail) -> right;
+
     return value;
 }
 
 
-Node *get_definition(Node **s) {
+Node *get_definition(const Token **s) {
     Node *value = create_node(TYPE_DEF_SEQ, {0});
 
     switch ((*s) -> type) {
@@ -66,58 +394,72 @@ Node *get_definition(Node **s) {
 
             value -> left -> type = TYPE_DEF;
 
-            assert(IS_TYPE(BRACKET) && (*s) -> value.op == 1 && "No opening bracket in function declaration!");
+            assert(IS_TYPE(BRACKET) && (*s) -> op == 1 && "No opening bracket in function declaration!");
             next(s);
 
-            if (!(IS_TYPE(BRACKET) && (*s) -> value.op == 0)) value -> left -> left = get_function_parameters(s);
+            if (!(IS_TYPE(BRACKET) && (*s) -> op == 0)) value -> left -> left = get_function_parameters(s);
 
-            assert(IS_TYPE(BRACKET) && (*s) -> value.op == 0 && "No closing bracket in function declaration!");
+            assert(IS_TYPE(BRACKET) && (*s) -> op == 0 && "No closing bracket in function declaration!");
             next(s);
 
+            // Block body is skipped at once and parsed only if function is called
+            if (lazy_tokens && IS_TYPE(BLOCK) && (*s) -> op == 1) {
+                int body = (int) (*s - lazy_tokens -> tokens);
+
+                add_lazy_function(value, body);
+
+                *s = lazy_tokens -> tokens + bracket_index[body] + 1;
+
+                break;
+            }
+
             value -> left -> right = get_statement(s);
 
+            if (lazy_tokens) add_lazy_function(value, -1);
+
             break;
         }
-        default: {
-            free(value);
-            return nullptr;
-        }
+        default: return nullptr;     // unused node stays in arena until tree is destructed
     }
 
-    value -> right = get_definition(s);
-
     return value;
 }
 
 
-Node *get_block_value(Node **s) {
-    Node *value = get_statement(s);
+Node *get_block_value(const Token **s) {
+    Node *value = get_statement(s), *last = value;
 
-    if (!(IS_TYPE(BLOCK) && (*s) -> value.op == 0))
-        value -> right = get_block_value(s);
+    while (!(IS_TYPE(BLOCK) && (*s) -> op == 0)) {
+        last -> right = get_statement(s);
+        last = last -> right;
+    }
 
     return value;
 }
 
 
-Node *get_function_parameters(Node **s) {
-    Node *value = get_ident(s);
+Node *get_function_parameters(const Token **s) {
+    Node *value = nullptr, **tail = &value;
+
+    while (1) {
+        *tail = get_ident(s);
     
-    assert(value && "Wrong parameter name in function declaration!");
+        assert(*tail && "Wrong parameter name in function declaration!");
+
+        (*tail) -> type = TYPE_PAR;
+
+        if (!IS_TYPE(CONT)) break;
 
-    if (IS_TYPE(CONT)) {
         next(s);
 
-        value -> right = get_function_parameters(s);
+        tail = &(*tail) -> right;
     }
 
-    value -> type = TYPE_PAR;
-
     return value;
 }
 
 
-Node *get_statement(Node **s) {
+Node *get_statement(const Token **s) {
     Node *value = create_node(TYPE_SEQ, {0});
 
     switch((*s) -> type) {
@@ -155,7 +497,10 @@ Node *get_statement(Node **s) {
         case TYPE_VAR: {
             Node *var = get_function(s);
 
-            if (var -> type == TYPE_VAR) {
+            if (var -> type == TYPE_VAR && IS_TYPE(CONT)) {
+                value -> left = get_gradient_statement(s, var);
+            }
+            else if (var -> type == TYPE_VAR) {
                 assert(IS_OP(ASS) && "No assign operator after variable!");
                 next(s);
 
@@ -175,7 +520,7 @@ Node *get_statement(Node **s) {
             break;
         }
         case TYPE_OP: {
-            switch ((*s) -> value.op) {
+            switch ((*s) -> op) {
                 case OP_REF: {
                     next(s);
 
@@ -207,13 +552,12 @@ Node *get_statement(Node **s) {
             break;
         }
         case TYPE_BLOCK: {
-            if ((*s) -> value.op == 1) {
+            if ((*s) -> op == 1) {
                 next(s);
 
-                free(value);
                 value = get_block_value(s);
 
-                assert(IS_TYPE(BLOCK) && (*s) -> value.op == 0 && "No closing bracket in block!");
+                assert(IS_TYPE(BLOCK) && (*s) -> op == 0 && "No closing bracket in block!");
                 next(s);
             }
 
@@ -223,12 +567,12 @@ Node *get_statement(Node **s) {
             value -> left = create_node(TYPE_IF, {0});
             next(s);
 
-            assert(IS_TYPE(BRACKET) && (*s) -> value.op == 1 && "No opening bracket in if!");
+            assert(IS_TYPE(BRACKET) && (*s) -> op == 1 && "No opening bracket in if!");
             next(s);
 
             value -> left -> left = get_condition(s);
 
-            assert(IS_TYPE(BRACKET) && (*s) -> value.op == 0 && "No closing bracket in if!");
+            assert(IS_TYPE(BRACKET) && (*s) -> op == 0 && "No closing bracket in if!");
             next(s);
 
             value -> left -> right = create_node(TYPE_BRANCH, {0}, get_statement(s));
@@ -245,44 +589,79 @@ Node *get_statement(Node **s) {
             value -> left = create_node(TYPE_WHILE, {0});
             next(s);
 
-            assert(IS_TYPE(BRACKET) && (*s) -> value.op == 1 && "No opening bracket in if!");
+            assert(IS_TYPE(BRACKET) && (*s) -> op == 1 && "No opening bracket in if!");
             next(s);
 
             value -> left -> left = get_condition(s);
 
-            assert(IS_TYPE(BRACKET) && (*s) -> value.op == 0 && "No closing bracket in if!");
+            assert(IS_TYPE(BRACKET) && (*s) -> op == 0 && "No closing bracket in if!");
             next(s);
 
             value -> left -> right = get_statement(s);
 
             break;
         }
-        default: {
-            free(value);
-            value = nullptr;
-        }
+        default: value = nullptr;
     }
 
     return value;
 }
 
 
-Node *get_ident(Node **s) {
+Node *get_ident(const Token **s) {
     if (!IS_TYPE(VAR)) return nullptr;
     
-    Node *value = copy_node(*s);
+    Node *value = get_token_node(*s);
+
+    next(s);
 
+    return value;
+}
+
+
+Node *get_gradient_statement(const Token **s, Node *target) {
+    Node *targets = get_ident_list(s, target);
+
+    assert(IS_OP(ASS) && "No assign operator after gradient variables!");
     next(s);
 
+    Node *exp = get_expression(s);
+
+    assert(exp && "No expression in gradient!");
+
+    assert(IS_OP(DIF) && "No derivative operator in gradient!");
+    next(s);
+
+    Node *vars = get_ident_list(s, get_ident(s));
+
+    return create_node(TYPE_OP, {OP_ASS}, targets, create_node(TYPE_OP, {OP_DIF}, exp, vars));
+}
+
+
+Node *get_ident_list(const Token **s, Node *first) {
+    assert(first && "No identificator in list!");
+
+    Node *value = create_node(TYPE_ARG, {0}, first), **tail = &value -> right;
+
+    while (IS_TYPE(CONT)) {
+        next(s);
+
+        *tail = create_node(TYPE_ARG, {0}, get_ident(s));
+
+        assert((*tail) -> left && "No identificator after comma!");
+
+        tail = &(*tail) -> right;
+    }
+
     return value;
 }
 
 
-Node *get_condition(Node **s) {
+Node *get_condition(const Token **s) {
     Node *value = get_derivative(s);
 
     if (IS_TYPE(OP)) {
-        Node *op = copy_node(*s);
+        Node *op = get_token_node(*s);
         next(s);
 
         op -> left = value, op -> right = get_derivative(s);
@@ -295,7 +674,7 @@ Node *get_condition(Node **s) {
 }
 
 
-Node *get_derivative(Node **s) {
+Node *get_derivative(const Token **s) {
     Node *value = get_expression(s);
 
     if (IS_OP(DIF)) {
@@ -303,50 +682,57 @@ Node *get_derivative(Node **s) {
 
         Node *var = get_ident(s);
 
-        value = diff(value, var -> value.var);
+        value = diff(value, var -> value.id);
     }
 
     return value;
 }
 
 
-Node *get_expression(Node **s) {
-    Node *value = get_term(s);
+int get_binding_power(const Token *token) {
+    if (token -> type != TYPE_OP) return 0;
 
-    if (IS_OP(ADD) || IS_OP(SUB)) {
-        Node *op = copy_node(*s); 
-        next(s);
-
-        op -> left = value, op -> right = get_expression(s);
-
-        return op;
-    }
-    else {
-        return value;
+    switch (token -> op) {
+        case OP_ADD: case OP_SUB: return 1;
+        case OP_MUL: case OP_DIV: return 2;
+        default: return 0;
     }
 }
 
 
-Node *get_term(Node **s) {
-    Node *value = get_unary(s);
+Node *get_expression(const Token **s) {
+    Node *value = nullptr;
+
+    // Place of the last operand and places where the current operands of every level begin
+    Node **hole = &value, **holes[BINARY_LEVELS] = {};
+
+    for (int i = 0; i < BINARY_LEVELS; i++) holes[i] = &value;
+
+    while (1) {
+        *hole = get_unary(s);
+
+        int power = get_binding_power(*s);
+        if (!power) break;
 
-    if (IS_OP(MUL) || IS_OP(DIV)) {
-        Node *op = copy_node(*s);
+        Node *op = get_token_node(*s);
         next(s);
 
-        op -> left = value, op -> right = get_term(s);
+        // Operators are right associative, so operator takes operand of its level and waits for the right one
+        op -> left = *holes[power - 1];
+        *holes[power - 1] = op;
 
-        return op;
-    }
-    else {
-        return value;
+        hole = &op -> right;
+
+        for (int i = power - 1; i < BINARY_LEVELS; i++) holes[i] = hole;
     }
+
+    return value;
 }
 
 
-Node *get_unary(Node **s) {
+Node *get_unary(const Token **s) {
     if (IS_OP(SUB)) {
-        Node *op = copy_node(*s);
+        Node *op = get_token_node(*s);
         next(s);
 
         op -> left = create_node(TYPE_NUM, {0}), op -> right = get_factor(s);
@@ -356,7 +742,7 @@ Node *get_unary(Node **s) {
         return op;
     }
     else if (IS_OP(REF)) {
-        Node *op = copy_node(*s);
+        Node *op = get_token_node(*s);
         next(s);
 
         op -> right = get_factor(s);
@@ -366,7 +752,7 @@ Node *get_unary(Node **s) {
         return op;
     }
     else if (IS_OP(LOC)) {
-        Node *op = copy_node(*s);
+        Node *op = get_token_node(*s);
         next(s);
 
         op -> right = get_ident(s);
@@ -381,14 +767,14 @@ Node *get_unary(Node **s) {
 }
 
 
-Node *get_factor(Node **s) {
+Node *get_factor(const Token **s) {
     Node *value = {};
 
-    if (IS_TYPE(BRACKET) && (*s) -> value.op == 1) {
+    if (IS_TYPE(BRACKET) && (*s) -> op == 1) {
         next(s);
         value = get_condition(s);
 
-        assert(IS_TYPE(BRACKET) && (*s) -> value.op == 0 && "No closing bracket in expression!");
+        assert(IS_TYPE(BRACKET) && (*s) -> op == 0 && "No closing bracket in expression!");
         next(s);
 
         return value;
@@ -402,32 +788,36 @@ Node *get_factor(Node **s) {
 }
 
 
-Node *get_function_arguments(Node **s) {
-    Node *value = create_node(TYPE_ARG, {0}, get_derivative(s), nullptr);
+Node *get_function_arguments(const Token **s) {
+    Node *value = nullptr, **tail = &value;
+
+    while (1) {
+        *tail = create_node(TYPE_ARG, {0}, get_derivative(s), nullptr);
     
-    assert(value -> left && "Wrong argument in function call!");
+        assert((*tail) -> left && "Wrong argument in function call!");
+
+        if (!IS_TYPE(CONT)) break;
 
-    if (IS_TYPE(CONT)) {
         next(s);
 
-        value -> right = get_function_arguments(s);
+        tail = &(*tail) -> right;
     }
 
     return value;
 }
 
 
-Node *get_function(Node **s) {
+Node *get_function(const Token **s) {
     Node *value = get_ident(s);
 
-    if (IS_TYPE(BRACKET) && (*s) -> value.op == 1) {
+    if (IS_TYPE(BRACKET) && (*s) -> op == 1) {
         next(s);
 
         value -> type = TYPE_CALL; 
 
-        if (!(IS_TYPE(BRACKET) && (*s) -> value.op == 0)) value -> left = get_function_arguments(s);
+        if (!(IS_TYPE(BRACKET) && (*s) -> op == 0)) value -> left = get_function_arguments(s);
 
-        assert(IS_TYPE(BRACKET) && (*s) -> value.op == 0 && "No closing bracket in function call!");
+        assert(IS_TYPE(BRACKET) && (*s) -> op == 0 && "No closing bracket in function call!");
         next(s);
     }
 
@@ -435,10 +825,10 @@ Node *get_function(Node **s) {
 }
 
 
-Node *get_number(Node **s) {
+Node *get_number(const Token **s) {
     assert(IS_TYPE(NUM) && "No number found!");
 
-    Node *value = copy_node(*s);
+    Node *value = get_token_node(*s);
 
     next(s);
 
@@ -446,6 +836,334 @@ Node *get_number(Node **s) {
 }
 
 
-void next(Node** s) {
+int *get_bracket_index(const TokenStream *tokens) {
+    assert(tokens && "Can't index null tokens!");
+
+    int *index = (int *) calloc((size_t) tokens -> size, sizeof(int));
+
+    // Opening brackets that are not closed yet
+    int *open = (int *) calloc((size_t) tokens -> size, sizeof(int)), depth = 0;
+
+    for (int i = 0; i < tokens -> size; i++) {
+        const Token *token = tokens -> tokens + i;
+
+        if (token -> type != TYPE_BLOCK && token -> type != TYPE_BRACKET) continue;
+
+        if (token -> op == 1) {
+            open[depth++] = i;
+            continue;
+        }
+
+        assert(depth > 0 && tokens -> tokens[open[depth - 1]].type == token -> type && "Closing bracket doesn't match opening one!");
+
+        index[open[--depth]] = i;
+    }
+
+    assert(depth == 0 && "Not all brackets are closed!");
+
+    free(open);
+
+    return index;
+}
+
+
+void add_lazy_function(Node *definition, int body) {
+    if (lazy_count == lazy_capacity) {
+        lazy_capacity = (lazy_capacity)? lazy_capacity * 2 : 64;
+        lazy_functions = (LazyFunction *) realloc(lazy_functions, (size_t) lazy_capacity * sizeof(LazyFunction));
+    }
+
+    lazy_functions[lazy_count++] = {definition, body, -1};
+}
+
+
+void parse_lazy_body(LazyFunction *function) {
+    const Token *s = lazy_tokens -> tokens + function -> body;
+
+    token_numbers = lazy_tokens -> numbers;
+
+    function -> definition -> left -> right = get_statement(&s);
+
+    assert(s == lazy_tokens -> tokens + bracket_index[function -> body] + 1 && "Function body ends in the wrong place!");
+
+    token_numbers = nullptr;
+
+    function -> body = -1;
+}
+
+
+Node *parse_called_functions(Node *program) {
+    assert(lazy_tokens && "Program was not parsed lazily!");
+
+    int max_id = -1;
+
+    for (int i = 0; i < lazy_count; i++)
+        if (lazy_functions[i].definition -> left -> value.id > max_id) max_id = lazy_functions[i].definition -> left -> value.id;
+
+    // Functions with the same name are chained, so all of them are visited together
+    int *first = (int *) calloc((size_t) max_id + 1, sizeof(int));
+    unsigned char *called = (unsigned char *) calloc((size_t) max_id + 1, sizeof(unsigned char));
+
+    for (int i = 0; i <= max_id; i++) first[i] = -1;
+
+    for (int i = lazy_count - 1; i >= 0; i--) {
+        int id = lazy_functions[i].definition -> left -> value.id;
+
+        lazy_functions[i].next = first[id];
+        first[id] = i;
+    }
+
+    CallList calls = {};
+
+    // Program starts from main, but global variables are initialized before it and can call functions too
+    Node main_call = {TYPE_CALL, {0}, nullptr, nullptr};
+
+    // Identificators of lexems are interned by shapes, so main is found by its textual name
+    for (int i = 0; i < lazy_count; i++) {
+        main_call.value.id = lazy_functions[i].definition -> left -> value.id;
+
+        if (!strcmp(get_ident_name(main_call.value.id), MAIN_FUNCTION_NAME)) add_called_functions(&calls, &main_call, called, max_id);
+    }
+
+    for (const Node *def = program; def; def = def -> right)
+        if (def -> left -> type == TYPE_NVAR) add_called_functions(&calls, def -> left, called, max_id);
+
+    while (calls.id_count) {
+        int id = calls.ids[--calls.id_count];
+
+        if (called[id]) continue;
+
+        called[id] = 1;
+
+        for (int i = first[id]; i != -1; i = lazy_functions[i].next) {
+            if (lazy_functions[i].body != -1) parse_lazy_body(lazy_functions + i);
+
+            add_called_functions(&calls, lazy_functions[i].definition -> left -> right, called, max_id);
+        }
+    }
+
+    // Functions that are never called are removed from definition sequence
+    for (Node **def = &program; *def;) {
+        if ((*def) -> left -> type == TYPE_DEF && !called[(*def) -> left -> value.id]) *def = (*def) -> right;
+        else def = &(*def) -> right;
+    }
+
+    free(calls.ids);
+    free(calls.nodes);
+    free(first);
+    free(called);
+
+    free(bracket_index);
+    bracket_index = nullptr;
+
+    free(lazy_functions);
+    lazy_functions = nullptr;
+    lazy_count = 0;
+    lazy_capacity = 0;
+
+    lazy_tokens = nullptr;
+
+    return program;
+}
+
+
+void add_called_functions(CallList *calls, const Node *node, const unsigned char *called, int max_id) {
+    if (!node) return;
+
+    if (!calls -> node_capacity) {
+        calls -> node_capacity = 64;
+        calls -> nodes = (const Node **) calloc((size_t) calls -> node_capacity, sizeof(const Node *));
+    }
+
+    int size = 0;
+
+    calls -> nodes[size++] = node;
+
+    while (size) {
+        node = calls -> nodes[--size];
+
+        if (node -> type == TYPE_CALL && node -> value.id <= max_id && !called[node -> value.id]) {
+            if (calls -> id_count == calls -> id_capacity) {
+                calls -> id_capacity = (calls -> id_capacity)? calls -> id_capacity * 2 : 64;
+                calls -> ids = (int *) realloc(calls -> ids, (size_t) calls -> id_capacity * sizeof(int));
+            }
+
+            calls -> ids[calls -> id_count++] = node -> value.id;
+        }
+
+        if (size + 2 > calls -> node_capacity) {
+            calls -> node_capacity = (calls -> node_capacity)? calls -> node_capacity * 2 : 64;
+            calls -> nodes = (const Node **) realloc(calls -> nodes, (size_t) calls -> node_capacity * sizeof(const Node *));
+        }
+
+        if (node -> left) calls -> nodes[size++] = node -> left;
+        if (node -> right) calls -> nodes[size++] = node -> right;
+    }
+}
+
+
+void next(const Token **s) {
     *s += 1;
+
+    if (*s == token_chunk_end) {
+        queue_pop(token_stream);
+
+        TokenChunk *chunk = (TokenChunk *) queue_front(token_stream);
+
+        *s = chunk -> tokens;
+        token_chunk_end = chunk -> tokens + chunk -> size;
+        token_numbers = chunk -> numbers;
+    }
+}
+
+
+int expand_gradients(Node *program) {
+    InlineContext context = {};
+
+    for (const Node *def = program; def; def = def -> right)
+        if (def -> left -> type == TYPE_DEF && def -> left -> value.id > context.max_id) context.max_id = def -> left -> value.id;
+
+    Node **functions = (Node **) calloc((size_t) context.max_id + 1, sizeof(Node *));
+
+    for (Node *def = program; def; def = def -> right)
+        if (def -> left -> type == TYPE_DEF && !functions[def -> left -> value.id]) functions[def -> left -> value.id] = def -> left;
+
+    context.functions = functions;
+
+    // Gradients can be inside of conditions and loops, so every statement is visited with explicit stack
+    int size = 0, capacity = 64;
+    Node **nodes = (Node **) calloc((size_t) capacity, sizeof(Node *));
+
+    for (const Node *def = program; def && !context.error; def = def -> right) {
+        if (def -> left -> type != TYPE_DEF || !def -> left -> right) continue;
+
+        context.caller = def -> left;
+
+        nodes[size++] = def -> left -> right;
+
+        while (size && !context.error) {
+            Node *node = nodes[--size];
+
+            if (node -> type == TYPE_SEQ && is_gradient_statement(node -> left)) {
+                Node *gradient = node -> left -> right;
+
+                Node *expression = inline_calls(&context, gradient -> left, nullptr, nullptr, 0);
+
+                if (context.error) break;
+
+                Node *code = get_gradient(expression, gradient -> right, node -> left -> left), *last = code;
+
+                while (last -> right) last = last -> right;
+
+                // Generated statements take place of gradient one
+                last -> right = node -> right;
+
+                node -> left = code -> left;
+                node -> right = code -> right;
+
+                node = last;
+            }
+
+            if (size + 2 > capacity) {
+                capacity *= 2;
+                nodes = (Node **) realloc(nodes, (size_t) capacity * sizeof(Node *));
+            }
+
+            // Expressions can't have statements, derivatives in them are DAGs that can't be walked as trees
+            if (node -> left && !is_expression_node(node -> left)) nodes[size++] = node -> left;
+            if (node -> right && !is_expression_node(node -> right)) nodes[size++] = node -> right;
+        }
+    }
+
+    free(nodes);
+    free(functions);
+
+    return context.error;
+}
+
+
+int is_gradient_statement(const Node *statement) {
+    return statement && statement -> type == TYPE_OP && statement -> value.op == OP_ASS &&
+           statement -> left && statement -> left -> type == TYPE_ARG;
+}
+
+
+int is_expression_node(const Node *node) {
+    return node -> type == TYPE_OP || node -> type == TYPE_NUM || node -> type == TYPE_VAR || node -> type == TYPE_CALL;
+}
+
+
+Node *inline_calls(InlineContext *context, const Node *node, const Node *params, const Node *args, int depth) {
+    if (!node || context -> error) return nullptr;
+
+    if (node -> type == TYPE_VAR) {
+        for (; params && args; params = params -> right, args = args -> right)
+            if (params -> value.id == node -> value.id) return args -> left;
+
+        // Global variable of called function must not be replaced with local variable of caller
+        if (depth && is_declared(context -> caller, node -> value.id)) {
+            printf("Global variable %s is hidden by local variable of %s, gradient can't be calculated!\n",
+                   get_ident_name(node -> value.id), get_ident_name(context -> caller -> value.id));
+
+            context -> error = 1;
+            return nullptr;
+        }
+    }
+
+    if (node -> type == TYPE_CALL && node -> value.id <= context -> max_id && context -> functions[node -> value.id]) {
+        Node *call_args = nullptr, **tail = &call_args;
+
+        for (const Node *arg = node -> left; arg; arg = arg -> right, tail = &(*tail) -> right)
+            *tail = create_node(TYPE_ARG, {0}, inline_calls(context, arg -> left, params, args, depth));
+
+        return inline_function(context, context -> functions[node -> value.id], call_args, depth + 1);
+    }
+
+    return create_node(node -> type, node -> value,
+                       inline_calls(context, node -> left, params, args, depth),
+                       inline_calls(context, node -> right, params, args, depth));
+}
+
+
+Node *inline_function(InlineContext *context, const Node *function, Node *args, int depth) {
+    if (context -> error) return nullptr;
+
+    if (depth > MAX_INLINE_DEPTH) {
+        printf("Function %s is recursive, gradient can't be calculated!\n", get_ident_name(function -> value.id));
+
+        context -> error = 1;
+        return nullptr;
+    }
+
+    Node *params = function -> left;
+
+    for (const Node *statement = function -> right; statement && !context -> error; statement = statement -> right) {
+        const Node *value = statement -> left;
+
+        if (value && value -> type == TYPE_RET) return inline_calls(context, value -> left, params, args, depth);
+
+        if (!value || value -> type != TYPE_NVAR) break;
+
+        // Local variable is replaced with its value like parameter, the latest declaration hides the others
+        args = create_node(TYPE_ARG, {0}, inline_calls(context, value -> right, params, args, depth), args);
+        params = create_node(TYPE_PAR, value -> value, nullptr, params);
+    }
+
+    if (!context -> error) {
+        printf("Function %s must have only variable declarations before return, gradient can't be calculated!\n",
+               get_ident_name(function -> value.id));
+
+        context -> error = 1;
+    }
+
+    return nullptr;
+}
+
+
+int is_declared(const Node *node, int id) {
+    if (!node) return 0;
+
+    if ((node -> type == TYPE_NVAR || node -> type == TYPE_PAR) && node -> value.id == id) return 1;
+
+    return is_declared(node -> left, id) || is_declared(node -> right, id);
 }
@@ -9,6 +9,7 @@ definition ::=
 statement ::=
     'var' ident = derivative ';'
     | ident '=' derivative ';'
+    | ident ',' ident {',' ident} '=' expression 'd' ident {',' ident} ';'     -- gradient, derivatives are assigned in order
     | '*' factor '=' condition ';'
     | ident '(' {derivative}? {',' derivative} ')' ';'
     | 'begin' {statement ';'} 'end'
@@ -20,9 +21,7 @@ condition ::= derivative {['==''!=''>''<''>=''<='] derivative}?
 
 derivative ::= expression | expression 'd' ident
 
-expression ::= term {['+''-'] term}
-
-term ::= unary {['*''/'] unary}
+expression ::= unary {['+''-''*''/'] unary}    -- right associative, '*' and '/' bind tighter
 
 unary ::= '-' factor | '*' factor | '&' ident | factor
 
@@ -37,42 +36,93 @@ number ::= ['0'-'9']+
 */
 
 
-/// Allocates copy of the origin node
-Node *copy_node(const Node *origin);
+/// Name of function that program starts from
+const char *const MAIN_FUNCTION_NAME = "VAR_22B14C_01B8923B";
+
+
+/// Allocates tree node for token
+Node *get_token_node(const Token *token);
+
+
+/// Reads statements of block in loop
+Node *get_block_value(const Token **s);
+
+/// Reads function parameters in loop
+Node *get_function_parameters(const Token **s);
+
+/// Reads function arguments in loop
+Node *get_function_arguments(const Token **s);
+
+/// Reads definitions in loop until the first token that doesn't start definition
+Node *get_definitions(const Token **s);
+
+/// Reads binary operators with precedence climbing, so only brackets and calls take stack
+Node *get_expression(const Token **s);
 
 
-/// Recursive call for block content
-Node *get_block_value(Node **s);
+/**
+ * \brief Finds matching closing bracket or block end for every opening one
+ * \param [in] tokens Lexems of the program
+ * \return Array with index of closing lexem at index of every opening one, it must be freed
+*/
+int *get_bracket_index(const TokenStream *tokens);
+
 
-/// Recursive call for function parameters
-Node *get_function_parameters(Node **s);
+/**
+ * \brief Replaces gradient statements with reverse mode code
+ * \param [in] program Whole parsed program, calls of functions in gradients are inlined, so their bodies must be parsed
+ * \return Non zero value means that some called function can't be inlined, the reason is printed
+ * \note Inlined function must consist of variable declarations and return statement and must not be recursive
+*/
+int expand_gradients(Node *program);
 
-/// Recursive call for function arguments
-Node *get_function_arguments(Node **s);
+
+/**
+ * \brief Parses bodies of functions that can be called from main or global variables and removes the other functions
+ * \param [in] program Program that was parsed by get_program with lazy flag, its lexems must be still alive
+ * \return Program without functions that are never called
+*/
+Node *parse_called_functions(Node *program);
 
 
 // Recursive descent parser
 
-Node *get_program(Node *str);
+/**
+ * \brief Parses lexems to program tree
+ * \param [in] tokens Lexems of the program
+ * \param [in] lazy   Non zero value means that block bodies of functions are skipped until parse_called_functions
+ * \return Program tree
+*/
+Node *get_program(const TokenStream *tokens, int lazy = 0);
+
+/**
+ * \brief Splits lexems at top-level definitions and parses them in parallel
+ * \param [in] tokens Lexems of the program
+ * \param [in] jobs   Amount of threads
+ * \return Program tree that is the same as get_program gives
+*/
+Node *get_program_jobs(const TokenStream *tokens, int jobs);
+
+Node *get_program_stream(Queue *tokens);
 
-Node *get_definition(Node **s);
+Node *get_definition(const Token **s);
 
-Node *get_statement(Node **s);
+Node *get_statement(const Token **s);
 
-Node *get_condition(Node **s);
+Node *get_gradient_statement(const Token **s, Node *target);
 
-Node *get_derivative(Node **s);
+Node *get_ident_list(const Token **s, Node *first);
 
-Node *get_expression(Node **s);
+Node *get_condition(const Token **s);
 
-Node *get_term(Node **s);
+Node *get_derivative(const Token **s);
 
-Node *get_unary(Node **s);
+Node *get_unary(const Token **s);
 
-Node *get_factor(Node **s);
+Node *get_factor(const Token **s);
 
-Node *get_function(Node **s);
+Node *get_function(const Token **s);
 
-Node *get_ident(Node **s);
+Node *get_ident(const Token **s);
 
-Node *get_number(Node **s);
+Node *get_number(const Token **s);
@@ -1,4 +1,6 @@
 #include <stdio.h>
+#include <zlib.h>
+#include <thread>
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wcast-qual"
@@ -17,6 +19,116 @@
 #pragma GCC diagnostic pop
 
 #include "image_parser.hpp"
+#include "tile_kernel.hpp"
+#include "raw_image.hpp"
+#include "png_stream.hpp"
+
+
+/// Contains information about block of symbol rows for one job
+typedef struct {
+    const unsigned char *data = nullptr;    ///< Raw RGB or RGBA image data or packed palette indices
+    int comp = 0;                           ///< Amount of channels in image data
+    const PaletteLut *lut = nullptr;        ///< Palette table if data contains packed indices
+    size_t row_size = 0;                    ///< Size of one packed row in bytes
+    int scale = 0;                          ///< Integer scale of upscaled image, zero means that it is detected
+    SymbolBuffer *buffer = nullptr;         ///< Buffer to write symbols to
+    int begin = 0;                          ///< Index of the first symbol row
+    int end = 0;                            ///< Index of the symbol row after the last one
+} ImageRows;
+
+
+/**
+ * \brief Marks not white pixels of any image row
+ * \param [in]  image Image data and format
+ * \param [in]  width Image width in pixels
+ * \param [in]  y     Row index
+ * \param [out] mask  Array of get_row_mask_size(width) words
+*/
+void get_image_row_mask(const ImageRows *image, int width, int y, RowMask *mask);
+
+
+/**
+ * \brief Detects integer scale of upscaled image by positions of its pixel edges
+ * \param [in] image  Image data and format
+ * \param [in] width  Image width in pixels
+ * \param [in] height Amount of image rows to check
+ * \param [in] y      Index of the first checked row in the whole image, rows above it must be white
+ * \param [in] scale  Max scale, it must divide size of the symbols grid
+ * \return Scale, 1 means that image is not upscaled, 0 means that rows are white and can't tell it
+*/
+int detect_image_scale(const ImageRows *image, int width, int height, int y, int scale);
+
+
+/**
+ * \brief Creates buffer of empty symbols that ends with TERMINATOR
+ * \param [in] width  Grid width in symbols
+ * \param [in] height Grid height in symbols
+ * \return New symbol buffer
+*/
+SymbolBuffer create_symbol_buffer(int width, int height);
+
+
+/**
+ * \brief Passes blank symbol rows to tile handler by tiles of tile_rows rows
+ * \param [in] width     Grid width in symbols
+ * \param [in] height    Amount of blank symbol rows
+ * \param [in] tile_rows Amount of symbol rows in one tile
+ * \param [in] handler   Tile handler
+ * \param [in] data      Pointer that is passed to handler
+*/
+void handle_blank_tiles(int width, int height, int tile_rows, TileHandler handler, void *data);
+
+
+/**
+ * \brief Parses block of symbol rows to buffer
+ * \param [in] rows Rows to parse
+*/
+void parse_image_rows(const ImageRows *rows);
+
+
+/**
+ * \brief Parses rows of packed palette indices to symbol buffer
+ * \param [in] width  Image width in pixels
+ * \param [in] height Image height in pixels
+ * \param [in] lut    Palette table
+ * \param [in] data   Rows of packed indices
+ * \param [in] jobs   Amount of threads to parse symbol rows with
+ * \param [in] scale  Integer scale of upscaled image, zero means that it is detected
+ * \return New symbol buffer
+*/
+SymbolBuffer parse_packed_data(int width, int height, const PaletteLut *lut, const unsigned char *data, int jobs, int scale);
+
+
+/**
+ * \brief Creates symbol buffer and parses all symbol rows of the image
+ * \param [in] width  Image width in pixels
+ * \param [in] height Image height in pixels
+ * \param [in] image  Image data and format, buffer and rows are set for every job
+ * \param [in] jobs   Amount of threads to parse symbol rows with
+ * \return New symbol buffer
+*/
+SymbolBuffer parse_image_jobs(int width, int height, ImageRows image, int jobs);
+
+
+/**
+ * \brief Decodes palette or grayscale png to packed indices and parses it
+ * \param [in] png   Opened stream of indexed image
+ * \param [in] jobs  Amount of threads to parse symbol rows with
+ * \param [in] scale Integer scale of upscaled image, zero means that it is detected
+ * \return New symbol buffer
+*/
+SymbolBuffer read_packed_symbols(PngStream *png, int jobs, int scale);
+
+
+/**
+ * \brief Reads next rows of RGB or RGBA image from raw file or png stream
+ * \param [in]  raw    Opened raw image or nullptr if rows are read from png
+ * \param [in]  png    Opened png stream
+ * \param [in]  count  Amount of rows
+ * \param [out] buffer Array for count rows
+ * \return Pointer to rows or nullptr in case of error
+*/
+const unsigned char *read_tile_rows(RawImage *raw, PngStream *png, int count, unsigned char *buffer);
 
 
 
@@ -41,9 +153,11 @@ void print_pixel(const Pixel *pixel, const char format) {
 Pixel *parse_pixels(int width, int height, const unsigned char *data) {
     assert(data && "Null data can't be parsed!");
 
-    Pixel *pixels = (Pixel *) calloc(width * height, sizeof(Pixel));
+    size_t size = (size_t) width * (size_t) height;
 
-    for(int i = 0; i < width * height; i++)
+    Pixel *pixels = (Pixel *) calloc(size, sizeof(Pixel));
+
+    for(size_t i = 0; i < size; i++)
         pixels[i] = {data[i * 4], data[i * 4 + 1], data[i * 4 + 2], data[i * 4 + 3]};
     
     return pixels;
@@ -87,10 +201,12 @@ Symbol get_image_symbol(const Image *image, int x, int y) {
     unsigned int mask = 1;
 
     for (int _y = y; _y < y + SYMBOL_SIZE; _y++) {
+        const Pixel *row = image -> pixels + (size_t) _y * image -> width;
+
         for (int _x = x; _x < x + SYMBOL_SIZE; _x++) {
-            if (!is_white(image -> pixels + _x + _y * image -> width)) {
+            if (!is_white(row + _x)) {
                 symbol.shape |= mask;
-                symbol.color = image -> pixels[_x + _y * image -> width];
+                symbol.color = row[_x];
             }
 
             mask <<= 1;
@@ -101,20 +217,22 @@ Symbol get_image_symbol(const Image *image, int x, int y) {
 }
 
 
-Symbol *parse_image(const Image *image, int *symbols_size) {
+Symbol *parse_image(const Image *image, size_t *symbols_size) {
     assert(image && "Can't parse null image!");
 
     const int OFFSET = SYMBOL_SIZE + 1;
 
     assert(image -> width % OFFSET == 0 && image -> height % OFFSET == 0 && "Wrong image size!");
 
-    *symbols_size = image -> width / OFFSET * image -> height / OFFSET + 1;
+    size_t width = (size_t) (image -> width / OFFSET);
+
+    *symbols_size = width * (size_t) (image -> height / OFFSET) + 1;
 
     Symbol *symbols = (Symbol *) calloc(*symbols_size, sizeof(Symbol));
 
     for (int y = 0; y < image -> height / OFFSET; y++)
         for (int x = 0; x < image -> width / OFFSET; x++)
-            symbols[x + y * image -> width / OFFSET] = get_image_symbol(image, x * OFFSET, y * OFFSET);
+            symbols[(size_t) y * width + x] = get_image_symbol(image, x * OFFSET, y * OFFSET);
     
     symbols[*symbols_size - 1].shape = TERMINATOR;
 
@@ -122,6 +240,464 @@ Symbol *parse_image(const Image *image, int *symbols_size) {
 }
 
 
+void parse_image_rows(const ImageRows *rows) {
+    assert(rows && "Can't parse null rows!");
+
+    const int OFFSET = SYMBOL_SIZE + 1;
+
+    int width = rows -> buffer -> width * OFFSET, comp = rows -> comp, scale = rows -> scale;
+
+    int mask_size = get_row_mask_size(width);
+
+    RowMask *masks = (RowMask *) calloc(SYMBOL_SIZE * mask_size, sizeof(RowMask));
+
+    // Mask of upscaled row before downsampling
+    RowMask *scaled = (scale > 1)? (RowMask *) calloc(get_row_mask_size(width * scale), sizeof(RowMask)) : nullptr;
+
+    for (int y = rows -> begin; y < rows -> end; y++) {
+        size_t first = (size_t) y * rows -> buffer -> width;
+
+        unsigned int *shapes = rows -> buffer -> shapes + first;
+        Pixel *colors = rows -> buffer -> colors + first;
+        RowMask *occupancy = rows -> buffer -> occupancy + (size_t) y * rows -> buffer -> occupancy_stride;
+
+        for (int row = 0; row < SYMBOL_SIZE; row++) {
+            if (scale > 1) {
+                // Only the top row of every block is read
+                get_image_row_mask(rows, width * scale, (y * OFFSET + row) * scale, scaled);
+                downsample_row_mask(scaled, width, scale, masks + row * mask_size);
+            }
+            else {
+                get_image_row_mask(rows, width, y * OFFSET + row, masks + row * mask_size);
+            }
+        }
+
+        // Buffer is already filled with empty symbols
+        if (is_blank_band(masks, width)) continue;
+
+        if (rows -> lut)
+            get_packed_row_symbols(rows -> data, rows -> row_size, width, rows -> lut, scale, y * OFFSET, masks, shapes, colors, occupancy);
+        else
+            get_row_symbols(rows -> data, width, comp, scale, y * OFFSET, masks, shapes, colors, occupancy);
+    }
+
+    free(masks);
+    free(scaled);
+}
+
+
+void get_image_row_mask(const ImageRows *image, int width, int y, RowMask *mask) {
+    if (image -> lut)
+        get_packed_row_mask(image -> data + (size_t) y * image -> row_size, width, image -> lut, mask);
+    else
+        get_row_mask(image -> data + (size_t) y * width * image -> comp, width, image -> comp, mask);
+}
+
+
+int detect_image_scale(const ImageRows *image, int width, int height, int y, int scale) {
+    if (scale <= 1) return 1;
+
+    int mask_size = get_row_mask_size(width);
+
+    // White row above the checked ones is compared with the first of them
+    RowMask *mask = (RowMask *) calloc(mask_size, sizeof(RowMask));
+    RowMask *prev = (RowMask *) calloc(mask_size, sizeof(RowMask));
+
+    RowMask ink = 0;
+
+    // Not upscaled image usually gives scale 1 after the first rows with ink
+    for (int row = 0; row < height && scale > 1; row++) {
+        get_image_row_mask(image, width, row, mask);
+
+        scale = get_mask_scale(mask, (y + row > 0)? prev : nullptr, width, y + row, scale);
+
+        for (int word = 0; word < mask_size; word++) ink |= mask[word];
+
+        RowMask *swap = prev;
+        prev = mask;
+        mask = swap;
+    }
+
+    free(mask);
+    free(prev);
+
+    return (ink)? scale : 0;
+}
+
+
+int get_image_scale(int width, int height, int comp, const unsigned char *data) {
+    assert(data && "Can't detect scale of null data!");
+    assert((comp == 3 || comp == 4) && "Only RGB and RGBA images are supported!");
+
+    const int OFFSET = SYMBOL_SIZE + 1;
+
+    assert(width % OFFSET == 0 && height % OFFSET == 0 && "Wrong image size!");
+
+    ImageRows image = {};
+
+    image.data = data;
+    image.comp = comp;
+
+    return detect_image_scale(&image, width, height, 0, get_gcd(width / OFFSET, height / OFFSET));
+}
+
+
+SymbolBuffer parse_image_data(int width, int height, int comp, const unsigned char *data, int jobs, int scale) {
+    assert(data && "Can't parse null data!");
+    assert((comp == 3 || comp == 4) && "Only RGB and RGBA images are supported!");
+
+    ImageRows image = {};
+
+    image.data = data;
+    image.comp = comp;
+    image.scale = scale;
+
+    return parse_image_jobs(width, height, image, jobs);
+}
+
+
+SymbolBuffer parse_packed_data(int width, int height, const PaletteLut *lut, const unsigned char *data, int jobs, int scale) {
+    assert(data && "Can't parse null data!");
+    assert(lut && "Can't parse packed data without palette table!");
+
+    ImageRows image = {};
+
+    image.data = data;
+    image.lut = lut;
+    image.scale = scale;
+    image.row_size = ((size_t) width * (size_t) lut -> depth + 7) / 8;
+
+    return parse_image_jobs(width, height, image, jobs);
+}
+
+
+SymbolBuffer parse_image_jobs(int width, int height, ImageRows image, int jobs) {
+    const int OFFSET = SYMBOL_SIZE + 1;
+
+    assert(width % OFFSET == 0 && height % OFFSET == 0 && "Wrong image size!");
+
+    // Upscaled image is parsed as if it was downscaled, scale divides size of the symbols grid
+    if (!image.scale) image.scale = detect_image_scale(&image, width, height, 0, get_gcd(width / OFFSET, height / OFFSET));
+
+    // Blank image looks the same with any scale
+    if (!image.scale) image.scale = 1;
+
+    assert(width % (OFFSET * image.scale) == 0 && height % (OFFSET * image.scale) == 0 && "Image size is not divisible by scale!");
+
+    width /= image.scale;
+    height /= image.scale;
+
+    SymbolBuffer buffer = create_symbol_buffer(width / OFFSET, height / OFFSET);
+
+    if (jobs > buffer.height) jobs = buffer.height;
+    if (jobs < 1) jobs = 1;
+
+    ImageRows *rows = (ImageRows *) calloc(jobs, sizeof(ImageRows));
+    std::thread *workers = new std::thread[jobs];
+
+    // Every job gets its own block of symbol rows, so they never write to the same place
+    for (int i = 0; i < jobs; i++) {
+        rows[i] = image;
+
+        rows[i].buffer = &buffer;
+        rows[i].begin = buffer.height * i / jobs;
+        rows[i].end = buffer.height * (i + 1) / jobs;
+
+        if (i) workers[i] = std::thread(&parse_image_rows, rows + i);
+    }
+
+    parse_image_rows(rows);
+
+    for (int i = 1; i < jobs; i++) workers[i].join();
+
+    delete[] workers;
+    free(rows);
+
+    return buffer;
+}
+
+
+SymbolBuffer create_symbol_buffer(int width, int height) {
+    SymbolBuffer buffer = {};
+
+    buffer.width = width;
+    buffer.height = height;
+    buffer.size = (size_t) buffer.width * (size_t) buffer.height + 1;
+
+    buffer.shapes = (unsigned int *) calloc(buffer.size, sizeof(unsigned int));
+    buffer.colors = (Pixel *) calloc(buffer.size, sizeof(Pixel));
+
+    buffer.occupancy_stride = (buffer.width + ROW_MASK_BITS - 1) / ROW_MASK_BITS;
+    buffer.occupancy = (RowMask *) calloc((size_t) buffer.occupancy_stride * buffer.height + 1, sizeof(RowMask));
+
+    buffer.shapes[buffer.size - 1] = TERMINATOR;
+
+    return buffer;
+}
+
+
+SymbolBuffer read_symbols(const char *filename, int jobs, int scale) {
+    assert(filename && "Image path is null!");
+
+    RawImage raw = {};
+
+    // Binary PPM, PAM and QOI files don't need stb
+    if (!open_raw_image(&raw, filename)) {
+        SymbolBuffer buffer = parse_image_data(raw.width, raw.height, raw.comp, raw.pixels, jobs, scale);
+
+        close_raw_image(&raw);
+
+        return buffer;
+    }
+
+    PngStream png = {};
+
+    // Palette and grayscale png are parsed without expanding indices to colors
+    if (!open_png_stream(&png, filename)) {
+        if (png.indexed) {
+            SymbolBuffer buffer = read_packed_symbols(&png, jobs, scale);
+
+            close_png_stream(&png);
+
+            return buffer;
+        }
+
+        close_png_stream(&png);
+    }
+
+    int width = 0, height = 0, comp = 0;
+
+    int info = stbi_info(filename, &width, &height, &comp);
+
+    assert(info && "Can't load image!");
+
+    // Grayscale images that can't be read by indices are expanded to RGB or RGBA
+    unsigned char *data = stbi_load(filename, &width, &height, &comp, (comp < 3)? comp + 2 : 0);
+
+    assert(data && "Can't load image!");
+
+    if (comp < 3) comp += 2;
+
+    SymbolBuffer buffer = parse_image_data(width, height, comp, data, jobs, scale);
+
+    stbi_image_free(data);
+
+    return buffer;
+}
+
+
+int read_symbol_tiles(const char *filename, int tile_rows, int jobs, TileHandler handler, void *data, int scale) {
+    assert(filename && "Image path is null!");
+    assert(tile_rows > 0 && "Tile must contain at least one symbol row!");
+    assert(handler && "Tile handler is null!");
+
+    const int OFFSET = SYMBOL_SIZE + 1;
+
+    RawImage raw = {};
+    PngStream png = {};
+    PaletteLut lut = {};
+
+    ImageRows image = {};
+
+    int width = 0, height = 0, from_png = 0;
+
+    if (!open_raw_image(&raw, filename, 1)) {
+        width = raw.width;
+        height = raw.height;
+        image.comp = raw.comp;
+        image.row_size = (size_t) width * (size_t) image.comp;
+    }
+    else if (!open_png_stream(&png, filename)) {
+        from_png = 1;
+        width = png.width;
+        height = png.height;
+
+        if (png.indexed) {
+            get_palette_lut(png.palette, png.depth, &lut);
+
+            image.lut = &lut;
+            image.row_size = get_png_row_size(&png);
+        }
+        else {
+            image.comp = 4;
+            image.row_size = (size_t) width * 4;
+        }
+    }
+    else return 1;
+
+    assert(width % OFFSET == 0 && height % OFFSET == 0 && "Wrong image size!");
+
+    // Scale divides size of the symbols grid, so image with prime grid size is not upscaled
+    int grid = get_gcd(width / OFFSET, height / OFFSET);
+
+    image.scale = (!scale && grid <= 1)? 1 : scale;
+
+    // Tile of upscaled image takes the same amount of symbol rows
+    int tile_height = OFFSET * tile_rows * ((image.scale)? image.scale : 1);
+
+    // Pixels of mapped PPM and PAM are used without copying
+    unsigned char *tile = (from_png || raw.is_qoi)? (unsigned char *) calloc(image.row_size * (size_t) tile_height, sizeof(unsigned char)) : nullptr;
+
+    // Blank tiles above the first tile with ink wait until the scale is known
+    int blank_height = 0;
+
+    for (int y = 0; y < height; y += tile_height) {
+        int count = (height - y < tile_height)? height - y : tile_height;
+
+        image.data = read_tile_rows((from_png)? nullptr : &raw, &png, count, tile);
+
+        assert(image.data && "Can't decode image row!");
+
+        if (!image.scale) {
+            image.scale = detect_image_scale(&image, width, count, y, grid);
+
+            if (!image.scale) {
+                blank_height += count;
+                continue;
+            }
+
+            // Upscaled image is read whole, where the whole image tells the scale
+            if (image.scale != 1) {
+                free(tile);
+
+                if (from_png) close_png_stream(&png);
+                else close_raw_image(&raw);
+
+                return 1;
+            }
+
+            handle_blank_tiles(width / OFFSET, blank_height / OFFSET, tile_rows, handler, data);
+
+            blank_height = 0;
+        }
+
+        SymbolBuffer symbols = parse_image_jobs(width, count, image, jobs);
+
+        handler(&symbols, data);
+
+        free_symbol_buffer(&symbols);
+    }
+
+    // Blank image looks the same with any scale
+    handle_blank_tiles(width / OFFSET, blank_height / OFFSET, tile_rows, handler, data);
+
+    free(tile);
+
+    if (from_png) close_png_stream(&png);
+    else close_raw_image(&raw);
+
+    return 0;
+}
+
+
+void handle_blank_tiles(int width, int height, int tile_rows, TileHandler handler, void *data) {
+    for (int y = 0; y < height; y += tile_rows) {
+        SymbolBuffer symbols = create_symbol_buffer(width, (height - y < tile_rows)? height - y : tile_rows);
+
+        handler(&symbols, data);
+
+        free_symbol_buffer(&symbols);
+    }
+}
+
+
+const unsigned char *read_tile_rows(RawImage *raw, PngStream *png, int count, unsigned char *buffer) {
+    if (raw) return read_raw_rows(raw, count, buffer);
+
+    size_t row_size = (png -> indexed)? get_png_row_size(png) : (size_t) png -> width * 4;
+
+    for (int y = 0; y < count; y++) {
+        unsigned char *row = buffer + (size_t) y * row_size;
+
+        if ((png -> indexed)? read_png_packed_row(png, row) : read_png_row(png, row)) return nullptr;
+    }
+
+    return buffer;
+}
+
+
+SymbolBuffer read_packed_symbols(PngStream *png, int jobs, int scale) {
+    size_t row_size = get_png_row_size(png);
+
+    unsigned char *data = (unsigned char *) calloc(row_size * (size_t) png -> height, sizeof(unsigned char));
+
+    for (int y = 0; y < png -> height; y++) {
+        int error = read_png_packed_row(png, data + (size_t) y * row_size);
+
+        assert(!error && "Can't decode image row!");
+    }
+
+    PaletteLut lut = {};
+    get_palette_lut(png -> palette, png -> depth, &lut);
+
+    SymbolBuffer buffer = parse_packed_data(png -> width, png -> height, &lut, data, jobs, scale);
+
+    free(data);
+
+    return buffer;
+}
+
+
+void free_symbol_buffer(SymbolBuffer *buffer) {
+    assert(buffer && "Can't free null pointer!");
+
+    free(buffer -> shapes);
+    buffer -> shapes = nullptr;
+
+    free(buffer -> colors);
+    buffer -> colors = nullptr;
+
+    free(buffer -> occupancy);
+    buffer -> occupancy = nullptr;
+    buffer -> occupancy_stride = 0;
+
+    buffer -> width = -1;
+    buffer -> height = -1;
+    buffer -> size = 0;
+}
+
+
+size_t get_next_symbol(const SymbolBuffer *buffer, size_t index) {
+    assert(buffer && "Can't search in null buffer!");
+    assert(buffer -> occupancy && "Buffer has no occupancy bitmap!");
+
+    size_t width = (size_t) buffer -> width;
+
+    // Empty rows and blocks of 64 symbols take one word compare each
+    for (size_t y = (index + 1) / width, x = (index + 1) % width; y < (size_t) buffer -> height; y++, x = 0) {
+        x = (size_t) find_next_bit(buffer -> occupancy + y * buffer -> occupancy_stride, (int) x, (int) width);
+
+        if (x < width) return y * width + x;
+    }
+
+    return buffer -> size - 1;
+}
+
+
+size_t count_symbols(const SymbolBuffer *buffer) {
+    assert(buffer && "Can't count symbols of null buffer!");
+
+    size_t count = 0, words = (size_t) buffer -> occupancy_stride * (size_t) buffer -> height;
+
+    for (size_t i = 0; i < words; i++)
+        count += (size_t) __builtin_popcountll(buffer -> occupancy[i]);
+
+    return count;
+}
+
+
+Symbol get_buffer_symbol(const SymbolBuffer *buffer, size_t index) {
+    assert(buffer && "Can't get symbol from null buffer!");
+    assert(index < buffer -> size && "Symbol index is out of buffer!");
+
+    const int OFFSET = SYMBOL_SIZE + 1;
+
+    size_t width = (size_t) buffer -> width;
+
+    return {buffer -> colors[index], buffer -> shapes[index], (int) (index % width) * OFFSET, (int) (index / width) * OFFSET};
+}
+
+
 void print_symbol(const Symbol *symbol) {
     assert(symbol && "Can't print null symbol!");
 
@@ -142,10 +718,10 @@ void print_symbol(const Symbol *symbol) {
 }
 
 
-int remove_empty_symbols(Symbol *buffer, int buffer_size) {
+size_t remove_empty_symbols(Symbol *buffer, size_t buffer_size) {
     assert(buffer && "Can't clear empty buffer!");
 
-    int read = 0, write = 0;
+    size_t read = 0, write = 0;
 
     for (; read < buffer_size; read++) {
         if (buffer[read].shape)
@@ -157,24 +733,28 @@ int remove_empty_symbols(Symbol *buffer, int buffer_size) {
 
 
 Pixel *symbols_to_pixels(int width, int height, const Symbol *symbols) {
-    Pixel *pixels = (Pixel *) calloc(width * height * 36, sizeof(Pixel));
+    size_t row = (size_t) width * 6;
 
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            int mask = 1;
+    Pixel *pixels = (Pixel *) calloc(row * height * 6, sizeof(Pixel));
 
-            for (int i = 0; i < SYMBOL_SIZE; i++) {
-                for (int j = 0; j < SYMBOL_SIZE; j++) {
-                    if (symbols[y * width + x].shape & mask) pixels[(y * 6 + i) * width * 6 + (x * 6 + j)] = symbols[y * width + x].color;
-                    else pixels[(y * 6 + i) * width * 6 + (x * 6 + j)] = {255, 255, 255, 255};
+    for (size_t y = 0; y < (size_t) height; y++) {
+        for (size_t x = 0; x < (size_t) width; x++) {
+            const Symbol *symbol = symbols + y * width + x;
+
+            unsigned int mask = 1;
+
+            for (size_t i = 0; i < SYMBOL_SIZE; i++) {
+                for (size_t j = 0; j < SYMBOL_SIZE; j++) {
+                    if (symbol -> shape & mask) pixels[(y * 6 + i) * row + (x * 6 + j)] = symbol -> color;
+                    else pixels[(y * 6 + i) * row + (x * 6 + j)] = {255, 255, 255, 255};
 
                     mask <<= 1;
                 }
             }
 
-            for (int i = 0; i < SYMBOL_SIZE + 1; i++) {
-                pixels[(y * 6 + i) * width * 6 + (x * 6 + 5)] = {161, 161, 161, 255};
-                pixels[(y * 6 + 5) * width * 6 + (x * 6 + i)] = {161, 161, 161, 255};
+            for (size_t i = 0; i < SYMBOL_SIZE + 1; i++) {
+                pixels[(y * 6 + i) * row + (x * 6 + 5)] = {161, 161, 161, 255};
+                pixels[(y * 6 + 5) * row + (x * 6 + i)] = {161, 161, 161, 255};
             }
 
         }
@@ -185,11 +765,13 @@ Pixel *symbols_to_pixels(int width, int height, const Symbol *symbols) {
 
 
 void write_image(const char *filename, int width, int height, const Pixel *pixels) {
-    unsigned char *data = (unsigned char *) calloc(width * height * 4, sizeof(unsigned char));
+    size_t size = (size_t) width * (size_t) height;
+
+    unsigned char *data = (unsigned char *) calloc(size * 4, sizeof(unsigned char));
 
     const int COMP = 4; // Amount of channels in image
 
-    for (int i = 0; i < width * height; i++) {
+    for (size_t i = 0; i < size; i++) {
         data[COMP * i + 0] = pixels[i].r;
         data[COMP * i + 1] = pixels[i].g;
         data[COMP * i + 2] = pixels[i].b;
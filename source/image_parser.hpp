@@ -32,6 +32,18 @@ typedef struct {
 const unsigned int TERMINATOR = 0x01FFFFFF;
 
 
+/// Contains symbols grid as separate arrays, symbol coordinates are derived from its index
+typedef struct {
+    unsigned int *shapes = nullptr; ///< Array of shapes from top left corner to bottom right that ends with TERMINATOR
+    Pixel *colors = nullptr;        ///< Array of symbols colors in the same order
+    int width = -1;                 ///< Grid width in symbols
+    int height = -1;                ///< Grid height in symbols
+    size_t size = 0;                ///< Shapes count including TERMINATOR
+    unsigned long long *occupancy = nullptr;    ///< Bit for every not empty symbol, each symbol row starts with new word
+    int occupancy_stride = 0;       ///< Occupancy words per symbol row
+} SymbolBuffer;
+
+
 
 
 /**
@@ -91,7 +103,93 @@ Symbol get_image_symbol(const Image *image, int x, int y);
  * \param [out] symbols_size New symbols array size
  * \return Array of symbols
 */
-Symbol *parse_image(const Image *image, int *symbols_size);
+Symbol *parse_image(const Image *image, size_t *symbols_size);
+
+
+/**
+ * \brief Parses raw image data to symbol buffer without creating array of pixels
+ * \param [in] width  Image width in pixels
+ * \param [in] height Image height in pixels
+ * \param [in] comp   Amount of channels, 3 for RGB and 4 for RGBA
+ * \param [in] data   Raw image data from stbi_load or mapped file
+ * \param [in] jobs   Amount of threads to parse symbol rows with
+ * \param [in] scale  Integer scale of upscaled image, zero means that it is detected
+ * \return New symbol buffer
+*/
+SymbolBuffer parse_image_data(int width, int height, int comp, const unsigned char *data, int jobs = 1, int scale = 0);
+
+
+/**
+ * \brief Detects integer scale of upscaled image by positions of its pixel edges
+ * \param [in] width  Image width in pixels
+ * \param [in] height Image height in pixels
+ * \param [in] comp   Amount of channels, 3 for RGB and 4 for RGBA
+ * \param [in] data   Raw image data
+ * \return Scale, 1 means that image is not upscaled, 0 means that image is blank
+*/
+int get_image_scale(int width, int height, int comp, const unsigned char *data);
+
+
+/**
+ * \brief Reads image straight into symbol buffer
+ * \note Binary PPM, PAM and QOI files are read without stb, other formats are loaded by stb
+ * \param [in] filename Path to file
+ * \param [in] jobs     Amount of threads to parse symbol rows with
+ * \param [in] scale    Integer scale of upscaled image, zero means that it is detected
+ * \return New symbol buffer
+*/
+SymbolBuffer read_symbols(const char *filename, int jobs = 1, int scale = 0);
+
+
+/// Function that gets symbols of every image tile in order
+typedef void (*TileHandler)(const SymbolBuffer *tile, void *data);
+
+
+/**
+ * \brief Reads image by horizontal tiles, so only one tile of pixels and symbols is in memory at a time
+ * \param [in] filename  Path to file
+ * \param [in] tile_rows Amount of symbol rows in one tile
+ * \param [in] jobs      Amount of threads to parse symbol rows of tile with
+ * \param [in] handler   Function that is called for every tile, its symbols end with TERMINATOR
+ * \param [in] data      Pointer that is passed to handler
+ * \param [in] scale     Integer scale of upscaled image, zero means that it is detected
+ * \return Non zero value means that image format can't be read by tiles or detected scale is not 1, handler is not called then
+ * \note Binary PPM, PAM, QOI and png that can be decoded row by row are supported, scale is detected by the first tile with ink
+*/
+int read_symbol_tiles(const char *filename, int tile_rows, int jobs, TileHandler handler, void *data = nullptr, int scale = 0);
+
+
+/**
+ * \brief Symbol buffer destructor
+ * \param [in] buffer To destruct
+*/
+void free_symbol_buffer(SymbolBuffer *buffer);
+
+
+/**
+ * \brief Jumps over empty symbols using occupancy bitmap
+ * \param [in] buffer To search in
+ * \param [in] index  Index of symbol to search after
+ * \return Index of the next not empty symbol or TERMINATOR index
+*/
+size_t get_next_symbol(const SymbolBuffer *buffer, size_t index);
+
+
+/**
+ * \brief Counts not empty symbols using occupancy bitmap
+ * \param [in] buffer To count in
+ * \return Amount of not empty symbols without TERMINATOR
+*/
+size_t count_symbols(const SymbolBuffer *buffer);
+
+
+/**
+ * \brief Gets symbol from buffer and calculates its coordinates
+ * \param [in] buffer To get from
+ * \param [in] index  Symbol index in buffer
+ * \return Symbol copy
+*/
+Symbol get_buffer_symbol(const SymbolBuffer *buffer, size_t index);
 
 
 /**
@@ -107,7 +205,7 @@ void print_symbol(const Symbol *symbol);
  * \param [in]  buffer_size Buffer actual size
  * \return New buffer size after cleaning
 */
-int remove_empty_symbols(Symbol *buffer, int buffer_size);
+size_t remove_empty_symbols(Symbol *buffer, size_t buffer_size);
 
 
 /**
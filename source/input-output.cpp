@@ -1,19 +1,22 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 
 #if defined(_WIN32) || defined(_WIN64)
     #include <io.h>
 #elif __linux__
     #include <unistd.h>
+    #include <sys/mman.h>
 #else
     #error "Your system case is not defined!"
 #endif
 
 #include <ctype.h>
 #include <string.h>
+#include <charconv>
 #include "libs/tree.hpp"
-#include "libs/text.hpp"
+#include "libs/ident.hpp"
 #include "input-output.hpp"
 
 
@@ -26,98 +29,407 @@ do {
 } while(0)
 
 
+/// First bytes of binary AST file
+const char BINARY_AST_MAGIC[4] = {'P', 'X', 'A', 'T'};
+
+
+/// Version of binary AST format, files of other versions are not read
+const unsigned int BINARY_AST_VERSION = 2;
+
+
+/// Size of text writer buffer
+const size_t TEXT_BUFFER_SIZE = 1 << 20;
+
+
+/// Free space that text writer keeps for one number
+const size_t TEXT_NUMBER_SIZE = 512;
+
+
+
+/**
+ * Binary AST file is header followed by three sections, each of them is padded with zeros to 8 bytes:
+ * node records in postorder starting with null one, offsets of identificators in string table and string table itself.
+ * Checksum covers all sections, so file is checked before any node is read
+*/
+typedef struct {
+    char magic[4] = {};                 ///< #BINARY_AST_MAGIC
+    unsigned int version = 0;           ///< #BINARY_AST_VERSION
+    unsigned int node_count = 0;        ///< Amount of node records including null one
+    NodeIndex root = NO_NODE;           ///< Index of root record
+    unsigned int string_count = 0;      ///< Amount of identificators
+    unsigned int strings_size = 0;      ///< Size of string table with padding
+    unsigned long long checksum = 0;    ///< FNV-1a hash of sections by 8 byte words
+} BinaryAstHeader;
+
+
+/// Node record of binary AST
+typedef struct {
+    NodeValue value = {0};              ///< Operator, exact number or index of identificator in string table
+    NodeIndex left = NO_NODE;           ///< Index of left child record, it is always less than index of parent
+    NodeIndex right = NO_NODE;          ///< Index of right child record, it is always less than index of parent
+    unsigned int type = 0;              ///< Node type from #NODE_TYPES
+    unsigned int reserved = 0;          ///< Keeps records aligned to 8 bytes
+} BinaryAstNode;
+
+
+/// Mapped binary AST file with its sections
+typedef struct {
+    const BinaryAstHeader *header = nullptr;    ///< File header
+    const BinaryAstNode *nodes = nullptr;       ///< Node records
+    const unsigned int *offsets = nullptr;      ///< Offsets of identificators in string table
+    const char *strings = nullptr;              ///< String table
+} BinaryAst;
+
+
+/// Buffered writer of text AST
+typedef struct {
+    FILE *file = nullptr;               ///< Output file
+    char *buffer = nullptr;             ///< Buffer of #TEXT_BUFFER_SIZE bytes
+    size_t size = 0;                    ///< Amount of bytes in buffer
+} TextWriter;
+
+
+/// Node of text AST that is being read or written
+typedef struct {
+    NodeIndex node = NO_NODE;           ///< Index of node in flat tree
+    int shift = 0;                      ///< Offset of node text
+    int stage = 0;                      ///< Amount of children that are already read or written
+    int type = 0;                       ///< Type of node that is being read
+    NodeValue value = {0};              ///< Value of node that is being read
+    NodeIndex children[2] = {};         ///< Children of node that is being read
+} TextFrame;
+
+
+
+/**
+ * \brief Writes flat tree to text file with explicit stack instead of recursion
+ * \param [in]  tree     Flat tree
+ * \param [in]  root     Index of root node
+ * \param [out] filepath Output file
+ * \return Non zero value means error
+*/
+int write_text_tree(const FlatTree *tree, NodeIndex root, const char *filepath);
+
+
 /**
- * \brief Prints node and it's children
- * \param [in]  node   Node to start from
- * \param [out] stream Output file
- * \param [in]  shift  Output text offset
+ * \brief Writes node type and value
+ * \param [in] writer Text writer
+ * \param [in] type   Node type
+ * \param [in] value  Node value
 */
-void write_node(Node *node, FILE *stream, int shift);
+void put_text_value(TextWriter *writer, int type, NodeValue value);
 
 
 /**
- * \brief Removes all spaces from buffer
- * \param [out] buffer Buffer to remove from
+ * \brief Adds text to writer buffer
+ * \param [in] writer Text writer
+ * \param [in] text   Text to add
+ * \param [in] size   Text size
 */
-void clear_spaces(char *buffer);
+void put_text(TextWriter *writer, const char *text, size_t size);
 
 
 /**
- * \brief Reads node from buffer
- * \param [in] buffer Char buffer to read from
+ * \brief Adds spaces to writer buffer
+ * \param [in] writer Text writer
+ * \param [in] count  Amount of spaces
 */
-Node *read_node(char **buffer);
+void put_text_spaces(TextWriter *writer, size_t count);
 
 
+/**
+ * \brief Gives free space of writer buffer, buffer is flushed if it has less than size bytes left
+ * \param [in] writer Text writer
+ * \param [in] size   Required amount of bytes
+ * \return Pointer to the end of buffer
+*/
+char *reserve_text(TextWriter *writer, size_t size);
+
+
+/// Writes buffer to file
+void flush_text_writer(TextWriter *writer);
+
+
+/**
+ * \brief Reads file to flat tree detecting its format
+ * \param [out] tree     Not constructed flat tree
+ * \param [in]  filepath Path to the file
+ * \param [out] root     Index of root node
+ * \return Non zero value means error
+*/
+int load_flat_tree(FlatTree *tree, const char *filepath, NodeIndex *root);
+
+
+/**
+ * \brief Reads text AST in one pass, nodes are placed in postorder
+ * \param [in]  tree Constructed empty flat tree
+ * \param [in]  text Mapped file
+ * \param [in]  size File size
+ * \param [out] root Index of root node
+ * \return Non zero value means error
+*/
+int read_text_tree(FlatTree *tree, const char *text, size_t size, NodeIndex *root);
+
+
+/**
+ * \brief Reads node value from slice of text
+ * \param [out] value Node value
+ * \param [in]  type  Node type
+ * \param [in]  begin Beginning of value text
+ * \param [in]  end   End of value text without trailing spaces
+ * \return Non zero value means error
+*/
+int read_text_value(NodeValue *value, int type, const char *begin, const char *end);
+
 
+/// Skips spaces and gives pointer to the next symbol or to the end of text
+const char *skip_text_spaces(const char *text, const char *end);
+
+
+/**
+ * \brief Copies flat tree to pointer tree
+ * \param [in] tree Flat tree
+ * \param [in] root Index of root node
+ * \return Root of pointer tree or nullptr if tree is empty or allocation fails
+*/
+Node *build_node_tree(const FlatTree *tree, NodeIndex root);
+
+
+/// Non zero value means that node value is identificator
+int is_ident_type(int type);
+
+
+/**
+ * \brief Writes flat tree to binary AST file
+ * \param [in]  tree     Flat tree with nodes in postorder, so children indices are less than parent ones
+ * \param [in]  root     Index of root node
+ * \param [out] filepath Output file
+ * \return Non zero value means error
+*/
+int write_binary_tree(const FlatTree *tree, NodeIndex root, const char *filepath);
+
+
+/**
+ * \brief Maps file to memory
+ * \param [in]  filepath Path to the file
+ * \param [out] size     File size
+ * \return File content that is freed by unmap_tree_file or nullptr in case of error
+*/
+char *map_tree_file(const char *filepath, size_t *size);
+
+
+/**
+ * \brief Unmaps file
+ * \param [in] file Mapped file content
+ * \param [in] size File size
+*/
+void unmap_tree_file(char *file, size_t size);
+
+
+/**
+ * \brief Checks binary AST file and finds its sections
+ * \param [out] ast  Sections of file
+ * \param [in]  file Mapped file content
+ * \param [in]  size File size
+ * \return Non zero value means that file is not binary AST or it is damaged
+*/
+int open_binary_tree(BinaryAst *ast, const char *file, size_t size);
+
+
+/**
+ * \brief Interns identificators of string table
+ * \param [in] ast Opened binary AST
+ * \return Array of identificators by their indices in string table that must be freed or nullptr in case of error
+*/
+int *read_binary_idents(const BinaryAst *ast);
+
+
+/**
+ * \brief Gives node value with identificator instead of string table index
+ * \param [in] record Node record
+ * \param [in] idents Identificators by their indices in string table
+ * \return Node value
+*/
+NodeValue get_binary_value(const BinaryAstNode *record, const int *idents);
+
+
+/**
+ * \brief Calculates FNV-1a hash of data by 8 byte words
+ * \param [in] data Data to hash
+ * \param [in] size Size of data, multiple of 8
+ * \return Hash
+*/
+unsigned long long get_binary_checksum(const char *data, size_t size);
 
-int write_tree(Tree *tree, const char *filepath) {
+
+/// Rounds size up to multiple of 8
+size_t align_binary_size(size_t size);
+
+
+
+int write_tree(Tree *tree, const char *filepath, int binary) {
     check(tree, "Invalid pointer to tree!", 1);
     check(filepath, "Invalid pointer to filepath!", 2);
 
-    FILE *output = fopen(filepath, "w");
+    FlatTree flat = {};
 
-    write_node(tree -> root, output, 0);
+    check(!flat_tree_constructor(&flat), "Failed to construct flat tree!", ALLOC_FAIL);
 
-    fclose(output);
-    return 0;
+    NodeIndex root = flatten_tree(tree -> root, &flat);
+
+    int error = (binary)? write_binary_tree(&flat, root, filepath) : write_text_tree(&flat, root, filepath);
+
+    flat_tree_destructor(&flat);
+
+    return error;
 }
 
 
-#define PRINT(...) fprintf(stream, __VA_ARGS__)
+int write_flat_tree(const FlatTree *tree, NodeIndex root, const char *filepath, int binary) {
+    check(tree, "Invalid pointer to tree!", 1);
+    check(filepath, "Invalid pointer to filepath!", 2);
+
+    return (binary)? write_binary_tree(tree, root, filepath) : write_text_tree(tree, root, filepath);
+}
+
+
+int write_text_tree(const FlatTree *tree, NodeIndex root, const char *filepath) {
+    TextWriter writer = {};
+
+    writer.file = fopen(filepath, "w");
+    check(writer.file, "Failed to open output file!", 3);
+
+    writer.buffer = (char *) calloc(TEXT_BUFFER_SIZE, sizeof(char));
+
+    size_t capacity = 64, depth = 0;
+    TextFrame *stack = (TextFrame *) calloc(capacity, sizeof(TextFrame));
 
-void write_node(Node *node, FILE *stream, int shift) {
-    if (!node) return;
+    if (!writer.buffer || !stack) {
+        fclose(writer.file);
+        free(writer.buffer);
+        free(stack);
+        check(0, "Failed to allocate text writer!", ALLOC_FAIL);
+    }
+
+    if (root) stack[depth++] = {root, 0, 0};
+
+    // Node with children is written as "{type, value,\n" + left + right + "}", missing child is written as "{ }"
+    while (depth) {
+        TextFrame *frame = stack + depth - 1;
+
+        NodeIndex node = frame -> node, left = tree -> lefts[node], right = tree -> rights[node];
+
+        size_t shift = (size_t) frame -> shift;
+
+        if (frame -> stage == 0) {
+            put_text_spaces(&writer, shift);
+            put_text(&writer, "{", 1);
+            put_text_value(&writer, tree -> types[node], tree -> values[node]);
+
+            if (!left && !right) {
+                put_text(&writer, "}", 1);
+                depth--;
+                continue;
+            }
+
+            put_text(&writer, ",\n", 2);
+        }
+        else if (tree -> lefts[node] && frame -> stage == 1) put_text(&writer, "\n", 1);
+        else if (tree -> rights[node] && frame -> stage == 2) put_text(&writer, "\n", 1);
+
+        if (frame -> stage == 2) {
+            put_text_spaces(&writer, shift);
+            put_text(&writer, "}", 1);
+            depth--;
+            continue;
+        }
 
-    PRINT("%*s{", shift, "");
-    
-    switch (node -> type) {
-        case TYPE_OP:       PRINT("%i, %i",     TYPE_OP, node -> value.op);         break;
-        case TYPE_NUM:      PRINT("%i, %.3f",  TYPE_NUM, node -> value.dbl);       break;
-        case TYPE_VAR:      PRINT("%i, %s",     TYPE_VAR, node -> value.var);       break;
-        case TYPE_CALL:     PRINT("%i, %s",     TYPE_CALL, node -> value.var);      break;
-        case TYPE_DEF:      PRINT("%i, %s",     TYPE_DEF, node -> value.var);       break;
-        case TYPE_NVAR:     PRINT("%i, %s",     TYPE_NVAR, node -> value.var);      break;
-        case TYPE_PAR:      PRINT("%i, %s",     TYPE_PAR, node -> value.var);       break;
-        default:            PRINT("%i, 0",      node -> type);                      break;
+        NodeIndex child = (frame -> stage++ == 0)? left : right;
+
+        if (!child) {
+            put_text_spaces(&writer, shift + 4);
+            put_text(&writer, "{ }\n", 4);
+            continue;
+        }
+
+        if (depth == capacity) {
+            capacity *= 2;
+            stack = (TextFrame *) realloc(stack, capacity * sizeof(TextFrame));
+        }
+
+        stack[depth++] = {child, (int) shift + 4, 0};
     }
 
-    if (node -> left) {
-        PRINT(",\n");
-        write_node(node -> left, stream, shift + 4);
+    flush_text_writer(&writer);
+
+    fclose(writer.file);
+    free(writer.buffer);
+    free(stack);
+
+    return 0;
+}
+
 
-        if (node -> right)
-            PRINT("\n");
-        else
-            PRINT("\n%*s{ }\n", shift + 4, "");
+void put_text_value(TextWriter *writer, int type, NodeValue value) {
+    char *text = reserve_text(writer, TEXT_NUMBER_SIZE), *limit = text + TEXT_NUMBER_SIZE;
+
+    text = std::to_chars(text, limit, type).ptr;
+
+    *(text++) = ',';
+    *(text++) = ' ';
+
+    switch (type) {
+        case TYPE_OP:   text = std::to_chars(text, limit, value.op).ptr; break;
+        case TYPE_NUM:  text = std::to_chars(text, limit, value.dbl, std::chars_format::fixed, 3).ptr; break;
+        case TYPE_VAR: case TYPE_CALL: case TYPE_DEF: case TYPE_NVAR: case TYPE_PAR: {
+            writer -> size = (size_t) (text - writer -> buffer);
+
+            const char *name = get_ident_name(value.id);
+            put_text(writer, name, strlen(name));
+
+            return;
+        }
+        default: *(text++) = '0'; break;
     }
-    
-    if (node -> right) {
-        if (!node -> left)
-            PRINT(",\n%*s{ }\n", shift + 4, "");
-        
-        write_node(node -> right, stream, shift + 4);
-        PRINT("\n");
+
+    writer -> size = (size_t) (text - writer -> buffer);
+}
+
+
+void put_text(TextWriter *writer, const char *text, size_t size) {
+    if (size > TEXT_BUFFER_SIZE) {
+        flush_text_writer(writer);
+        fwrite(text, sizeof(char), size, writer -> file);
+        return;
     }
 
-    if (node -> left || node -> right)
-        PRINT("%*s}", shift, "");
-    else
-        PRINT("}");
+    memcpy(reserve_text(writer, size), text, size);
+    writer -> size += size;
 }
 
-#undef PRINT
 
+void put_text_spaces(TextWriter *writer, size_t count) {
+    while (count) {
+        size_t size = (count < TEXT_BUFFER_SIZE)? count : TEXT_BUFFER_SIZE;
 
-void clear_spaces(char *buffer) {
-    int read = 0, write = 0;
+        memset(reserve_text(writer, size), ' ', size);
+        writer -> size += size;
 
-    for (; buffer[read] != '\0'; read++) {
-        if (!isspace(buffer[read]))
-            buffer[write++] = buffer[read];
+        count -= size;
     }
+}
+
+
+char *reserve_text(TextWriter *writer, size_t size) {
+    if (writer -> size + size > TEXT_BUFFER_SIZE) flush_text_writer(writer);
+
+    return writer -> buffer + writer -> size;
+}
+
 
-    buffer[write] = '\0';
+void flush_text_writer(TextWriter *writer) {
+    fwrite(writer -> buffer, sizeof(char), writer -> size, writer -> file);
+    writer -> size = 0;
 }
 
 
@@ -125,61 +437,469 @@ int read_tree(Tree *tree, const char *filepath) {
     check(tree, "Invalid pointer to tree!", 1);
     check(filepath, "Invalid pointer to filepath!", 2);
 
-    int input = open(filepath, O_RDONLY);
+    FlatTree flat = {};
+    NodeIndex root = NO_NODE;
+
+    int error = load_flat_tree(&flat, filepath, &root);
 
-    char *buffer = nullptr;
+    if (!error) {
+        tree -> root = build_node_tree(&flat, root);
 
-    read_in_buffer(input, &buffer, get_file_size(input));
+        if (!tree -> root && root) error = ALLOC_FAIL;
+    }
+
+    flat_tree_destructor(&flat);
+
+    return error;
+}
+
+
+NodeIndex read_flat_tree(FlatTree *tree, const char *filepath) {
+    check(tree, "Invalid pointer to tree!", NO_NODE);
+    check(filepath, "Invalid pointer to filepath!", NO_NODE);
+
+    NodeIndex root = NO_NODE;
+
+    return (load_flat_tree(tree, filepath, &root))? NO_NODE : root;
+}
 
-    replace_in_buffer(buffer, '\n', ' ');
 
-    clear_spaces(buffer);
+int load_flat_tree(FlatTree *tree, const char *filepath, NodeIndex *root) {
+    size_t size = 0;
+    char *file = map_tree_file(filepath, &size);
 
-    char *buf = buffer;
+    check(file, "Failed to read file!", 3);
 
-    tree -> root = read_node(&buf);
+    int error = 0;
 
-    free(buffer);
+    if (size >= sizeof(BINARY_AST_MAGIC) && !memcmp(file, BINARY_AST_MAGIC, sizeof(BINARY_AST_MAGIC))) {
+        BinaryAst ast = {};
+        int *idents = nullptr;
+
+        if (open_binary_tree(&ast, file, size) || !(idents = read_binary_idents(&ast)) ||
+            flat_tree_constructor(tree, ast.header -> node_count)) {
+            free(idents);
+            unmap_tree_file(file, size);
+            return 4;
+        }
+
+        // Records are in postorder like flat tree nodes, so their indices stay the same
+        for (NodeIndex i = 1; i < ast.header -> node_count; i++) {
+            const BinaryAstNode *record = ast.nodes + i;
+
+            add_flat_node(tree, (int) record -> type, get_binary_value(record, idents));
+
+            tree -> lefts[i] = record -> left;
+            tree -> rights[i] = record -> right;
+        }
+
+        *root = ast.header -> root;
+
+        free(idents);
+    }
+    else {
+        error = flat_tree_constructor(tree);
+
+        if (!error) error = read_text_tree(tree, file, size, root);
+    }
+
+    unmap_tree_file(file, size);
+
+    return error;
+}
+
+
+int read_text_tree(FlatTree *tree, const char *text, size_t size, NodeIndex *root) {
+    const char *s = text, *end = text + size;
+
+    size_t capacity = 64, depth = 0;
+    TextFrame *stack = (TextFrame *) calloc(capacity, sizeof(TextFrame));
+
+    check(stack, "Failed to allocate stack!", ALLOC_FAIL);
+
+    int error = 0;
+
+    *root = NO_NODE;
+
+    // Node is "{ }" or "{type, value}" or "{type, value, left right}", parents wait on stack for their children
+    // and are placed after them, when their closing bracket is read
+    do {
+        s = skip_text_spaces(s, end);
+
+        if (s == end || *s != '{') {
+            error = 5;
+            break;
+        }
+
+        s = skip_text_spaces(s + 1, end);
+
+        NodeIndex node = NO_NODE;
+        int has_children = 0, is_empty = 0, type = 0;
+        NodeValue node_value = {0};
+
+        if (s < end && *s == '}') {
+            is_empty = 1;
+            s++;
+        }
+        else {
+            std::from_chars_result result = std::from_chars(s, end, type);
+
+            s = skip_text_spaces(result.ptr, end);
+
+            if (result.ec != std::errc() || s == end || *s != ',') {
+                error = 5;
+                break;
+            }
+
+            const char *value = skip_text_spaces(s + 1, end);
+
+            s = value;
+            while (s < end && *s != ',' && *s != '}') s++;
+
+            const char *value_end = s;
+            while (value_end > value && isspace((unsigned char) value_end[-1])) value_end--;
+
+            if (s == end || read_text_value(&node_value, type, value, value_end)) {
+                error = 5;
+                break;
+            }
+
+            has_children = (*(s++) == ',');
+        }
+
+        if (has_children) {
+            if (depth == capacity) {
+                capacity *= 2;
+                stack = (TextFrame *) realloc(stack, capacity * sizeof(TextFrame));
+            }
+
+            stack[depth++] = {NO_NODE, 0, 0, type, node_value, {NO_NODE, NO_NODE}};
+            continue;
+        }
+
+        if (!is_empty) {
+            node = add_flat_node(tree, type, node_value);
+
+            if (!node) {
+                error = ALLOC_FAIL;
+                break;
+            }
+        }
+
+        // Closing brackets of parents that got both children
+        for (;;) {
+            if (!depth) {
+                *root = node;
+                break;
+            }
+
+            TextFrame *parent = stack + depth - 1;
+
+            parent -> children[parent -> stage++] = node;
+
+            if (parent -> stage < 2) break;
+
+            s = skip_text_spaces(s, end);
+
+            if (s == end || *s != '}') {
+                error = 5;
+                break;
+            }
+
+            s++;
+
+            node = add_flat_node(tree, parent -> type, parent -> value);
+
+            if (!node) {
+                error = ALLOC_FAIL;
+                break;
+            }
+
+            tree -> lefts[node] = parent -> children[0];
+            tree -> rights[node] = parent -> children[1];
+
+            depth--;
+        }
+    } while (depth && !error);
+
+    free(stack);
+
+    check(!error || error == ALLOC_FAIL, "Wrong text AST format!", error);
+
+    return error;
+}
+
+
+int read_text_value(NodeValue *value, int type, const char *begin, const char *end) {
+    switch (type) {
+        case TYPE_OP:       return std::from_chars(begin, end, value -> op).ec != std::errc();
+        case TYPE_NUM:      return std::from_chars(begin, end, value -> dbl).ec != std::errc();
+        case TYPE_VAR: case TYPE_CALL: case TYPE_DEF: case TYPE_NVAR: case TYPE_PAR: {
+            value -> id = intern_ident_slice(begin, (int) (end - begin));
+            return 0;
+        }
+        default:            return 0;
+    }
+}
+
+
+const char *skip_text_spaces(const char *text, const char *end) {
+    // Indentation takes most of the file, so runs of spaces are skipped by eight at once
+    const unsigned long long SPACES = 0x2020202020202020ULL;
+
+    while (text < end) {
+        unsigned long long word = 0;
+
+        if (end - text >= 8) memcpy(&word, text, sizeof(word));
+
+        if (word == SPACES) text += 8;
+        else if (isspace((unsigned char) *text)) text++;
+        else break;
+    }
+
+    return text;
+}
+
+
+Node *build_node_tree(const FlatTree *tree, NodeIndex root) {
+    if (!root) return nullptr;
+
+    Node **nodes = (Node **) calloc(tree -> size, sizeof(Node *));
+    if (!nodes) return nullptr;
+
+    // Children go before parent in postorder, so they are created first and shared ones are created once
+    for (NodeIndex node = 1; node <= root; node++)
+        nodes[node] = create_node(tree -> types[node], tree -> values[node], nodes[tree -> lefts[node]], nodes[tree -> rights[node]]);
+
+    Node *result = nodes[root];
+
+    free(nodes);
+
+    return result;
+}
+
+
+int is_ident_type(int type) {
+    return type == TYPE_VAR || type == TYPE_CALL || type == TYPE_DEF || type == TYPE_NVAR || type == TYPE_PAR;
+}
+
+
+int write_binary_tree(const FlatTree *tree, NodeIndex root, const char *filepath) {
+    int max_id = -1;
+
+    for (NodeIndex node = 1; node < tree -> size; node++) {
+        check(tree -> lefts[node] < node && tree -> rights[node] < node, "Flat tree nodes are not in postorder!", INVALID_ARG);
+
+        if (is_ident_type(tree -> types[node]) && tree -> values[node].id > max_id) max_id = tree -> values[node].id;
+    }
+
+    // Identificators get indices in string table in order of their first use
+    int *indices = (int *) calloc((size_t) max_id + 2, sizeof(int));
+    const char **names = (const char **) calloc((size_t) max_id + 2, sizeof(const char *));
+
+    unsigned int string_count = 0;
+    size_t chars = 0;
+
+    for (NodeIndex node = 1; indices && names && node < tree -> size; node++) {
+        if (!is_ident_type(tree -> types[node]) || indices[tree -> values[node].id]) continue;
+
+        names[string_count] = get_ident_name(tree -> values[node].id);
+        chars += strlen(names[string_count]) + 1;
+
+        indices[tree -> values[node].id] = (int) ++string_count;
+    }
+
+    size_t nodes_size = (size_t) tree -> size * sizeof(BinaryAstNode);
+    size_t offsets_size = align_binary_size(string_count * sizeof(unsigned int)), strings_size = align_binary_size(chars);
+    size_t file_size = sizeof(BinaryAstHeader) + nodes_size + offsets_size + strings_size;
+
+    char *file = (indices && names)? (char *) calloc(file_size, sizeof(char)) : nullptr;
+
+    if (!file) {
+        free(indices);
+        free(names);
+        check(0, "Failed to allocate binary AST!", ALLOC_FAIL);
+    }
+
+    BinaryAstHeader *header = (BinaryAstHeader *) file;
+    BinaryAstNode *nodes = (BinaryAstNode *) (file + sizeof(BinaryAstHeader));
+    unsigned int *offsets = (unsigned int *) (file + sizeof(BinaryAstHeader) + nodes_size);
+    char *strings = file + sizeof(BinaryAstHeader) + nodes_size + offsets_size;
+
+    for (NodeIndex node = 1; node < tree -> size; node++) {
+        BinaryAstNode *record = nodes + node;
+
+        record -> type = tree -> types[node];
+        record -> left = tree -> lefts[node];
+        record -> right = tree -> rights[node];
+
+        // Unused bytes of value stay zero, so the same tree always gives the same file
+        if (is_ident_type(tree -> types[node])) record -> value.id = indices[tree -> values[node].id] - 1;
+        else if (tree -> types[node] == TYPE_OP) record -> value.op = tree -> values[node].op;
+        else if (tree -> types[node] == TYPE_NUM) record -> value.dbl = tree -> values[node].dbl;
+    }
+
+    for (unsigned int i = 0, offset = 0; i < string_count; i++) {
+        offsets[i] = offset;
+
+        size_t length = strlen(names[i]) + 1;
+        memcpy(strings + offset, names[i], length);
+
+        offset += (unsigned int) length;
+    }
+
+    free(indices);
+    free(names);
+
+    memcpy(header -> magic, BINARY_AST_MAGIC, sizeof(BINARY_AST_MAGIC));
+    header -> version = BINARY_AST_VERSION;
+    header -> node_count = tree -> size;
+    header -> root = root;
+    header -> string_count = string_count;
+    header -> strings_size = (unsigned int) strings_size;
+    header -> checksum = get_binary_checksum(file + sizeof(BinaryAstHeader), file_size - sizeof(BinaryAstHeader));
+
+    FILE *output = fopen(filepath, "wb");
+
+    size_t written = (output)? fwrite(file, sizeof(char), file_size, output) : 0;
+
+    if (output) fclose(output);
+
+    free(file);
+
+    check(written == file_size, "Failed to write binary AST!", 3);
 
     return 0;
 }
 
 
-Node *read_node(char **buffer) {
-    if (strncmp(*buffer, "{}", 2) == 0) {
-        *buffer += 2;
+char *map_tree_file(const char *filepath, size_t *size) {
+    int input = open(filepath, O_RDONLY);
+    if (input == -1) return nullptr;
+
+    struct stat file_stat = {};
+
+    if (fstat(input, &file_stat) || file_stat.st_size <= 0) {
+        close(input);
         return nullptr;
     }
 
-    Node *node = create_node(0, {0});
+    *size = (size_t) file_stat.st_size;
+
+    char *file = nullptr;
+
+    #if defined(_WIN32) || defined(_WIN64)
+        file = (char *) calloc(*size, sizeof(char));
+
+        if (file && (size_t) read(input, file, (unsigned int) *size) != *size) {
+            free(file);
+            file = nullptr;
+        }
+    #else
+        void *map = mmap(nullptr, *size, PROT_READ, MAP_PRIVATE, input, 0);
+
+        if (map != MAP_FAILED) {
+            madvise(map, *size, MADV_SEQUENTIAL);
+            file = (char *) map;
+        }
+    #endif
 
-    char *name = (char *) calloc(64, sizeof(char));
+    close(input);
 
-    int offset = 0;
+    return file;
+}
+
+
+void unmap_tree_file(char *file, size_t size) {
+    #if defined(_WIN32) || defined(_WIN64)
+        free(file);
+    #else
+        if (file) munmap(file, size);
+    #endif
+}
+
+
+int open_binary_tree(BinaryAst *ast, const char *file, size_t size) {
+    check(size >= sizeof(BinaryAstHeader), "Binary AST is too small!", 1);
+
+    const BinaryAstHeader *header = (const BinaryAstHeader *) file;
+
+    check(!memcmp(header -> magic, BINARY_AST_MAGIC, sizeof(BINARY_AST_MAGIC)), "File is not binary AST!", 1);
+    check(header -> version == BINARY_AST_VERSION, "Binary AST version is not supported!", 2);
+
+    size_t nodes_size = (size_t) header -> node_count * sizeof(BinaryAstNode);
+    size_t offsets_size = align_binary_size((size_t) header -> string_count * sizeof(unsigned int));
 
-    sscanf(*buffer, "{%i,%[^,}]%n", &node -> type, name, &offset);
+    check(header -> node_count > 0 && header -> strings_size % 8 == 0 &&
+          sizeof(BinaryAstHeader) + nodes_size + offsets_size + header -> strings_size == size, "Binary AST size is wrong!", 3);
 
-    *buffer += offset;      // skip parsed symbols without ',' or '}'
-    
-    switch (node -> type) {
-        case TYPE_OP:       node -> value.op = atoi(name); break;
-        case TYPE_NUM:      node -> value.dbl = atof(name); break;
-        case TYPE_VAR:      node -> value.var = name; break;
-        case TYPE_CALL:     node -> value.var = name; break;
-        case TYPE_DEF:      node -> value.var = name; break;
-        case TYPE_NVAR:     node -> value.var = name; break;
-        case TYPE_PAR:      node -> value.var = name; break;
-        default:            free(name); break;
+    check(header -> checksum == get_binary_checksum(file + sizeof(BinaryAstHeader), size - sizeof(BinaryAstHeader)),
+          "Binary AST checksum is wrong!", 4);
+
+    ast -> header = header;
+    ast -> nodes = (const BinaryAstNode *) (file + sizeof(BinaryAstHeader));
+    ast -> offsets = (const unsigned int *) (file + sizeof(BinaryAstHeader) + nodes_size);
+    ast -> strings = file + sizeof(BinaryAstHeader) + nodes_size + offsets_size;
+
+    // Children are checked to go before parent, so tree can't have cycles and is built in one pass, but can share nodes
+    check(header -> root < header -> node_count, "Binary AST root is wrong!", 5);
+
+    for (NodeIndex node = 1; node < header -> node_count; node++) {
+        const BinaryAstNode *record = ast -> nodes + node;
+
+        check(record -> type <= TYPE_BRANCH, "Binary AST node type is wrong!", 5);
+
+        check(record -> left < node && record -> right < node, "Binary AST node child is wrong!", 5);
+
+        check(!is_ident_type((int) record -> type) || (unsigned int) record -> value.id < header -> string_count,
+              "Binary AST identificator is wrong!", 5);
     }
 
-    if (**buffer == ',') {
-        *buffer += 1;       // skip ','
+    // The last byte of string table is zero, so every string ends inside of it
+    check(header -> string_count == 0 || (header -> strings_size > 0 && ast -> strings[header -> strings_size - 1] == '\0'),
+          "Binary AST string table is wrong!", 5);
+
+    for (unsigned int i = 0; i < header -> string_count; i++)
+        check(ast -> offsets[i] < header -> strings_size, "Binary AST string offset is wrong!", 5);
+
+    return 0;
+}
+
+
+int *read_binary_idents(const BinaryAst *ast) {
+    int *idents = (int *) calloc((size_t) ast -> header -> string_count + 1, sizeof(int));
+    if (!idents) return nullptr;
+
+    for (unsigned int i = 0; i < ast -> header -> string_count; i++)
+        idents[i] = intern_ident_name(ast -> strings + ast -> offsets[i]);
+
+    return idents;
+}
+
+
+NodeValue get_binary_value(const BinaryAstNode *record, const int *idents) {
+    NodeValue value = record -> value;
 
-        node -> left = read_node(buffer);
-        node -> right = read_node(buffer);
+    if (is_ident_type((int) record -> type)) value.id = idents[record -> value.id];
+
+    return value;
+}
+
+
+unsigned long long get_binary_checksum(const char *data, size_t size) {
+    unsigned long long hash = 14695981039346656037ULL;
+
+    for (size_t i = 0; i + 8 <= size; i += 8) {
+        unsigned long long word = 0;
+        memcpy(&word, data + i, sizeof(word));
+
+        hash = (hash ^ word) * 1099511628211ULL;
     }
 
-    *buffer += 1;           // skip '}'
+    return hash;
+}
+
 
-    return node;
+size_t align_binary_size(size_t size) {
+    return (size + 7) & ~(size_t) 7;
 }
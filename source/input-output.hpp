@@ -1,10 +1,12 @@
 /**
- * \brief Prints tree to file in preorder
+ * \brief Prints tree to file
  * \param [in]  tree     To print
  * \param [out] filepath Output file
+ * \param [in]  binary   Non zero value means that tree is saved in binary format with exact numbers
  * \return Non zero value means error
+ * \note Text format repeats node for every parent that shares it, binary format keeps it once
 */
-int write_tree(Tree *tree, const char *filepath);
+int write_tree(Tree *tree, const char *filepath, int binary = 0);
 
 
 /**
@@ -12,5 +14,27 @@ int write_tree(Tree *tree, const char *filepath);
  * \param [out] tree     Not allocated tree
  * \param [in]  filepath Path to the file
  * \return Non zero value means error
+ * \note Binary format is detected by the first bytes of file, otherwise file is read as text
 */
 int read_tree(Tree *tree, const char *filepath);
+
+
+/**
+ * \brief Prints flat tree to file in the same format as write_tree
+ * \param [in]  tree     To print
+ * \param [in]  root     Index of root node
+ * \param [out] filepath Output file
+ * \param [in]  binary   Non zero value means binary format, children must go before parents then
+ * \return Non zero value means error
+*/
+int write_flat_tree(const FlatTree *tree, NodeIndex root, const char *filepath, int binary = 0);
+
+
+/**
+ * \brief Reads file straight into flat tree placing nodes in postorder
+ * \param [out] tree     Not constructed flat tree
+ * \param [in]  filepath Path to the file
+ * \return Index of root node or NO_NODE in case of error
+ * \note Binary format is detected by the first bytes of file, its records are copied to flat tree as they are
+*/
+NodeIndex read_flat_tree(FlatTree *tree, const char *filepath);
@@ -0,0 +1,187 @@
+/**
+ * \file
+ * \brief Identificator table module source
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "ident.hpp"
+
+
+/// Identificator key and its name
+typedef struct {
+    size_t key = 0;                 ///< Offset of key in key pool
+    int size = 0;                   ///< Key size in bytes
+    int is_name = 0;                ///< Non zero value means that key is textual name itself
+    unsigned int hash = 0;          ///< Key hash
+    char *name = nullptr;           ///< Textual name, created on demand
+} Ident;
+
+
+/// Open addressing hash table of identificators
+typedef struct {
+    Ident *idents = nullptr;        ///< Identificators by their indices
+    int count = 0;                  ///< Amount of identificators
+    int capacity = 0;               ///< Size of identificators array
+    int *slots = nullptr;           ///< Index plus one of identificator for every hash slot, zero means empty slot
+    int slot_count = 0;             ///< Amount of slots, always power of two
+    unsigned char *keys = nullptr;  ///< Key pool
+    size_t keys_size = 0;           ///< Used bytes of key pool
+    size_t keys_capacity = 0;       ///< Size of key pool
+} IdentTable;
+
+
+/// Identificators of the program
+IdentTable ident_table = {};
+
+
+/// Calculates FNV-1a hash of key
+unsigned int get_key_hash(const unsigned char *key, int size, int is_name);
+
+
+/// Finds or adds key of any kind
+int intern_key(const unsigned char *key, int size, int is_name);
+
+
+/// Doubles amount of slots and places all identificators again
+void grow_ident_slots();
+
+
+
+
+unsigned int get_key_hash(const unsigned char *key, int size, int is_name) {
+    unsigned int hash = 2166136261u ^ (unsigned int) is_name;
+
+    for (int i = 0; i < size; i++)
+        hash = (hash ^ key[i]) * 16777619u;
+
+    return hash;
+}
+
+
+void grow_ident_slots() {
+    free(ident_table.slots);
+
+    ident_table.slot_count = (ident_table.slot_count)? ident_table.slot_count * 2 : 256;
+    ident_table.slots = (int *) calloc((size_t) ident_table.slot_count, sizeof(int));
+
+    unsigned int mask = (unsigned int) ident_table.slot_count - 1;
+
+    for (int i = 0; i < ident_table.count; i++) {
+        unsigned int slot = ident_table.idents[i].hash & mask;
+
+        while (ident_table.slots[slot]) slot = (slot + 1) & mask;
+
+        ident_table.slots[slot] = i + 1;
+    }
+}
+
+
+int intern_key(const unsigned char *key, int size, int is_name) {
+    // Table is never more than half full
+    if (ident_table.count * 2 >= ident_table.slot_count) grow_ident_slots();
+
+    unsigned int hash = get_key_hash(key, size, is_name), mask = (unsigned int) ident_table.slot_count - 1;
+
+    unsigned int slot = hash & mask;
+
+    for (; ident_table.slots[slot]; slot = (slot + 1) & mask) {
+        const Ident *ident = ident_table.idents + ident_table.slots[slot] - 1;
+
+        if (ident -> hash == hash && ident -> size == size && ident -> is_name == is_name &&
+            !memcmp(ident_table.keys + ident -> key, key, (size_t) size))
+            return ident_table.slots[slot] - 1;
+    }
+
+    if (ident_table.count == ident_table.capacity) {
+        ident_table.capacity = (ident_table.capacity)? ident_table.capacity * 2 : 128;
+        ident_table.idents = (Ident *) realloc(ident_table.idents, (size_t) ident_table.capacity * sizeof(Ident));
+    }
+
+    if (ident_table.keys_size + (size_t) size > ident_table.keys_capacity) {
+        ident_table.keys_capacity = (ident_table.keys_capacity)? ident_table.keys_capacity * 2 : 4096;
+
+        if (ident_table.keys_capacity < ident_table.keys_size + (size_t) size)
+            ident_table.keys_capacity = ident_table.keys_size + (size_t) size;
+
+        ident_table.keys = (unsigned char *) realloc(ident_table.keys, ident_table.keys_capacity);
+    }
+
+    memcpy(ident_table.keys + ident_table.keys_size, key, (size_t) size);
+
+    ident_table.idents[ident_table.count] = {ident_table.keys_size, size, is_name, hash, nullptr};
+    ident_table.keys_size += (size_t) size;
+
+    ident_table.slots[slot] = ++ident_table.count;
+
+    return ident_table.count - 1;
+}
+
+
+int intern_ident(const unsigned char *key, int size) {
+    assert(key && "Can't intern null key!");
+    assert(size >= 3 && size <= IDENT_KEY_SIZE && (size - 3) % 4 == 0 && "Wrong identificator key size!");
+
+    return intern_key(key, size, 0);
+}
+
+
+int intern_ident_name(const char *name) {
+    assert(name && "Can't intern null name!");
+
+    return intern_key((const unsigned char *) name, (int) strlen(name), 1);
+}
+
+
+int intern_ident_slice(const char *name, int size) {
+    assert(name && "Can't intern null name!");
+    assert(size >= 0 && "Wrong name size!");
+
+    return intern_key((const unsigned char *) name, size, 1);
+}
+
+
+const char *get_ident_name(int id) {
+    assert(id >= 0 && id < ident_table.count && "Unknown identificator!");
+
+    Ident *ident = ident_table.idents + id;
+
+    if (ident -> name) return ident -> name;
+
+    const unsigned char *key = ident_table.keys + ident -> key;
+
+    if (ident -> is_name) {
+        ident -> name = (char *) calloc((size_t) ident -> size + 1, sizeof(char));
+        memcpy(ident -> name, key, (size_t) ident -> size);
+
+        return ident -> name;
+    }
+
+    // VAR_ prefix, six digits of color, underscore, eight digits of every shape and null terminator
+    ident -> name = (char *) calloc(4 + 6 + 1 + 8 * IDENT_MAX_SHAPES + 1, sizeof(char));
+
+    int offset = sprintf(ident -> name, "VAR_%02X%02X%02X_", key[0], key[1], key[2]);
+
+    for (int i = 3; i < ident -> size; i += 4) {
+        unsigned int shape = 0;
+        memcpy(&shape, key + i, sizeof(shape));
+
+        offset += sprintf(ident -> name + offset, "%08X", shape);
+    }
+
+    return ident -> name;
+}
+
+
+void free_ident_table() {
+    for (int i = 0; i < ident_table.count; i++)
+        free(ident_table.idents[i].name);
+
+    free(ident_table.idents);
+    free(ident_table.slots);
+    free(ident_table.keys);
+
+    ident_table = {};
+}
@@ -0,0 +1,52 @@
+/**
+ * \file
+ * \brief Identificator table module header
+*/
+
+
+/// Max amount of shapes in one identificator
+const int IDENT_MAX_SHAPES = 5;
+
+
+/// Max size of identificator key: three color bytes and four bytes of every shape
+const int IDENT_KEY_SIZE = 3 + 4 * IDENT_MAX_SHAPES;
+
+
+/**
+ * \brief Finds or adds identificator by color and shapes of its symbols
+ * \param [in] key  Red, green and blue bytes of color followed by shapes
+ * \param [in] size Key size in bytes
+ * \return Index of identificator, indices are given one by one starting from zero
+*/
+int intern_ident(const unsigned char *key, int size);
+
+
+/**
+ * \brief Finds or adds identificator by its textual name
+ * \param [in] name Name that was read from AST
+ * \return Index of identificator
+*/
+int intern_ident_name(const char *name);
+
+
+/**
+ * \brief Finds or adds identificator by part of text
+ * \param [in] name Name that doesn't have to end with null terminator, for example slice of mapped file
+ * \param [in] size Name size in bytes
+ * \return Index of identificator, it is the same as intern_ident_name gives for this name
+*/
+int intern_ident_slice(const char *name, int size);
+
+
+/**
+ * \brief Gives textual name of identificator
+ * \param [in] id Index of identificator
+ * \return Name like VAR_RRGGBB_XXXXXXXX, it is created on the first call and lives until table is freed
+*/
+const char *get_ident_name(int id);
+
+
+/**
+ * \brief Frees identificator table and all names
+*/
+void free_ident_table();
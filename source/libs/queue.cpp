@@ -0,0 +1,79 @@
+/**
+ * \file
+ * \brief Single producer single consumer queue module source
+*/
+
+#include <stdlib.h>
+#include <assert.h>
+#include <atomic>
+#include <thread>
+#include "queue.hpp"
+
+
+
+
+int queue_constructor(Queue *queue, size_t slot_size, long capacity) {
+    if (!queue || !slot_size || capacity < 1) return 1;
+
+    queue -> slots = (unsigned char *) calloc(capacity, slot_size);
+    if (!queue -> slots) return 2;
+
+    queue -> slot_size = slot_size;
+    queue -> capacity = capacity;
+
+    queue -> head.store(0);
+    queue -> tail.store(0);
+
+    return 0;
+}
+
+
+void *queue_back(Queue *queue) {
+    assert(queue && "Can't push to null queue!");
+
+    long tail = queue -> tail.load(std::memory_order_relaxed);
+
+    while (tail - queue -> head.load(std::memory_order_acquire) == queue -> capacity)
+        std::this_thread::yield();
+
+    return queue -> slots + (tail % queue -> capacity) * queue -> slot_size;
+}
+
+
+void queue_push(Queue *queue) {
+    assert(queue && "Can't push to null queue!");
+
+    queue -> tail.store(queue -> tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+
+void *queue_front(Queue *queue) {
+    assert(queue && "Can't pop from null queue!");
+
+    long head = queue -> head.load(std::memory_order_relaxed);
+
+    while (queue -> tail.load(std::memory_order_acquire) == head)
+        std::this_thread::yield();
+
+    return queue -> slots + (head % queue -> capacity) * queue -> slot_size;
+}
+
+
+void queue_pop(Queue *queue) {
+    assert(queue && "Can't pop from null queue!");
+
+    queue -> head.store(queue -> head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+
+int queue_destructor(Queue *queue) {
+    if (!queue) return 1;
+
+    free(queue -> slots);
+    queue -> slots = nullptr;
+
+    queue -> slot_size = 0;
+    queue -> capacity = 0;
+
+    return 0;
+}
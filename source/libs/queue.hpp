@@ -0,0 +1,69 @@
+/**
+ * \file
+ * \brief Single producer single consumer queue module header
+*/
+
+
+#include <atomic>
+
+
+/// Single producer single consumer queue of fixed size slots
+typedef struct {
+    unsigned char *slots = nullptr;     ///< Memory for all slots
+    size_t slot_size = 0;               ///< Slot size in bytes
+    long capacity = 0;                  ///< Amount of slots
+    std::atomic<long> head = {0};       ///< Amount of slots released by consumer
+    std::atomic<long> tail = {0};       ///< Amount of slots pushed by producer
+} Queue;
+
+
+/**
+ * \brief Constructs the queue
+ * \param [out] queue     Queue to construct
+ * \param [in]  slot_size Size of one slot in bytes
+ * \param [in]  capacity  Amount of slots
+ * \return Non zero value means error
+*/
+int queue_constructor(Queue *queue, size_t slot_size, long capacity);
+
+
+/**
+ * \brief Waits for free slot in the end of the queue
+ * \param [in] queue Producer's queue
+ * \return Pointer to slot memory that will be pushed by queue_push
+ * \warning Only producer thread can call this function
+*/
+void *queue_back(Queue *queue);
+
+
+/**
+ * \brief Gives slot from queue_back to consumer
+ * \param [in] queue Producer's queue
+ * \warning Only producer thread can call this function
+*/
+void queue_push(Queue *queue);
+
+
+/**
+ * \brief Waits for pushed slot in the beginning of the queue
+ * \param [in] queue Consumer's queue
+ * \return Pointer to slot memory that stays valid until queue_pop
+ * \warning Only consumer thread can call this function
+*/
+void *queue_front(Queue *queue);
+
+
+/**
+ * \brief Gives slot from queue_front back to producer
+ * \param [in] queue Consumer's queue
+ * \warning Only consumer thread can call this function
+*/
+void queue_pop(Queue *queue);
+
+
+/**
+ * \brief Destructs the queue
+ * \param [in] queue Queue to destruct
+ * \return Non zero value means error
+*/
+int queue_destructor(Queue *queue);
@@ -1,7 +1,6 @@
 /// Stack data type
 typedef struct {
-    const char *name = nullptr;
-    size_t hash = 0;
+    int id = -1;
     int index = 0;
 } stack_data_t;
 
@@ -14,7 +13,7 @@ typedef struct {
 } Stack;
 
 
-#define POISON_VALUE {nullptr, 0xC0FFEE, 0}
+#define POISON_VALUE {-1, 0xC0FFEE}
 #define MAX_CAPACITY_VALUE 100000
 
 
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "tree.hpp"
+#include "ident.hpp"
 
 
 #define MAX_FILE_PATH 512
@@ -16,11 +17,20 @@ do {                                                                         \
 } while(0)
 
 
-/**
- * \brief Free node and its children
- * \param [in] node Node pointer
-*/
-void free_node(Node *node);
+/// Amount of nodes in the first chunk of arena
+const size_t NODE_CHUNK_MIN = 1024;
+
+
+/// Max amount of nodes in one chunk of arena
+const size_t NODE_CHUNK_MAX = 1 << 16;
+
+
+/// Arena that nodes are allocated from if thread didn't set its own one
+NodeArena node_arena = {};
+
+
+/// Arena of the current thread
+thread_local NodeArena *thread_arena = &node_arena;
 
 
 /**
@@ -54,6 +64,38 @@ Node *full_search(Node *node, int value, Node *path[]);
 void write_record(FILE *file, Node *node);
 
 
+/// Open addressing table of nodes that are already placed in flat tree
+typedef struct {
+    const Node **keys = nullptr;        ///< Placed nodes, nullptr means empty cell
+    NodeIndex *indices = nullptr;       ///< Indices of placed nodes in flat tree
+    size_t size = 0;                    ///< Amount of placed nodes
+    size_t capacity = 0;                ///< Amount of cells, power of two
+} PlacedNodes;
+
+
+/**
+ * \brief Gives index of node in flat tree
+ * \param [in] placed Table of placed nodes
+ * \param [in] node   Node to find, it can be null
+ * \return Index of node or NO_NODE if node is not placed yet
+*/
+NodeIndex find_placed_node(const PlacedNodes *placed, const Node *node);
+
+
+/**
+ * \brief Adds node to table of placed nodes, table grows if it's half full
+ * \param [in] placed Table of placed nodes
+ * \param [in] node   Node that is placed
+ * \param [in] index  Index of node in flat tree
+ * \return Non zero value means error
+*/
+int add_placed_node(PlacedNodes *placed, const Node *node, NodeIndex index);
+
+
+/// Gives the first cell of node in table
+size_t get_placed_cell(const PlacedNodes *placed, const Node *node);
+
+
 
 
 int tree_constructor(Tree *tree, Node *root) {
@@ -69,7 +111,7 @@ int tree_constructor(Tree *tree, Node *root) {
 
 
 Node *create_node(int type, NodeValue value, Node *left, Node *right) {
-    Node *node = (Node *) calloc(1, sizeof(Node));
+    Node *node = arena_alloc_node(thread_arena);
 
     if (node) {
         node -> type = type;
@@ -86,7 +128,7 @@ int tree_destructor(Tree *tree) {
     ASSERT(tree, "Constructor can't work with null pointer to tree!", INVALID_ARG);
     ASSERT(tree -> root, "Tree has null root!", INVALID_ARG);
 
-    free_node(tree -> root);
+    free_node_arena(&node_arena);
 
     tree -> root = nullptr;
     tree -> size = 0;
@@ -95,31 +137,279 @@ int tree_destructor(Tree *tree) {
 }
 
 
-void free_node(Node *node) {
-    if (!node) return;
+Node *arena_alloc_node(NodeArena *arena) {
+    if (!arena) return nullptr;
 
-    if (node -> left) {
-        free_node(node -> left);
-        node -> left = nullptr;
+    if (arena -> used == arena -> chunk_size) {
+        if (arena -> chunk_count == arena -> chunk_capacity) {
+            int capacity = (arena -> chunk_capacity)? arena -> chunk_capacity * 2 : 16;
+
+            Node **chunks = (Node **) realloc(arena -> chunks, (size_t) capacity * sizeof(Node *));
+            if (!chunks) return nullptr;
+
+            arena -> chunks = chunks;
+            arena -> chunk_capacity = capacity;
+        }
+
+        // Every chunk is twice as big as the previous one, so small trees don't take much memory
+        size_t size = (arena -> chunk_size)? arena -> chunk_size * 2 : NODE_CHUNK_MIN;
+        if (size > NODE_CHUNK_MAX) size = NODE_CHUNK_MAX;
+
+        Node *chunk = (Node *) calloc(size, sizeof(Node));
+        if (!chunk) return nullptr;
+
+        arena -> chunks[arena -> chunk_count++] = chunk;
+        arena -> chunk_size = size;
+        arena -> used = 0;
     }
 
-    if (node -> right) {
-        free_node(node -> right);
-        node -> right = nullptr;
+    return arena -> chunks[arena -> chunk_count - 1] + arena -> used++;
+}
+
+
+NodeArena *set_node_arena(NodeArena *arena) {
+    NodeArena *previous = thread_arena;
+
+    thread_arena = (arena)? arena : &node_arena;
+
+    return previous;
+}
+
+
+NodeArena *get_node_arena() {
+    return &node_arena;
+}
+
+
+int merge_node_arena(NodeArena *to, NodeArena *from) {
+    ASSERT(to && from, "Can't merge null arenas!", INVALID_ARG);
+
+    if (!from -> chunk_count) return 0;
+
+    if (to -> chunk_count + from -> chunk_count > to -> chunk_capacity) {
+        int capacity = to -> chunk_count + from -> chunk_count;
+
+        Node **chunks = (Node **) realloc(to -> chunks, (size_t) capacity * sizeof(Node *));
+        ASSERT(chunks, "Failed to allocate chunks array!", ALLOC_FAIL);
+
+        to -> chunks = chunks;
+        to -> chunk_capacity = capacity;
     }
 
-    switch (node -> type) {
-        case TYPE_OP:       node -> value.op = 0; break;
-        case TYPE_NUM:      node -> value.dbl = 0.0; break;
-        case TYPE_VAR:      free(node -> value.var); break;
-        case TYPE_CALL:     free(node -> value.var); break;
-        case TYPE_DEF:      free(node -> value.var); break;
-        case TYPE_NVAR:     free(node -> value.var); break;
-        case TYPE_PAR:      free(node -> value.var); break;
-        default:            node -> value.dbl = 0.0;
+    if (to -> chunk_count) {
+        // Chunks are placed before the last one, so nodes are still taken from it
+        Node *last = to -> chunks[to -> chunk_count - 1];
+
+        for (int i = 0; i < from -> chunk_count; i++)
+            to -> chunks[to -> chunk_count - 1 + i] = from -> chunks[i];
+
+        to -> chunk_count += from -> chunk_count;
+        to -> chunks[to -> chunk_count - 1] = last;
+    }
+    else {
+        for (int i = 0; i < from -> chunk_count; i++)
+            to -> chunks[i] = from -> chunks[i];
+
+        to -> chunk_count = from -> chunk_count;
+        to -> used = from -> used;
+        to -> chunk_size = from -> chunk_size;
+    }
+
+    free(from -> chunks);
+
+    *from = {};
+
+    return 0;
+}
+
+
+void free_node_arena(NodeArena *arena) {
+    if (!arena) return;
+
+    for (int i = 0; i < arena -> chunk_count; i++)
+        free(arena -> chunks[i]);
+
+    free(arena -> chunks);
+
+    *arena = {};
+}
+
+
+int flat_tree_constructor(FlatTree *tree, NodeIndex capacity) {
+    ASSERT(tree, "Constructor can't work with null pointer to tree!", INVALID_ARG);
+
+    if (capacity < 1) capacity = 1;
+
+    tree -> types = (unsigned char *) calloc(capacity, sizeof(unsigned char));
+    tree -> values = (NodeValue *) calloc(capacity, sizeof(NodeValue));
+    tree -> lefts = (NodeIndex *) calloc(capacity, sizeof(NodeIndex));
+    tree -> rights = (NodeIndex *) calloc(capacity, sizeof(NodeIndex));
+
+    ASSERT(tree -> types && tree -> values && tree -> lefts && tree -> rights, "Failed to allocate flat tree!", ALLOC_FAIL);
+
+    tree -> capacity = capacity;
+
+    // Null node has zero index, so children that are not set point to it
+    tree -> size = 1;
+
+    return 0;
+}
+
+
+NodeIndex add_flat_node(FlatTree *tree, int type, NodeValue value) {
+    if (!tree || !tree -> capacity) return NO_NODE;
+
+    if (tree -> size == tree -> capacity) {
+        NodeIndex capacity = tree -> capacity * 2;
+
+        unsigned char *types = (unsigned char *) realloc(tree -> types, capacity * sizeof(unsigned char));
+        if (types) tree -> types = types;
+
+        NodeValue *values = (NodeValue *) realloc(tree -> values, capacity * sizeof(NodeValue));
+        if (values) tree -> values = values;
+
+        NodeIndex *lefts = (NodeIndex *) realloc(tree -> lefts, capacity * sizeof(NodeIndex));
+        if (lefts) tree -> lefts = lefts;
+
+        NodeIndex *rights = (NodeIndex *) realloc(tree -> rights, capacity * sizeof(NodeIndex));
+        if (rights) tree -> rights = rights;
+
+        if (!types || !values || !lefts || !rights) return NO_NODE;
+
+        tree -> capacity = capacity;
+    }
+
+    NodeIndex node = tree -> size++;
+
+    tree -> types[node] = (unsigned char) type;
+    tree -> values[node] = value;
+    tree -> lefts[node] = NO_NODE;
+    tree -> rights[node] = NO_NODE;
+
+    return node;
+}
+
+
+NodeIndex flatten_tree(const Node *root, FlatTree *tree) {
+    if (!root || !tree) return NO_NODE;
+
+    // Node waits on stack until its children are placed, stage is amount of children that are already pushed
+    typedef struct {
+        const Node *node;
+        int stage;
+    } PendingNode;
+
+    size_t capacity = 64, size = 0;
+    PendingNode *stack = (PendingNode *) calloc(capacity, sizeof(PendingNode));
+    if (!stack) return NO_NODE;
+
+    // Nodes that several parents share are placed once, so expression DAG stays DAG
+    PlacedNodes placed = {};
+
+    NodeIndex result = NO_NODE;
+
+    stack[size++] = {root, 0};
+
+    while (size) {
+        PendingNode *pending = stack + size - 1;
+
+        if (pending -> stage < 2) {
+            const Node *child = (pending -> stage++ == 0)? pending -> node -> left : pending -> node -> right;
+
+            if (!child || find_placed_node(&placed, child)) continue;
+
+            if (size == capacity) {
+                capacity *= 2;
+                stack = (PendingNode *) realloc(stack, capacity * sizeof(PendingNode));
+            }
+
+            stack[size++] = {child, 0};
+            continue;
+        }
+
+        const Node *node = stack[--size].node;
+
+        result = add_flat_node(tree, node -> type, node -> value);
+
+        if (!result || add_placed_node(&placed, node, result)) {
+            result = NO_NODE;
+            break;
+        }
+
+        tree -> lefts[result] = find_placed_node(&placed, node -> left);
+        tree -> rights[result] = find_placed_node(&placed, node -> right);
     }
 
-    free(node);
+    free(stack);
+    free(placed.keys);
+    free(placed.indices);
+
+    return result;
+}
+
+
+NodeIndex find_placed_node(const PlacedNodes *placed, const Node *node) {
+    if (!node || !placed -> size) return NO_NODE;
+
+    for (size_t cell = get_placed_cell(placed, node); placed -> keys[cell]; cell = (cell + 1) & (placed -> capacity - 1))
+        if (placed -> keys[cell] == node) return placed -> indices[cell];
+
+    return NO_NODE;
+}
+
+
+int add_placed_node(PlacedNodes *placed, const Node *node, NodeIndex index) {
+    if (2 * (placed -> size + 1) > placed -> capacity) {
+        PlacedNodes grown = {};
+
+        grown.capacity = (placed -> capacity)? placed -> capacity * 2 : 64;
+        grown.keys = (const Node **) calloc(grown.capacity, sizeof(const Node *));
+        grown.indices = (NodeIndex *) calloc(grown.capacity, sizeof(NodeIndex));
+
+        if (!grown.keys || !grown.indices) {
+            free(grown.keys);
+            free(grown.indices);
+            return ALLOC_FAIL;
+        }
+
+        for (size_t i = 0; i < placed -> capacity; i++)
+            if (placed -> keys[i]) add_placed_node(&grown, placed -> keys[i], placed -> indices[i]);
+
+        free(placed -> keys);
+        free(placed -> indices);
+
+        *placed = grown;
+    }
+
+    size_t cell = get_placed_cell(placed, node);
+
+    while (placed -> keys[cell]) cell = (cell + 1) & (placed -> capacity - 1);
+
+    placed -> keys[cell] = node;
+    placed -> indices[cell] = index;
+    placed -> size++;
+
+    return 0;
+}
+
+
+size_t get_placed_cell(const PlacedNodes *placed, const Node *node) {
+    // Nodes are aligned, so low bits of address are dropped before Fibonacci hashing
+    return (size_t) (((unsigned long long) (size_t) node >> 4) * 11400714819323198485ULL >> 20) & (placed -> capacity - 1);
+}
+
+
+int flat_tree_destructor(FlatTree *tree) {
+    ASSERT(tree, "Destructor can't work with null pointer to tree!", INVALID_ARG);
+
+    free(tree -> types);
+    free(tree -> values);
+    free(tree -> lefts);
+    free(tree -> rights);
+
+    *tree = {};
+
+    return 0;
 }
 
 
@@ -142,7 +432,7 @@ void print_node(Node *node, FILE *stream) {
     switch (node -> type) {
         case TYPE_OP:       fprintf(stream, "%s", op2str(node -> value.op)); break;
         case TYPE_NUM:      fprintf(stream, "%g", node -> value.dbl); break;
-        case TYPE_VAR:      fprintf(stream, "%s", node -> value.var); break;
+        case TYPE_VAR:      fprintf(stream, "%s", get_ident_name(node -> value.id)); break;
         case TYPE_IF:       fprintf(stream, "IF"); break;
         case TYPE_WHILE:    fprintf(stream, "WHILE"); break;
         case TYPE_CALL:     fprintf(stream, "CALL"); break;
@@ -212,14 +502,14 @@ void write_record(FILE *file, Node *node) {
     switch (node -> type) {
         case TYPE_OP:       fprintf(file, "OP | <value> %s", op2str(node -> value.op)); break;
         case TYPE_NUM:      fprintf(file, "NUM | <value> %g", node -> value.dbl); break;
-        case TYPE_VAR:      fprintf(file, "VAR | <value> %s", node -> value.var); break;
+        case TYPE_VAR:      fprintf(file, "VAR | <value> %s", get_ident_name(node -> value.id)); break;
         case TYPE_IF:       fprintf(file, "IF"); break;
         case TYPE_WHILE:    fprintf(file, "WHILE"); break;
-        case TYPE_CALL:     fprintf(file, "FUNC CALL | <value> %s", node -> value.var); break;
-        case TYPE_DEF:      fprintf(file, "FUNC DEF | <value> %s", node -> value.var); break;
-        case TYPE_NVAR:     fprintf(file, "NEW VAR | <value> %s", node -> value.var); break;
+        case TYPE_CALL:     fprintf(file, "FUNC CALL | <value> %s", get_ident_name(node -> value.id)); break;
+        case TYPE_DEF:      fprintf(file, "FUNC DEF | <value> %s", get_ident_name(node -> value.id)); break;
+        case TYPE_NVAR:     fprintf(file, "NEW VAR | <value> %s", get_ident_name(node -> value.id)); break;
         case TYPE_ARG:      fprintf(file, "ARG"); break;
-        case TYPE_PAR:      fprintf(file, "FUNC PAR | <value> %s", node -> value.var); break;
+        case TYPE_PAR:      fprintf(file, "FUNC PAR | <value> %s", get_ident_name(node -> value.id)); break;
         case TYPE_SEQ:      fprintf(file, "SEQ"); break;
         case TYPE_RET:      fprintf(file, "RETURN"); break;
         case TYPE_DEF_SEQ:  fprintf(file, "DEF SEQ"); break;
@@ -52,7 +52,7 @@ typedef enum {
 typedef union {
     int    op;
     double dbl;
-    char   *var;
+    int    id;
 } NodeValue; 
 
 
@@ -65,6 +65,16 @@ struct Node {
 };
 
 
+/// Bump allocator that gives nodes from big chunks and frees them all at once
+typedef struct {
+    Node **chunks = nullptr;            ///< Allocated chunks of nodes
+    int chunk_count = 0;                ///< Amount of chunks
+    int chunk_capacity = 0;             ///< Size of chunks array
+    size_t used = 0;                    ///< Amount of nodes taken from the last chunk
+    size_t chunk_size = 0;              ///< Amount of nodes in the last chunk
+} NodeArena;
+
+
 /// Tree class
 typedef struct {
     Node *root = nullptr;               ///< Tree root node
@@ -72,6 +82,25 @@ typedef struct {
 } Tree;
 
 
+/// Index of node in flat tree
+typedef unsigned int NodeIndex;
+
+
+/// Index of null node that every flat tree starts with, so zero index means no child
+const NodeIndex NO_NODE = 0;
+
+
+/// Tree that keeps every node field in its own array and links nodes by indices, children go before parents
+typedef struct {
+    unsigned char *types = nullptr;     ///< Node types from #NODE_TYPES
+    NodeValue *values = nullptr;        ///< Node values
+    NodeIndex *lefts = nullptr;         ///< Left child indices
+    NodeIndex *rights = nullptr;        ///< Right child indices
+    NodeIndex size = 0;                 ///< Amount of nodes including null one
+    NodeIndex capacity = 0;             ///< Size of arrays
+} FlatTree;
+
+
 /**
  * \brief Constructs tree
  * \param [out] tree Previously initialized tree structure
@@ -83,23 +112,101 @@ int tree_constructor(Tree *tree, Node *root = nullptr);
 
 
 /**
- * \brief Allocates new node
+ * \brief Allocates new node from node arena
  * \param [in] value New node's value
  * \param [in] left  New node's left child
  * \param [in] right New node's right child
  * \return Pointer to node or nullptr if allocates fail
+ * \note Node can't be freed by itself, it lives until tree_destructor call
 */
 Node *create_node(int type, NodeValue value, Node *left = nullptr, Node *right = nullptr);
 
 
+/**
+ * \brief Takes uninitialized node from arena
+ * \param [in] arena Arena to take node from
+ * \return Pointer to node or nullptr if allocates fail
+*/
+Node *arena_alloc_node(NodeArena *arena);
+
+
+/**
+ * \brief Sets arena that create_node takes nodes from in the current thread
+ * \param [in] arena Arena of thread or nullptr for the common one that tree_destructor frees
+ * \return Previous arena of thread
+*/
+NodeArena *set_node_arena(NodeArena *arena);
+
+
+/**
+ * \brief Moves all chunks of one arena to another
+ * \param [in] to   Arena to move chunks to
+ * \param [in] from Arena to move chunks from, it becomes empty
+ * \return Non zero value means error
+*/
+int merge_node_arena(NodeArena *to, NodeArena *from);
+
+
+/**
+ * \brief Gives common arena that threads use by default
+ * \return Arena that tree_destructor frees
+*/
+NodeArena *get_node_arena();
+
+
+/**
+ * \brief Frees all chunks of arena
+ * \param [in] arena Arena to free
+*/
+void free_node_arena(NodeArena *arena);
+
+
 /**
  * \brief Destructs tree
- * \param [in] tree All tree nodes will be free
+ * \param [in] tree Tree to destruct
  * \return Non zero value means error
+ * \note All nodes are freed at once with node arena, so nodes of other trees are freed too
 */
 int tree_destructor(Tree *tree);
 
 
+/**
+ * \brief Allocates flat tree arrays and adds null node to them
+ * \param [out] tree     Flat tree to construct
+ * \param [in]  capacity Amount of nodes to allocate arrays for, they grow if it's not enough
+ * \return Non zero value means error
+*/
+int flat_tree_constructor(FlatTree *tree, NodeIndex capacity = 1024);
+
+
+/**
+ * \brief Adds node without children to the end of flat tree
+ * \param [in] tree  Constructed flat tree
+ * \param [in] type  Node type
+ * \param [in] value Node value
+ * \return Index of node or NO_NODE if allocation fails
+*/
+NodeIndex add_flat_node(FlatTree *tree, int type, NodeValue value);
+
+
+/**
+ * \brief Copies pointer tree to flat tree placing nodes in postorder
+ * \param [in]  root Root of pointer tree
+ * \param [out] tree Constructed empty flat tree
+ * \return Index of root in flat tree, it is the last node, or NO_NODE if allocation fails
+ * \note Node that several parents share is placed once, so expression DAG from d operator doesn't grow
+*/
+NodeIndex flatten_tree(const Node *root, FlatTree *tree);
+
+
+/**
+ * \brief Frees flat tree arrays
+ * \param [in] tree Flat tree to destruct
+ * \return Non zero value means error
+*/
+int flat_tree_destructor(FlatTree *tree);
+
+
 /**
  * \brief Prints tree
  * \param [in]  node Tree to print
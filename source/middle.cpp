@@ -2,14 +2,21 @@
 #include <string.h>
 #include "libs/tree.hpp"
 #include "libs/parser.hpp"
+#include "libs/ident.hpp"
 #include "dif.hpp"
+#include "canon.hpp"
 #include "input-output.hpp"
 
 
+void enable_canonize(char *argv[], void *data);         ///< -c parser
+void enable_binary(char *argv[], void *data);           ///< -b parser
+
+
 
 
 int main(int argc, char *argv[]) {
     char *ast_path = nullptr, *opti_ast_path = nullptr;
+    int canonize_on = 0, binary_on = 0;
 
     Command command_list[] = {
         {
@@ -26,6 +33,20 @@ int main(int argc, char *argv[]) {
             &opti_ast_path,
             "<filepath> Sets path to save optimized AST (otherwise old one will be replaced)"
         },
+        {
+            "-c", "--canonize", 
+            0, 
+            &enable_canonize, 
+            &canonize_on,
+            "Rewrites arithmetic to sums of products with collected like terms"
+        },
+        {
+            "-b", "--binary", 
+            0, 
+            &enable_binary, 
+            &binary_on,
+            "Saves optimized AST in binary format that is read without parsing"
+        },
         {
             "-h", "--help", 
             0, 
@@ -43,9 +64,25 @@ int main(int argc, char *argv[]) {
 
     optimize(tree.root);
 
-    write_tree(&tree, (opti_ast_path)? opti_ast_path : ast_path);
+    if (canonize_on) canonize(tree.root);
+
+    write_tree(&tree, (opti_ast_path)? opti_ast_path : ast_path, binary_on);
+
+    tree_destructor(&tree);
+
+    free_ident_table();
 
     printf("Middlend!\n");
 
     return 0;
 }
+
+
+void enable_canonize(char *argv[], void *data) {
+    *((int *) data) = 1;
+}
+
+
+void enable_binary(char *argv[], void *data) {
+    *((int *) data) = 1;
+}
@@ -0,0 +1,365 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <zlib.h>
+#include "image_parser.hpp"
+#include "png_stream.hpp"
+
+
+/// Size of buffer for compressed data
+const unsigned int PNG_INPUT_SIZE = 1 << 16;
+
+
+/// Png color types that can be decoded row by row
+typedef enum {
+    PNG_GRAY        = 0,        ///< Grayscale indices
+    PNG_RGB         = 2,        ///< Three channels
+    PNG_PALETTE     = 3,        ///< Palette indices
+    PNG_RGBA        = 6,        ///< Four channels
+} PNG_COLOR_TYPES;
+
+
+/// Png row filter types
+typedef enum {
+    FILTER_NONE     = 0,        ///< Row is not filtered
+    FILTER_SUB      = 1,        ///< Difference with left pixel
+    FILTER_UP       = 2,        ///< Difference with upper pixel
+    FILTER_AVERAGE  = 3,        ///< Difference with average of left and upper pixels
+    FILTER_PAETH    = 4,        ///< Difference with Paeth predictor
+} PNG_FILTERS;
+
+
+/// Reads big endian 32-bit number
+unsigned int read_be32(const unsigned char *bytes);
+
+
+/**
+ * \brief Fills palette with grayscale colors for every index
+ * \param [in] png Opened stream of grayscale image
+*/
+void set_gray_palette(PngStream *png);
+
+
+/**
+ * \brief Reads PLTE or tRNS chunk to palette
+ * \param [in] png    Opened stream
+ * \param [in] type   Chunk type
+ * \param [in] length Chunk data length
+ * \return Non zero value means error
+*/
+int read_png_palette(PngStream *png, const unsigned char *type, unsigned int length);
+
+
+/**
+ * \brief Inflates and unfilters next row
+ * \param [in] png Opened stream
+ * \return Pointer to unfiltered row or nullptr in case of error
+*/
+const unsigned char *inflate_png_row(PngStream *png);
+
+
+/**
+ * \brief Fills zlib input with data of the next IDAT chunks
+ * \param [in] png Opened stream
+ * \return Non zero value means that there are no IDAT chunks left
+*/
+int fill_png_input(PngStream *png);
+
+
+/**
+ * \brief Unfilters row in place
+ * \param [in] png Opened stream with filtered row
+ * \return Non zero value means unknown filter type
+*/
+int unfilter_png_row(PngStream *png);
+
+
+
+
+unsigned int read_be32(const unsigned char *bytes) {
+    return (unsigned int) bytes[0] << 24 | (unsigned int) bytes[1] << 16 | (unsigned int) bytes[2] << 8 | (unsigned int) bytes[3];
+}
+
+
+int open_png_stream(PngStream *png, const char *filename) {
+    assert(png && "Can't open null stream!");
+    assert(filename && "Image path is null!");
+
+    const unsigned char SIGNATURE[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+
+    // Signature, IHDR chunk length and type, IHDR data and CRC
+    unsigned char header[8 + 8 + 13 + 4] = {};
+
+    png -> file = fopen(filename, "rb");
+    if (!png -> file) return 1;
+
+    if (fread(header, 1, sizeof(header), png -> file) != sizeof(header) ||
+        memcmp(header, SIGNATURE, sizeof(SIGNATURE)) || memcmp(header + 12, "IHDR", 4)) {
+        close_png_stream(png);
+        return 1;
+    }
+
+    const unsigned char *ihdr = header + 16;
+
+    int bit_depth = ihdr[8], color_type = ihdr[9], interlace = ihdr[12];
+
+    png -> color_type = color_type;
+    png -> indexed = (color_type == PNG_GRAY || color_type == PNG_PALETTE);
+
+    int depth_supported = (png -> indexed)? (bit_depth == 1 || bit_depth == 2 || bit_depth == 4 || bit_depth == 8) : (bit_depth == 8);
+
+    if (!depth_supported || interlace != 0 || (!png -> indexed && color_type != PNG_RGB && color_type != PNG_RGBA)) {
+        close_png_stream(png);
+        return 1;
+    }
+
+    png -> width = (int) read_be32(ihdr);
+    png -> height = (int) read_be32(ihdr + 4);
+    png -> comp = (color_type == PNG_RGBA)? 4 : (color_type == PNG_RGB)? 3 : 1;
+    png -> depth = bit_depth * png -> comp;
+    png -> rows_read = 0;
+    png -> chunk_left = 0;
+
+    if (color_type == PNG_GRAY) set_gray_palette(png);
+
+    size_t row_size = get_png_row_size(png) + 1;
+
+    png -> input = (unsigned char *) calloc(PNG_INPUT_SIZE, sizeof(unsigned char));
+    png -> row = (unsigned char *) calloc(row_size, sizeof(unsigned char));
+    png -> prev = (unsigned char *) calloc(row_size, sizeof(unsigned char));
+
+    png -> zlib = {};
+
+    // PLTE and tRNS chunks are read before the first IDAT chunk
+    if (inflateInit(&png -> zlib) != Z_OK || fill_png_input(png)) {
+        close_png_stream(png);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+size_t get_png_row_size(const PngStream *png) {
+    assert(png && "Can't get row size of null stream!");
+
+    return ((size_t) png -> width * (size_t) png -> depth + 7) / 8;
+}
+
+
+void set_gray_palette(PngStream *png) {
+    int max_index = (1 << png -> depth) - 1;
+
+    for (int i = 0; i <= max_index; i++) {
+        unsigned char gray = (unsigned char) (i * 255 / max_index);
+
+        png -> palette[i] = {gray, gray, gray, 255};
+    }
+}
+
+
+int read_png_palette(PngStream *png, const unsigned char *type, unsigned int length) {
+    unsigned char data[3 * 256] = {};
+
+    if (length > sizeof(data) || fread(data, 1, length, png -> file) != length) return 1;
+
+    if (png -> color_type == PNG_PALETTE && !memcmp(type, "PLTE", 4)) {
+        for (unsigned int i = 0; i < length / 3; i++)
+            png -> palette[i] = {data[3 * i], data[3 * i + 1], data[3 * i + 2], 255};
+    }
+
+    if (png -> color_type == PNG_PALETTE && !memcmp(type, "tRNS", 4)) {
+        for (unsigned int i = 0; i < length; i++)
+            png -> palette[i].a = data[i];
+    }
+
+    // Grayscale image has only one transparent gray level
+    if (png -> color_type == PNG_GRAY && !memcmp(type, "tRNS", 4) && length == 2) {
+        int gray = (data[0] << 8 | data[1]) & ((1 << png -> depth) - 1);
+
+        png -> palette[gray].a = 0;
+    }
+
+    fseek(png -> file, 4, SEEK_CUR);    // skip CRC
+
+    return 0;
+}
+
+
+int fill_png_input(PngStream *png) {
+    while (png -> chunk_left == 0) {
+        unsigned char chunk[8] = {};
+
+        if (fread(chunk, 1, sizeof(chunk), png -> file) != sizeof(chunk)) return 1;
+
+        unsigned int length = read_be32(chunk);
+
+        if (!memcmp(chunk + 4, "IEND", 4)) return 1;
+
+        if (!memcmp(chunk + 4, "IDAT", 4) && length > 0) {
+            png -> chunk_left = length;
+            break;
+        }
+
+        if (png -> indexed && (!memcmp(chunk + 4, "PLTE", 4) || !memcmp(chunk + 4, "tRNS", 4))) {
+            if (read_png_palette(png, chunk + 4, length)) return 1;
+            continue;
+        }
+
+        fseek(png -> file, (long) length + 4, SEEK_CUR);    // skip chunk data and CRC
+    }
+
+    unsigned int size = (png -> chunk_left < PNG_INPUT_SIZE)? png -> chunk_left : PNG_INPUT_SIZE;
+
+    if (fread(png -> input, 1, size, png -> file) != size) return 1;
+
+    png -> chunk_left -= size;
+
+    if (png -> chunk_left == 0) fseek(png -> file, 4, SEEK_CUR); // skip CRC
+
+    png -> zlib.next_in = png -> input;
+    png -> zlib.avail_in = size;
+
+    return 0;
+}
+
+
+int unfilter_png_row(PngStream *png) {
+    unsigned char *cur = png -> row + 1;
+    const unsigned char *up = png -> prev + 1;
+
+    // Filters work with bytes, so packed indices use previous byte
+    int bpp = (png -> depth + 7) / 8, size = (int) get_png_row_size(png);
+
+    switch (png -> row[0]) {
+        case FILTER_NONE: break;
+        case FILTER_SUB: {
+            for (int i = bpp; i < size; i++)
+                cur[i] = (unsigned char) (cur[i] + cur[i - bpp]);
+
+            break;
+        }
+        case FILTER_UP: {
+            for (int i = 0; i < size; i++)
+                cur[i] = (unsigned char) (cur[i] + up[i]);
+
+            break;
+        }
+        case FILTER_AVERAGE: {
+            for (int i = 0; i < size; i++) {
+                int left = (i >= bpp)? cur[i - bpp] : 0;
+                cur[i] = (unsigned char) (cur[i] + ((left + up[i]) >> 1));
+            }
+
+            break;
+        }
+        case FILTER_PAETH: {
+            for (int i = 0; i < size; i++) {
+                int a = (i >= bpp)? cur[i - bpp] : 0, b = up[i], c = (i >= bpp)? up[i - bpp] : 0;
+                int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+
+                int predictor = (pa <= pb && pa <= pc)? a : (pb <= pc)? b : c;
+
+                cur[i] = (unsigned char) (cur[i] + predictor);
+            }
+
+            break;
+        }
+        default: return 1;
+    }
+
+    return 0;
+}
+
+
+const unsigned char *inflate_png_row(PngStream *png) {
+    if (png -> rows_read >= png -> height) return nullptr;
+
+    png -> zlib.next_out = png -> row;
+    png -> zlib.avail_out = (unsigned int) get_png_row_size(png) + 1;
+
+    while (png -> zlib.avail_out) {
+        if (!png -> zlib.avail_in && fill_png_input(png)) return nullptr;
+
+        int result = inflate(&png -> zlib, Z_NO_FLUSH);
+
+        if (result == Z_STREAM_END) {
+            if (png -> zlib.avail_out) return nullptr;
+            break;
+        }
+
+        if (result != Z_OK && result != Z_BUF_ERROR) return nullptr;
+    }
+
+    if (unfilter_png_row(png)) return nullptr;
+
+    // Current row becomes previous one for the next row
+    unsigned char *prev = png -> prev;
+    png -> prev = png -> row;
+    png -> row = prev;
+
+    png -> rows_read++;
+
+    return png -> prev + 1;
+}
+
+
+int read_png_row(PngStream *png, unsigned char *rgba) {
+    assert(png && "Can't read from null stream!");
+    assert(rgba && "Can't write row to null array!");
+    assert(!png -> indexed && "Indexed rows are read by read_png_packed_row!");
+
+    const unsigned char *pixel = inflate_png_row(png);
+    if (!pixel) return 1;
+
+    if (png -> comp == 4) {
+        memcpy(rgba, pixel, (size_t) png -> width * 4);
+    }
+    else {
+        for (int x = 0; x < png -> width; x++, pixel += 3, rgba += 4) {
+            rgba[0] = pixel[0];
+            rgba[1] = pixel[1];
+            rgba[2] = pixel[2];
+            rgba[3] = 255;
+        }
+    }
+
+    return 0;
+}
+
+
+int read_png_packed_row(PngStream *png, unsigned char *row) {
+    assert(png && "Can't read from null stream!");
+    assert(row && "Can't write row to null array!");
+    assert(png -> indexed && "Only indexed rows can be read packed!");
+
+    const unsigned char *packed = inflate_png_row(png);
+    if (!packed) return 1;
+
+    memcpy(row, packed, get_png_row_size(png));
+
+    return 0;
+}
+
+
+void close_png_stream(PngStream *png) {
+    assert(png && "Can't close null stream!");
+
+    if (png -> input) inflateEnd(&png -> zlib);
+
+    free(png -> input);
+    png -> input = nullptr;
+
+    free(png -> row);
+    png -> row = nullptr;
+
+    free(png -> prev);
+    png -> prev = nullptr;
+
+    if (png -> file) fclose(png -> file);
+    png -> file = nullptr;
+
+    png -> width = -1;
+    png -> height = -1;
+}
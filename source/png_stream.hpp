@@ -0,0 +1,60 @@
+/// Contains state of png file that is decoded row by row
+typedef struct {
+    FILE *file = nullptr;               ///< Png file
+    z_stream zlib = {};                 ///< Inflate state for IDAT data
+    unsigned char *input = nullptr;     ///< Buffer for compressed data
+    unsigned char *row = nullptr;       ///< Current filtered row with filter type byte
+    unsigned char *prev = nullptr;      ///< Previous unfiltered row with filter type byte
+    unsigned int chunk_left = 0;        ///< Bytes left in the current IDAT chunk
+    int width = -1;                     ///< Image width in pixels
+    int height = -1;                    ///< Image height in pixels
+    int comp = 0;                       ///< Amount of channels in png row
+    int color_type = -1;                ///< Png color type from header
+    int depth = 8;                      ///< Bits per pixel of packed index rows
+    int indexed = 0;                    ///< Non zero value means that rows contain palette or grayscale indices
+    Pixel palette[256] = {};            ///< Color of every index of indexed image
+    int rows_read = 0;                  ///< Amount of rows already decoded
+} PngStream;
+
+
+/**
+ * \brief Opens png file and reads its header
+ * \param [out] png      Stream to open
+ * \param [in]  filename Path to file
+ * \return Non zero value means that file can't be decoded row by row
+ * \note Only not interlaced 8-bit RGB and RGBA, 1/2/4/8-bit palette and grayscale images are supported
+*/
+int open_png_stream(PngStream *png, const char *filename);
+
+
+/**
+ * \brief Calculates size of one unfiltered row
+ * \param [in] png Opened stream
+ * \return Row size in bytes
+*/
+size_t get_png_row_size(const PngStream *png);
+
+
+/**
+ * \brief Decodes next row of RGB or RGBA png
+ * \param [in]  png  Opened stream
+ * \param [out] rgba Array of width * 4 bytes for RGBA pixels
+ * \return Non zero value means error
+*/
+int read_png_row(PngStream *png, unsigned char *rgba);
+
+
+/**
+ * \brief Decodes next row of indexed png without expanding indices to colors
+ * \param [in]  png Opened stream
+ * \param [out] row Array of get_png_row_size(png) bytes for packed indices
+ * \return Non zero value means error
+*/
+int read_png_packed_row(PngStream *png, unsigned char *row);
+
+
+/**
+ * \brief Closes png file
+ * \param [in] png Stream to close
+*/
+void close_png_stream(PngStream *png);
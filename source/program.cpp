@@ -15,6 +15,7 @@
 #include "libs/tree.hpp"
 #include "libs/stack.hpp"
 #include "libs/text.hpp"
+#include "libs/ident.hpp"
 #include "program.hpp"
 
 
@@ -32,11 +33,37 @@ struct VarList {
 };
 
 
+/// Class of structurally equal subterms of expression
+typedef struct {
+    int type = 0;                       ///< Node type
+    unsigned long long value = 0;       ///< Bits of node value
+    int left = -1;                      ///< Class of left child or -1
+    int right = -1;                     ///< Class of right child or -1
+    int pure = 0;                       ///< Non zero value means that subterm has only arithmetic, comparisons, numbers and variables
+    int seen = 0;                       ///< Non zero value means that subterm is evaluated at least once
+    int slot = -1;                      ///< Index of temporary variable after local ones or -1 if subterm is not shared
+    int stored = 0;                     ///< Non zero value means that subterm value is already saved to temporary variable
+} TermClass;
+
+
+/// Subterms of the expression that is being printed, repeated ones are evaluated once
+typedef struct {
+    TermClass *classes = nullptr;       ///< Classes of subterms, array has half of table size
+    int size = 0;                       ///< Amount of classes
+    int *table = nullptr;               ///< Open addressing table of class indices, -1 means empty cell
+    int table_size = 0;                 ///< Amount of cells, power of two
+    int *node_classes = nullptr;        ///< Class of every program tree node or -1
+    NodeIndex root = NO_NODE;           ///< Root of the expression or NO_NODE if no expression is printed
+    int slot_offset = 0;                ///< Index of the first temporary variable
+    int slot_count = 0;                 ///< Amount of temporary variables
+} SharedTerms;
+
+
 #define ASSERT(condition, ...)          \
 do                                      \
 {                                       \
     if (!(condition)) {                 \
-        printf("[%-p] ", node);         \
+        printf("[%u] ", node);         \
         printf(__VA_ARGS__);            \
         exit(1);                        \
     }                                   \
@@ -69,6 +96,12 @@ do {                                                \
 /// Calls function for assembler source code output with only argument
 #define CALL_FUNC(func_name, node_arg) func_name(node_arg, file, var_list, shift + TAB_SIZE)
 
+/// Fields of program tree node by its index
+#define TYPE(node)  program_tree -> types[node]
+#define VALUE(node) program_tree -> values[node]
+#define LEFT(node)  program_tree -> lefts[node]
+#define RIGHT(node) program_tree -> rights[node]
+
 
 
 
@@ -78,58 +111,97 @@ int line = 1;
 /// List of the functions
 Stack func_list = {};
 
+/// Tree of the program that is being printed
+const FlatTree *program_tree = nullptr;
+
+/// Shared subterms of the current expression
+SharedTerms shared_terms = {};
+
 
 /// Reads definition sequence type node and prints result to file
-void read_def_sequence(const Node *node, FILE *file, VarList *var_list, int shift);
+void read_def_sequence(NodeIndex node, FILE *file, VarList *var_list, int shift);
 
 /// Reads sequence type node and prints result to file
-void read_sequence(const Node *node, FILE *file, VarList *var_list, int shift);
+void read_sequence(NodeIndex node, FILE *file, VarList *var_list, int shift);
 
 /// Add new variable to variable list of the current scope
-void add_variable(const Node *node, FILE *file, VarList *var_list, int shift);
+void add_variable(NodeIndex node, FILE *file, VarList *var_list, int shift);
 
 /// Add new function to function list of the current scope
-void add_function(const Node *node, FILE *file, VarList *var_list, int shift);
+void add_function(NodeIndex node, FILE *file, VarList *var_list, int shift);
 
 /// Prints expression to file
-void add_expression(const Node *node, FILE *file, VarList *var_list, int shift);
+void add_expression(NodeIndex node, FILE *file, VarList *var_list, int shift);
 
 /// Prints variable assign operation to file
-void add_assign(const Node *node, FILE *file, VarList *var_list, int shift);
+void add_assign(NodeIndex node, FILE *file, VarList *var_list, int shift);
 
 /// Prints if operator to file
-void add_if(const Node *node, FILE *file, VarList *var_list, int shift);
+void add_if(NodeIndex node, FILE *file, VarList *var_list, int shift);
 
 /// Prints while operator to file
-void add_while(const Node *node, FILE *file, VarList *var_list, int shift);
+void add_while(NodeIndex node, FILE *file, VarList *var_list, int shift);
 
 /// Prints function call to file
-void add_function_call(const Node *node, FILE *file, VarList *var_list, int shift);
+void add_function_call(NodeIndex node, FILE *file, VarList *var_list, int shift);
 
 /// Prints return statement to file
-void add_return(const Node *node, FILE *file, VarList *var_list, int shift);
+void add_return(NodeIndex node, FILE *file, VarList *var_list, int shift);
 
 /// Prints function parameters in reverse order
-void add_parameters(const Node *node, FILE *file, int shift, int index_offset);
+void add_parameters(NodeIndex node, FILE *file, int shift, int index_offset);
 
 
 /**
- * \brief Finds variable in list by its name hash
- * \param [in] hash Var name hash
+ * \brief Finds repeated subterms of expression and gives them temporary variables
+ * \param [in] root     Expression root
+ * \param [in] var_list List of variables
+ * \note Only expressions of arithmetic, comparisons, numbers and variables are checked,
+ * because calls and memory access can change values between evaluations
+*/
+void find_shared_terms(NodeIndex root, const VarList *var_list);
+
+/// Sets class of every expression node, returns class of node or -1 for null node
+int add_term_class(NodeIndex node);
+
+
+/// Gives table cell of class with the same key or empty cell for it
+int find_term_cell(const TermClass *key);
+
+
+/// Doubles size of class table
+void grow_term_table();
+
+
+/// Gives temporary variables to classes that are evaluated more than once
+void mark_shared_terms(NodeIndex node);
+
+
+/// Forgets classes of expression nodes
+void clear_shared_terms(NodeIndex node);
+
+
+/// Gives class of node if it is shared or nullptr
+TermClass *get_shared_term(NodeIndex node);
+
+
+/**
+ * \brief Finds variable in list by its identificator
+ * \param [in] id Var identificator
  * \param [in] var_list List of variables
  * \param [in] is_global Returns non zero value if variable was declarated global
  * \param [in] max_depth Max depth of recursive search in var list previous
  * \return Pointer to variable or null
 */
-Variable *find_variable(size_t hash, const VarList *var_list, int *is_global = nullptr, int max_depth = INT_MAX);
+Variable *find_variable(int id, const VarList *var_list, int *is_global = nullptr, int max_depth = INT_MAX);
 
 
 /**
- * \brief Finds function by its name hash
- * \param [in] hash Function name hash
+ * \brief Finds function by its identificator
+ * \param [in] id Function identificator
  * \return Pointer to function
 */
-Function *find_function(size_t hash);
+Function *find_function(int id);
 
 
 /**
@@ -149,9 +221,6 @@ void include_file(const char *filename, FILE *file, int shift);
 int count_variables(const VarList *varlist);
 
 
-/// Calculates hash sum of the string
-size_t string_hash(const char *str);
-
 /// Prints condition result to file
 void print_cond(const char *cond_op, FILE *file, int shift);
 
@@ -171,7 +240,7 @@ void free_varlist(VarList *varlist);
 
 
 
-int print_program(const Tree *tree, const char *filename) {
+int print_program(const FlatTree *tree, NodeIndex root, const char *filename) {
     if (!tree) return 1;
     if (!filename) return 2;
 
@@ -179,6 +248,11 @@ int print_program(const Tree *tree, const char *filename) {
 
     line = 1;
 
+    program_tree = tree;
+
+    shared_terms.node_classes = (int *) calloc(tree -> size, sizeof(int));
+    for (NodeIndex i = 0; i < tree -> size; i++) shared_terms.node_classes[i] = -1;
+
     int shift = -4;              // Это по факту костыль, чтоб макросы работали без исключений
 
     VarList global_list = init_varlist();
@@ -188,11 +262,11 @@ int print_program(const Tree *tree, const char *filename) {
     const char *MAIN_FUNC = "VAR_22B14C_01B8923B";
 
     Function lib[] = {
-        {"VAR_22B14C_00076DC0", string_hash("VAR_22B14C_00076DC0"), 0},
-        {"VAR_22B14C_01435CD4", string_hash("VAR_22B14C_01435CD4"), 1},
-        {"VAR_22B14C_0062909C", string_hash("VAR_22B14C_0062909C"), 1},
-        {"VAR_22B14C_0013A52700E2108E01151151", string_hash("VAR_22B14C_0013A52700E2108E01151151"), 3},
-        {"VAR_22B14C_0194AD2B", string_hash("VAR_22B14C_0194AD2B"), 0},
+        {intern_ident_name("VAR_22B14C_00076DC0"), 0},
+        {intern_ident_name("VAR_22B14C_01435CD4"), 1},
+        {intern_ident_name("VAR_22B14C_0062909C"), 1},
+        {intern_ident_name("VAR_22B14C_0013A52700E2108E01151151"), 3},
+        {intern_ident_name("VAR_22B14C_0194AD2B"), 0},
     };
 
     for (int i = 0; i < (int)(sizeof(lib) / sizeof(Function)); i++) stack_push(&func_list, lib[i]);
@@ -202,9 +276,9 @@ int print_program(const Tree *tree, const char *filename) {
 
     include_file("stdlib.asm", file, 0);
 
-    read_def_sequence(tree -> root, file, &global_list, shift + TAB_SIZE);
+    read_def_sequence(root, file, &global_list, shift + TAB_SIZE);
 
-    if (!find_function(string_hash(MAIN_FUNC))) {
+    if (!find_function(intern_ident_name(MAIN_FUNC))) {
         printf("Main function was not declarated in the current scope!");
         abort();
     }
@@ -222,6 +296,13 @@ int print_program(const Tree *tree, const char *filename) {
 
     fclose(file);
 
+    free(shared_terms.classes);
+    free(shared_terms.table);
+    free(shared_terms.node_classes);
+    shared_terms = {};
+
+    program_tree = nullptr;
+
     return 0;
 }
 
@@ -243,20 +324,20 @@ void include_file(const char *filename, FILE *file, int shift) {
 }
 
 
-void read_def_sequence(const Node *node, FILE *file, VarList *var_list, int shift) {
-    for (const Node *iter = node; iter; iter = iter -> right){
+void read_def_sequence(NodeIndex node, FILE *file, VarList *var_list, int shift) {
+    for (NodeIndex iter = node; iter; iter = RIGHT(iter)){
         ASSERT(iter, "Definition sequence is null!");
 
-        ASSERT(iter -> type == TYPE_DEF_SEQ, "Definition sequence expect type %i, but %i got!", TYPE_DEF_SEQ, iter -> type);
+        ASSERT(TYPE(iter) == TYPE_DEF_SEQ, "Definition sequence expect type %i, but %i got!", TYPE_DEF_SEQ, TYPE(iter));
 
-        ASSERT(iter -> left, "Definition sequence has no left child!");
+        ASSERT(LEFT(iter), "Definition sequence has no left child!");
 
-        PRINT("# Definition sequence node [%-p]", iter);
+        PRINT("# Definition sequence node [%u]", iter);
 
-        switch (iter -> left -> type) {
-            case TYPE_NVAR:     CALL_FUNC(add_variable, iter -> left);       break;
-            case TYPE_DEF:      CALL_FUNC(add_function, iter -> left);      break;
-            default: ASSERT(0, "Definition sequence left child has type %i!", iter -> left -> type);
+        switch (TYPE(LEFT(iter))) {
+            case TYPE_NVAR:     CALL_FUNC(add_variable, LEFT(iter));       break;
+            case TYPE_DEF:      CALL_FUNC(add_function, LEFT(iter));      break;
+            default: ASSERT(0, "Definition sequence left child has type %i!", TYPE(LEFT(iter)));
         }
 
         SKIP_LINE();
@@ -264,24 +345,24 @@ void read_def_sequence(const Node *node, FILE *file, VarList *var_list, int shif
 }
 
 
-void read_sequence(const Node *node, FILE *file, VarList *var_list, int shift) {
-    for (const Node *iter = node; iter; iter = iter -> right){
+void read_sequence(NodeIndex node, FILE *file, VarList *var_list, int shift) {
+    for (NodeIndex iter = node; iter; iter = RIGHT(iter)){
         ASSERT(iter, "Sequence is null!");
 
-        ASSERT(iter -> type == TYPE_SEQ, "Sequence expect type %i, but %i got!", TYPE_SEQ, iter -> type);
+        ASSERT(TYPE(iter) == TYPE_SEQ, "Sequence expect type %i, but %i got!", TYPE_SEQ, TYPE(iter));
 
-        ASSERT(iter -> left, "Sequence has no left child!");
+        ASSERT(LEFT(iter), "Sequence has no left child!");
 
-        PRINT("# Sequence node [%-p]", iter);
+        PRINT("# Sequence node [%u]", iter);
 
-        switch (iter -> left -> type) {
-            case TYPE_NVAR:     CALL_FUNC(add_variable, iter -> left);                               break;
-            case TYPE_OP:       CALL_FUNC(add_assign, iter -> left);                              break;
-            case TYPE_IF:       CALL_FUNC(add_if, iter -> left);                                  break;
-            case TYPE_WHILE:    CALL_FUNC(add_while, iter -> left);                               break;
-            case TYPE_RET:      CALL_FUNC(add_return, iter -> left);                              break;
-            case TYPE_CALL:     CALL_FUNC(add_function_call, iter -> left); PRINTL("POP RBX");    break;
-            default: ASSERT(0, "Sequence left child has type %i!", iter -> left -> type);
+        switch (TYPE(LEFT(iter))) {
+            case TYPE_NVAR:     CALL_FUNC(add_variable, LEFT(iter));                               break;
+            case TYPE_OP:       CALL_FUNC(add_assign, LEFT(iter));                              break;
+            case TYPE_IF:       CALL_FUNC(add_if, LEFT(iter));                                  break;
+            case TYPE_WHILE:    CALL_FUNC(add_while, LEFT(iter));                               break;
+            case TYPE_RET:      CALL_FUNC(add_return, LEFT(iter));                              break;
+            case TYPE_CALL:     CALL_FUNC(add_function_call, LEFT(iter)); PRINTL("POP RBX");    break;
+            default: ASSERT(0, "Sequence left child has type %i!", TYPE(LEFT(iter)));
         }
 
         SKIP_LINE();
@@ -289,79 +370,87 @@ void read_sequence(const Node *node, FILE *file, VarList *var_list, int shift) {
 }
 
 
-void add_variable(const Node *node, FILE *file, VarList *var_list, int shift) {
-    ASSERT(node -> type == TYPE_NVAR, "Node is not new variable type!");
-
-    size_t hash = string_hash(node -> value.var);
+void add_variable(NodeIndex node, FILE *file, VarList *var_list, int shift) {
+    ASSERT(TYPE(node) == TYPE_NVAR, "Node is not new variable type!");
 
     int is_global = 0;
-    ASSERT(!find_variable(hash, var_list, &is_global, 1), "Variable %s has already been declarated!", node -> value.var);
+    ASSERT(!find_variable(VALUE(node).id, var_list, &is_global, 1), "Variable %s has already been declarated!", get_ident_name(VALUE(node).id));
 
-    Variable new_var = {node -> value.var, hash, count_variables(var_list)};
+    Variable new_var = {VALUE(node).id, count_variables(var_list)};
 
     stack_push(&var_list -> list, new_var);
 
-    ASSERT(node -> right, "New variable has no expression to assign!");
-    CALL_FUNC(add_expression, node -> right);
+    ASSERT(RIGHT(node), "New variable has no expression to assign!");
+    CALL_FUNC(add_expression, RIGHT(node));
 
     PRINT("POP [%i%s]", new_var.index, (is_global)? "" : " + RDX");
-    PRINT("# Add variable %s!", new_var.name);
+    PRINT("# Add variable %s!", get_ident_name(new_var.id));
 }
 
 
-void add_parameters(const Node *node, FILE *file, int shift, int index_offset) {
+void add_parameters(NodeIndex node, FILE *file, int shift, int index_offset) {
     if (!node) return;
 
-    ASSERT(node -> type == TYPE_PAR, "Node is not parameter type!");
+    ASSERT(TYPE(node) == TYPE_PAR, "Node is not parameter type!");
 
-    if (node -> right) add_parameters(node -> right, file, shift, index_offset + 1);
+    if (RIGHT(node)) add_parameters(RIGHT(node), file, shift, index_offset + 1);
 
-    PRINT("# Function parameter %s", node -> value.var);
+    PRINT("# Function parameter %s", get_ident_name(VALUE(node).id));
     PRINTL("POP [%i + RDX]", index_offset);
     SKIP_LINE();
 }
 
 
-void add_function(const Node *node, FILE *file, VarList *var_list, int shift) {
-    ASSERT(node -> type == TYPE_DEF, "Node is not function define type!");
+void add_function(NodeIndex node, FILE *file, VarList *var_list, int shift) {
+    ASSERT(TYPE(node) == TYPE_DEF, "Node is not function define type!");
     
-    ASSERT(!find_function(string_hash(node -> value.var)), "Function %s has already been declarated!", node -> value.var);
+    ASSERT(!find_function(VALUE(node).id), "Function %s has already been declarated!", get_ident_name(VALUE(node).id));
 
-    Function new_func = {node -> value.var, string_hash(node -> value.var), 0};
+    Function new_func = {VALUE(node).id, 0};
 
-    PRINT("# Function declaration [%-p]", node);
+    PRINT("# Function declaration [%u]", node);
     SKIP_LINE();
 
     VarList new_varlist = init_varlist(var_list);
 
-    PRINTL("FUNC_%s:", node -> value.var);
+    PRINTL("FUNC_%s:", get_ident_name(VALUE(node).id));
     SKIP_LINE();
 
-    for (const Node *par = node -> left; par; par = par -> right, new_func.index++) 
-        stack_push(&new_varlist.list, {par -> value.var, string_hash(par -> value.var), new_func.index});
+    for (NodeIndex par = LEFT(node); par; par = RIGHT(par), new_func.index++) 
+        stack_push(&new_varlist.list, {VALUE(par).id, new_func.index});
 
-    add_parameters(node -> left, file, shift + TAB_SIZE, 0);
+    add_parameters(LEFT(node), file, shift + TAB_SIZE, 0);
 
     stack_push(&func_list, new_func);
 
-    ASSERT(node -> right, "Function has no sequence!");
-    read_sequence(node -> right, file, &new_varlist, shift + TAB_SIZE);
+    ASSERT(RIGHT(node), "Function has no sequence!");
+    read_sequence(RIGHT(node), file, &new_varlist, shift + TAB_SIZE);
 
     free_varlist(&new_varlist);
 }
 
 
-void add_expression(const Node *node, FILE *file, VarList *var_list, int shift) {
-    switch(node -> type) {
+void add_expression(NodeIndex node, FILE *file, VarList *var_list, int shift) {
+    int is_root = (shared_terms.root == NO_NODE);
+
+    if (is_root) find_shared_terms(node, var_list);
+
+    TermClass *term = get_shared_term(node);
+
+    if (term && term -> stored) {
+        PRINT("# Shared expression node [%u]", node);
+        PRINT("PUSH [%i + RDX]", shared_terms.slot_offset + term -> slot);
+    }
+    else switch(TYPE(node)) {
         case TYPE_NUM: {
-            PRINT("PUSH %.3f", node -> value.dbl);
+            PRINT("PUSH %.3f", VALUE(node).dbl);
             break;
         }
         case TYPE_VAR: {
             int is_global = 0;
-            Variable *var = find_variable(string_hash(node -> value.var), var_list, &is_global);
+            Variable *var = find_variable(VALUE(node).id, var_list, &is_global);
 
-            ASSERT(var, "Variable %s is not declarated in the current scope!", node -> value.var);
+            ASSERT(var, "Variable %s is not declarated in the current scope!", get_ident_name(VALUE(node).id));
 
             PRINT("PUSH [%i%s]", var -> index, (is_global)? "" : " + RDX");
             break;
@@ -374,14 +463,14 @@ void add_expression(const Node *node, FILE *file, VarList *var_list, int shift)
             break;
         }
         case TYPE_OP: {
-            PRINT("# Expression node [%-p]", node);
+            PRINT("# Expression node [%u]", node);
 
-            if (node -> left)   CALL_FUNC(add_expression, node -> left);
-            if (node -> right)  CALL_FUNC(add_expression, node -> right);
+            if (LEFT(node))   CALL_FUNC(add_expression, LEFT(node));
+            if (RIGHT(node))  CALL_FUNC(add_expression, RIGHT(node));
 
             shift += 4;
 
-            switch (node -> value.op) {
+            switch (VALUE(node).op) {
                 case OP_ADD: PRINT("ADD"); break;
                 case OP_SUB: PRINT("SUB"); break;
                 case OP_MUL: PRINT("MUL"); break;
@@ -395,9 +484,9 @@ void add_expression(const Node *node, FILE *file, VarList *var_list, int shift)
                 case OP_LEQ:    print_cond("JBE", file, shift); break;
 
                 case OP_REF: {
-                    ASSERT(node -> right, "No expression after referencing operation!");
+                    ASSERT(RIGHT(node), "No expression after referencing operation!");
 
-                    add_expression(node -> right, file, var_list, shift + TAB_SIZE);
+                    add_expression(RIGHT(node), file, var_list, shift + TAB_SIZE);
 
                     PRINT("POP RAX");
                     PRINT("PUSH [RAX]");
@@ -406,51 +495,196 @@ void add_expression(const Node *node, FILE *file, VarList *var_list, int shift)
                 }
 
                 case OP_LOC: {
-                    ASSERT(node -> right, "No identificator after locate operation!");
-                    ASSERT(node -> right -> type == TYPE_VAR, "No identificator after locate operation!");
+                    ASSERT(RIGHT(node), "No identificator after locate operation!");
+                    ASSERT(TYPE(RIGHT(node)) == TYPE_VAR, "No identificator after locate operation!");
 
                     int is_global = 0;
-                    Variable *var = find_variable(string_hash(node -> right -> value.var), var_list, &is_global);
+                    Variable *var = find_variable(VALUE(RIGHT(node)).id, var_list, &is_global);
 
-                    ASSERT(var, "Variable %s is not declarated in the current scope!", node -> value.var);
+                    ASSERT(var, "Variable %s is not declarated in the current scope!", get_ident_name(VALUE(RIGHT(node)).id));
 
                     PRINT("PUSH %i%s", var -> index, (is_global)? "" : " + RDX");
 
                     break;
                 }
 
-                default: ASSERT(0, "Unexpected operator %i in expression!", node -> value.op);
+                default: ASSERT(0, "Unexpected operator %i in expression!", VALUE(node).op);
             }
 
             break;
         }
-        default: ASSERT(0, "Node has type %i and it's not expression type!", node -> type);
+        default: ASSERT(0, "Node has type %i and it's not expression type!", TYPE(node));
+    }
+
+    if (term && !term -> stored) {
+        // Value is saved to temporary variable and pushed back for parent expression
+        PRINT("POP [%i + RDX]", shared_terms.slot_offset + term -> slot);
+        PRINT("PUSH [%i + RDX]", shared_terms.slot_offset + term -> slot);
+
+        term -> stored = 1;
+    }
+
+    if (is_root) {
+        clear_shared_terms(node);
+
+        // Classes are removed in reverse order, so probe sequences of the rest stay unbroken
+        for (int i = shared_terms.size - 1; i >= 0; i--)
+            shared_terms.table[find_term_cell(shared_terms.classes + i)] = -1;
+
+        shared_terms.root = NO_NODE;
+        shared_terms.size = 0;
+        shared_terms.slot_count = 0;
+    }
+}
+
+
+void find_shared_terms(NodeIndex root, const VarList *var_list) {
+    shared_terms.root = root;
+
+    int root_class = add_term_class(root);
+
+    // Global variables have no frame for temporary ones, calls and memory access can't be evaluated once
+    if (!var_list -> prev || !shared_terms.classes[root_class].pure) return;
+
+    mark_shared_terms(root);
+
+    shared_terms.slot_offset = count_variables(var_list);
+}
+
+
+int add_term_class(NodeIndex node) {
+    if (!node) return -1;
+
+    // Node that several parents share already has its class
+    if (shared_terms.node_classes[node] != -1) return shared_terms.node_classes[node];
+
+    TermClass key = {};
+
+    key.type = TYPE(node);
+    key.value = (unsigned int) VALUE(node).id;
+    key.left = add_term_class(LEFT(node));
+    key.right = add_term_class(RIGHT(node));
+
+    // Numbers are equal only if all their bits are
+    if (key.type == TYPE_NUM) memcpy(&key.value, &VALUE(node).dbl, sizeof(key.value));
+
+    // Expression that has calls or memory access can't be evaluated once
+    switch (key.type) {
+        case TYPE_NUM: case TYPE_VAR: key.pure = 1; break;
+        case TYPE_OP: {
+            switch (VALUE(node).op) {
+                case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV:
+                case OP_EQ:  case OP_NEQ: case OP_GRE: case OP_LES: case OP_GEQ: case OP_LEQ:
+                    key.pure = (key.left == -1 || shared_terms.classes[key.left].pure) &&
+                               (key.right == -1 || shared_terms.classes[key.right].pure);
+                    break;
+                default: break;
+            }
+            break;
+        }
+        default: break;
+    }
+
+    if (2 * (shared_terms.size + 1) > shared_terms.table_size) grow_term_table();
+
+    int cell = find_term_cell(&key);
+
+    if (shared_terms.table[cell] == -1) {
+        shared_terms.table[cell] = shared_terms.size;
+        shared_terms.classes[shared_terms.size++] = key;
+    }
+
+    return shared_terms.node_classes[node] = shared_terms.table[cell];
+}
+
+
+int find_term_cell(const TermClass *key) {
+    unsigned long long fields[] = {key -> value, (unsigned) key -> type, (unsigned) key -> left, (unsigned) key -> right};
+
+    int cell = (int) (gnu_hash(fields, sizeof(fields)) & (size_t) (shared_terms.table_size - 1));
+
+    for (; shared_terms.table[cell] != -1; cell = (cell + 1) & (shared_terms.table_size - 1)) {
+        const TermClass *iter = shared_terms.classes + shared_terms.table[cell];
+
+        if (iter -> type == key -> type && iter -> value == key -> value && iter -> left == key -> left && iter -> right == key -> right)
+            break;
+    }
+
+    return cell;
+}
+
+
+void grow_term_table() {
+    shared_terms.table_size = (shared_terms.table_size)? 2 * shared_terms.table_size : 64;
+
+    shared_terms.table = (int *) realloc(shared_terms.table, (size_t) shared_terms.table_size * sizeof(int));
+    shared_terms.classes = (TermClass *) realloc(shared_terms.classes, (size_t) shared_terms.table_size / 2 * sizeof(TermClass));
+
+    for (int i = 0; i < shared_terms.table_size; i++) shared_terms.table[i] = -1;
+
+    for (int i = 0; i < shared_terms.size; i++) shared_terms.table[find_term_cell(shared_terms.classes + i)] = i;
+}
+
+
+void mark_shared_terms(NodeIndex node) {
+    // Only operations are worth saving, numbers and variables are pushed by one instruction
+    if (!node || TYPE(node) != TYPE_OP) return;
+
+    TermClass *term = shared_terms.classes + shared_terms.node_classes[node];
+
+    if (term -> seen) {
+        if (term -> slot == -1) term -> slot = shared_terms.slot_count++;
+        return;
     }
+
+    term -> seen = 1;
+
+    mark_shared_terms(LEFT(node));
+    mark_shared_terms(RIGHT(node));
 }
 
 
-void add_assign(const Node *node, FILE *file, VarList *var_list, int shift) {
-    PRINT("# Assign node [%-p]", node);
+void clear_shared_terms(NodeIndex node) {
+    if (!node || shared_terms.node_classes[node] == -1) return;
 
-    ASSERT(node -> type == TYPE_OP && node -> value.op == OP_ASS, "Assign expect op %i, but %i got!", OP_ASS, node -> value.op);
+    shared_terms.node_classes[node] = -1;
 
-    ASSERT(node -> right, "No expression to assign!");
-    CALL_FUNC(add_expression, node -> right);
+    clear_shared_terms(LEFT(node));
+    clear_shared_terms(RIGHT(node));
+}
 
-    ASSERT(node -> left, "No variable to assign!");
+
+TermClass *get_shared_term(NodeIndex node) {
+    if (shared_terms.node_classes[node] == -1) return nullptr;
+
+    TermClass *term = shared_terms.classes + shared_terms.node_classes[node];
+
+    return (term -> slot == -1)? nullptr : term;
+}
+
+
+void add_assign(NodeIndex node, FILE *file, VarList *var_list, int shift) {
+    PRINT("# Assign node [%u]", node);
+
+    ASSERT(TYPE(node) == TYPE_OP && VALUE(node).op == OP_ASS, "Assign expect op %i, but %i got!", OP_ASS, VALUE(node).op);
+
+    ASSERT(RIGHT(node), "No expression to assign!");
+    CALL_FUNC(add_expression, RIGHT(node));
+
+    ASSERT(LEFT(node), "No variable to assign!");
     
-    if (node -> left -> type == TYPE_VAR) {
+    if (TYPE(LEFT(node)) == TYPE_VAR) {
         int is_global = 0;
-        Variable *var = find_variable(string_hash(node -> left -> value.var), var_list, &is_global);
+        Variable *var = find_variable(VALUE(LEFT(node)).id, var_list, &is_global);
 
-        ASSERT(var, "Variable %s is not declarated in the current scope!", node -> left -> value.var);
+        ASSERT(var, "Variable %s is not declarated in the current scope!", get_ident_name(VALUE(LEFT(node)).id));
 
         PRINTL("POP [%i%s]", var -> index, (is_global)? "" : " + RDX");
     }
-    else if (node -> left -> type == TYPE_OP && node -> left -> value.op == OP_REF) {
-        ASSERT(node -> left -> right, "No expression after referencing operation!");
+    else if (TYPE(LEFT(node)) == TYPE_OP && VALUE(LEFT(node)).op == OP_REF) {
+        ASSERT(RIGHT(LEFT(node)), "No expression after referencing operation!");
 
-        add_expression(node -> left -> right, file, var_list, shift + TAB_SIZE);
+        add_expression(RIGHT(LEFT(node)), file, var_list, shift + TAB_SIZE);
 
         PRINTL("POP RAX");
         PRINTL("POP [RAX]");
@@ -461,13 +695,13 @@ void add_assign(const Node *node, FILE *file, VarList *var_list, int shift) {
 }
 
 
-void add_if(const Node *node, FILE *file, VarList *var_list, int shift) {
-    ASSERT(node -> type == TYPE_IF, "If expect type %i, but %i got!", TYPE_IF, node -> type);
+void add_if(NodeIndex node, FILE *file, VarList *var_list, int shift) {
+    ASSERT(TYPE(node) == TYPE_IF, "If expect type %i, but %i got!", TYPE_IF, TYPE(node));
 
-    PRINT("# If node [%-p]", node);
+    PRINT("# If node [%u]", node);
 
-    ASSERT(node -> left, "If has no condition!");
-    CALL_FUNC(add_expression, node -> left);
+    ASSERT(LEFT(node), "If has no condition!");
+    CALL_FUNC(add_expression, LEFT(node));
 
     PRINTL("PUSH 0");
     int cur_line = line;
@@ -475,18 +709,18 @@ void add_if(const Node *node, FILE *file, VarList *var_list, int shift) {
 
     SKIP_LINE();
 
-    ASSERT(node -> right -> left, "If has no sequence after it!");
+    ASSERT(LEFT(RIGHT(node)), "If has no sequence after it!");
 
     VarList new_varlist = init_varlist(var_list);
-    read_sequence(node -> right -> left, file, &new_varlist, shift + TAB_SIZE);
+    read_sequence(LEFT(RIGHT(node)), file, &new_varlist, shift + TAB_SIZE);
     free_varlist(&new_varlist);
 
     PRINTL("JMP IF_%i_END", cur_line);
     PRINTL("IF_%i_FALSE:", cur_line);
 
-    if (node -> right -> right) {
+    if (RIGHT(RIGHT(node))) {
         new_varlist = init_varlist(var_list);
-        read_sequence(node -> right -> right, file, &new_varlist, shift + TAB_SIZE);
+        read_sequence(RIGHT(RIGHT(node)), file, &new_varlist, shift + TAB_SIZE);
         free_varlist(&new_varlist);
     }
 
@@ -494,27 +728,27 @@ void add_if(const Node *node, FILE *file, VarList *var_list, int shift) {
 }
 
 
-void add_while(const Node *node, FILE *file, VarList *var_list, int shift) {
-    ASSERT(node -> type == TYPE_WHILE, "While expect type %i, but %i got!", TYPE_WHILE, node -> type);
+void add_while(NodeIndex node, FILE *file, VarList *var_list, int shift) {
+    ASSERT(TYPE(node) == TYPE_WHILE, "While expect type %i, but %i got!", TYPE_WHILE, TYPE(node));
 
-    PRINT("# While node [%-p]", node);
+    PRINT("# While node [%u]", node);
 
     int cur_line = line;
 
     PRINTL("CYCLE_%i_ITER:", cur_line);
 
-    ASSERT(node -> left, "While has no condition!");
-    CALL_FUNC(add_expression, node -> left);
+    ASSERT(LEFT(node), "While has no condition!");
+    CALL_FUNC(add_expression, LEFT(node));
 
     PRINTL("PUSH 0");
     PRINTL("JE CYCLE_%i_FALSE", cur_line);
 
     SKIP_LINE();
 
-    ASSERT(node -> right, "While has no sequence after it!");
+    ASSERT(RIGHT(node), "While has no sequence after it!");
 
     VarList new_varlist = init_varlist(var_list);
-    read_sequence(node -> right, file, &new_varlist, shift + TAB_SIZE);
+    read_sequence(RIGHT(node), file, &new_varlist, shift + TAB_SIZE);
     free_varlist(&new_varlist);
 
     PRINTL("JMP CYCLE_%i_ITER", cur_line);
@@ -523,30 +757,30 @@ void add_while(const Node *node, FILE *file, VarList *var_list, int shift) {
 }
 
 
-void add_function_call(const Node *node, FILE *file, VarList *var_list, int shift) {
-    ASSERT(node -> type == TYPE_CALL, "Function call expect type %i, but %i got!", TYPE_CALL, node -> type);
+void add_function_call(NodeIndex node, FILE *file, VarList *var_list, int shift) {
+    ASSERT(TYPE(node) == TYPE_CALL, "Function call expect type %i, but %i got!", TYPE_CALL, TYPE(node));
 
-    PRINT("# Call function node [%-p]", node);
+    PRINT("# Call function node [%u]", node);
 
-    Function *func = find_function(string_hash(node -> value.var));
+    Function *func = find_function(VALUE(node).id);
 
-    ASSERT(func, "Function %s was not declarated in the current scope!", node -> value.var);
+    ASSERT(func, "Function %s was not declarated in the current scope!", get_ident_name(VALUE(node).id));
 
     shift += 4;
 
     int arg_count = 0;
 
-    for (const Node *arg = node -> left; arg; arg = arg -> right, arg_count++) {
-        ASSERT(arg -> type == TYPE_ARG, "Node is not argument type!");
+    for (NodeIndex arg = LEFT(node); arg; arg = RIGHT(arg), arg_count++) {
+        ASSERT(TYPE(arg) == TYPE_ARG, "Node is not argument type!");
 
-        PRINT("# Argument node [%-p]", node);
+        PRINT("# Argument node [%u]", node);
 
-        CALL_FUNC(add_expression, arg -> left);
+        CALL_FUNC(add_expression, LEFT(arg));
 
         SKIP_LINE();
     }
 
-    ASSERT(arg_count == func -> index, "Function %s expects %i arguments, but got %i!", func -> name, func -> index, arg_count);
+    ASSERT(arg_count == func -> index, "Function %s expects %i arguments, but got %i!", get_ident_name(func -> id), func -> index, arg_count);
 
     PRINT("PUSH RDX");
     PRINT("PUSH %i", count_variables(var_list)); 
@@ -554,7 +788,7 @@ void add_function_call(const Node *node, FILE *file, VarList *var_list, int shif
     PRINT("POP RDX");
     SKIP_LINE();
 
-    PRINT("CALL FUNC_%s", node -> value.var);
+    PRINT("CALL FUNC_%s", get_ident_name(VALUE(node).id));
 
     SKIP_LINE();
     PRINT("PUSH RDX");
@@ -565,22 +799,22 @@ void add_function_call(const Node *node, FILE *file, VarList *var_list, int shif
 }
 
 
-void add_return(const Node *node, FILE *file, VarList *var_list, int shift) {
-    ASSERT(node -> type == TYPE_RET, "Return expect type %i, but %i got!", TYPE_RET, node -> type);
+void add_return(NodeIndex node, FILE *file, VarList *var_list, int shift) {
+    ASSERT(TYPE(node) == TYPE_RET, "Return expect type %i, but %i got!", TYPE_RET, TYPE(node));
 
-    PRINT("# Return node [%-p]", node);
+    PRINT("# Return node [%u]", node);
 
-    ASSERT(node -> left, "Return has no expression!");
-    CALL_FUNC(add_expression, node -> left);
+    ASSERT(LEFT(node), "Return has no expression!");
+    CALL_FUNC(add_expression, LEFT(node));
 
     PRINTL("RET");
 }
 
 
-Variable *find_variable(size_t hash, const VarList *var_list, int *is_global, int max_depth) {
+Variable *find_variable(int id, const VarList *var_list, int *is_global, int max_depth) {
     for(int d = 1; d <= max_depth && var_list; d++, var_list = var_list -> prev)
         for(int i = 0; i < var_list -> list.size; i++)
-            if ((var_list -> list.data)[i].hash == hash) {
+            if ((var_list -> list.data)[i].id == id) {
                 if (is_global) *is_global = (var_list -> prev == nullptr);
 
                 return var_list -> list.data + i;
@@ -590,19 +824,14 @@ Variable *find_variable(size_t hash, const VarList *var_list, int *is_global, in
 }
 
 
-Function *find_function(size_t hash) {
+Function *find_function(int id) {
     for (int i = 0; i < func_list.size; i++)
-        if (func_list.data[i].hash == hash) return func_list.data + i;
+        if (func_list.data[i].id == id) return func_list.data + i;
     
     return nullptr;
 }
 
 
-size_t string_hash(const char *str) {
-    return gnu_hash(str, strlen(str) * sizeof(char));
-}
-
-
 size_t gnu_hash(const void *ptr, size_t size) {
     if (!ptr || !size) return 0;
     
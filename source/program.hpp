@@ -1,9 +1,10 @@
 /**
  * \brief Prints program to assembler file
- * \param [in]  tree     Program tree to print
+ * \param [in]  tree     Program flat tree to print
+ * \param [in]  root     Index of program root node
  * \param [out] filename Output file
 */
-int print_program(const Tree *tree, const char *filename);
+int print_program(const FlatTree *tree, NodeIndex root, const char *filename);
 
 
 /**
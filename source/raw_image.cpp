@@ -0,0 +1,420 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <ctype.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+    #include <io.h>
+#else
+    #include <unistd.h>
+    #include <sys/mman.h>
+#endif
+
+#include "raw_image.hpp"
+
+
+/// Size of QOI header in bytes
+const size_t QOI_HEADER_SIZE = 14;
+
+
+/// Size of QOI end marker in bytes
+const size_t QOI_PADDING_SIZE = 8;
+
+
+/// QOI chunk tags
+typedef enum {
+    QOI_OP_INDEX    = 0x00,         ///< Pixel from index array
+    QOI_OP_DIFF     = 0x40,         ///< Small difference with previous pixel
+    QOI_OP_LUMA     = 0x80,         ///< Difference with previous pixel based on green channel
+    QOI_OP_RUN      = 0xC0,         ///< Previous pixel is repeated
+    QOI_OP_RGB      = 0xFE,         ///< New RGB values
+    QOI_OP_RGBA     = 0xFF,         ///< New RGBA values
+} QOI_OPS;
+
+
+/// Mask for 2-bit QOI chunk tags
+const unsigned char QOI_MASK = 0xC0;
+
+
+/**
+ * \brief Maps whole file to memory for reading
+ * \param [out] image    Image to write file content and size to
+ * \param [in]  filename Path to file
+ * \return Non zero value means error
+*/
+int map_image_file(RawImage *image, const char *filename);
+
+
+/**
+ * \brief Reads next word of PPM or PAM header skipping whitespaces and comments
+ * \param [in]     image     Image with mapped file
+ * \param [in,out] pos       Position in file
+ * \param [out]    word      Buffer for word
+ * \param [in]     word_size Buffer size
+ * \return Non zero value means that header ended unexpectedly or word is too long
+*/
+int read_header_word(const RawImage *image, size_t *pos, char *word, size_t word_size);
+
+
+/**
+ * \brief Reads positive number of PPM or PAM header
+ * \param [in]     image  Image with mapped file
+ * \param [in,out] pos    Position in file
+ * \param [out]    number Read number
+ * \return Non zero value means that there is no number
+*/
+int read_header_number(const RawImage *image, size_t *pos, int *number);
+
+
+/**
+ * \brief Checks that pixels after header fit in file and sets pointer to them
+ * \param [in,out] image Image with mapped file and known size
+ * \param [in]     pos   Position of the first pixel
+ * \return Non zero value means that file is too small
+*/
+int set_file_pixels(RawImage *image, size_t pos);
+
+
+/**
+ * \brief Parses binary PPM (P6) header
+ * \param [in,out] image Image with mapped file
+ * \return Non zero value means that file is not 8-bit binary PPM
+*/
+int parse_ppm(RawImage *image);
+
+
+/**
+ * \brief Parses PAM (P7) header
+ * \param [in,out] image Image with mapped file
+ * \return Non zero value means that file is not 8-bit RGB or RGB_ALPHA PAM
+*/
+int parse_pam(RawImage *image);
+
+
+/**
+ * \brief Parses QOI header
+ * \param [in,out] image Image with mapped file
+ * \return Non zero value means that file is not QOI
+*/
+int parse_qoi(RawImage *image);
+
+
+/**
+ * \brief Decodes next QOI pixels to RGBA
+ * \param [in,out] image Image with parsed header
+ * \param [out]    out   Array for pixels
+ * \param [in]     count Amount of pixels
+*/
+void decode_qoi_pixels(RawImage *image, unsigned char *out, size_t count);
+
+
+
+
+int map_image_file(RawImage *image, const char *filename) {
+    int file = open(filename, O_RDONLY);
+    if (file == -1) return 1;
+
+    struct stat file_stat = {};
+
+    if (fstat(file, &file_stat) || file_stat.st_size <= 0) {
+        close(file);
+        return 1;
+    }
+
+    image -> file_size = (size_t) file_stat.st_size;
+
+    #if defined(_WIN32) || defined(_WIN64)
+        image -> file = (unsigned char *) calloc(image -> file_size, sizeof(unsigned char));
+
+        if (image -> file && (size_t) read(file, image -> file, (unsigned int) image -> file_size) != image -> file_size) {
+            free(image -> file);
+            image -> file = nullptr;
+        }
+    #else
+        void *map = mmap(nullptr, image -> file_size, PROT_READ, MAP_PRIVATE, file, 0);
+
+        if (map != MAP_FAILED) {
+            madvise(map, image -> file_size, MADV_SEQUENTIAL);
+            image -> file = (unsigned char *) map;
+        }
+    #endif
+
+    close(file);
+
+    return image -> file == nullptr;
+}
+
+
+int read_header_word(const RawImage *image, size_t *pos, char *word, size_t word_size) {
+    const unsigned char *file = image -> file;
+
+    while (*pos < image -> file_size) {
+        if (file[*pos] == '#')
+            while (*pos < image -> file_size && file[*pos] != '\n') (*pos)++;
+        else if (isspace(file[*pos]))
+            (*pos)++;
+        else
+            break;
+    }
+
+    size_t length = 0;
+
+    for (; *pos < image -> file_size && !isspace(file[*pos]); (*pos)++, length++) {
+        if (length + 1 >= word_size) return 1;
+
+        word[length] = (char) file[*pos];
+    }
+
+    word[length] = '\0';
+
+    return length == 0;
+}
+
+
+int read_header_number(const RawImage *image, size_t *pos, int *number) {
+    char word[16] = "";
+
+    if (read_header_word(image, pos, word, sizeof(word))) return 1;
+
+    char *end = nullptr;
+    long value = strtol(word, &end, 10);
+
+    if (*end != '\0' || value <= 0 || value > INT_MAX) return 1;
+
+    *number = (int) value;
+
+    return 0;
+}
+
+
+int set_file_pixels(RawImage *image, size_t pos) {
+    size_t size = (size_t) image -> width * (size_t) image -> height * (size_t) image -> comp;
+
+    if (pos > image -> file_size || size / (size_t) image -> width / (size_t) image -> height != (size_t) image -> comp) return 1;
+
+    if (image -> file_size - pos < size) return 1;
+
+    image -> pixels = image -> file + pos;
+
+    return 0;
+}
+
+
+int parse_ppm(RawImage *image) {
+    size_t pos = 2;
+
+    int max_value = 0;
+
+    if (read_header_number(image, &pos, &image -> width))  return 1;
+    if (read_header_number(image, &pos, &image -> height)) return 1;
+    if (read_header_number(image, &pos, &max_value))       return 1;
+
+    if (max_value != 255) return 1;
+
+    image -> comp = 3;
+
+    // Pixels start after single whitespace
+    return set_file_pixels(image, pos + 1);
+}
+
+
+int parse_pam(RawImage *image) {
+    size_t pos = 2;
+
+    int max_value = 0;
+
+    char word[16] = "";
+
+    while (!read_header_word(image, &pos, word, sizeof(word))) {
+        if (!strcmp(word, "ENDHDR")) {
+            if (max_value != 255 || (image -> comp != 3 && image -> comp != 4)) return 1;
+
+            if (image -> width <= 0 || image -> height <= 0) return 1;
+
+            return set_file_pixels(image, pos + 1);
+        }
+
+        int error = 0;
+
+        if (!strcmp(word, "WIDTH"))
+            error = read_header_number(image, &pos, &image -> width);
+        else if (!strcmp(word, "HEIGHT"))
+            error = read_header_number(image, &pos, &image -> height);
+        else if (!strcmp(word, "DEPTH"))
+            error = read_header_number(image, &pos, &image -> comp);
+        else if (!strcmp(word, "MAXVAL"))
+            error = read_header_number(image, &pos, &max_value);
+        else    // TUPLTYPE is defined by DEPTH for supported images
+            while (pos < image -> file_size && image -> file[pos] != '\n') pos++;
+
+        if (error) return 1;
+    }
+
+    return 1;
+}
+
+
+int parse_qoi(RawImage *image) {
+    const unsigned char *file = image -> file;
+
+    if (image -> file_size < QOI_HEADER_SIZE + QOI_PADDING_SIZE || memcmp(file, "qoif", 4)) return 1;
+
+    unsigned int width  = (unsigned int) file[4] << 24 | (unsigned int) file[5] << 16 | (unsigned int) file[6]  << 8 | file[7];
+    unsigned int height = (unsigned int) file[8] << 24 | (unsigned int) file[9] << 16 | (unsigned int) file[10] << 8 | file[11];
+
+    if (width == 0 || height == 0 || width > INT_MAX || height > INT_MAX) return 1;
+    if ((file[12] != 3 && file[12] != 4)) return 1;
+
+    if ((size_t) width * height * 4 / 4 / width != height) return 1;
+
+    image -> width = (int) width;
+    image -> height = (int) height;
+    image -> comp = 4;
+    image -> is_qoi = 1;
+
+    image -> qoi = {};
+    image -> qoi.pos = QOI_HEADER_SIZE;
+
+    return 0;
+}
+
+
+void decode_qoi_pixels(RawImage *image, unsigned char *out, size_t count) {
+    const unsigned char *file = image -> file;
+
+    QoiState *qoi = &image -> qoi;
+
+    // Chunks are never longer than 5 bytes, so padding protects reads near the end
+    size_t end = image -> file_size - QOI_PADDING_SIZE;
+
+    for (unsigned char *last = out + count * 4; out < last; out += 4) {
+        if (qoi -> run > 0) {
+            qoi -> run--;
+        }
+        else if (qoi -> pos < end) {
+            unsigned char tag = file[qoi -> pos++];
+
+            unsigned char *pixel = qoi -> pixel;
+
+            if (tag == QOI_OP_RGB) {
+                memcpy(pixel, file + qoi -> pos, 3);
+                qoi -> pos += 3;
+            }
+            else if (tag == QOI_OP_RGBA) {
+                memcpy(pixel, file + qoi -> pos, 4);
+                qoi -> pos += 4;
+            }
+            else {
+                switch (tag & QOI_MASK) {
+                    case QOI_OP_INDEX: memcpy(pixel, qoi -> index[tag], 4); break;
+                    case QOI_OP_DIFF: {
+                        pixel[0] = (unsigned char) (pixel[0] + ((tag >> 4) & 3) - 2);
+                        pixel[1] = (unsigned char) (pixel[1] + ((tag >> 2) & 3) - 2);
+                        pixel[2] = (unsigned char) (pixel[2] + (tag & 3) - 2);
+                        break;
+                    }
+                    case QOI_OP_LUMA: {
+                        int next = file[qoi -> pos++], green = (tag & 0x3F) - 32;
+
+                        pixel[0] = (unsigned char) (pixel[0] + green - 8 + ((next >> 4) & 0x0F));
+                        pixel[1] = (unsigned char) (pixel[1] + green);
+                        pixel[2] = (unsigned char) (pixel[2] + green - 8 + (next & 0x0F));
+                        break;
+                    }
+                    case QOI_OP_RUN: qoi -> run = tag & 0x3F; break;
+                    default: break;
+                }
+            }
+
+            memcpy(qoi -> index[(pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64], pixel, 4);
+        }
+
+        memcpy(out, qoi -> pixel, 4);
+    }
+}
+
+
+int open_raw_image(RawImage *image, const char *filename, int by_rows) {
+    assert(image && "Can't open null image!");
+    assert(filename && "Image path is null!");
+
+    if (map_image_file(image, filename)) return 1;
+
+    int error = 1;
+
+    if (image -> file_size >= 2 && image -> file[0] == 'P' && image -> file[1] == '6')
+        error = parse_ppm(image);
+    else if (image -> file_size >= 2 && image -> file[0] == 'P' && image -> file[1] == '7')
+        error = parse_pam(image);
+    else if (image -> file_size >= 4 && !memcmp(image -> file, "qoif", 4))
+        error = parse_qoi(image);
+
+    if (!error && image -> is_qoi && !by_rows) {
+        size_t size = (size_t) image -> width * (size_t) image -> height;
+
+        image -> decoded = (unsigned char *) calloc(size * 4, sizeof(unsigned char));
+
+        if (image -> decoded) decode_qoi_pixels(image, image -> decoded, size);
+        else error = 1;
+
+        image -> pixels = image -> decoded;
+    }
+
+    if (error) close_raw_image(image);
+
+    return error;
+}
+
+
+const unsigned char *read_raw_rows(RawImage *image, int count, unsigned char *buffer) {
+    assert(image && "Can't read from null image!");
+    assert(count > 0 && "Wrong amount of rows!");
+
+    if (count > image -> height - image -> rows_read) return nullptr;
+
+    size_t row_size = (size_t) image -> width * (size_t) image -> comp;
+
+    const unsigned char *rows = nullptr;
+
+    if (image -> pixels) {
+        rows = image -> pixels + (size_t) image -> rows_read * row_size;
+    }
+    else {
+        assert(buffer && "Can't decode rows to null array!");
+
+        decode_qoi_pixels(image, buffer, (size_t) image -> width * (size_t) count);
+        rows = buffer;
+    }
+
+    image -> rows_read += count;
+
+    return rows;
+}
+
+
+void close_raw_image(RawImage *image) {
+    assert(image && "Can't close null image!");
+
+    #if defined(_WIN32) || defined(_WIN64)
+        free(image -> file);
+    #else
+        if (image -> file) munmap(image -> file, image -> file_size);
+    #endif
+
+    image -> file = nullptr;
+    image -> file_size = 0;
+
+    free(image -> decoded);
+    image -> decoded = nullptr;
+
+    image -> pixels = nullptr;
+    image -> width = -1;
+    image -> height = -1;
+    image -> comp = 0;
+    image -> is_qoi = 0;
+    image -> rows_read = 0;
+}
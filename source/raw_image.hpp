@@ -0,0 +1,53 @@
+/// Contains state of QOI decoder between rows
+typedef struct {
+    size_t pos = 0;                             ///< Position of the next chunk in file
+    int run = 0;                                ///< Amount of repeats of the previous pixel left
+    unsigned char pixel[4] = {0, 0, 0, 255};    ///< Previous pixel
+    unsigned char index[64][4] = {};            ///< Array of previously seen pixels
+} QoiState;
+
+
+/// Contains raw pixels of image that was read without stb
+typedef struct {
+    unsigned char *file = nullptr;          ///< Mapped file content
+    size_t file_size = 0;                   ///< File size in bytes
+    unsigned char *decoded = nullptr;       ///< Decoded pixels if they can't be used straight from file
+    const unsigned char *pixels = nullptr;  ///< Pixels from top left corner to bottom right
+    int width = -1;                         ///< Image width in pixels
+    int height = -1;                        ///< Image height in pixels
+    int comp = 0;                           ///< Amount of channels, 3 for RGB and 4 for RGBA
+    int is_qoi = 0;                         ///< Non zero value means that pixels are decoded from QOI chunks
+    int rows_read = 0;                      ///< Amount of rows already given by read_raw_rows
+    QoiState qoi = {};                      ///< QOI decoder state
+} RawImage;
+
+
+
+
+/**
+ * \brief Reads binary PPM, PAM or QOI image
+ * \param [out] image    Image to read
+ * \param [in]  filename Path to file
+ * \param [in]  by_rows  Non zero value means that QOI is not decoded whole and rows are read by read_raw_rows
+ * \return Non zero value means that file has another format and should be loaded by stb
+ * \note PPM (P6) and PAM (P7) pixels are used straight from mapped file, QOI is decoded to RGBA
+*/
+int open_raw_image(RawImage *image, const char *filename, int by_rows = 0);
+
+
+/**
+ * \brief Gives next rows of image
+ * \param [in]  image  Opened image
+ * \param [in]  count  Amount of rows
+ * \param [out] buffer Array of count * width * comp bytes for rows that are decoded from QOI
+ * \return Pointer to the first pixel of rows or nullptr if image has less rows left
+ * \note PPM and PAM rows are given straight from mapped file without copying
+*/
+const unsigned char *read_raw_rows(RawImage *image, int count, unsigned char *buffer);
+
+
+/**
+ * \brief Unmaps image file and frees decoded pixels
+ * \param [in] image To close
+*/
+void close_raw_image(RawImage *image);
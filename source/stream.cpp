@@ -0,0 +1,371 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <zlib.h>
+#include <atomic>
+#include <thread>
+#include "libs/tree.hpp"
+#include "libs/queue.hpp"
+#include "libs/ident.hpp"
+#include "image_parser.hpp"
+#include "tile_kernel.hpp"
+#include "png_stream.hpp"
+#include "symbol_parser.hpp"
+#include "grammar.hpp"
+#include "stream.hpp"
+
+
+/// Contains state shared by front end stages that work at the same time
+typedef struct {
+    PngStream png = {};         ///< Image that is decoded band by band
+    int width = 0;              ///< Image width in symbols
+    int occupancy_stride = 0;   ///< Occupancy words in symbol row
+    int tolerance = 0;          ///< Max amount of wrong pixels in reserved shape
+    int scale = 0;              ///< Integer scale of upscaled image, zero means that it is detected
+    int first_band = 0;         ///< Index of the band that is decoded before stages start, bands above it are blank
+    unsigned char *band = nullptr;  ///< Pixel rows of one symbol row, the first band is decoded before stages start
+    Queue rows = {};            ///< Symbol rows from decoder to lexer
+    Queue tokens = {};          ///< Token chunks from lexer to parser
+} FrontStream;
+
+
+/**
+ * \brief Decodes bands until the first one with ink and detects scale by them unless it is set
+ * \param [in] stream Front end state, band is allocated and filled with rows of the first band with ink
+ * \return Non zero value means that image is upscaled or its first band with ink can't tell it, so image must be read whole
+*/
+int read_first_band(FrontStream *stream);
+
+
+/**
+ * \brief Decodes next rows of image to band
+ * \param [in]  png   Opened image
+ * \param [in]  count Amount of rows
+ * \param [out] band  Array for count rows
+ * \return Non zero value means error
+*/
+int read_band_rows(PngStream *png, int count, unsigned char *band);
+
+
+/// Returns size of band row in bytes, indexed images stay packed and the others are expanded to RGBA
+size_t get_band_row_size(const PngStream *png);
+
+
+/**
+ * \brief Marks not white pixels of band row
+ * \param [in]  png  Opened image
+ * \param [in]  lut  Palette table of indexed image
+ * \param [in]  row  Band row
+ * \param [out] mask Array of get_row_mask_size(png -> width) words
+*/
+void get_band_row_mask(const PngStream *png, const PaletteLut *lut, const unsigned char *row, RowMask *mask);
+
+
+/**
+ * \brief Decodes image band by band and pushes symbol rows to the queue
+ * \param [in] stream Front end state
+ * \note Queue ends with the row that starts with TERMINATOR
+*/
+void decode_symbol_rows(FrontStream *stream);
+
+
+/**
+ * \brief Lexes symbol rows from the queue and pushes token chunks to the queue
+ * \param [in] stream Front end state
+*/
+void lex_symbol_rows(FrontStream *stream);
+
+
+/// Returns occupancy bitmap of symbol row in queue slot
+RowMask *get_row_occupancy(void *slot);
+
+
+/// Returns shapes of symbol row in queue slot
+unsigned int *get_row_shapes(const FrontStream *stream, void *slot);
+
+
+/// Returns colors of symbol row in queue slot
+Pixel *get_row_colors(const FrontStream *stream, void *slot);
+
+
+
+
+int stream_program(const char *filename, Node **program, int tolerance, int scale) {
+    assert(filename && "Image path is null!");
+    assert(program && "Can't write program to null pointer!");
+
+    FrontStream stream = {};
+
+    if (open_png_stream(&stream.png, filename)) return 1;
+
+    const int OFFSET = SYMBOL_SIZE + 1;
+
+    assert(stream.png.width > 0 && "Image has no pixels!");
+    assert(stream.png.width % OFFSET == 0 && stream.png.height % OFFSET == 0 && "Wrong image size!");
+
+    stream.scale = scale;
+
+    if (read_first_band(&stream)) {
+        free(stream.band);
+
+        close_png_stream(&stream.png);
+
+        return 1;
+    }
+
+    stream.width = stream.png.width / stream.scale / OFFSET;
+    stream.tolerance = tolerance;
+
+    stream.occupancy_stride = (stream.width + ROW_MASK_BITS - 1) / ROW_MASK_BITS;
+
+    size_t row_size = (size_t) stream.occupancy_stride * sizeof(RowMask) + (size_t) stream.width * (sizeof(unsigned int) + sizeof(Pixel));
+
+    queue_constructor(&stream.rows, row_size, ROW_QUEUE_SIZE);
+    queue_constructor(&stream.tokens, sizeof(TokenChunk), TOKEN_QUEUE_SIZE);
+
+    std::thread decoder(&decode_symbol_rows, &stream);
+    std::thread lexer(&lex_symbol_rows, &stream);
+
+    *program = get_program_stream(&stream.tokens);
+
+    decoder.join();
+    lexer.join();
+
+    queue_destructor(&stream.rows);
+    queue_destructor(&stream.tokens);
+
+    free(stream.band);
+
+    close_png_stream(&stream.png);
+
+    return 0;
+}
+
+
+RowMask *get_row_occupancy(void *slot) {
+    return (RowMask *) slot;
+}
+
+
+unsigned int *get_row_shapes(const FrontStream *stream, void *slot) {
+    return (unsigned int *) (get_row_occupancy(slot) + stream -> occupancy_stride);
+}
+
+
+Pixel *get_row_colors(const FrontStream *stream, void *slot) {
+    return (Pixel *) (get_row_shapes(stream, slot) + stream -> width);
+}
+
+
+int read_first_band(FrontStream *stream) {
+    const int OFFSET = SYMBOL_SIZE + 1;
+
+    PngStream *png = &stream -> png;
+
+    int width = png -> width;
+
+    size_t row_size = get_band_row_size(png);
+
+    // Scale divides size of the symbols grid, so image with prime grid size is not upscaled
+    int scale = get_gcd(width / OFFSET, png -> height / OFFSET);
+
+    if (!stream -> scale && scale <= 1) stream -> scale = 1;
+
+    if (stream -> scale) {
+        assert(width % (OFFSET * stream -> scale) == 0 && png -> height % (OFFSET * stream -> scale) == 0 && "Image size is not divisible by scale!");
+
+        stream -> band = (unsigned char *) calloc(row_size * (size_t) (OFFSET * stream -> scale), sizeof(unsigned char));
+
+        return png -> height && read_band_rows(png, OFFSET * stream -> scale, stream -> band);
+    }
+
+    stream -> band = (unsigned char *) calloc(row_size * OFFSET, sizeof(unsigned char));
+
+    PaletteLut lut = {};
+    if (png -> indexed) get_palette_lut(png -> palette, png -> depth, &lut);
+
+    int mask_size = get_row_mask_size(width);
+
+    RowMask *masks = (RowMask *) calloc(2 * mask_size, sizeof(RowMask));
+
+    RowMask ink = 0;
+
+    // Blank bands can't tell the scale, they are skipped until the band with ink
+    for (int band = 0; !ink && band < png -> height / OFFSET; band++) {
+        stream -> first_band = band;
+
+        if (read_band_rows(png, OFFSET, stream -> band)) {
+            free(masks);
+            return 1;
+        }
+
+        for (int row = 0; row < OFFSET && scale > 1; row++) {
+            int y = band * OFFSET + row;
+
+            RowMask *mask = masks + (y % 2) * mask_size, *prev = masks + (1 - y % 2) * mask_size;
+
+            get_band_row_mask(png, &lut, stream -> band + row * row_size, mask);
+
+            scale = get_mask_scale(mask, (y > 0)? prev : nullptr, width, y, scale);
+
+            for (int word = 0; word < mask_size; word++) ink |= mask[word];
+        }
+    }
+
+    free(masks);
+
+    // Blank image looks the same with any scale
+    stream -> scale = (ink)? scale : 1;
+
+    return stream -> scale != 1;
+}
+
+
+int read_band_rows(PngStream *png, int count, unsigned char *band) {
+    size_t row_size = get_band_row_size(png);
+
+    for (int row = 0; row < count; row++) {
+        int error = (png -> indexed)? read_png_packed_row(png, band + row * row_size) : read_png_row(png, band + row * row_size);
+
+        if (error) return 1;
+    }
+
+    return 0;
+}
+
+
+size_t get_band_row_size(const PngStream *png) {
+    const int COMP = 4; // Amount of channels in band of not indexed image
+
+    return (png -> indexed)? get_png_row_size(png) : (size_t) png -> width * COMP;
+}
+
+
+void get_band_row_mask(const PngStream *png, const PaletteLut *lut, const unsigned char *row, RowMask *mask) {
+    const int COMP = 4; // Amount of channels in band of not indexed image
+
+    if (png -> indexed)
+        get_packed_row_mask(row, png -> width, lut, mask);
+    else
+        get_row_mask(row, png -> width, COMP, mask);
+}
+
+
+void decode_symbol_rows(FrontStream *stream) {
+    assert(stream && "Can't decode null stream!");
+
+    const int OFFSET = SYMBOL_SIZE + 1;
+    const int COMP = 4; // Amount of channels in band of not indexed image
+
+    PngStream *png = &stream -> png;
+
+    int scale = stream -> scale, width = png -> width / scale;
+
+    int mask_size = get_row_mask_size(width);
+
+    // Indexed images stay packed, so band is smaller and palette table is used instead of colors
+    size_t row_size = get_band_row_size(png);
+
+    PaletteLut lut = {};
+    if (png -> indexed) get_palette_lut(png -> palette, png -> depth, &lut);
+
+    unsigned char *band = stream -> band;
+    RowMask *masks = (RowMask *) calloc(SYMBOL_SIZE * mask_size, sizeof(RowMask));
+
+    // Mask of upscaled row before downsampling
+    RowMask *scaled = (scale > 1)? (RowMask *) calloc(get_row_mask_size(png -> width), sizeof(RowMask)) : nullptr;
+
+    for (int y = 0; y < png -> height / scale / OFFSET; y++) {
+        // The first band is already decoded and bands above it are blank
+        if (y > stream -> first_band) {
+            int error = read_band_rows(png, OFFSET * scale, band);
+
+            assert(!error && "Can't decode image row!");
+        }
+
+        // Only the top row of every block is read
+        for (int row = 0; row < SYMBOL_SIZE && y >= stream -> first_band; row++) {
+            if (scale > 1) {
+                get_band_row_mask(png, &lut, band + row * scale * row_size, scaled);
+                downsample_row_mask(scaled, width, scale, masks + row * mask_size);
+            }
+            else {
+                get_band_row_mask(png, &lut, band + row * row_size, masks + row * mask_size);
+            }
+        }
+
+        void *slot = queue_back(&stream -> rows);
+
+        unsigned int *shapes = get_row_shapes(stream, slot);
+        Pixel *colors = get_row_colors(stream, slot);
+        RowMask *occupancy = get_row_occupancy(slot);
+
+        // Slot is reused, lexer of blank band reads only its first symbol and then jumps by occupancy
+        memset(occupancy, 0, stream -> occupancy_stride * sizeof(RowMask));
+
+        if (y < stream -> first_band || is_blank_band(masks, width))
+            shapes[0] = 0;
+        else if (png -> indexed)
+            get_packed_row_symbols(band, row_size, width, &lut, scale, 0, masks, shapes, colors, occupancy);
+        else
+            get_row_symbols(band, width, COMP, scale, 0, masks, shapes, colors, occupancy);
+
+        queue_push(&stream -> rows);
+    }
+
+    free(masks);
+    free(scaled);
+
+    void *slot = queue_back(&stream -> rows);
+
+    get_row_shapes(stream, slot)[0] = TERMINATOR;
+
+    queue_push(&stream -> rows);
+}
+
+
+void lex_symbol_rows(FrontStream *stream) {
+    assert(stream && "Can't lex null stream!");
+
+    TokenChunk *chunk = (TokenChunk *) queue_back(&stream -> tokens);
+
+    // Chunk has a number for every lexem, so lexer never grows numbers array
+    Lexer lexer = {};
+    lexer.tokens = chunk -> tokens;
+    lexer.numbers = chunk -> numbers;
+    lexer.number_capacity = TOKEN_CHUNK_SIZE;
+    lexer.tolerance = stream -> tolerance;
+
+    while (lexer.state != LEX_END) {
+        void *slot = queue_front(&stream -> rows);
+
+        const unsigned int *shapes = get_row_shapes(stream, slot);
+        const Pixel *colors = get_row_colors(stream, slot);
+        const RowMask *occupancy = get_row_occupancy(slot);
+
+        for (int x = 0; x < stream -> width && lexer.state != LEX_END; x++) {
+            if (lexer.size > TOKEN_CHUNK_SIZE - LEX_SYMBOL_TOKENS) {
+                chunk -> size = lexer.size;
+                queue_push(&stream -> tokens);
+
+                chunk = (TokenChunk *) queue_back(&stream -> tokens);
+
+                lexer.tokens = chunk -> tokens;
+                lexer.size = 0;
+                lexer.numbers = chunk -> numbers;
+                lexer.number_count = 0;
+            }
+
+            lex_symbol(&lexer, shapes[x], colors + x);
+
+            // Only the first empty symbol can finish token, the rest don't change lexer state
+            if (!shapes[x]) x = find_next_bit(occupancy, x + 1, stream -> width) - 1;
+        }
+
+        queue_pop(&stream -> rows);
+    }
+
+    chunk -> size = lexer.size;
+    queue_push(&stream -> tokens);
+}
@@ -0,0 +1,18 @@
+/// Amount of symbol rows that decoder can get ahead of lexer
+const long ROW_QUEUE_SIZE = 64;
+
+
+/// Amount of token chunks that lexer can get ahead of parser
+const long TOKEN_QUEUE_SIZE = 16;
+
+
+/**
+ * \brief Decodes image, lexes and parses it at the same time
+ * \param [in]  filename Path to png image
+ * \param [out] program  Program tree
+ * \param [in]  tolerance Max amount of wrong pixels in reserved shape
+ * \param [in]  scale    Integer scale of upscaled image, zero means that it is detected
+ * \return Non zero value means that image can't be decoded band by band or detected scale is not 1
+ * \note Only a few symbol rows and token chunks are held in memory at once, scale is detected by the first band with ink
+*/
+int stream_program(const char *filename, Node **program, int tolerance = 0, int scale = 0);
@@ -1,216 +1,761 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #define SYMBOL_PARSER_X86
+#endif
+
+#include <string.h>
 #include "libs/tree.hpp"
+#include "libs/ident.hpp"
 #include "image_parser.hpp"
 #include "symbol_parser.hpp"
 
 
 
 
-#define CASE_TOKEN_TYPE(token_type) case SHAPE_##token_type: token -> type = TYPE_##token_type; ptr++; break
-#define CASE_TOKEN_OP(token_op) case SHAPE_##token_op: token -> type = TYPE_OP; token -> value.op = OP_##token_op; ptr++; break
+/// All reserved shapes for nearest shape search
+const unsigned int RESERVED_SHAPE_LIST[] = {
+    SHAPE_ZERO, SHAPE_ONE, SHAPE_TWO, SHAPE_THREE, SHAPE_FOUR,
+    SHAPE_FIVE, SHAPE_SIX, SHAPE_SEVEN, SHAPE_EIGHT, SHAPE_NINE,
+    SHAPE_SEQ, SHAPE_CONT, SHAPE_BLOCK_BEGIN, SHAPE_BLOCK_END, SHAPE_BRACKET_BEGIN, SHAPE_BRACKET_END,
+    SHAPE_IF, SHAPE_WHILE, SHAPE_NVAR, SHAPE_DEF, SHAPE_RET,
+    SHAPE_ADD, SHAPE_SUB, SHAPE_MUL, SHAPE_DIV,
+    SHAPE_AND, SHAPE_OR, SHAPE_NOT, SHAPE_ASS, SHAPE_DOT,
+    SHAPE_EQ, SHAPE_NEQ, SHAPE_GRE, SHAPE_LES, SHAPE_GEQ, SHAPE_LEQ,
+    SHAPE_ELSE, SHAPE_DIF, SHAPE_COM, SHAPE_REF, SHAPE_LOC,
+};
+
+
+/// Amount of reserved shapes
+const int RESERVED_SHAPE_COUNT = (int) (sizeof(RESERVED_SHAPE_LIST) / sizeof(RESERVED_SHAPE_LIST[0]));
+
+
+/// Kinds of shapes for lexer
+typedef enum {
+    SHAPE_KIND_IDENT,           ///< Part of identificator
+    SHAPE_KIND_DIGIT,           ///< Digit of number
+    SHAPE_KIND_TOKEN,           ///< Shape that is lexem itself
+    SHAPE_KIND_DOT,             ///< Decimal point
+    SHAPE_KIND_COMMENT,         ///< Comment border
+    SHAPE_KIND_END,             ///< TERMINATOR
+} SHAPE_KINDS;
+
+
+/// Everything lexer needs to know about shape
+typedef struct {
+    unsigned int shape = 0;         ///< Masked shape, zero for empty slot of table
+    unsigned char kind = 0;         ///< Kind from #SHAPE_KINDS
+    unsigned char type = 0;         ///< Lexem type for tokens and digits
+    unsigned char value = 0;        ///< Operator or bracket value of lexem, value of digit
+    unsigned char reserved = 0;     ///< Non zero value means that shape finishes identificator
+} ShapeClass;
+
+
+#define SHAPE_DIGIT(name, digit)    {SHAPE_##name, SHAPE_KIND_DIGIT, TYPE_NUM, digit, 0}
+#define SHAPE_TOKEN(name)           {SHAPE_##name, SHAPE_KIND_TOKEN, TYPE_##name, 0, 1}
+#define SHAPE_OP(name, reserved)    {SHAPE_##name, SHAPE_KIND_TOKEN, TYPE_OP, OP_##name, reserved}
+
+/// Classes of all shapes that are not identificator parts
+constexpr ShapeClass SHAPE_CLASS_LIST[] = {
+    SHAPE_DIGIT(ZERO, 0), SHAPE_DIGIT(ONE, 1), SHAPE_DIGIT(TWO, 2), SHAPE_DIGIT(THREE, 3), SHAPE_DIGIT(FOUR, 4),
+    SHAPE_DIGIT(FIVE, 5), SHAPE_DIGIT(SIX, 6), SHAPE_DIGIT(SEVEN, 7), SHAPE_DIGIT(EIGHT, 8), SHAPE_DIGIT(NINE, 9),
+
+    SHAPE_TOKEN(IF), SHAPE_TOKEN(WHILE), SHAPE_TOKEN(NVAR), SHAPE_TOKEN(DEF),
+    SHAPE_TOKEN(SEQ), SHAPE_TOKEN(CONT), SHAPE_TOKEN(RET), SHAPE_TOKEN(ELSE),
+
+    {SHAPE_BRACKET_BEGIN, SHAPE_KIND_TOKEN, TYPE_BRACKET, 1, 1}, {SHAPE_BRACKET_END, SHAPE_KIND_TOKEN, TYPE_BRACKET, 0, 1},
+    {SHAPE_BLOCK_BEGIN,   SHAPE_KIND_TOKEN, TYPE_BLOCK,   1, 1}, {SHAPE_BLOCK_END,   SHAPE_KIND_TOKEN, TYPE_BLOCK,   0, 1},
+
+    SHAPE_OP(ADD, 1), SHAPE_OP(SUB, 1), SHAPE_OP(MUL, 1), SHAPE_OP(DIV, 1),
+    SHAPE_OP(AND, 1), SHAPE_OP(OR, 1), SHAPE_OP(NOT, 1),
+    SHAPE_OP(EQ, 1), SHAPE_OP(NEQ, 1), SHAPE_OP(GRE, 1), SHAPE_OP(LES, 1), SHAPE_OP(GEQ, 1), SHAPE_OP(LEQ, 1),
+    SHAPE_OP(ASS, 1), SHAPE_OP(DIF, 1),
+
+    // References and locals can be parts of identificators
+    SHAPE_OP(REF, 0), SHAPE_OP(LOC, 0),
+
+    {SHAPE_DOT, SHAPE_KIND_DOT, 0, 0, 1},
+    {SHAPE_COM, SHAPE_KIND_COMMENT, 0, 0, 1},
+    {TERMINATOR, SHAPE_KIND_END, TYPE_ESC, 0, 1},
+};
+
+#undef SHAPE_DIGIT
+#undef SHAPE_TOKEN
+#undef SHAPE_OP
+
+
+/// Amount of bits in shape hash
+const int SHAPE_HASH_BITS = 7;
+
+
+/// Multiplicative hash of masked shape
+constexpr unsigned int get_shape_hash(unsigned int shape, unsigned int multiplier) {
+    return (shape * multiplier) >> (32 - SHAPE_HASH_BITS);
+}
+
+
+/// Checks that every shape of SHAPE_CLASS_LIST gets its own hash
+constexpr int is_perfect_shape_hash(unsigned int multiplier) {
+    unsigned char used[1 << SHAPE_HASH_BITS] = {};
+
+    for (const ShapeClass &shape_class : SHAPE_CLASS_LIST) {
+        unsigned int hash = get_shape_hash(shape_class.shape, multiplier);
+
+        if (used[hash]) return 0;
+
+        used[hash] = 1;
+    }
+
+    return 1;
+}
+
+
+/// Searches for multiplier of perfect shape hash starting from golden ratio
+constexpr unsigned int find_shape_hash_multiplier() {
+    unsigned int multiplier = 0x9E3779B1;
+
+    while (!is_perfect_shape_hash(multiplier)) multiplier += 2;
+
+    return multiplier;
+}
+
+
+/// Multiplier of perfect shape hash
+constexpr unsigned int SHAPE_HASH_MULTIPLIER = find_shape_hash_multiplier();
+
+
+/// Shape classes placed by their hashes
+typedef struct {
+    ShapeClass slots[1 << SHAPE_HASH_BITS] = {};    ///< Class of every hash, empty slots have zero shape
+} ShapeTable;
+
+
+/// Places every shape class to the slot of its hash
+constexpr ShapeTable get_shape_table() {
+    ShapeTable table = {};
+
+    for (const ShapeClass &shape_class : SHAPE_CLASS_LIST)
+        table.slots[get_shape_hash(shape_class.shape, SHAPE_HASH_MULTIPLIER)] = shape_class;
+
+    return table;
+}
+
+
+/// Table that classifies shape with one probe
+constexpr ShapeTable SHAPE_TABLE = get_shape_table();
+
+
+/// Class of shapes that are not in table
+constexpr ShapeClass IDENT_CLASS = {};
+
+
+/**
+ * \brief Classifies shape with one table probe
+ * \param [in] shape Masked shape
+ * \return Class from table or IDENT_CLASS if shape is identificator part
+*/
+inline const ShapeClass *get_shape_class(unsigned int shape);
+
+
+/// Nearest reserved shape search function
+typedef unsigned int (*NearestShapeKernel)(unsigned int shape, int tolerance);
+
+
+/// Scans all reserved shapes counting different pixels, compiled separately for every instruction set
+__attribute__((always_inline)) inline unsigned int scan_reserved_shapes(unsigned int shape, int tolerance);
+
+
+/// Finds nearest reserved shape with software popcount
+unsigned int get_nearest_shape_scalar(unsigned int shape, int tolerance);
+
+
+#ifdef SYMBOL_PARSER_X86
+
+/// Finds nearest reserved shape with popcnt instruction
+unsigned int get_nearest_shape_popcnt(unsigned int shape, int tolerance);
+
+#endif
+
+
+/// Chooses the fastest nearest shape search supported by CPU
+NearestShapeKernel select_nearest_shape_kernel();
+
+
+/// Lexer that grows its array of lexems while image is read by tiles
+typedef struct {
+    Lexer lexer = {};           ///< Lexer state that is kept between tiles
+    size_t capacity = 0;        ///< Size of lexer array
+} TileLexer;
+
+
+/// Part of symbols that is lexed by one job
+typedef struct {
+    const SymbolBuffer *symbols = nullptr;  ///< Symbols of the whole image
+    size_t begin = 0;                       ///< Index of the first symbol of part
+    size_t end = 0;                         ///< Index of the symbol after the last one
+    size_t count = 0;                       ///< Amount of not empty symbols before TERMINATOR
+    size_t terminator = 0;                  ///< Index of the first TERMINATOR or end of part if there is no such
+    int comments = 0;                       ///< Amount of comment borders before TERMINATOR
+    Lexer lexer = {};                       ///< Lexer of part, it starts inside comment if previous parts have odd amount of borders
+} LexRange;
 
-Node *parse_symbols(const Symbol *symbols, int symbols_size, int *tokens_size) {
+
+/// Moves lexems and numbers of lexer to stream shrinking arrays to their sizes
+TokenStream get_lexer_stream(Lexer *lexer);
+
+
+/**
+ * \brief Gives symbols to lexer jumping over empty ones
+ * \param [in] lexer   Lexer state
+ * \param [in] symbols Symbols to lex
+ * \param [in] begin   Index of the first symbol to lex
+ * \param [in] end     Index of the symbol after the last one to lex
+*/
+void lex_symbols(Lexer *lexer, const SymbolBuffer *symbols, size_t begin, size_t end);
+
+
+/**
+ * \brief Splits symbols to parts at empty symbols and lexes them in parallel
+ * \param [in] symbols   To parse
+ * \param [in] tolerance Max amount of wrong pixels in reserved shape
+ * \param [in] jobs      Amount of threads
+ * \return Lexems of the program that are the same as sequential lexer gives
+*/
+TokenStream parse_symbols_jobs(const SymbolBuffer *symbols, int tolerance, int jobs);
+
+
+/**
+ * \brief Finds the first empty symbol starting from index
+ * \param [in] symbols Symbols to search in
+ * \param [in] index   Index to start from
+ * \return Index of the empty symbol or index of TERMINATOR at the end of buffer if there is no such
+*/
+size_t find_empty_symbol(const SymbolBuffer *symbols, size_t index);
+
+
+/// Counts not empty symbols and comment borders of part and finds TERMINATOR in it
+void scan_lex_range(LexRange *range);
+
+
+/// Lexes part of symbols keeping keys of identificators
+void lex_range(LexRange *range);
+
+
+/**
+ * \brief Appends lexems of part to stream interning its identificators and moving its numbers
+ * \param [in] stream Stream with enough space for lexems and numbers
+ * \param [in] lexer  Lexer of part
+*/
+void append_lexer_tokens(TokenStream *stream, const Lexer *lexer);
+
+
+/// Gives all symbols of tile except its TERMINATOR to TileLexer
+void lex_symbol_tile(const SymbolBuffer *tile, void *data);
+
+
+/// Adds number or identificator that was read by lexer to lexems
+void finish_token(Lexer *lexer);
+
+
+/// Starts identificator from its first symbol
+void start_ident(Lexer *lexer, unsigned int shape, const Pixel *color);
+
+
+/// Adds symbol to identificator name
+void add_ident_shape(Lexer *lexer, unsigned int shape);
+
+
+
+
+TokenStream parse_symbols(const SymbolBuffer *symbols, int tolerance, int jobs) {
     assert(symbols && "Can't parse null symbols!");
-    assert(tokens_size && "Can't work with null tokens_size!");
 
-    Node *tokens = (Node *) calloc(symbols_size, sizeof(Node));
+    if (jobs > 1) return parse_symbols_jobs(symbols, tolerance, jobs);
 
-    Node *token = tokens;
-    const Symbol *ptr = symbols;
+    Lexer lexer = {};
+    lexer.tolerance = tolerance;
 
-    for (; (ptr -> shape & SHAPE_BTIMASK) != TERMINATOR; token++) {
-        while (!(ptr -> shape & SHAPE_BTIMASK)) ptr++;
+    // Every lexem except escape one takes at least one not empty symbol
+    lexer.tokens = (Token *) calloc(count_symbols(symbols) + 1, sizeof(Token));
 
-        switch (ptr -> shape & SHAPE_BTIMASK) {
-            CASE_TOKEN_TYPE(IF);
-            CASE_TOKEN_TYPE(WHILE);
-            CASE_TOKEN_TYPE(NVAR);
-            CASE_TOKEN_TYPE(DEF);
-            CASE_TOKEN_TYPE(SEQ);
-            CASE_TOKEN_TYPE(CONT);
-            CASE_TOKEN_TYPE(RET);
-            CASE_TOKEN_TYPE(ELSE);
+    lex_symbols(&lexer, symbols, 0, symbols -> size);
+
+    return get_lexer_stream(&lexer);
+}
 
-            case SHAPE_BRACKET_BEGIN: token -> type = TYPE_BRACKET; token -> value.op = 1; ptr++; break;
-            case SHAPE_BRACKET_END:   token -> type = TYPE_BRACKET; token -> value.op = 0; ptr++; break;
 
-            case SHAPE_BLOCK_BEGIN: token -> type = TYPE_BLOCK; token -> value.op = 1; ptr++; break;
-            case SHAPE_BLOCK_END:   token -> type = TYPE_BLOCK; token -> value.op = 0; ptr++; break;
-            
-            CASE_TOKEN_OP(ADD);
-            CASE_TOKEN_OP(SUB);
-            CASE_TOKEN_OP(MUL);
-            CASE_TOKEN_OP(DIV);
+TokenStream parse_symbols_jobs(const SymbolBuffer *symbols, int tolerance, int jobs) {
+    if ((size_t) jobs > symbols -> size) jobs = (int) symbols -> size;
 
-            CASE_TOKEN_OP(AND);
-            CASE_TOKEN_OP(OR);
-            CASE_TOKEN_OP(NOT);
+    LexRange *ranges = (LexRange *) calloc(jobs, sizeof(LexRange));
+    std::thread *workers = new std::thread[jobs];
 
-            CASE_TOKEN_OP(EQ);
-            CASE_TOKEN_OP(NEQ);
-            CASE_TOKEN_OP(GRE);
-            CASE_TOKEN_OP(LES);
-            CASE_TOKEN_OP(GEQ);
-            CASE_TOKEN_OP(LEQ);
+    // Lexer is always waiting for the next lexem or skipping comment after empty symbol, so parts start after them
+    size_t begin = 0;
 
-            CASE_TOKEN_OP(ASS);
+    for (int i = 0; i < jobs; i++) {
+        ranges[i] = {};
 
-            CASE_TOKEN_OP(DIF);
+        ranges[i].symbols = symbols;
+        ranges[i].lexer.tolerance = tolerance;
+        ranges[i].lexer.defer_idents = 1;
+        ranges[i].begin = begin;
 
-            CASE_TOKEN_OP(REF);
-            CASE_TOKEN_OP(LOC);
+        begin = (i == jobs - 1)? symbols -> size : find_empty_symbol(symbols, symbols -> size * (size_t) (i + 1) / (size_t) jobs) + 1;
 
-            case SHAPE_DOT: assert(0 && "Single dot!");
+        if (begin < ranges[i].begin) begin = ranges[i].begin;
+        if (begin > symbols -> size) begin = symbols -> size;
+
+        ranges[i].end = begin;
+    }
 
-            case SHAPE_COM:
-                ptr++;
+    for (int i = 1; i < jobs; i++) workers[i] = std::thread(&scan_lex_range, ranges + i);
 
-                while (ptr -> shape != SHAPE_COM && ptr -> shape != TERMINATOR) ptr++;
+    scan_lex_range(ranges);
 
-                if (ptr -> shape == SHAPE_COM) ptr++;
+    for (int i = 1; i < jobs; i++) workers[i].join();
 
-                token--;  // Костыль так как token сдвигается на каждой итерации
+    // Every comment border switches lexer between comment and space whatever state it was in
+    int comments = 0, last = 0;
 
-                break;
+    for (int i = 0; i < jobs; i++) {
+        if (comments % 2) ranges[i].lexer.state = LEX_COMMENT;
 
-            case TERMINATOR: token -> type = TYPE_ESC; break; // Escape token
+        comments += ranges[i].comments;
+        last = i;
 
-            default: {
-                if (to_digit(ptr -> shape) != -1) {
-                    token -> type = TYPE_NUM;
+        if (ranges[i].terminator < ranges[i].end) break;
+    }
 
-                    for(; to_digit(ptr -> shape) != -1; ptr++)
-                        token -> value.dbl = token -> value.dbl * 10 + to_digit(ptr -> shape);
-                        
-                    if ((ptr -> shape & SHAPE_BTIMASK) == SHAPE_DOT) {
-                        int point = 1;
+    for (int i = 1; i <= last; i++) workers[i] = std::thread(&lex_range, ranges + i);
 
-                        ptr++; // skip dot symbol
+    lex_range(ranges);
 
-                        for(; to_digit(ptr -> shape) != -1; ptr++) {
-                            token -> value.dbl = token -> value.dbl * 10 + to_digit(ptr -> shape);
-                            point *= 10;
-                        }
-                        
-                        assert(point > 1 && "No number after dot!");
+    for (int i = 1; i <= last; i++) workers[i].join();
 
-                        token -> value.dbl /= (double) point;
-                    }
-                }
-                else {
-                    token -> type = TYPE_VAR;
+    TokenStream stream = {};
 
-                    token -> value.var = (char *) calloc(64, sizeof(char));
+    size_t token_count = 0, number_count = 0;
 
-                    int offset = 0;
+    for (int i = 0; i <= last; i++) {
+        token_count += (size_t) ranges[i].lexer.size;
+        number_count += (size_t) ranges[i].lexer.number_count;
+    }
 
-                    sprintf(token -> value.var, "VAR_%02X%02X%02X_%n", ptr -> color.r, ptr -> color.g, ptr -> color.b, &offset);
+    stream.tokens = (Token *) calloc(token_count, sizeof(Token));
+    stream.numbers = (number_count)? (double *) calloc(number_count, sizeof(double)) : nullptr;
 
-                    for (; ptr -> shape && !is_reserved_shape(ptr -> shape); ptr++) {
-                        sprintf(token -> value.var + offset, "%08X", ptr -> shape);
-                        offset += 8;
+    // Identificators are interned in the same order as sequential lexer does
+    for (int i = 0; i <= last; i++) append_lexer_tokens(&stream, &ranges[i].lexer);
 
-                        assert(offset < 56 && "Variable name is too large!");
-                    }
-                }
+    for (int i = 0; i < jobs; i++) {
+        free(ranges[i].lexer.tokens);
+        free(ranges[i].lexer.numbers);
+        free(ranges[i].lexer.idents);
+    }
 
-                break;
-            }
+    delete[] workers;
+    free(ranges);
+
+    return stream;
+}
+
+
+size_t find_empty_symbol(const SymbolBuffer *symbols, size_t index) {
+    while (index < symbols -> size - 1 && symbols -> shapes[index]) index++;
+
+    return (index < symbols -> size - 1)? index : symbols -> size - 1;
+}
+
+
+void scan_lex_range(LexRange *range) {
+    const SymbolBuffer *symbols = range -> symbols;
+
+    range -> terminator = range -> end;
+
+    if (range -> begin >= range -> end) return;
+
+    for (size_t i = range -> begin; i < range -> end; i = get_next_symbol(symbols, i)) {
+        unsigned int shape = symbols -> shapes[i] & SHAPE_BTIMASK;
+
+        if (!shape) continue;
+
+        range -> count++;
+
+        if (shape == TERMINATOR) {
+            range -> terminator = i;
+            return;
         }
+
+        // Only shapes that are close enough to comment border can be replaced with it
+        int tolerance = range -> lexer.tolerance;
+
+        if (tolerance && shape != SHAPE_COM && __builtin_popcount(shape ^ SHAPE_COM) <= tolerance)
+            shape = get_nearest_shape(shape, tolerance);
+
+        if (shape == SHAPE_COM) range -> comments++;
+
+        if (i == symbols -> size - 1) break;
     }
+}
+
+
+void lex_range(LexRange *range) {
+    if (range -> begin >= range -> end) return;
 
-    *tokens_size = (int) (token - tokens);
+    // Every lexem except escape one takes at least one not empty symbol
+    range -> lexer.tokens = (Token *) calloc(range -> count + LEX_SYMBOL_TOKENS, sizeof(Token));
 
-    return (Node *) realloc(tokens, *tokens_size * sizeof(Node));
+    lex_symbols(&range -> lexer, range -> symbols, range -> begin, range -> end);
 }
 
-#undef CASE_TOKEN_TYPE
-#undef CASE_TOKEN_OP
 
+void append_lexer_tokens(TokenStream *stream, const Lexer *lexer) {
+    for (int i = 0; i < lexer -> size; i++) {
+        Token token = lexer -> tokens[i];
 
-int to_digit(unsigned int shape) {
-    switch (shape & SHAPE_BTIMASK) {
-        case SHAPE_ZERO:      return 0;
-        case SHAPE_ONE:       return 1;
-        case SHAPE_TWO:       return 2;
-        case SHAPE_THREE:     return 3;
-        case SHAPE_FOUR:      return 4;
-        case SHAPE_FIVE:      return 5;
-        case SHAPE_SIX:       return 6;
-        case SHAPE_SEVEN:     return 7;
-        case SHAPE_EIGHT:     return 8;
-        case SHAPE_NINE:      return 9;
-        default:              return -1;
+        if (token.type == TYPE_NUM) token.value += (unsigned int) stream -> number_count;
+
+        if (token.type == TYPE_VAR) {
+            const IdentKey *ident = lexer -> idents + token.value;
+
+            token.value = (unsigned int) intern_ident(ident -> key, ident -> size);
+        }
+
+        stream -> tokens[stream -> size++] = token;
     }
+
+    for (int i = 0; i < lexer -> number_count; i++)
+        stream -> numbers[stream -> number_count++] = lexer -> numbers[i];
 }
 
 
-#define RETURN_ONE(shape_name) case shape_name: return 1;
+TokenStream parse_symbol_tiles(const char *filename, int tile_rows, int jobs, int tolerance, int scale) {
+    assert(filename && "Image path is null!");
 
-int is_reserved_shape(unsigned int shape) {
-    switch (shape & SHAPE_BTIMASK) {
-        RETURN_ONE(SHAPE_SEQ)
-        RETURN_ONE(SHAPE_CONT)
-        RETURN_ONE(SHAPE_RET)
-        RETURN_ONE(SHAPE_BLOCK_BEGIN)
-        RETURN_ONE(SHAPE_BLOCK_END)
-        RETURN_ONE(SHAPE_BRACKET_BEGIN)
-        RETURN_ONE(SHAPE_BRACKET_END)
-        RETURN_ONE(SHAPE_IF)
-        RETURN_ONE(SHAPE_WHILE)
-        RETURN_ONE(SHAPE_NVAR)
-        RETURN_ONE(SHAPE_DEF)
-        RETURN_ONE(SHAPE_ADD)
-        RETURN_ONE(SHAPE_SUB)
-        RETURN_ONE(SHAPE_MUL)
-        RETURN_ONE(SHAPE_DIV)
-        RETURN_ONE(SHAPE_AND)
-        RETURN_ONE(SHAPE_OR)
-        RETURN_ONE(SHAPE_NOT)
-        RETURN_ONE(SHAPE_ASS)
-        RETURN_ONE(SHAPE_DOT)
-        RETURN_ONE(SHAPE_EQ)
-        RETURN_ONE(SHAPE_NEQ)
-        RETURN_ONE(SHAPE_GRE)
-        RETURN_ONE(SHAPE_LES)
-        RETURN_ONE(SHAPE_GEQ)
-        RETURN_ONE(SHAPE_LEQ)
-        RETURN_ONE(SHAPE_ELSE)
-        RETURN_ONE(SHAPE_DIF)
-        RETURN_ONE(SHAPE_COM)
-        RETURN_ONE(TERMINATOR)
-        default: return 0;
+    TileLexer tiles = {};
+    tiles.lexer.tolerance = tolerance;
+
+    if (read_symbol_tiles(filename, tile_rows, jobs, &lex_symbol_tile, &tiles, scale)) return {};
+
+    // Tiles don't contain the end of the image
+    if (tiles.capacity < (size_t) tiles.lexer.size + LEX_SYMBOL_TOKENS) {
+        tiles.capacity = (size_t) tiles.lexer.size + LEX_SYMBOL_TOKENS;
+        tiles.lexer.tokens = (Token *) realloc(tiles.lexer.tokens, tiles.capacity * sizeof(Token));
+    }
+
+    Pixel color = {};
+
+    lex_symbol(&tiles.lexer, TERMINATOR, &color);
+
+    return get_lexer_stream(&tiles.lexer);
+}
+
+
+TokenStream get_lexer_stream(Lexer *lexer) {
+    TokenStream stream = {};
+
+    stream.size = lexer -> size;
+    stream.tokens = (Token *) realloc(lexer -> tokens, (size_t) lexer -> size * sizeof(Token));
+
+    stream.number_count = lexer -> number_count;
+    stream.numbers = (lexer -> number_count)? (double *) realloc(lexer -> numbers, (size_t) lexer -> number_count * sizeof(double)) : nullptr;
+
+    if (!lexer -> number_count) free(lexer -> numbers);
+
+    lexer -> tokens = nullptr;
+    lexer -> numbers = nullptr;
+
+    return stream;
+}
+
+
+void free_token_stream(TokenStream *tokens) {
+    assert(tokens && "Can't free null stream!");
+
+    free(tokens -> tokens);
+    tokens -> tokens = nullptr;
+    tokens -> size = 0;
+
+    free(tokens -> numbers);
+    tokens -> numbers = nullptr;
+    tokens -> number_count = 0;
+}
+
+
+void lex_symbols(Lexer *lexer, const SymbolBuffer *symbols, size_t begin, size_t end) {
+    for (size_t i = begin; i < end && lexer -> state != LEX_END; i++) {
+        lex_symbol(lexer, symbols -> shapes[i], symbols -> colors + i);
+
+        // Only the first empty symbol can finish token, the rest don't change lexer state
+        if (!symbols -> shapes[i]) i = get_next_symbol(symbols, i) - 1;
     }
 }
 
-#undef RETURN_ONE
 
+void lex_symbol_tile(const SymbolBuffer *tile, void *data) {
+    TileLexer *tiles = (TileLexer *) data;
 
-void print_tokens(const Node *tokens) {
-    for(; tokens -> type != TYPE_ESC; tokens++) {
-        printf("Type: %i ", tokens -> type);
+    // Symbols of tile can finish one token of the previous tile and add one token each
+    size_t required = (size_t) tiles -> lexer.size + count_symbols(tile) + LEX_SYMBOL_TOKENS;
 
-        switch (tokens -> type) {
-            case TYPE_OP:  printf("%s", op2str(tokens -> value.op)); break;
-            case TYPE_NUM: printf("%lg", tokens -> value.dbl); break;
-            case TYPE_VAR: printf("%s", tokens -> value.var); break;
-            case TYPE_BLOCK:  printf("%i", tokens -> value.op); break;
-            case TYPE_BRACKET:  printf("%i", tokens -> value.op); break;
-            default: break;
+    if (tiles -> capacity < required) {
+        tiles -> capacity = (required > tiles -> capacity * 2)? required : tiles -> capacity * 2;
+        tiles -> lexer.tokens = (Token *) realloc(tiles -> lexer.tokens, tiles -> capacity * sizeof(Token));
+    }
+
+    lex_symbols(&tiles -> lexer, tile, 0, tile -> size - 1);
+}
+
+
+void finish_token(Lexer *lexer) {
+    if (lexer -> state == LEX_FRACTION) {
+        assert(lexer -> point > 1 && "No number after dot!");
+
+        lexer -> number /= (double) lexer -> point;
+    }
+
+    if (lexer -> state == LEX_NUMBER || lexer -> state == LEX_FRACTION) {
+        if (lexer -> number_count == lexer -> number_capacity) {
+            lexer -> number_capacity = (lexer -> number_capacity)? lexer -> number_capacity * 2 : 256;
+            lexer -> numbers = (double *) realloc(lexer -> numbers, (size_t) lexer -> number_capacity * sizeof(double));
         }
 
-        putchar('\n');
+        lexer -> token.value = (unsigned int) lexer -> number_count;
+        lexer -> numbers[lexer -> number_count++] = lexer -> number;
+    }
+
+    if (lexer -> state == LEX_IDENT && lexer -> defer_idents) {
+        if (lexer -> ident_count == lexer -> ident_capacity) {
+            lexer -> ident_capacity = (lexer -> ident_capacity)? lexer -> ident_capacity * 2 : 64;
+            lexer -> idents = (IdentKey *) realloc(lexer -> idents, (size_t) lexer -> ident_capacity * sizeof(IdentKey));
+        }
+
+        IdentKey *ident = lexer -> idents + lexer -> ident_count;
+
+        memcpy(ident -> key, lexer -> ident, (size_t) lexer -> offset);
+        ident -> size = lexer -> offset;
+
+        lexer -> token.value = (unsigned int) lexer -> ident_count++;
+    }
+    else if (lexer -> state == LEX_IDENT) {
+        lexer -> token.value = (unsigned int) intern_ident(lexer -> ident, lexer -> offset);
+    }
+
+    lexer -> tokens[lexer -> size++] = lexer -> token;
+
+    lexer -> token = {};
+    lexer -> number = 0;
+    lexer -> state = LEX_SPACE;
+}
+
+
+void start_ident(Lexer *lexer, unsigned int shape, const Pixel *color) {
+    lexer -> token.type = TYPE_VAR;
+
+    // Name is made from key only when program is written
+    lexer -> ident[0] = color -> r;
+    lexer -> ident[1] = color -> g;
+    lexer -> ident[2] = color -> b;
+    lexer -> offset = 3;
+
+    add_ident_shape(lexer, shape);
+
+    lexer -> state = LEX_IDENT;
+}
+
+
+void add_ident_shape(Lexer *lexer, unsigned int shape) {
+    assert(lexer -> offset + (int) sizeof(shape) <= IDENT_KEY_SIZE && "Variable name is too large!");
+
+    memcpy(lexer -> ident + lexer -> offset, &shape, sizeof(shape));
+    lexer -> offset += (int) sizeof(shape);
+}
+
+
+inline const ShapeClass *get_shape_class(unsigned int shape) {
+    const ShapeClass *shape_class = SHAPE_TABLE.slots + get_shape_hash(shape, SHAPE_HASH_MULTIPLIER);
+
+    return (shape_class -> shape == shape)? shape_class : &IDENT_CLASS;
+}
+
+
+void lex_symbol(Lexer *lexer, unsigned int shape, const Pixel *color) {
+    assert(lexer && "Can't work with null lexer!");
+    assert(color && "Can't work with null color!");
+
+    shape &= SHAPE_BTIMASK;
+
+    // Stray pixels turn reserved shape into identificator, so it's replaced with the nearest one
+    if (lexer -> tolerance && shape && shape != TERMINATOR) shape = get_nearest_shape(shape, lexer -> tolerance);
+
+    const ShapeClass *shape_class = get_shape_class(shape);
+
+    switch (lexer -> state) {
+        case LEX_NUMBER: {
+            if (shape_class -> kind == SHAPE_KIND_DIGIT) {
+                lexer -> number = lexer -> number * 10 + shape_class -> value;
+                return;
+            }
+
+            if (shape_class -> kind == SHAPE_KIND_DOT) {
+                lexer -> state = LEX_FRACTION;
+                return;
+            }
+
+            finish_token(lexer);
+            break;
+        }
+        case LEX_FRACTION: {
+            if (shape_class -> kind == SHAPE_KIND_DIGIT) {
+                lexer -> number = lexer -> number * 10 + shape_class -> value;
+                lexer -> point *= 10;
+                return;
+            }
+
+            finish_token(lexer);
+            break;
+        }
+        case LEX_IDENT: {
+            if (shape && !shape_class -> reserved) {
+                add_ident_shape(lexer, shape);
+                return;
+            }
+
+            finish_token(lexer);
+            break;
+        }
+        case LEX_COMMENT: {
+            if (shape_class -> kind == SHAPE_KIND_COMMENT) lexer -> state = LEX_SPACE;
+
+            if (shape_class -> kind != SHAPE_KIND_END) return;
+
+            break;
+        }
+        case LEX_END: return;
+        case LEX_SPACE: break;
+        default: assert(0 && "Unknown lexer state!");
     }
+
+    if (!shape) return;
+
+    Token *token = lexer -> tokens + lexer -> size;
+
+    *token = {};
+
+    switch (shape_class -> kind) {
+        case SHAPE_KIND_TOKEN: token -> type = shape_class -> type; token -> op = shape_class -> value; break;
+
+        case SHAPE_KIND_DOT: assert(0 && "Single dot!");
+
+        case SHAPE_KIND_COMMENT: lexer -> state = LEX_COMMENT; return;
+
+        case SHAPE_KIND_END: token -> type = TYPE_ESC; lexer -> state = LEX_END; break; // Escape token
+
+        case SHAPE_KIND_DIGIT: {
+            lexer -> token.type = TYPE_NUM;
+            lexer -> number = shape_class -> value;
+            lexer -> point = 1;
+            lexer -> state = LEX_NUMBER;
+            return;
+        }
+
+        case SHAPE_KIND_IDENT: start_ident(lexer, shape, color); return;
+
+        default: assert(0 && "Unknown shape kind!");
+    }
+
+    lexer -> size++;
+}
+
+
+unsigned int scan_reserved_shapes(unsigned int shape, int tolerance) {
+    unsigned int nearest = shape;
+    int best = tolerance + 1, count = 0;
+
+    for (int i = 0; i < RESERVED_SHAPE_COUNT; i++) {
+        int distance = __builtin_popcount(shape ^ RESERVED_SHAPE_LIST[i]);
+
+        if (distance < best) {
+            best = distance;
+            nearest = RESERVED_SHAPE_LIST[i];
+            count = 1;
+        }
+        else if (distance == best) {
+            count++;
+        }
+    }
+
+    // Shape in the middle of two reserved shapes is left as is
+    return (count == 1)? nearest : shape;
 }
 
 
-void free_tokens(Node *tokens) {
-    for(int i = 0; tokens[i].type != TYPE_ESC; i++)
-        if (tokens[i].type == TYPE_VAR) free(tokens[i].value.var);
-    
-    free(tokens);
+unsigned int get_nearest_shape_scalar(unsigned int shape, int tolerance) {
+    return scan_reserved_shapes(shape, tolerance);
+}
+
+
+#ifdef SYMBOL_PARSER_X86
+
+__attribute__((target("popcnt")))
+unsigned int get_nearest_shape_popcnt(unsigned int shape, int tolerance) {
+    return scan_reserved_shapes(shape, tolerance);
+}
+
+#endif
+
+
+NearestShapeKernel select_nearest_shape_kernel() {
+    #ifdef SYMBOL_PARSER_X86
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("popcnt")) return &get_nearest_shape_popcnt;
+    #endif
+
+    return &get_nearest_shape_scalar;
+}
+
+
+unsigned int get_nearest_shape(unsigned int shape, int tolerance) {
+    static const NearestShapeKernel KERNEL = select_nearest_shape_kernel();
+
+    if (tolerance <= 0 || is_reserved_shape(shape)) return shape;
+
+    return (*KERNEL)(shape, tolerance);
+}
+
+
+int to_digit(unsigned int shape) {
+    const ShapeClass *shape_class = get_shape_class(shape & SHAPE_BTIMASK);
+
+    return (shape_class -> kind == SHAPE_KIND_DIGIT)? shape_class -> value : -1;
+}
+
+
+int is_reserved_shape(unsigned int shape) {
+    return get_shape_class(shape & SHAPE_BTIMASK) -> reserved;
+}
+
+
+void print_tokens(const TokenStream *tokens) {
+    for(const Token *token = tokens -> tokens; token -> type != TYPE_ESC; token++) {
+        printf("Type: %i ", token -> type);
+
+        switch (token -> type) {
+            case TYPE_OP:  printf("%s", op2str(token -> op)); break;
+            case TYPE_NUM: printf("%lg", tokens -> numbers[token -> value]); break;
+            case TYPE_VAR: printf("%s", get_ident_name((int) token -> value)); break;
+            case TYPE_BLOCK:  printf("%i", token -> op); break;
+            case TYPE_BRACKET:  printf("%i", token -> op); break;
+            default: break;
+        }
+
+        putchar('\n');
+    }
 }
 
 
@@ -354,19 +899,19 @@ void draw_new_function(const Node *node, Symbol **s, int shift) {
     **s = {GREEN_PIXEL, SHAPE_DEF, 0, 0};
     next(s);
 
-    draw_ident(node -> value.var, s);
+    draw_ident(get_ident_name(node -> value.id), s);
 
     **s = {GREEN_PIXEL, SHAPE_BRACKET_BEGIN, 0, 0};
     next(s);
 
     if (node -> left) {
-        draw_ident(node -> left -> value.var, s);
+        draw_ident(get_ident_name(node -> left -> value.id), s);
 
         for (const Node *arg = node -> left -> right; arg; arg = arg -> right) {
             **s = {GREEN_PIXEL, SHAPE_CONT, 0, 0};
             next(s);
 
-            draw_ident(arg -> value.var, s);
+            draw_ident(get_ident_name(arg -> value.id), s);
         }
     }
 
@@ -391,7 +936,7 @@ void draw_expression(const Node *node, Symbol **s) {
             break;
         }
         case TYPE_VAR: {
-            draw_ident(node -> value.var, s);
+            draw_ident(get_ident_name(node -> value.id), s);
 
             break;
         }
@@ -431,7 +976,7 @@ void draw_expression(const Node *node, Symbol **s) {
 
 
 void draw_assign(const Node *node, Symbol **s) {
-    draw_ident(node -> left -> value.var, s);
+    draw_ident(get_ident_name(node -> left -> value.id), s);
 
     **s = {GREEN_PIXEL, SHAPE_ASS, 0, 0};
     next(s);
@@ -503,7 +1048,7 @@ void draw_while(const Node *node, Symbol **s, int shift) {
 
 
 void draw_function_call(const Node *node, Symbol **s) {
-    draw_ident(node -> value.var, s);
+    draw_ident(get_ident_name(node -> value.id), s);
 
     **s = {GREEN_PIXEL, SHAPE_BRACKET_BEGIN, 0, 0};
     next(s);
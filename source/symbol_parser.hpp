@@ -5,6 +5,78 @@ const unsigned int SHAPE_BTIMASK = 0x01FFFFFF;
 #include "reserved_shapes.hpp"
 
 
+/// Lexer states
+typedef enum {
+    LEX_SPACE,                  ///< Waits for the next lexem
+    LEX_NUMBER,                 ///< Reads integer part of number
+    LEX_FRACTION,               ///< Reads fractional part of number
+    LEX_IDENT,                  ///< Reads identificator
+    LEX_COMMENT,                ///< Skips comment
+    LEX_END,                    ///< TERMINATOR was found
+} LEXER_STATES;
+
+
+/// Packed lexem
+typedef struct {
+    unsigned char type = 0;     ///< Lexem type from #NODE_TYPES
+    unsigned char op = 0;       ///< Operator or bracket value
+    unsigned int value = 0;     ///< Identificator index or index of number in number table
+} Token;
+
+
+/// Lexems of the whole program
+typedef struct {
+    Token *tokens = nullptr;    ///< Lexems ending with escape one
+    int size = 0;               ///< Amount of lexems
+    double *numbers = nullptr;  ///< Values of number lexems
+    int number_count = 0;       ///< Amount of numbers
+} TokenStream;
+
+
+/// Key of identificator that is interned after lexing
+typedef struct {
+    unsigned char key[IDENT_KEY_SIZE] = {};     ///< Color and shapes of identificator
+    int size = 0;                               ///< Size of key
+} IdentKey;
+
+
+/// Contains lexer state between symbols, so symbols can be given one by one
+typedef struct {
+    int state = LEX_SPACE;      ///< Current state from #LEXER_STATES
+    Token token = {};           ///< Number or identificator that is being read
+    double number = 0;          ///< Value of number that is being read
+    unsigned char ident[IDENT_KEY_SIZE] = {};   ///< Key of identificator that is being read
+    int offset = 0;             ///< Size of identificator key
+    int point = 1;              ///< Divider for fractional part of number
+    Token *tokens = nullptr;    ///< Array to write lexems to
+    int size = 0;               ///< Amount of lexems in array
+    double *numbers = nullptr;  ///< Array to write values of numbers to
+    int number_count = 0;       ///< Amount of numbers in array
+    int number_capacity = 0;    ///< Size of numbers array, it grows if lexer runs out of it
+    IdentKey *idents = nullptr; ///< Keys of identificators if lexer doesn't intern them itself
+    int ident_count = 0;        ///< Amount of keys in array
+    int ident_capacity = 0;     ///< Size of keys array, it grows if lexer runs out of it
+    int defer_idents = 0;       ///< Non zero value means that identificators get indices of their keys instead of interned ones
+    int tolerance = 0;          ///< Max amount of wrong pixels in reserved shape, zero means exact match
+} Lexer;
+
+
+/// Max amount of lexems that one symbol can finish
+const int LEX_SYMBOL_TOKENS = 2;
+
+
+/// Amount of lexems in one chunk of lexems stream
+const int TOKEN_CHUNK_SIZE = 1024;
+
+
+/// Part of lexems stream that is given from lexer to parser
+typedef struct {
+    int size = 0;                               ///< Amount of lexems in chunk
+    Token tokens[TOKEN_CHUNK_SIZE] = {};        ///< Lexems
+    double numbers[TOKEN_CHUNK_SIZE] = {};      ///< Values of number lexems of this chunk
+} TokenChunk;
+
+
 /**
  * \brief Converts shape to digit
  * \param [in] shape To convert
@@ -13,6 +85,15 @@ const unsigned int SHAPE_BTIMASK = 0x01FFFFFF;
 int to_digit(unsigned int shape);
 
 
+/**
+ * \brief Finds reserved shape that differs from shape in the least amount of pixels
+ * \param [in] shape     To match
+ * \param [in] tolerance Max amount of different pixels
+ * \return Nearest reserved shape or shape itself if there is no such or there are two nearest
+*/
+unsigned int get_nearest_shape(unsigned int shape, int tolerance);
+
+
 /**
  * \brief Checks if shape is in list of reserved shapes
  * \param [in] shape To check
@@ -23,26 +104,49 @@ int is_reserved_shape(unsigned int shape);
 
 /**
  * \brief Parses symbols to lexems
- * \param [in] symbols      To parse
- * \param [in] symbols_size Symbols array size
- * \param [in] tokens_size  Size of token array
- * \return Array of lexems
+ * \param [in] symbols   To parse
+ * \param [in] tolerance Max amount of wrong pixels in reserved shape
+ * \param [in] jobs      Amount of threads to lex parts of symbols with
+ * \return Lexems of the program
+ * \note Lexems are the same for any amount of jobs
+*/
+TokenStream parse_symbols(const SymbolBuffer *symbols, int tolerance = 0, int jobs = 1);
+
+
+/**
+ * \brief Reads image by tiles and parses their symbols to lexems, so the whole image is never in memory
+ * \param [in] filename  Path to file
+ * \param [in] tile_rows Amount of symbol rows in one tile
+ * \param [in] jobs      Amount of threads to parse symbol rows of tile with
+ * \param [in] tolerance Max amount of wrong pixels in reserved shape
+ * \param [in] scale     Integer scale of upscaled image, zero means that it is detected
+ * \return Lexems of the program, array of lexems is null if image format can't be read by tiles
+*/
+TokenStream parse_symbol_tiles(const char *filename, int tile_rows, int jobs, int tolerance = 0, int scale = 0);
+
+
+/**
+ * \brief Gives next symbol to lexer
+ * \param [in] lexer Lexer state
+ * \param [in] shape Symbol shape
+ * \param [in] color Symbol color
+ * \note Lexer's array must have at least LEX_SYMBOL_TOKENS free lexems
 */
-Node *parse_symbols(const Symbol *symbols, int symbols_size, int *tokens_size);
+void lex_symbol(Lexer *lexer, unsigned int shape, const Pixel *color);
 
 
 /**
  * \brief Prints tokens type and value
  * \param [in] tokens To print
 */
-void print_tokens(const Node *tokens);
+void print_tokens(const TokenStream *tokens);
 
 
 /**
- * \brief Free tokens array and char * type values
+ * \brief Frees lexems and numbers
  * \param [in] tokens To free
 */
-void free_tokens(Node *tokens);
+void free_token_stream(TokenStream *tokens);
 
 
 int draw_program(const Tree *tree, Symbol *symbols);
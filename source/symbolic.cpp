@@ -0,0 +1,600 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+#include "libs/tree.hpp"
+#include "libs/ident.hpp"
+#include "dif.hpp"
+#include "canon.hpp"
+#include "symbolic.hpp"
+
+
+/// Initial amount of cells in table of compiled nodes
+const size_t SYMBOL_TABLE_SIZE = 64;
+
+
+/// Initial size of instructions array
+const int SYMBOL_CODE_SIZE = 64;
+
+
+
+/// Open addressing table that counts how many times every node of DAG is used
+typedef struct {
+    const Node **keys = nullptr;        ///< Counted nodes or nullptr for empty cells
+    int *uses = nullptr;                ///< Amount of parents that use node
+    int *slots = nullptr;               ///< Index of slot with node value or -1 if it is not evaluated yet
+    size_t size = 0;                    ///< Amount of nodes
+    size_t capacity = 0;                ///< Amount of cells, power of two
+} SymbolNodes;
+
+
+/// State of expression compiler
+typedef struct {
+    SymbolProgram *program = nullptr;   ///< Program that is being compiled
+    SymbolNodes nodes = {};             ///< Uses of DAG nodes
+    int *vars = nullptr;                ///< Identificators of variables in order of point arrays
+    int depth = 0;                      ///< Current amount of values on stack
+} SymbolCompiler;
+
+
+
+
+/**
+ * \brief Parses sum of products
+ * \param [in] s Pointer to the current symbol
+ * \return Expression or nullptr in case of syntax error
+*/
+Node *get_symbolic_sum(const char **s);
+
+
+/**
+ * \brief Parses product of factors
+ * \param [in] s Pointer to the current symbol
+ * \return Expression or nullptr in case of syntax error
+*/
+Node *get_symbolic_product(const char **s);
+
+
+/**
+ * \brief Parses number, variable, bracket expression or negated factor
+ * \param [in] s Pointer to the current symbol
+ * \return Expression or nullptr in case of syntax error
+*/
+Node *get_symbolic_factor(const char **s);
+
+
+/// Skips spaces
+void skip_symbolic_spaces(const char **s);
+
+
+/**
+ * \brief Finds cell of node in table
+ * \param [in] nodes Table with at least one empty cell
+ * \param [in] node  Node to find
+ * \return Index of cell with node or of empty cell where node should be added
+*/
+size_t find_symbol_node(const SymbolNodes *nodes, const Node *node);
+
+
+/**
+ * \brief Counts uses of nodes, children of every node are counted once
+ * \param [in] compiler Compiler state
+ * \param [in] node     Node that is used one more time
+ * \return Non zero value means error
+*/
+int count_symbol_uses(SymbolCompiler *compiler, const Node *node);
+
+
+/**
+ * \brief Adds instructions that evaluate node to program
+ * \param [in] compiler Compiler state
+ * \param [in] node     Node to compile
+ * \return Non zero value means that node can't be compiled
+*/
+int compile_symbol_node(SymbolCompiler *compiler, const Node *node);
+
+
+/**
+ * \brief Adds instruction to program
+ * \param [in] compiler Compiler state
+ * \param [in] code     Instruction code
+ * \param [in] arg      Index of variable or slot
+ * \param [in] num      Value of constant
+ * \param [in] change   Change of stack size after instruction
+ * \return Non zero value means error
+*/
+int add_symbol_instruction(SymbolCompiler *compiler, int code, int arg, double num, int change);
+
+
+/**
+ * \brief Runs program over one batch of points
+ * \param [in]  program Compiled program
+ * \param [in]  points  Arrays of variable values shifted to the batch start
+ * \param [out] results Values of batch points
+ * \param [in]  count   Amount of points in batch
+ * \param [in]  stack   Buffers for stack values, #SYMBOL_BATCH values for every stack position
+ * \param [in]  slots   Buffers for shared values, #SYMBOL_BATCH values for every slot
+ * \param [in]  values  Array of pointers to the current stack values
+*/
+void eval_symbol_batch(const SymbolProgram *program, const double *const *points, double *results, int count,
+                       double *stack, double *slots, const double **values);
+
+
+
+
+Node *parse_symbolic(SymbolContext *context, const char *text) {
+    assert(context && "Can't parse to null context!");
+    assert(text && "Can't parse null string!");
+
+    NodeArena *previous = set_node_arena(&context -> arena);
+
+    Node *value = get_symbolic_sum(&text);
+
+    skip_symbolic_spaces(&text);
+
+    set_node_arena(previous);
+
+    return (*text)? nullptr : value;
+}
+
+
+Node *get_symbolic_sum(const char **s) {
+    Node *value = get_symbolic_product(s);
+
+    skip_symbolic_spaces(s);
+
+    while (value && (**s == '+' || **s == '-')) {
+        int op = (**s == '+')? OP_ADD : OP_SUB;
+        (*s)++;
+
+        Node *right = get_symbolic_product(s);
+        if (!right) return nullptr;
+
+        value = create_node(TYPE_OP, {op}, value, right);
+
+        skip_symbolic_spaces(s);
+    }
+
+    return value;
+}
+
+
+Node *get_symbolic_product(const char **s) {
+    Node *value = get_symbolic_factor(s);
+
+    skip_symbolic_spaces(s);
+
+    while (value && (**s == '*' || **s == '/')) {
+        int op = (**s == '*')? OP_MUL : OP_DIV;
+        (*s)++;
+
+        Node *right = get_symbolic_factor(s);
+        if (!right) return nullptr;
+
+        value = create_node(TYPE_OP, {op}, value, right);
+
+        skip_symbolic_spaces(s);
+    }
+
+    return value;
+}
+
+
+Node *get_symbolic_factor(const char **s) {
+    skip_symbolic_spaces(s);
+
+    if (**s == '(') {
+        (*s)++;
+
+        Node *value = get_symbolic_sum(s);
+
+        skip_symbolic_spaces(s);
+
+        if (!value || **s != ')') return nullptr;
+        (*s)++;
+
+        return value;
+    }
+
+    if (**s == '-') {
+        (*s)++;
+
+        Node *value = get_symbolic_factor(s);
+        if (!value) return nullptr;
+
+        Node *zero = create_node(TYPE_NUM, {0});
+        zero -> value.dbl = 0;
+
+        return create_node(TYPE_OP, {OP_SUB}, zero, value);
+    }
+
+    if (isdigit((unsigned char) **s) || **s == '.') {
+        char *end = nullptr;
+        double num = strtod(*s, &end);
+
+        if (end == *s) return nullptr;
+        *s = end;
+
+        Node *value = create_node(TYPE_NUM, {0});
+        value -> value.dbl = num;
+
+        return value;
+    }
+
+    if (isalpha((unsigned char) **s) || **s == '_') {
+        char name[256] = "";
+        int size = 0;
+
+        for (; isalnum((unsigned char) (*s)[size]) || (*s)[size] == '_'; size++)
+            if (size + 1 == (int) sizeof(name)) return nullptr;
+
+        memcpy(name, *s, (size_t) size);
+        *s += size;
+
+        return create_node(TYPE_VAR, {intern_ident_name(name)});
+    }
+
+    return nullptr;
+}
+
+
+void skip_symbolic_spaces(const char **s) {
+    while (isspace((unsigned char) **s)) (*s)++;
+}
+
+
+Node *create_symbolic_var(SymbolContext *context, const char *name) {
+    assert(context && "Can't create variable in null context!");
+    assert(name && "Variable name is null!");
+
+    NodeArena *previous = set_node_arena(&context -> arena);
+
+    Node *value = create_node(TYPE_VAR, {intern_ident_name(name)});
+
+    set_node_arena(previous);
+
+    return value;
+}
+
+
+Node *create_symbolic_num(SymbolContext *context, double num) {
+    assert(context && "Can't create number in null context!");
+
+    NodeValue value = {0};
+    value.dbl = num;
+
+    NodeArena *previous = set_node_arena(&context -> arena);
+
+    Node *node = create_node(TYPE_NUM, value);
+
+    set_node_arena(previous);
+
+    return node;
+}
+
+
+Node *create_symbolic_op(SymbolContext *context, int op, Node *left, Node *right) {
+    assert(context && "Can't create operator in null context!");
+    assert((op == OP_ADD || op == OP_SUB || op == OP_MUL || op == OP_DIV) && "Operator is not arithmetic!");
+    assert(left && right && "Operand is null!");
+
+    NodeArena *previous = set_node_arena(&context -> arena);
+
+    Node *node = create_node(TYPE_OP, {op}, left, right);
+
+    set_node_arena(previous);
+
+    return node;
+}
+
+
+Node *diff_symbolic(SymbolContext *context, const Node *expression, const char *var) {
+    assert(context && "Can't differentiate to null context!");
+    assert(expression && "Can't differentiate null expression!");
+    assert(var && "Variable name is null!");
+
+    NodeArena *previous = set_node_arena(&context -> arena);
+
+    Node *result = diff(expression, intern_ident_name(var));
+
+    set_node_arena(previous);
+
+    return result;
+}
+
+
+Node *simplify_symbolic(SymbolContext *context, Node *expression) {
+    assert(context && "Can't simplify in null context!");
+    assert(expression && "Can't simplify null expression!");
+
+    // New nodes are linked to old ones, so they must live as long as expression
+    NodeArena *previous = set_node_arena(&context -> arena);
+
+    optimize(expression);
+
+    // Shared nodes stay shared, and equal canonical subexpressions of different nodes are merged after that
+    canonize(expression, 1);
+
+    Node *result = share_expression(expression);
+
+    set_node_arena(previous);
+
+    return result;
+}
+
+
+void free_symbol_context(SymbolContext *context) {
+    assert(context && "Can't free null context!");
+
+    free_node_arena(&context -> arena);
+}
+
+
+int compile_symbolic(SymbolProgram *program, const Node *expression, const char *const *vars, int var_count) {
+    assert(program && "Can't compile to null program!");
+    assert(expression && "Can't compile null expression!");
+    assert((vars || var_count == 0) && "Variable names are null!");
+
+    *program = {};
+    program -> var_count = var_count;
+
+    SymbolCompiler compiler = {};
+    compiler.program = program;
+
+    compiler.vars = (int *) calloc((size_t) var_count + 1, sizeof(int));
+    if (!compiler.vars) return ALLOC_FAIL;
+
+    for (int i = 0; i < var_count; i++) compiler.vars[i] = intern_ident_name(vars[i]);
+
+    int error = count_symbol_uses(&compiler, expression);
+
+    if (!error) {
+        for (size_t i = 0; i < compiler.nodes.capacity; i++) compiler.nodes.slots[i] = -1;
+
+        error = compile_symbol_node(&compiler, expression);
+    }
+
+    free(compiler.vars);
+    free(compiler.nodes.keys);
+    free(compiler.nodes.uses);
+    free(compiler.nodes.slots);
+
+    if (error) free_symbolic_program(program);
+
+    return error;
+}
+
+
+size_t find_symbol_node(const SymbolNodes *nodes, const Node *node) {
+    size_t cell = ((size_t) node >> 4) & (nodes -> capacity - 1);
+
+    while (nodes -> keys[cell] && nodes -> keys[cell] != node) cell = (cell + 1) & (nodes -> capacity - 1);
+
+    return cell;
+}
+
+
+int count_symbol_uses(SymbolCompiler *compiler, const Node *node) {
+    SymbolNodes *nodes = &compiler -> nodes;
+
+    if (2 * (nodes -> size + 1) > nodes -> capacity) {
+        SymbolNodes old = *nodes;
+
+        nodes -> capacity = (old.capacity)? 2 * old.capacity : SYMBOL_TABLE_SIZE;
+        nodes -> keys = (const Node **) calloc(nodes -> capacity, sizeof(const Node *));
+        nodes -> uses = (int *) calloc(nodes -> capacity, sizeof(int));
+        nodes -> slots = (int *) calloc(nodes -> capacity, sizeof(int));
+
+        if (!nodes -> keys || !nodes -> uses || !nodes -> slots) {
+            free(old.keys);
+            free(old.uses);
+            free(old.slots);
+            return ALLOC_FAIL;
+        }
+
+        for (size_t i = 0; i < old.capacity; i++) {
+            if (!old.keys[i]) continue;
+
+            size_t cell = find_symbol_node(nodes, old.keys[i]);
+
+            nodes -> keys[cell] = old.keys[i];
+            nodes -> uses[cell] = old.uses[i];
+        }
+
+        free(old.keys);
+        free(old.uses);
+        free(old.slots);
+    }
+
+    size_t cell = find_symbol_node(nodes, node);
+
+    if (nodes -> keys[cell]) {
+        nodes -> uses[cell]++;
+        return 0;
+    }
+
+    nodes -> keys[cell] = node;
+    nodes -> uses[cell] = 1;
+    nodes -> size++;
+
+    if (node -> type != TYPE_OP) return 0;
+
+    if (!node -> left || !node -> right) return INVALID_ARG;
+
+    int error = count_symbol_uses(compiler, node -> left);
+
+    return (error)? error : count_symbol_uses(compiler, node -> right);
+}
+
+
+int compile_symbol_node(SymbolCompiler *compiler, const Node *node) {
+    size_t cell = find_symbol_node(&compiler -> nodes, node);
+
+    int *slot = &compiler -> nodes.slots[cell];
+
+    if (*slot >= 0) return add_symbol_instruction(compiler, SYM_LOAD, *slot, 0, 1);
+
+    int error = 0;
+
+    switch (node -> type) {
+        case TYPE_NUM: error = add_symbol_instruction(compiler, SYM_NUM, 0, node -> value.dbl, 1); break;
+        case TYPE_VAR: {
+            int var = 0;
+
+            while (var < compiler -> program -> var_count && compiler -> vars[var] != node -> value.id) var++;
+
+            if (var == compiler -> program -> var_count) return INVALID_ARG;
+
+            error = add_symbol_instruction(compiler, SYM_VAR, var, 0, 1);
+
+            break;
+        }
+        case TYPE_OP: {
+            int code = 0;
+
+            switch (node -> value.op) {
+                case OP_ADD: code = SYM_ADD; break;
+                case OP_SUB: code = SYM_SUB; break;
+                case OP_MUL: code = SYM_MUL; break;
+                case OP_DIV: code = SYM_DIV; break;
+                default: return INVALID_ARG;
+            }
+
+            error = compile_symbol_node(compiler, node -> left);
+            if (!error) error = compile_symbol_node(compiler, node -> right);
+            if (!error) error = add_symbol_instruction(compiler, code, 0, 0, -1);
+
+            break;
+        }
+        default: return INVALID_ARG;
+    }
+
+    // Operations that are used more than once are saved to slots, leaves are cheaper to push again
+    if (!error && node -> type == TYPE_OP && compiler -> nodes.uses[cell] > 1) {
+        *slot = compiler -> program -> slot_count++;
+
+        error = add_symbol_instruction(compiler, SYM_STORE, *slot, 0, 0);
+    }
+
+    return error;
+}
+
+
+int add_symbol_instruction(SymbolCompiler *compiler, int code, int arg, double num, int change) {
+    SymbolProgram *program = compiler -> program;
+
+    if (program -> size == program -> capacity) {
+        int capacity = (program -> capacity)? 2 * program -> capacity : SYMBOL_CODE_SIZE;
+
+        SymbolInstruction *instructions = (SymbolInstruction *) realloc(program -> code, (size_t) capacity * sizeof(SymbolInstruction));
+        if (!instructions) return ALLOC_FAIL;
+
+        program -> code = instructions;
+        program -> capacity = capacity;
+    }
+
+    program -> code[program -> size++] = {code, arg, num};
+
+    compiler -> depth += change;
+
+    if (compiler -> depth > program -> stack_size) program -> stack_size = compiler -> depth;
+
+    return 0;
+}
+
+
+int eval_symbolic(const SymbolProgram *program, const double *const *points, double *results, size_t count) {
+    assert(program && "Can't evaluate null program!");
+    assert((points || program -> var_count == 0) && "Points are null!");
+    assert(results && "Can't write results to null array!");
+
+    if (!program -> code) return INVALID_ARG;
+
+    // Scratch buffers belong to call, so one program can be evaluated by several threads
+    double *stack = (double *) calloc((size_t) (program -> stack_size + program -> slot_count) * SYMBOL_BATCH, sizeof(double));
+    const double **values = (const double **) calloc((size_t) program -> stack_size, sizeof(const double *));
+    const double **batch = (const double **) calloc((size_t) program -> var_count + 1, sizeof(const double *));
+
+    if (!stack || !values || !batch) {
+        free(stack);
+        free(values);
+        free(batch);
+        return ALLOC_FAIL;
+    }
+
+    for (size_t start = 0; start < count; start += SYMBOL_BATCH) {
+        int size = (count - start < (size_t) SYMBOL_BATCH)? (int) (count - start) : SYMBOL_BATCH;
+
+        for (int i = 0; i < program -> var_count; i++) batch[i] = points[i] + start;
+
+        eval_symbol_batch(program, batch, results + start, size, stack,
+                          stack + (size_t) program -> stack_size * SYMBOL_BATCH, values);
+    }
+
+    free(stack);
+    free(values);
+    free(batch);
+
+    return 0;
+}
+
+
+void eval_symbol_batch(const SymbolProgram *program, const double *const *points, double *results, int count,
+                       double *stack, double *slots, const double **values) {
+    int top = 0;
+
+    // Values point to variable arrays and slots without copying, results of operations are written to stack buffers
+    for (int ip = 0; ip < program -> size; ip++) {
+        const SymbolInstruction *instruction = program -> code + ip;
+
+        switch (instruction -> code) {
+            case SYM_NUM: {
+                double *out = stack + (size_t) top * SYMBOL_BATCH;
+
+                for (int i = 0; i < count; i++) out[i] = instruction -> num;
+
+                values[top++] = out;
+                break;
+            }
+            case SYM_VAR:   values[top++] = points[instruction -> arg]; break;
+            case SYM_LOAD:  values[top++] = slots + (size_t) instruction -> arg * SYMBOL_BATCH; break;
+            case SYM_STORE: {
+                double *slot = slots + (size_t) instruction -> arg * SYMBOL_BATCH;
+
+                memcpy(slot, values[top - 1], (size_t) count * sizeof(double));
+
+                values[top - 1] = slot;
+                break;
+            }
+            case SYM_ADD: case SYM_SUB: case SYM_MUL: case SYM_DIV: {
+                const double *a = values[top - 2], *b = values[top - 1];
+
+                double *out = stack + (size_t) (top - 2) * SYMBOL_BATCH;
+
+                switch (instruction -> code) {
+                    case SYM_ADD: for (int i = 0; i < count; i++) out[i] = a[i] + b[i]; break;
+                    case SYM_SUB: for (int i = 0; i < count; i++) out[i] = a[i] - b[i]; break;
+                    case SYM_MUL: for (int i = 0; i < count; i++) out[i] = a[i] * b[i]; break;
+                    case SYM_DIV: for (int i = 0; i < count; i++) out[i] = a[i] / b[i]; break;
+                    default: break;
+                }
+
+                values[--top - 1] = out;
+                break;
+            }
+            default: break;
+        }
+    }
+
+    memcpy(results, values[0], (size_t) count * sizeof(double));
+}
+
+
+void free_symbolic_program(SymbolProgram *program) {
+    assert(program && "Can't free null program!");
+
+    free(program -> code);
+
+    *program = {};
+}
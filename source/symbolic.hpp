@@ -0,0 +1,145 @@
+/**
+ * \file
+ * \brief Symbolic math library header
+ * \note Expression nodes are taken from arena of symbol context and are freed with it by free_symbol_context,
+ * other contexts and trees are not touched. Compiled program does not keep nodes and can outlive them. Parsing, differentiation and
+ * compilation use common identificator table and must be called from one thread, evaluation can be run from many
+*/
+
+
+/// Amount of points that are evaluated by every instruction at once
+const int SYMBOL_BATCH = 256;
+
+
+/// Instructions of compiled expression
+typedef enum {
+    SYM_NUM,                    ///< Pushes constant
+    SYM_VAR,                    ///< Pushes variable
+    SYM_ADD,                    ///< Replaces two values with their sum
+    SYM_SUB,                    ///< Replaces two values with their difference
+    SYM_MUL,                    ///< Replaces two values with their product
+    SYM_DIV,                    ///< Replaces two values with their quotient
+    SYM_STORE,                  ///< Saves top value to slot without popping it
+    SYM_LOAD,                   ///< Pushes value of slot
+} SYMBOL_CODES;
+
+
+/// Owner of expression nodes, all its expressions are freed at once
+typedef struct {
+    NodeArena arena = {};               ///< Arena that nodes of context expressions are taken from
+} SymbolContext;
+
+
+/// One instruction of postfix program
+typedef struct {
+    int code = SYM_NUM;         ///< Instruction code from #SYMBOL_CODES
+    int arg = 0;                ///< Index of variable or slot
+    double num = 0;             ///< Value of constant
+} SymbolInstruction;
+
+
+/// Expression compiled to postfix program
+typedef struct {
+    SymbolInstruction *code = nullptr;  ///< Instructions
+    int size = 0;                       ///< Amount of instructions
+    int capacity = 0;                   ///< Size of instructions array
+    int var_count = 0;                  ///< Amount of variables that program takes
+    int stack_size = 0;                 ///< Max amount of values on stack
+    int slot_count = 0;                 ///< Amount of slots for shared subexpressions
+} SymbolProgram;
+
+
+
+
+/**
+ * \brief Parses infix expression with numbers, variables, four arithmetic operators and brackets
+ * \param [in] context Context that owns expression nodes
+ * \param [in] text    Expression like "x * (y - 2) / -z", variable names are kept as they are
+ * \return Expression tree or nullptr in case of syntax error
+*/
+Node *parse_symbolic(SymbolContext *context, const char *text);
+
+
+/**
+ * \brief Creates expression that uses variable
+ * \param [in] context Context that owns expression nodes
+ * \param [in] name    Variable name
+ * \return Variable node
+*/
+Node *create_symbolic_var(SymbolContext *context, const char *name);
+
+
+/**
+ * \brief Creates constant expression
+ * \param [in] context Context that owns expression nodes
+ * \param [in] num     Value of constant
+ * \return Number node
+*/
+Node *create_symbolic_num(SymbolContext *context, double num);
+
+
+/**
+ * \brief Creates arithmetic operation
+ * \param [in] context Context that owns expression nodes
+ * \param [in] op      OP_ADD, OP_SUB, OP_MUL or OP_DIV
+ * \param [in] left    Left operand
+ * \param [in] right   Right operand
+ * \return Operator node
+*/
+Node *create_symbolic_op(SymbolContext *context, int op, Node *left, Node *right);
+
+
+/**
+ * \brief Differentiates expression
+ * \param [in] context    Context that owns derivative nodes
+ * \param [in] expression Expression of any context
+ * \param [in] var        Name of variable to differentiate for
+ * \return Derivative DAG or nullptr if expression has nodes that can't be differentiated
+*/
+Node *diff_symbolic(SymbolContext *context, const Node *expression, const char *var);
+
+
+/**
+ * \brief Calculates constants, removes neutral elements and collects like terms, every shared node of DAG is simplified once
+ * \param [in] context    Context that owns expression
+ * \param [in] expression Expression to simplify in place
+ * \return Simplified DAG, its equal subexpressions are the same nodes
+*/
+Node *simplify_symbolic(SymbolContext *context, Node *expression);
+
+
+/**
+ * \brief Frees all expressions of context, it can be used again after that
+ * \param [in] context Context to free
+*/
+void free_symbol_context(SymbolContext *context);
+
+
+/**
+ * \brief Compiles expression to postfix program, shared subexpressions of DAG are evaluated once
+ * \param [out] program   Program to compile to
+ * \param [in]  expression Expression to compile
+ * \param [in]  vars       Names of variables in order of point arrays that program will be evaluated with
+ * \param [in]  var_count  Amount of variables
+ * \return Non zero value means that expression has unknown variable or node that can't be compiled
+*/
+int compile_symbolic(SymbolProgram *program, const Node *expression, const char *const *vars, int var_count);
+
+
+/**
+ * \brief Evaluates program for every point
+ * \param [in]  program Compiled program
+ * \param [in]  points  Arrays of variable values, points[i][j] is value of i-th variable in j-th point
+ * \param [out] results Array of values in every point
+ * \param [in]  count   Amount of points
+ * \return Non zero value means error
+ * \note Points are processed in batches of #SYMBOL_BATCH, every instruction runs over the whole batch
+*/
+int eval_symbolic(const SymbolProgram *program, const double *const *points, double *results, size_t count);
+
+
+/**
+ * \brief Frees program instructions
+ * \param [in] program Program to free
+*/
+void free_symbolic_program(SymbolProgram *program);
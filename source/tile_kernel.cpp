@@ -0,0 +1,548 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <immintrin.h>
+    #define TILE_KERNEL_X86
+#endif
+
+#include "image_parser.hpp"
+#include "tile_kernel.hpp"
+
+
+/// Row mask kernel function for one type of pixels
+typedef void (*RowMaskKernel)(const unsigned char *row, int width, RowMask *mask);
+
+
+/// Row mask downsampling kernel function
+typedef void (*DownsampleKernel)(const RowMask *mask, int width, int scale, RowMask *reduced);
+
+
+/// Instruction sets of kernels from the slowest to the fastest
+typedef enum {
+    KERNEL_SCALAR,                      ///< One pixel at a time
+    KERNEL_SSE2,                        ///< SSE2
+    KERNEL_AVX2,                        ///< AVX2 for row masks and BMI2 for downsampling
+} KERNEL_LEVELS;
+
+
+/// Row mask kernels for all supported types of pixels
+typedef struct {
+    RowMaskKernel rgba = nullptr;       ///< Kernel for 4 channels
+    RowMaskKernel rgb = nullptr;        ///< Kernel for 3 channels
+    const char *name = nullptr;         ///< Instruction set name
+} RowMaskKernels;
+
+
+/// Marks not white pixels from x to the end of the row one pixel at a time
+void get_row_mask_tail(const unsigned char *row, int x, int width, int comp, RowMask *mask);
+
+
+/// Marks not white RGBA pixels one at a time
+void get_row_mask_rgba_scalar(const unsigned char *row, int width, RowMask *mask);
+
+/// Marks not white RGB pixels one at a time
+void get_row_mask_rgb_scalar(const unsigned char *row, int width, RowMask *mask);
+
+
+#ifdef TILE_KERNEL_X86
+
+/// Marks not white RGBA pixels four at a time
+void get_row_mask_sse2(const unsigned char *row, int width, RowMask *mask);
+
+/// Marks not white RGBA pixels eight at a time
+void get_row_mask_avx2(const unsigned char *row, int width, RowMask *mask);
+
+/// Marks not white RGB pixels sixteen at a time
+void get_row_mask_rgb_sse2(const unsigned char *row, int width, RowMask *mask);
+
+/// Returns table that gathers every third bit of 12-bit number in 4-bit number
+const unsigned char *get_third_bits_table();
+
+/// Gathers pixels of power of two scale a word at a time
+void downsample_row_mask_bmi2(const RowMask *mask, int width, int scale, RowMask *reduced);
+
+#endif
+
+
+/// Gathers pixels one at a time
+void downsample_row_mask_scalar(const RowMask *mask, int width, int scale, RowMask *reduced);
+
+
+/// Chooses the fastest downsampling kernel supported by CPU that is not above level from #KERNEL_LEVELS
+DownsampleKernel select_downsample_kernel(int level);
+
+
+/// Gets shape of symbol which left column is offset from row masks of its five rows
+unsigned int get_mask_shape(const RowMask *masks, int mask_size, int offset);
+
+
+/// Chooses the fastest row mask kernels supported by CPU that are not above level from #KERNEL_LEVELS
+RowMaskKernels select_row_mask_kernels(int level);
+
+
+/**
+ * \brief Gets SYMBOL_SIZE bits from row mask
+ * \param [in] mask   Row mask
+ * \param [in] offset Index of the first bit
+ * \return Bits in the lowest positions
+*/
+unsigned int get_mask_bits(const RowMask *mask, int offset);
+
+
+/// Kernels used by get_row_mask, the fastest ones supported by CPU unless others are set
+RowMaskKernels row_mask_kernels = select_row_mask_kernels(KERNEL_AVX2);
+
+/// Kernel used by downsample_row_mask
+DownsampleKernel downsample_kernel = select_downsample_kernel(KERNEL_AVX2);
+
+
+
+
+int get_row_mask_size(int width) {
+    return (width + ROW_MASK_BITS - 1) / ROW_MASK_BITS + 1;
+}
+
+
+void get_row_mask_tail(const unsigned char *row, int x, int width, int comp, RowMask *mask) {
+    for (const unsigned char *pixel = row + x * comp; x < width; x++, pixel += comp) {
+        if (pixel[0] != 255 || pixel[1] != 255 || pixel[2] != 255)
+            mask[x / ROW_MASK_BITS] |= 1ull << (x % ROW_MASK_BITS);
+    }
+}
+
+
+void get_row_mask_scalar(const unsigned char *row, int width, int comp, RowMask *mask) {
+    assert(row && "Can't get mask of null row!");
+    assert(mask && "Can't write to null mask!");
+    assert((comp == 3 || comp == 4) && "Only RGB and RGBA rows are supported!");
+
+    memset(mask, 0, get_row_mask_size(width) * sizeof(RowMask));
+
+    get_row_mask_tail(row, 0, width, comp, mask);
+}
+
+
+void get_row_mask_rgba_scalar(const unsigned char *row, int width, RowMask *mask) {
+    get_row_mask_scalar(row, width, 4, mask);
+}
+
+
+void get_row_mask_rgb_scalar(const unsigned char *row, int width, RowMask *mask) {
+    get_row_mask_scalar(row, width, 3, mask);
+}
+
+
+#ifdef TILE_KERNEL_X86
+
+__attribute__((target("sse2")))
+void get_row_mask_sse2(const unsigned char *row, int width, RowMask *mask) {
+    assert(row && "Can't get mask of null row!");
+    assert(mask && "Can't write to null mask!");
+
+    memset(mask, 0, get_row_mask_size(width) * sizeof(RowMask));
+
+    const __m128i ALPHA = _mm_set1_epi32((int) 0xFF000000);
+    const __m128i WHITE = _mm_set1_epi32(-1);
+
+    int x = 0;
+
+    for (; x + 4 <= width; x += 4) {
+        __m128i pixels = _mm_loadu_si128((const __m128i *) (row + x * 4));
+        __m128i is_white = _mm_cmpeq_epi32(_mm_or_si128(pixels, ALPHA), WHITE);
+
+        RowMask bits = (RowMask) (~_mm_movemask_ps(_mm_castsi128_ps(is_white)) & 0xF);
+
+        mask[x / ROW_MASK_BITS] |= bits << (x % ROW_MASK_BITS);
+    }
+
+    get_row_mask_tail(row, x, width, 4, mask);
+}
+
+
+__attribute__((target("avx2")))
+void get_row_mask_avx2(const unsigned char *row, int width, RowMask *mask) {
+    assert(row && "Can't get mask of null row!");
+    assert(mask && "Can't write to null mask!");
+
+    memset(mask, 0, get_row_mask_size(width) * sizeof(RowMask));
+
+    const __m256i ALPHA = _mm256_set1_epi32((int) 0xFF000000);
+    const __m256i WHITE = _mm256_set1_epi32(-1);
+
+    int x = 0;
+
+    for (; x + 8 <= width; x += 8) {
+        __m256i pixels = _mm256_loadu_si256((const __m256i *) (row + x * 4));
+        __m256i is_white = _mm256_cmpeq_epi32(_mm256_or_si256(pixels, ALPHA), WHITE);
+
+        RowMask bits = (RowMask) (~_mm256_movemask_ps(_mm256_castsi256_ps(is_white)) & 0xFF);
+
+        mask[x / ROW_MASK_BITS] |= bits << (x % ROW_MASK_BITS);
+    }
+
+    get_row_mask_tail(row, x, width, 4, mask);
+}
+
+const unsigned char *get_third_bits_table() {
+    static unsigned char table[1 << 12] = {};
+
+    for (int value = 0; value < (1 << 12); value++)
+        for (int bit = 0; bit < 4; bit++)
+            table[value] = (unsigned char) (table[value] | ((value >> (3 * bit)) & 1) << bit);
+
+    return table;
+}
+
+
+__attribute__((target("sse2")))
+void get_row_mask_rgb_sse2(const unsigned char *row, int width, RowMask *mask) {
+    assert(row && "Can't get mask of null row!");
+    assert(mask && "Can't write to null mask!");
+
+    static const unsigned char *THIRD_BITS = get_third_bits_table();
+
+    memset(mask, 0, get_row_mask_size(width) * sizeof(RowMask));
+
+    const __m128i WHITE = _mm_set1_epi8(-1);
+
+    int x = 0;
+
+    for (; x + 16 <= width; x += 16) {
+        const unsigned char *bytes = row + x * 3;
+
+        // Bit for every white byte of sixteen pixels
+        RowMask white = 0;
+
+        for (int i = 0; i < 3; i++) {
+            __m128i is_white = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (bytes + 16 * i)), WHITE);
+
+            white |= (RowMask) _mm_movemask_epi8(is_white) << (16 * i);
+        }
+
+        // Bit 3 * i is set only if all channels of pixel i are white
+        white &= (white >> 1) & (white >> 2);
+
+        RowMask bits = 0;
+
+        for (int i = 0; i < 4; i++)
+            bits |= (RowMask) THIRD_BITS[(white >> (12 * i)) & 0xFFF] << (4 * i);
+
+        mask[x / ROW_MASK_BITS] |= (~bits & 0xFFFF) << (x % ROW_MASK_BITS);
+    }
+
+    get_row_mask_tail(row, x, width, 3, mask);
+}
+
+#endif
+
+
+RowMaskKernels select_row_mask_kernels(int level) {
+    #ifdef TILE_KERNEL_X86
+        __builtin_cpu_init();
+
+        if (level >= KERNEL_AVX2 && __builtin_cpu_supports("avx2")) return {&get_row_mask_avx2, &get_row_mask_rgb_sse2, "avx2"};
+        if (level >= KERNEL_SSE2 && __builtin_cpu_supports("sse2")) return {&get_row_mask_sse2, &get_row_mask_rgb_sse2, "sse2"};
+    #endif
+
+    return {&get_row_mask_rgba_scalar, &get_row_mask_rgb_scalar, "scalar"};
+}
+
+
+void downsample_row_mask_scalar(const RowMask *mask, int width, int scale, RowMask *reduced) {
+    memset(reduced, 0, get_row_mask_size(width) * sizeof(RowMask));
+
+    for (int x = 0, source = 0; x < width; x++, source += scale) {
+        if (mask[source / ROW_MASK_BITS] >> (source % ROW_MASK_BITS) & 1)
+            reduced[x / ROW_MASK_BITS] |= (RowMask) 1 << (x % ROW_MASK_BITS);
+    }
+}
+
+
+#ifdef TILE_KERNEL_X86
+
+__attribute__((target("bmi2")))
+void downsample_row_mask_bmi2(const RowMask *mask, int width, int scale, RowMask *reduced) {
+    if ((scale & (scale - 1)) || scale > ROW_MASK_BITS) {
+        downsample_row_mask_scalar(mask, width, scale, reduced);
+        return;
+    }
+
+    memset(reduced, 0, get_row_mask_size(width) * sizeof(RowMask));
+
+    // Every scale-th bit of the word is left top pixel of block
+    RowMask pattern = 0;
+
+    for (int bit = 0; bit < ROW_MASK_BITS; bit += scale)
+        pattern |= (RowMask) 1 << bit;
+
+    int per_word = ROW_MASK_BITS / scale, words = (width * scale + ROW_MASK_BITS - 1) / ROW_MASK_BITS;
+
+    for (int word = 0, x = 0; word < words; word++, x += per_word)
+        reduced[x / ROW_MASK_BITS] |= (RowMask) _pext_u64(mask[word], pattern) << (x % ROW_MASK_BITS);
+}
+
+#endif
+
+
+DownsampleKernel select_downsample_kernel(int level) {
+    #ifdef TILE_KERNEL_X86
+        __builtin_cpu_init();
+
+        if (level >= KERNEL_AVX2 && __builtin_cpu_supports("bmi2")) return &downsample_row_mask_bmi2;
+    #endif
+
+    return &downsample_row_mask_scalar;
+}
+
+
+void downsample_row_mask(const RowMask *mask, int width, int scale, RowMask *reduced) {
+    assert(mask && "Can't downsample null mask!");
+    assert(reduced && "Can't write to null mask!");
+    assert(scale > 0 && "Wrong scale!");
+
+    (*downsample_kernel)(mask, width, scale, reduced);
+}
+
+
+int get_gcd(int a, int b) {
+    while (b) {
+        int rest = a % b;
+        a = b;
+        b = rest;
+    }
+
+    return a;
+}
+
+
+int get_mask_scale(const RowMask *mask, const RowMask *prev, int width, int y, int scale) {
+    assert(mask && "Can't get scale of null mask!");
+
+    int mask_size = get_row_mask_size(width);
+
+    for (int word = 0; word < mask_size && scale > 1; word++) {
+        // Bit is set if pixel differs from its left neighbour
+        RowMask carry = (word > 0)? mask[word - 1] >> (ROW_MASK_BITS - 1) : 0;
+        RowMask edges = mask[word] ^ (mask[word] << 1 | carry);
+
+        for (; edges && scale > 1; edges &= edges - 1)
+            scale = get_gcd(scale, word * ROW_MASK_BITS + __builtin_ctzll(edges));
+
+        if (prev && prev[word] != mask[word]) scale = get_gcd(scale, y);
+    }
+
+    return scale;
+}
+
+
+void get_row_mask(const unsigned char *row, int width, int comp, RowMask *mask) {
+    assert((comp == 3 || comp == 4) && "Only RGB and RGBA rows are supported!");
+
+    (*((comp == 4)? row_mask_kernels.rgba : row_mask_kernels.rgb))(row, width, mask);
+}
+
+
+const char *get_row_mask_kernel() {
+    return row_mask_kernels.name;
+}
+
+
+int set_row_mask_kernel(const char *name) {
+    assert(name && "Kernel name is null!");
+
+    const char *const NAMES[] = {"scalar", "sse2", "avx2"};
+
+    for (int level = KERNEL_SCALAR; level <= KERNEL_AVX2; level++) {
+        if (strcmp(name, NAMES[level])) continue;
+
+        RowMaskKernels kernels = select_row_mask_kernels(level);
+
+        // CPU doesn't support instruction set
+        if (strcmp(kernels.name, name)) return 1;
+
+        row_mask_kernels = kernels;
+        downsample_kernel = select_downsample_kernel(level);
+
+        return 0;
+    }
+
+    return 1;
+}
+
+
+unsigned int get_mask_bits(const RowMask *mask, int offset) {
+    int word = offset / ROW_MASK_BITS, bit = offset % ROW_MASK_BITS;
+
+    RowMask value = mask[word] >> bit;
+
+    if (bit > ROW_MASK_BITS - SYMBOL_SIZE)
+        value |= mask[word + 1] << (ROW_MASK_BITS - bit);
+
+    return (unsigned int) (value & ((1u << SYMBOL_SIZE) - 1));
+}
+
+
+unsigned int get_mask_shape(const RowMask *masks, int mask_size, int offset) {
+    unsigned int shape = 0;
+
+    for (int row = 0; row < SYMBOL_SIZE; row++)
+        shape |= get_mask_bits(masks + row * mask_size, offset) << (row * SYMBOL_SIZE);
+
+    return shape;
+}
+
+
+void get_row_symbols(const unsigned char *data, int width, int comp, int scale, int y, const RowMask *masks, unsigned int *shapes, Pixel *colors, RowMask *occupancy) {
+    assert(data && "Can't get symbols from null data!");
+    assert(masks && "Can't get symbols without row masks!");
+    assert(shapes && "Can't write to null shapes!");
+    assert(colors && "Can't write to null colors!");
+    assert(occupancy && "Can't write to null occupancy!");
+
+    const int OFFSET = SYMBOL_SIZE + 1;
+
+    int mask_size = get_row_mask_size(width);
+
+    for (int i = 0; i < width / OFFSET; i++) {
+        unsigned int shape = get_mask_shape(masks, mask_size, i * OFFSET);
+
+        shapes[i] = shape;
+
+        if (shape) {
+            occupancy[i / ROW_MASK_BITS] |= (RowMask) 1 << (i % ROW_MASK_BITS);
+
+            // Last not white pixel in the symbol has the highest bit in the shape
+            int last = 31 - __builtin_clz(shape);
+
+            // Upscaled image has left top pixel of block at scaled coordinates
+            size_t row = (size_t) (y + last / SYMBOL_SIZE) * scale, column = (size_t) (i * OFFSET + last % SYMBOL_SIZE) * scale;
+
+            const unsigned char *pixel = data + (row * width * scale + column) * comp;
+
+            colors[i] = {pixel[0], pixel[1], pixel[2], (comp == 4)? pixel[3] : (unsigned char) 255};
+        }
+        else {
+            colors[i] = {};
+        }
+    }
+}
+
+
+void get_palette_lut(const Pixel *palette, int depth, PaletteLut *lut) {
+    assert(palette && "Can't build table for null palette!");
+    assert(lut && "Can't write to null table!");
+    assert((depth == 1 || depth == 2 || depth == 4 || depth == 8) && "Wrong bits per pixel!");
+
+    memcpy(lut -> colors, palette, sizeof(lut -> colors));
+
+    lut -> depth = depth;
+
+    int per_byte = 8 / depth;
+
+    for (int byte = 0; byte < 256; byte++) {
+        unsigned char packed = (unsigned char) byte, ink = 0;
+
+        for (int i = 0; i < per_byte; i++) {
+            if (!is_white(palette + get_packed_index(&packed, i, depth)))
+                ink = (unsigned char) (ink | 1 << i);
+        }
+
+        lut -> ink[byte] = ink;
+    }
+}
+
+
+int get_packed_index(const unsigned char *row, int x, int depth) {
+    int bit = x * depth;
+
+    // The leftmost pixel is stored in the most significant bits
+    return (row[bit / 8] >> (8 - depth - bit % 8)) & ((1 << depth) - 1);
+}
+
+
+void get_packed_row_mask(const unsigned char *row, int width, const PaletteLut *lut, RowMask *mask) {
+    assert(row && "Can't get mask of null row!");
+    assert(lut && "Can't get mask without palette table!");
+    assert(mask && "Can't write to null mask!");
+
+    memset(mask, 0, get_row_mask_size(width) * sizeof(RowMask));
+
+    int per_byte = 8 / lut -> depth;
+
+    // Pixels of one byte never cross mask word boundary
+    for (int i = 0, x = 0; x < width; i++, x += per_byte)
+        mask[x / ROW_MASK_BITS] |= (RowMask) lut -> ink[row[i]] << (x % ROW_MASK_BITS);
+
+    // Padding bits of the last byte aren't pixels
+    mask[width / ROW_MASK_BITS] &= ((RowMask) 1 << (width % ROW_MASK_BITS)) - 1;
+}
+
+
+void get_packed_row_symbols(const unsigned char *data, size_t row_size, int width, const PaletteLut *lut, int scale, int y, const RowMask *masks, unsigned int *shapes, Pixel *colors, RowMask *occupancy) {
+    assert(data && "Can't get symbols from null data!");
+    assert(lut && "Can't get symbols without palette table!");
+    assert(masks && "Can't get symbols without row masks!");
+    assert(shapes && "Can't write to null shapes!");
+    assert(colors && "Can't write to null colors!");
+    assert(occupancy && "Can't write to null occupancy!");
+
+    const int OFFSET = SYMBOL_SIZE + 1;
+
+    int mask_size = get_row_mask_size(width);
+
+    for (int i = 0; i < width / OFFSET; i++) {
+        unsigned int shape = get_mask_shape(masks, mask_size, i * OFFSET);
+
+        shapes[i] = shape;
+
+        if (shape) {
+            occupancy[i / ROW_MASK_BITS] |= (RowMask) 1 << (i % ROW_MASK_BITS);
+
+            int last = 31 - __builtin_clz(shape);
+
+            const unsigned char *row = data + (size_t) (y + last / SYMBOL_SIZE) * scale * row_size;
+
+            colors[i] = lut -> colors[get_packed_index(row, (i * OFFSET + last % SYMBOL_SIZE) * scale, lut -> depth)];
+        }
+        else {
+            colors[i] = {};
+        }
+    }
+}
+
+
+int is_blank_band(const RowMask *masks, int width) {
+    assert(masks && "Can't check null masks!");
+
+    int mask_size = get_row_mask_size(width);
+
+    RowMask ink = 0;
+
+    for (int row = 0; row < SYMBOL_SIZE; row++)
+        for (int word = 0; word < mask_size; word++)
+            ink |= masks[row * mask_size + word];
+
+    return ink == 0;
+}
+
+
+int find_next_bit(const RowMask *mask, int begin, int end) {
+    assert(mask && "Can't search in null mask!");
+
+    for (int word = begin / ROW_MASK_BITS; word * ROW_MASK_BITS < end; word++) {
+        RowMask bits = mask[word];
+
+        if (word == begin / ROW_MASK_BITS) bits &= ~(RowMask) 0 << (begin % ROW_MASK_BITS);
+
+        if (bits) {
+            int bit = word * ROW_MASK_BITS + __builtin_ctzll(bits);
+
+            return (bit < end)? bit : end;
+        }
+    }
+
+    return end;
+}
@@ -0,0 +1,168 @@
+/// Row mask word, each bit shows if pixel isn't white
+typedef unsigned long long RowMask;
+
+
+/// Amount of pixels in one row mask word
+const int ROW_MASK_BITS = 64;
+
+
+/// Contains whiteness and colors of palette entries for rows of packed indices
+typedef struct {
+    Pixel colors[256] = {};             ///< Color of every index
+    unsigned char ink[256] = {};        ///< Bit for every not white pixel of packed byte, the leftmost pixel is the lowest bit
+    int depth = 8;                      ///< Bits per pixel
+} PaletteLut;
+
+
+/**
+ * \brief Calculates row mask size in words
+ * \param [in] width Row width in pixels
+ * \return Words count including one padding word
+*/
+int get_row_mask_size(int width);
+
+
+/**
+ * \brief Marks not white pixels of the row one pixel at a time
+ * \param [in]  row   Pointer to the first pixel of the row
+ * \param [in]  width Row width in pixels
+ * \param [in]  comp  Amount of channels, 3 for RGB and 4 for RGBA
+ * \param [out] mask  Array of get_row_mask_size(width) words
+*/
+void get_row_mask_scalar(const unsigned char *row, int width, int comp, RowMask *mask);
+
+
+/**
+ * \brief Marks not white pixels of the row using the best kernel supported by CPU
+ * \param [in]  row   Pointer to the first pixel of the row
+ * \param [in]  width Row width in pixels
+ * \param [in]  comp  Amount of channels, 3 for RGB and 4 for RGBA
+ * \param [out] mask  Array of get_row_mask_size(width) words
+*/
+void get_row_mask(const unsigned char *row, int width, int comp, RowMask *mask);
+
+
+/**
+ * \brief Returns name of the kernel used by get_row_mask
+ * \return "avx2", "sse2" or "scalar"
+*/
+const char *get_row_mask_kernel();
+
+
+/**
+ * \brief Makes get_row_mask and downsample_row_mask use kernels of the instruction set instead of the fastest ones
+ * \param [in] name "avx2", "sse2" or "scalar", "avx2" also turns on BMI2 downsampling
+ * \return Non zero value means that name is wrong or CPU doesn't support the instruction set
+ * \note It is meant for tests, so it must not be called while rows are parsed
+*/
+int set_row_mask_kernel(const char *name);
+
+
+/**
+ * \brief Assembles shapes and colors for the whole row of symbols from row masks
+ * \param [in]  data   Raw RGB or RGBA image data
+ * \param [in]  width  Image width in pixels
+ * \param [in]  comp   Amount of channels, 3 for RGB and 4 for RGBA
+ * \param [in]  scale  Image scale, width and y are given for image downscaled by it
+ * \param [in]  y      'y' of the symbols top left corner
+ * \param [in]  masks  SYMBOL_SIZE row masks of rows from y to y + SYMBOL_SIZE one after another
+ * \param [out] shapes Array of width / (SYMBOL_SIZE + 1) shapes
+ * \param [out] colors Array of width / (SYMBOL_SIZE + 1) colors
+ * \param [out] occupancy Zeroed bitmap where bits of not empty symbols are set
+*/
+void get_row_symbols(const unsigned char *data, int width, int comp, int scale, int y, const RowMask *masks, unsigned int *shapes, Pixel *colors, RowMask *occupancy);
+
+
+/**
+ * \brief Precomputes whiteness of every packed byte of palette indices
+ * \param [in]  palette Array of 256 colors, one for each index
+ * \param [in]  depth   Bits per pixel, 1, 2, 4 or 8
+ * \param [out] lut     Table to fill
+*/
+void get_palette_lut(const Pixel *palette, int depth, PaletteLut *lut);
+
+
+/**
+ * \brief Gets palette index of pixel from row of packed indices
+ * \param [in] row   Pointer to the first byte of the row
+ * \param [in] x     Pixel position in the row
+ * \param [in] depth Bits per pixel
+ * \return Palette index
+*/
+int get_packed_index(const unsigned char *row, int x, int depth);
+
+
+/**
+ * \brief Marks not white pixels of the row of packed indices a byte at a time
+ * \param [in]  row   Pointer to the first byte of the row
+ * \param [in]  width Row width in pixels
+ * \param [in]  lut   Palette table
+ * \param [out] mask  Array of get_row_mask_size(width) words
+*/
+void get_packed_row_mask(const unsigned char *row, int width, const PaletteLut *lut, RowMask *mask);
+
+
+/**
+ * \brief Assembles shapes and colors for the whole row of symbols from masks of packed index rows
+ * \param [in]  data     Rows of packed palette indices
+ * \param [in]  row_size Size of one row in bytes
+ * \param [in]  width    Image width in pixels
+ * \param [in]  lut      Palette table
+ * \param [in]  scale    Image scale, width and y are given for image downscaled by it
+ * \param [in]  y        'y' of the symbols top left corner
+ * \param [in]  masks    SYMBOL_SIZE row masks of rows from y to y + SYMBOL_SIZE one after another
+ * \param [out] shapes   Array of width / (SYMBOL_SIZE + 1) shapes
+ * \param [out] colors   Array of width / (SYMBOL_SIZE + 1) colors
+ * \param [out] occupancy Zeroed bitmap where bits of not empty symbols are set
+*/
+void get_packed_row_symbols(const unsigned char *data, size_t row_size, int width, const PaletteLut *lut, int scale, int y, const RowMask *masks, unsigned int *shapes, Pixel *colors, RowMask *occupancy);
+
+
+/**
+ * \brief Checks all row masks of the band a word at a time
+ * \param [in] masks SYMBOL_SIZE row masks one after another
+ * \param [in] width Row width in pixels
+ * \return Non zero value means that band has no ink at all
+*/
+int is_blank_band(const RowMask *masks, int width);
+
+
+/**
+ * \brief Finds the first set bit of the mask a word at a time
+ * \param [in] mask  Bitmap to search in
+ * \param [in] begin Index of the first bit to check
+ * \param [in] end   Index of the bit after the last one to check
+ * \return Index of the set bit or end if there is no such bit
+*/
+int find_next_bit(const RowMask *mask, int begin, int end);
+
+
+/**
+ * \brief Calculates greatest common divisor
+ * \param [in] a First number
+ * \param [in] b Second number
+ * \return Greatest common divisor
+*/
+int get_gcd(int a, int b);
+
+
+/**
+ * \brief Narrows down integer scale of upscaled image using pixel edges of the row
+ * \param [in] mask  Row mask of the row
+ * \param [in] prev  Row mask of the previous row or nullptr for the first row
+ * \param [in] width Row width in pixels
+ * \param [in] y     Row index
+ * \param [in] scale Current scale candidate
+ * \return Greatest common divisor of scale and positions of all edges
+*/
+int get_mask_scale(const RowMask *mask, const RowMask *prev, int width, int y, int scale);
+
+
+/**
+ * \brief Reduces row mask of upscaled image taking left top pixel of every scale x scale block
+ * \param [in]  mask    Row mask of upscaled row with width * scale pixels
+ * \param [in]  width   Reduced row width in pixels
+ * \param [in]  scale   Image scale
+ * \param [out] reduced Array of get_row_mask_size(width) words
+*/
+void downsample_row_mask(const RowMask *mask, int width, int scale, RowMask *reduced);
@@ -0,0 +1,250 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../source/libs/tree.hpp"
+#include "../source/libs/ident.hpp"
+#include "../source/input-output.hpp"
+
+
+/// Path to temporary AST file
+const char *const TEST_AST = "binary/binary_ast_test.ast";
+
+
+/// Size of binary AST header, node count and checksum are at the same offsets as in input-output.cpp
+const size_t HEADER_SIZE = 32, NODE_COUNT_OFFSET = 8, CHECKSUM_OFFSET = 24;
+
+
+/// Size of binary AST node record, its left child index and reserved field are at the same offsets as in input-output.cpp
+const size_t RECORD_SIZE = 24, LEFT_OFFSET = 8, RESERVED_OFFSET = 20;
+
+
+/// Contains binary AST file in memory
+typedef struct {
+    char *data = nullptr;       ///< File bytes
+    size_t size = 0;            ///< File size
+} TestFile;
+
+
+/// Creates number node
+Node *get_test_num(double num);
+
+
+/// Creates variable node
+Node *get_test_var(const char *name);
+
+
+/// Creates operator node
+Node *get_test_op(int op, Node *left, Node *right);
+
+
+/// Non zero value means that trees have the same nodes, numbers are compared exactly
+int is_same_tree(const Node *a, const Node *b);
+
+
+/// Reads the whole file, data is null in case of error
+TestFile read_test_file(const char *filepath);
+
+
+/// Writes size bytes of data to file, non zero value means error
+int write_test_file(const char *filepath, const char *data, size_t size);
+
+
+/// Recalculates FNV-1a checksum of sections like write_tree does
+void update_test_checksum(TestFile *file);
+
+
+/// Reads unsigned int field of binary AST
+unsigned int get_test_field(const TestFile *file, size_t offset);
+
+
+/// Writes unsigned int field of binary AST
+void set_test_field(TestFile *file, size_t offset, unsigned int value);
+
+
+/**
+ * \brief Writes damaged copy of binary AST and checks that read_tree rejects it
+ * \param [in] name Test name
+ * \param [in] data Damaged file
+ * \param [in] size Size of damaged file
+ * \return Non zero value means error
+*/
+int check_damaged(const char *name, const char *data, size_t size);
+
+
+
+
+int main() {
+    int errors = 0;
+
+    // Shared node is saved once and numbers are saved exactly
+    Node *shared = get_test_op(OP_SUB, get_test_var("X"), get_test_num(0.1));
+
+    Tree tree = {get_test_op(OP_ADD, get_test_op(OP_DIV, shared, get_test_var("Y")), shared), 0};
+
+    if (write_tree(&tree, TEST_AST, 1)) {
+        printf("%-40s FAILED, tree is not written\n", "round trip");
+        return 1;
+    }
+
+    Tree copy = {};
+
+    int error = read_tree(&copy, TEST_AST) || !is_same_tree(tree.root, copy.root) || copy.root -> left -> left != copy.root -> right;
+
+    printf("%-40s %s\n", "round trip", (error)? "FAILED, tree is different" : "OK");
+
+    errors += error;
+
+    TestFile file = read_test_file(TEST_AST);
+
+    if (!file.data) {
+        printf("%-40s FAILED, file is not read\n", "damaged files");
+        return 1;
+    }
+
+    unsigned int node_count = get_test_field(&file, NODE_COUNT_OFFSET);
+
+    size_t offsets = HEADER_SIZE + node_count * RECORD_SIZE, last = HEADER_SIZE + (node_count - 1) * RECORD_SIZE;
+
+    TestFile damaged = {(char *) calloc(file.size, sizeof(char)), file.size};
+
+    // Reserved field is not checked by itself, but checksum covers every section
+    memcpy(damaged.data, file.data, file.size);
+    damaged.data[last + RESERVED_OFFSET] ^= 1;
+
+    errors += check_damaged("flipped byte", damaged.data, file.size);
+
+    errors += check_damaged("truncated file", file.data, file.size - 8);
+
+    // The rest damages are done with right checksum, so fields are checked by themselves
+    memcpy(damaged.data, file.data, file.size);
+    set_test_field(&damaged, last + LEFT_OFFSET, node_count - 1);
+    update_test_checksum(&damaged);
+
+    errors += check_damaged("child is not less than parent", damaged.data, file.size);
+
+    memcpy(damaged.data, file.data, file.size);
+    set_test_field(&damaged, offsets, 1 << 20);
+    update_test_checksum(&damaged);
+
+    errors += check_damaged("string offset out of range", damaged.data, file.size);
+
+    free(damaged.data);
+    free(file.data);
+
+    remove(TEST_AST);
+
+    free_node_arena(get_node_arena());
+    free_ident_table();
+
+    return (errors)? 1 : 0;
+}
+
+
+Node *get_test_num(double num) {
+    NodeValue value = {0};
+    value.dbl = num;
+
+    return create_node(TYPE_NUM, value);
+}
+
+
+Node *get_test_var(const char *name) {
+    return create_node(TYPE_VAR, {intern_ident_name(name)});
+}
+
+
+Node *get_test_op(int op, Node *left, Node *right) {
+    return create_node(TYPE_OP, {op}, left, right);
+}
+
+
+int is_same_tree(const Node *a, const Node *b) {
+    if (!a || !b) return a == b;
+
+    if (a -> type != b -> type) return 0;
+
+    if (a -> type == TYPE_NUM) {
+        if (memcmp(&a -> value.dbl, &b -> value.dbl, sizeof(double))) return 0;
+    }
+    else if (a -> value.id != b -> value.id) return 0;
+
+    return is_same_tree(a -> left, b -> left) && is_same_tree(a -> right, b -> right);
+}
+
+
+TestFile read_test_file(const char *filepath) {
+    TestFile file = {};
+
+    FILE *stream = fopen(filepath, "rb");
+    if (!stream) return file;
+
+    fseek(stream, 0, SEEK_END);
+    file.size = (size_t) ftell(stream);
+    fseek(stream, 0, SEEK_SET);
+
+    file.data = (char *) calloc(file.size, sizeof(char));
+
+    if (fread(file.data, sizeof(char), file.size, stream) != file.size) {
+        free(file.data);
+        file.data = nullptr;
+    }
+
+    fclose(stream);
+
+    return file;
+}
+
+
+int write_test_file(const char *filepath, const char *data, size_t size) {
+    FILE *stream = fopen(filepath, "wb");
+    if (!stream) return 1;
+
+    size_t written = fwrite(data, sizeof(char), size, stream);
+
+    fclose(stream);
+
+    return written != size;
+}
+
+
+void update_test_checksum(TestFile *file) {
+    unsigned long long hash = 14695981039346656037ULL;
+
+    for (size_t i = HEADER_SIZE; i + 8 <= file -> size; i += 8) {
+        unsigned long long word = 0;
+        memcpy(&word, file -> data + i, sizeof(word));
+
+        hash = (hash ^ word) * 1099511628211ULL;
+    }
+
+    memcpy(file -> data + CHECKSUM_OFFSET, &hash, sizeof(hash));
+}
+
+
+unsigned int get_test_field(const TestFile *file, size_t offset) {
+    unsigned int value = 0;
+    memcpy(&value, file -> data + offset, sizeof(value));
+
+    return value;
+}
+
+
+void set_test_field(TestFile *file, size_t offset, unsigned int value) {
+    memcpy(file -> data + offset, &value, sizeof(value));
+}
+
+
+int check_damaged(const char *name, const char *data, size_t size) {
+    if (write_test_file(TEST_AST, data, size)) {
+        printf("%-40s FAILED, file is not written\n", name);
+        return 1;
+    }
+
+    Tree tree = {};
+
+    int error = !read_tree(&tree, TEST_AST);
+
+    printf("%-40s %s\n", name, (error)? "FAILED, damaged file is read" : "OK");
+
+    return error;
+}
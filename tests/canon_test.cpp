@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "../source/libs/tree.hpp"
+#include "../source/libs/ident.hpp"
+#include "../source/dif.hpp"
+#include "../source/canon.hpp"
+
+
+/// Relative precision of comparing results
+const double TEST_EPSILON = 1e-9;
+
+
+/// Values of variables X and Y that expressions are calculated with
+const double TEST_X = 2, TEST_Y = 3;
+
+
+/// Amount of sums of the same sum, tree of such DAG has 2^SHARED_DEPTH leaves
+const int SHARED_DEPTH = 40;
+
+
+/// Order of nested derivative, canonization of its DAG as a tree takes minutes
+const int NESTED_ORDER = 10;
+
+
+/// Creates number node
+Node *get_test_num(double num);
+
+
+/// Creates variable node
+Node *get_test_var(const char *name);
+
+
+/// Creates operator node
+Node *get_test_op(int op, Node *left, Node *right);
+
+
+/// Non zero value means that trees have the same nodes
+int is_same_tree(const Node *a, const Node *b);
+
+
+/**
+ * \brief Calculates expression at X = #TEST_X and Y = #TEST_Y, every node of DAG is calculated once
+ * \param [in] expression Expression or DAG
+ * \return Value of expression or NAN if it has unknown node
+*/
+double calc_test_expression(const Node *expression);
+
+
+/**
+ * \brief Canonizes expression and compares it with expected tree
+ * \param [in] name       Test name
+ * \param [in] expression Expression to canonize
+ * \param [in] expected   Expected canonical tree
+ * \return Non zero value means error
+*/
+int check_canonical(const char *name, Node *expression, const Node *expected);
+
+
+/**
+ * \brief Canonizes expression and compares its value with expected one
+ * \param [in] name       Test name
+ * \param [in] expression Expression to canonize
+ * \param [in] expected   Expected value at X = #TEST_X and Y = #TEST_Y
+ * \return Non zero value means error
+*/
+int check_canonical_value(const char *name, Node *expression, double expected);
+
+
+
+
+int main() {
+    int errors = 0;
+
+    // Like terms are collected, coefficients go before atoms
+    errors += check_canonical("X + X * 2 + X",
+        get_test_op(OP_ADD, get_test_op(OP_ADD, get_test_var("X"), get_test_op(OP_MUL, get_test_var("X"), get_test_num(2))), get_test_var("X")),
+        get_test_op(OP_MUL, get_test_num(4), get_test_var("X")));
+
+    errors += check_canonical("X * Y - Y * X",
+        get_test_op(OP_SUB, get_test_op(OP_MUL, get_test_var("X"), get_test_var("Y")), get_test_op(OP_MUL, get_test_var("Y"), get_test_var("X"))),
+        get_test_num(0));
+
+    // Rational coefficients keep numerator and denominator apart
+    errors += check_canonical("X / 2 + X / 3",
+        get_test_op(OP_ADD, get_test_op(OP_DIV, get_test_var("X"), get_test_num(2)), get_test_op(OP_DIV, get_test_var("X"), get_test_num(3))),
+        get_test_op(OP_DIV, get_test_op(OP_MUL, get_test_num(5), get_test_var("X")), get_test_num(6)));
+
+    errors += check_canonical("X * Y / Y",
+        get_test_op(OP_DIV, get_test_op(OP_MUL, get_test_var("X"), get_test_var("Y")), get_test_var("Y")),
+        get_test_var("X"));
+
+    errors += check_canonical("(X + Y) * 2 - Y",
+        get_test_op(OP_SUB, get_test_op(OP_MUL, get_test_op(OP_ADD, get_test_var("X"), get_test_var("Y")), get_test_num(2)), get_test_var("Y")),
+        get_test_op(OP_ADD, get_test_op(OP_MUL, get_test_num(2), get_test_var("X")), get_test_var("Y")));
+
+    errors += check_canonical("Y + X * 2",
+        get_test_op(OP_ADD, get_test_var("Y"), get_test_op(OP_MUL, get_test_var("X"), get_test_num(2))),
+        get_test_op(OP_ADD, get_test_op(OP_MUL, get_test_num(2), get_test_var("X")), get_test_var("Y")));
+
+    // Every sum is shared by both operands of the next one, so shared sums must be expanded once
+    Node *shared = get_test_var("X");
+
+    for (int depth = 0; depth < SHARED_DEPTH; depth++) shared = get_test_op(OP_ADD, shared, shared);
+
+    errors += check_canonical("shared sums", shared, get_test_op(OP_MUL, get_test_num(ldexp(1, SHARED_DEPTH)), get_test_var("X")));
+
+    // X * X * X / (X - 1) = X * X + X + 1 + 1 / (X - 1), so its n-th derivative for n > 2 is (-1)^n * n! / (X - 1)^(n + 1)
+    Node *nested = get_test_op(OP_DIV,
+        get_test_op(OP_MUL, get_test_op(OP_MUL, get_test_var("X"), get_test_var("X")), get_test_var("X")),
+        get_test_op(OP_SUB, get_test_var("X"), get_test_num(1)));
+
+    double expected = 1;
+
+    for (int order = 1; order <= NESTED_ORDER; order++) {
+        nested = diff(nested, intern_ident_name("X"));
+        expected *= -order / (TEST_X - 1);
+    }
+
+    expected /= TEST_X - 1;
+
+    errors += check_canonical_value("nested derivative", nested, expected);
+
+    free_node_arena(get_node_arena());
+    free_ident_table();
+
+    return (errors)? 1 : 0;
+}
+
+
+Node *get_test_num(double num) {
+    NodeValue value = {0};
+    value.dbl = num;
+
+    return create_node(TYPE_NUM, value);
+}
+
+
+Node *get_test_var(const char *name) {
+    return create_node(TYPE_VAR, {intern_ident_name(name)});
+}
+
+
+Node *get_test_op(int op, Node *left, Node *right) {
+    return create_node(TYPE_OP, {op}, left, right);
+}
+
+
+int is_same_tree(const Node *a, const Node *b) {
+    if (!a || !b) return a == b;
+
+    if (a -> type != b -> type) return 0;
+
+    if (a -> type == TYPE_NUM) {
+        if (a -> value.dbl < b -> value.dbl || a -> value.dbl > b -> value.dbl) return 0;
+    }
+    else if (a -> value.id != b -> value.id) return 0;
+
+    return is_same_tree(a -> left, b -> left) && is_same_tree(a -> right, b -> right);
+}
+
+
+double calc_test_expression(const Node *expression) {
+    FlatTree tree = {};
+    flat_tree_constructor(&tree);
+
+    // Flat tree keeps shared nodes once and children before parents, so values are calculated in one pass
+    NodeIndex root = flatten_tree(expression, &tree);
+
+    double *values = (double *) calloc(tree.size, sizeof(double));
+
+    for (NodeIndex node = 1; node <= root; node++) {
+        double left = values[tree.lefts[node]], right = values[tree.rights[node]];
+
+        switch (tree.types[node]) {
+            case TYPE_NUM: values[node] = tree.values[node].dbl; break;
+            case TYPE_VAR: {
+                if (tree.values[node].id == intern_ident_name("X")) values[node] = TEST_X;
+                else if (tree.values[node].id == intern_ident_name("Y")) values[node] = TEST_Y;
+                else values[node] = NAN;
+                break;
+            }
+            case TYPE_OP: {
+                switch (tree.values[node].op) {
+                    case OP_ADD: values[node] = left + right; break;
+                    case OP_SUB: values[node] = left - right; break;
+                    case OP_MUL: values[node] = left * right; break;
+                    case OP_DIV: values[node] = left / right; break;
+                    default: values[node] = NAN; break;
+                }
+                break;
+            }
+            default: values[node] = NAN; break;
+        }
+    }
+
+    double result = (root)? values[root] : NAN;
+
+    free(values);
+    flat_tree_destructor(&tree);
+
+    return result;
+}
+
+
+int check_canonical(const char *name, Node *expression, const Node *expected) {
+    canonize(expression);
+
+    int error = !is_same_tree(expression, expected);
+
+    printf("%-40s %s\n", name, (error)? "FAILED, canonical tree is different" : "OK");
+
+    return error;
+}
+
+
+int check_canonical_value(const char *name, Node *expression, double expected) {
+    canonize(expression);
+
+    double value = calc_test_expression(expression);
+
+    int error = !(fabs(value - expected) <= TEST_EPSILON * fmax(1, fabs(expected)));
+
+    if (error) printf("%-40s FAILED, %g instead of %g\n", name, value, expected);
+    else printf("%-40s OK\n", name);
+
+    return error;
+}
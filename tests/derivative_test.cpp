@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "../source/libs/tree.hpp"
+#include "../source/libs/ident.hpp"
+#include "../source/dif.hpp"
+
+
+/// Relative precision of comparing results
+const double TEST_EPSILON = 1e-9;
+
+
+/// Values of variables X and Y that expressions are calculated with
+const double TEST_X = 2, TEST_Y = 3;
+
+
+/// Order of nested derivative, optimization of its DAG as a tree takes about a minute
+const int NESTED_ORDER = 12;
+
+
+/// Creates number node
+Node *get_test_num(double num);
+
+
+/// Creates variable node
+Node *get_test_var(const char *name);
+
+
+/// Creates operator node
+Node *get_test_op(int op, Node *left, Node *right);
+
+
+/**
+ * \brief Calculates expression at X = #TEST_X and Y = #TEST_Y, every node of DAG is calculated once
+ * \param [in] expression Expression or DAG
+ * \return Value of expression or NAN if it has unknown node
+*/
+double calc_test_expression(const Node *expression);
+
+
+/**
+ * \brief Compares value of derivative with expected one
+ * \param [in] name       Test name
+ * \param [in] derivative Derivative to check
+ * \param [in] expected   Expected value at X = #TEST_X and Y = #TEST_Y
+ * \return Non zero value means error
+*/
+int check_derivative(const char *name, const Node *derivative, double expected);
+
+
+
+
+int main() {
+    int errors = 0;
+
+    int x = intern_ident_name("X"), y = intern_ident_name("Y");
+
+    // Derivative of variable is one only for the variable that expression is differentiated for
+    errors += check_derivative("X d X", diff(get_test_var("X"), x), 1);
+    errors += check_derivative("Y d X", diff(get_test_var("Y"), x), 0);
+
+    Node *product = get_test_op(OP_MUL, get_test_op(OP_MUL, get_test_var("X"), get_test_var("X")), get_test_var("Y"));
+
+    errors += check_derivative("X * X * Y d X", diff(product, x), 2 * TEST_X * TEST_Y);
+    errors += check_derivative("X * X * Y d Y", diff(product, y), TEST_X * TEST_X);
+
+    Node *quotient = get_test_op(OP_DIV, get_test_var("Y"), get_test_op(OP_ADD, get_test_var("X"), get_test_num(1)));
+
+    errors += check_derivative("Y / (X + 1) d X", diff(quotient, x), -TEST_Y / ((TEST_X + 1) * (TEST_X + 1)));
+    errors += check_derivative("Y / (X + 1) d Y", diff(quotient, y), 1 / (TEST_X + 1));
+
+    // X * X * X / (X - 1) = X * X + X + 1 + 1 / (X - 1), so its n-th derivative for n > 2 is (-1)^n * n! / (X - 1)^(n + 1),
+    // denominator of derivative is squared with every order and X - 1 keeps it from overflow
+    Node *nested = get_test_op(OP_DIV,
+        get_test_op(OP_MUL, get_test_op(OP_MUL, get_test_var("X"), get_test_var("X")), get_test_var("X")),
+        get_test_op(OP_SUB, get_test_var("X"), get_test_num(1)));
+
+    double expected = 1;
+
+    for (int order = 1; order <= NESTED_ORDER; order++) {
+        nested = diff(nested, x);
+        expected *= -order / (TEST_X - 1);
+    }
+
+    expected /= TEST_X - 1;
+
+    optimize(nested);
+
+    errors += check_derivative("nested derivative after optimization", nested, expected);
+
+    free_node_arena(get_node_arena());
+    free_ident_table();
+
+    return (errors)? 1 : 0;
+}
+
+
+Node *get_test_num(double num) {
+    NodeValue value = {0};
+    value.dbl = num;
+
+    return create_node(TYPE_NUM, value);
+}
+
+
+Node *get_test_var(const char *name) {
+    return create_node(TYPE_VAR, {intern_ident_name(name)});
+}
+
+
+Node *get_test_op(int op, Node *left, Node *right) {
+    return create_node(TYPE_OP, {op}, left, right);
+}
+
+
+double calc_test_expression(const Node *expression) {
+    FlatTree tree = {};
+    flat_tree_constructor(&tree);
+
+    // Flat tree keeps shared nodes once and children before parents, so values are calculated in one pass
+    NodeIndex root = flatten_tree(expression, &tree);
+
+    double *values = (double *) calloc(tree.size, sizeof(double));
+
+    for (NodeIndex node = 1; node <= root; node++) {
+        double left = values[tree.lefts[node]], right = values[tree.rights[node]];
+
+        switch (tree.types[node]) {
+            case TYPE_NUM: values[node] = tree.values[node].dbl; break;
+            case TYPE_VAR: {
+                if (tree.values[node].id == intern_ident_name("X")) values[node] = TEST_X;
+                else if (tree.values[node].id == intern_ident_name("Y")) values[node] = TEST_Y;
+                else values[node] = NAN;
+                break;
+            }
+            case TYPE_OP: {
+                switch (tree.values[node].op) {
+                    case OP_ADD: values[node] = left + right; break;
+                    case OP_SUB: values[node] = left - right; break;
+                    case OP_MUL: values[node] = left * right; break;
+                    case OP_DIV: values[node] = left / right; break;
+                    default: values[node] = NAN; break;
+                }
+                break;
+            }
+            default: values[node] = NAN; break;
+        }
+    }
+
+    double result = (root)? values[root] : NAN;
+
+    free(values);
+    flat_tree_destructor(&tree);
+
+    return result;
+}
+
+
+int check_derivative(const char *name, const Node *derivative, double expected) {
+    double value = (derivative)? calc_test_expression(derivative) : NAN;
+
+    int error = !(fabs(value - expected) <= TEST_EPSILON * fmax(1, fabs(expected)));
+
+    if (error) printf("%-40s FAILED, %g instead of %g\n", name, value, expected);
+    else printf("%-40s OK\n", name);
+
+    return error;
+}
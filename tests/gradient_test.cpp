@@ -0,0 +1,347 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "../source/libs/tree.hpp"
+#include "../source/libs/queue.hpp"
+#include "../source/libs/ident.hpp"
+#include "../source/image_parser.hpp"
+#include "../source/symbol_parser.hpp"
+#include "../source/grammar.hpp"
+
+
+/// Max amount of lexems in test program
+const int MAX_TEST_TOKENS = 256;
+
+
+/// Max amount of variables in test program
+const int MAX_TEST_VARS = 64;
+
+
+/// Precision of comparing results
+const double TEST_EPSILON = 1e-9;
+
+
+/// Value of variable of test program
+typedef struct {
+    int id = 0;                         ///< Identificator
+    double value = 0;                   ///< Value
+} TestVar;
+
+
+/// Variables of test program
+typedef struct {
+    TestVar vars[MAX_TEST_VARS] = {};   ///< Variables in order of declaration
+    int size = 0;                       ///< Amount of variables
+} TestScope;
+
+
+/**
+ * \brief Makes lexems of program written by words separated by spaces
+ * \param [in]  text    Program like "def main ( ) [ var X = 2 ; ]", "main" is name of main function
+ * \param [out] tokens  Array of #MAX_TEST_TOKENS lexems
+ * \param [out] numbers Array of #MAX_TEST_TOKENS numbers
+ * \return Lexems of the program
+*/
+TokenStream get_test_tokens(const char *text, Token *tokens, double *numbers);
+
+
+/**
+ * \brief Parses program and replaces its gradient statements
+ * \param [in]  text  Program written by words
+ * \param [out] error Result of expand_gradients
+ * \return Program tree
+*/
+Node *get_test_program(const char *text, int *error);
+
+
+/**
+ * \brief Runs global declarations and statements of main that are declarations and assignments
+ * \param [in]  program Program tree without calls in executed statements
+ * \param [out] scope   Variables after the last statement
+*/
+void run_test_program(const Node *program, TestScope *scope);
+
+
+/// Calculates arithmetic expression, only sqrt can be called
+double eval_test_expression(const Node *node, const TestScope *scope);
+
+
+/// Sets value of variable and adds variable if it is not in scope yet
+void set_test_var(TestScope *scope, int id, double value);
+
+
+/// Gives value of variable by name or NAN if scope has no such variable
+double get_test_var(const TestScope *scope, const char *name);
+
+
+/**
+ * \brief Runs program and compares its variables with expected values
+ * \param [in] name     Test name
+ * \param [in] text     Program written by words
+ * \param [in] vars     Names of checked variables separated by spaces
+ * \param [in] expected Expected values of checked variables
+ * \return Non zero value means error
+*/
+int test_gradient(const char *name, const char *text, const char *vars, const double *expected);
+
+
+/**
+ * \brief Checks that expand_gradients refuses program
+ * \param [in] name Test name
+ * \param [in] text Program written by words
+ * \return Non zero value means error
+*/
+int test_gradient_error(const char *name, const char *text);
+
+
+
+
+int main() {
+    int errors = 0;
+
+    {
+        // Targets are the variables themselves, so they must be assigned after all derivatives are calculated
+        const double EXPECTED[] = {5.0, 1.5};
+        errors += test_gradient("aliased targets",
+            "def main ( ) [ var X = 1.5 ; var Y = 2 ; X , Y = X * Y + X * X d X , Y ; return 0 ; ]", "X Y", EXPECTED);
+    }
+
+    {
+        const double EXPECTED[] = {2.0, 1.5};
+        errors += test_gradient("swapped aliased targets",
+            "def main ( ) [ var X = 1.5 ; var Y = 2 ; Y , X = X * Y d X , Y ; return 0 ; ]", "Y X", EXPECTED);
+    }
+
+    {
+        // F(U) = U^3 + U^2 and U = X * Y = 1, so F' = 5
+        const double EXPECTED[] = {2.5, 10.0};
+        errors += test_gradient("inlined function with local variable",
+            "def F ( P ) [ var L = P * P ; return L * P + L ; ] "
+            "def main ( ) [ var X = 2 ; var Y = 0.5 ; var G = 0 ; var H = 0 ; G , H = F ( X * Y ) d X , Y ; return 0 ; ]",
+            "G H", EXPECTED);
+    }
+
+    {
+        const double EXPECTED[] = {3.0, 2.0};
+        errors += test_gradient("inlined function with global variable",
+            "var Z = 3 ; def F ( P ) [ return P * Z ; ] "
+            "def main ( ) [ var X = 2 ; var Y = 5 ; var G = 0 ; var H = 0 ; G , H = F ( X ) + X * Y - 5 * X d X , Z ; return 0 ; ]",
+            "G H", EXPECTED);
+    }
+
+    {
+        // sqrt(X * X + 9) at X = 4, its derivative is X / 5
+        const double EXPECTED[] = {0.8, 0.0};
+        errors += test_gradient("sqrt call",
+            "def main ( ) [ var X = 4 ; var Y = 1 ; var G = 0 ; var H = 0 ; "
+            "G , H = VAR_22B14C_0062909C ( X * X + 9 ) d X , Y ; return 0 ; ]", "G H", EXPECTED);
+    }
+
+    {
+        // Derivative DAG of F is a huge tree, statements are searched for gradients without walking it
+        const double EXPECTED[] = {4.0, 4.0};
+        errors += test_gradient("nested derivative in other function",
+            "def F ( X ) [ return ( ( ( ( ( ( ( ( ( ( ( ( ( ( ( ( X * X * X / ( X - 1 ) "
+            "d X ) d X ) d X ) d X ) d X ) d X ) d X ) d X ) d X ) d X ) d X ) d X ) d X ) d X ) d X ) d X ) ; ] "
+            "def main ( ) [ var X = 2 ; var Y = 1 ; X , Y = X * X * Y d X , Y ; return 0 ; ]", "X Y", EXPECTED);
+    }
+
+    errors += test_gradient_error("recursive function",
+        "def F ( P ) [ return F ( P ) * P ; ] "
+        "def main ( ) [ var X = 2 ; var Y = 1 ; X , Y = F ( X ) d X , Y ; return 0 ; ]");
+
+    errors += test_gradient_error("mutually recursive functions",
+        "def F ( P ) [ return E ( P ) ; ] def E ( P ) [ return F ( P ) + 1 ; ] "
+        "def main ( ) [ var X = 2 ; var Y = 1 ; X , Y = F ( X ) d X , Y ; return 0 ; ]");
+
+    errors += test_gradient_error("global variable hidden by local one",
+        "var Z = 3 ; def F ( P ) [ return P * Z ; ] "
+        "def main ( ) [ var Z = 1 ; var X = 2 ; var Y = 1 ; X , Y = F ( X ) d X , Y ; return 0 ; ]");
+
+    errors += test_gradient_error("function with assignment",
+        "def F ( P ) [ P = P * 2 ; return P ; ] "
+        "def main ( ) [ var X = 2 ; var Y = 1 ; X , Y = F ( X ) d X , Y ; return 0 ; ]");
+
+    free_node_arena(get_node_arena());
+    free_ident_table();
+
+    return (errors)? 1 : 0;
+}
+
+
+TokenStream get_test_tokens(const char *text, Token *tokens, double *numbers) {
+    // Lexems that are the same for every program, brackets keep 1 for opening and 0 for closing one in operator
+    const struct { const char *word; Token token; } WORDS[] = {
+        {"def",     {TYPE_DEF, 0, 0}},
+        {"var",     {TYPE_NVAR, 0, 0}},
+        {"return",  {TYPE_RET, 0, 0}},
+        {";",       {TYPE_SEQ, 0, 0}},
+        {",",       {TYPE_CONT, 0, 0}},
+        {"(",       {TYPE_BRACKET, 1, 0}},
+        {")",       {TYPE_BRACKET, 0, 0}},
+        {"[",       {TYPE_BLOCK, 1, 0}},
+        {"]",       {TYPE_BLOCK, 0, 0}},
+        {"=",       {TYPE_OP, OP_ASS, 0}},
+        {"+",       {TYPE_OP, OP_ADD, 0}},
+        {"-",       {TYPE_OP, OP_SUB, 0}},
+        {"*",       {TYPE_OP, OP_MUL, 0}},
+        {"/",       {TYPE_OP, OP_DIV, 0}},
+        {"d",       {TYPE_OP, OP_DIF, 0}},
+    };
+
+    TokenStream stream = {tokens, 0, numbers, 0};
+
+    char word[64] = "";
+
+    for (int length = 0; sscanf(text, " %63s%n", word, &length) == 1; text += length) {
+        Token token = {TYPE_VAR, 0, 0};
+
+        int is_reserved = 0;
+
+        for (int i = 0; i < (int) (sizeof(WORDS) / sizeof(WORDS[0])) && !is_reserved; i++)
+            if (!strcmp(word, WORDS[i].word)) token = WORDS[i].token, is_reserved = 1;
+
+        if (!is_reserved && word[0] >= '0' && word[0] <= '9') {
+            token.type = TYPE_NUM;
+            token.value = (unsigned int) stream.number_count;
+            numbers[stream.number_count++] = atof(word);
+        }
+        else if (!is_reserved) {
+            token.value = (unsigned int) intern_ident_name((strcmp(word, "main"))? word : MAIN_FUNCTION_NAME);
+        }
+
+        tokens[stream.size++] = token;
+    }
+
+    tokens[stream.size++] = {TYPE_ESC, 0, 0};
+
+    return stream;
+}
+
+
+Node *get_test_program(const char *text, int *error) {
+    Token tokens[MAX_TEST_TOKENS] = {};
+    double numbers[MAX_TEST_TOKENS] = {};
+
+    TokenStream stream = get_test_tokens(text, tokens, numbers);
+
+    Node *program = get_program(&stream);
+
+    *error = expand_gradients(program);
+
+    return program;
+}
+
+
+void run_test_program(const Node *program, TestScope *scope) {
+    const Node *body = nullptr;
+
+    for (const Node *def = program; def; def = def -> right) {
+        if (def -> left -> type == TYPE_NVAR)
+            set_test_var(scope, def -> left -> value.id, eval_test_expression(def -> left -> right, scope));
+        else if (def -> left -> value.id == intern_ident_name(MAIN_FUNCTION_NAME))
+            body = def -> left -> right;
+    }
+
+    for (const Node *statement = body; statement; statement = statement -> right) {
+        const Node *node = statement -> left;
+
+        if (node -> type == TYPE_NVAR)
+            set_test_var(scope, node -> value.id, eval_test_expression(node -> right, scope));
+        else if (node -> type == TYPE_OP && node -> value.op == OP_ASS)
+            set_test_var(scope, node -> left -> value.id, eval_test_expression(node -> right, scope));
+    }
+}
+
+
+double eval_test_expression(const Node *node, const TestScope *scope) {
+    switch (node -> type) {
+        case TYPE_NUM: return node -> value.dbl;
+        case TYPE_VAR: {
+            for (int i = 0; i < scope -> size; i++)
+                if (scope -> vars[i].id == node -> value.id) return scope -> vars[i].value;
+
+            return NAN;
+        }
+        case TYPE_CALL: {
+            if (node -> value.id != intern_ident_name("VAR_22B14C_0062909C")) return NAN;
+
+            return sqrt(eval_test_expression(node -> left -> left, scope));
+        }
+        case TYPE_OP: {
+            double left = eval_test_expression(node -> left, scope), right = eval_test_expression(node -> right, scope);
+
+            switch (node -> value.op) {
+                case OP_ADD: return left + right;
+                case OP_SUB: return left - right;
+                case OP_MUL: return left * right;
+                case OP_DIV: return left / right;
+                default: return NAN;
+            }
+        }
+        default: return NAN;
+    }
+}
+
+
+void set_test_var(TestScope *scope, int id, double value) {
+    for (int i = 0; i < scope -> size; i++) {
+        if (scope -> vars[i].id == id) {
+            scope -> vars[i].value = value;
+            return;
+        }
+    }
+
+    if (scope -> size < MAX_TEST_VARS) scope -> vars[scope -> size++] = {id, value};
+}
+
+
+double get_test_var(const TestScope *scope, const char *name) {
+    int id = intern_ident_name(name);
+
+    for (int i = 0; i < scope -> size; i++)
+        if (scope -> vars[i].id == id) return scope -> vars[i].value;
+
+    return NAN;
+}
+
+
+int test_gradient(const char *name, const char *text, const char *vars, const double *expected) {
+    int error = 0;
+    Node *program = get_test_program(text, &error);
+
+    if (error) {
+        printf("%-40s FAILED, gradient is not expanded\n", name);
+        return 1;
+    }
+
+    TestScope scope = {};
+    run_test_program(program, &scope);
+
+    char var[64] = "";
+    int index = 0;
+
+    for (int length = 0; sscanf(vars, " %63s%n", var, &length) == 1; vars += length, index++) {
+        double value = get_test_var(&scope, var);
+
+        if (!(fabs(value - expected[index]) < TEST_EPSILON)) {
+            printf("%-40s FAILED, %s is %g instead of %g\n", name, var, value, expected[index]);
+            return 1;
+        }
+    }
+
+    printf("%-40s OK\n", name);
+
+    return 0;
+}
+
+
+int test_gradient_error(const char *name, const char *text) {
+    int error = 0;
+    get_test_program(text, &error);
+
+    printf("%-40s %s\n", name, (error)? "OK" : "FAILED, gradient is expanded");
+
+    return (error)? 0 : 1;
+}
@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../source/image_parser.hpp"
+
+
+/// Distance between top left corners of neighbour symbols
+const int OFFSET = SYMBOL_SIZE + 1;
+
+
+/// Image size in symbols, its greatest common divisor allows scales 2 and 3
+const int TEST_WIDTH = 12, TEST_HEIGHT = 6;
+
+
+/// Amount of blank symbol rows at the top of test images
+const int BLANK_ROWS = 2;
+
+
+/// Path to temporary image that is read by tiles
+const char *const TEST_IMAGE = "binary/image_scale_test.ppm";
+
+
+/// Contains symbols of all tiles in order
+typedef struct {
+    unsigned int *shapes = nullptr; ///< Shapes of all tiles
+    Pixel *colors = nullptr;        ///< Colors of all tiles
+    size_t size = 0;                ///< Amount of symbols in all tiles
+    int tiles = 0;                  ///< Amount of handled tiles
+} TileSymbols;
+
+
+/**
+ * \brief Creates RGB image of random symbols with blank rows at the top
+ * \param [in] blank_rows Amount of blank symbol rows, all rows are blank if it is not less than #TEST_HEIGHT
+ * \param [in] scale      Every pixel is copied as scale x scale block
+ * \return Array of TEST_WIDTH * OFFSET * scale x TEST_HEIGHT * OFFSET * scale pixels with three channels
+*/
+unsigned char *create_test_image(int blank_rows, int scale);
+
+
+/**
+ * \brief Detects scale of test image and compares it with expected one
+ * \param [in] name       Test name
+ * \param [in] blank_rows Amount of blank symbol rows
+ * \param [in] scale      Image scale
+ * \param [in] expected   Expected scale
+ * \return Non zero value means error
+*/
+int check_image_scale(const char *name, int blank_rows, int scale, int expected);
+
+
+/// Appends symbols of tile to TileSymbols
+void collect_tile(const SymbolBuffer *tile, void *data);
+
+
+/**
+ * \brief Writes test image to PPM file, reads it by tiles and compares symbols with the whole image parsed with right scale
+ * \param [in] name       Test name
+ * \param [in] blank_rows Amount of blank symbol rows
+ * \param [in] scale      Image scale
+ * \param [in] tile_scale Scale that is passed to tile reader, zero means that it is detected
+ * \param [in] expected   Expected result of tile reader
+ * \return Non zero value means error
+*/
+int check_tiles(const char *name, int blank_rows, int scale, int tile_scale, int expected);
+
+
+
+
+int main() {
+    srand(1);
+
+    int errors = 0;
+
+    errors += check_image_scale("native image", 0, 1, 1);
+    errors += check_image_scale("native image with blank rows", BLANK_ROWS, 1, 1);
+    errors += check_image_scale("upscaled x2 image with blank rows", BLANK_ROWS, 2, 2);
+    errors += check_image_scale("upscaled x3 image with blank rows", BLANK_ROWS, 3, 3);
+    errors += check_image_scale("blank image", TEST_HEIGHT, 2, 0);
+
+    // Blank tiles above the first tile with ink don't make reader fall back to the whole image
+    errors += check_tiles("tiles of native image with blank rows", BLANK_ROWS, 1, 0, 0);
+    errors += check_tiles("tiles of blank image", TEST_HEIGHT, 1, 0, 0);
+    errors += check_tiles("tiles of upscaled x2 image", BLANK_ROWS, 2, 0, 1);
+    errors += check_tiles("tiles of upscaled x2 image with scale 2", BLANK_ROWS, 2, 2, 0);
+    errors += check_tiles("tiles of native image with scale 1", BLANK_ROWS, 1, 1, 0);
+
+    remove(TEST_IMAGE);
+
+    return (errors)? 1 : 0;
+}
+
+
+unsigned char *create_test_image(int blank_rows, int scale) {
+    int width = TEST_WIDTH * OFFSET, height = TEST_HEIGHT * OFFSET;
+
+    unsigned char *data = (unsigned char *) calloc((size_t) width * height * scale * scale * 3, sizeof(unsigned char));
+
+    for (int y = 0; y < height * scale; y++) {
+        // Random value of every block is taken by its left top pixel
+        unsigned int seed = (unsigned int) rand();
+
+        for (int x = 0; x < width * scale; x++) {
+            int block_x = x / scale, block_y = y / scale;
+
+            unsigned char *pixel = data + ((size_t) y * width * scale + x) * 3;
+
+            if (y % scale) {
+                memcpy(pixel, pixel - (size_t) width * scale * 3, 3);
+                continue;
+            }
+
+            if (x % scale) {
+                memcpy(pixel, pixel - 3, 3);
+                continue;
+            }
+
+            seed = seed * 1103515245 + 12345;
+
+            // Edge after the first pixel of the first row with ink makes detected scale exact
+            int ink = (block_y == blank_rows * OFFSET)? block_x == 1 : (seed >> 16) % 3 == 0;
+
+            if (block_y < blank_rows * OFFSET || block_x % OFFSET == SYMBOL_SIZE || block_y % OFFSET == SYMBOL_SIZE) ink = 0;
+
+            memset(pixel, (ink)? (int) (seed >> 24) % 128 : 255, 3);
+        }
+    }
+
+    return data;
+}
+
+
+int check_image_scale(const char *name, int blank_rows, int scale, int expected) {
+    unsigned char *data = create_test_image(blank_rows, scale);
+
+    int detected = get_image_scale(TEST_WIDTH * OFFSET * scale, TEST_HEIGHT * OFFSET * scale, 3, data);
+
+    free(data);
+
+    if (detected != expected) printf("%-45s FAILED, scale %i instead of %i\n", name, detected, expected);
+    else printf("%-45s OK\n", name);
+
+    return detected != expected;
+}
+
+
+void collect_tile(const SymbolBuffer *tile, void *data) {
+    TileSymbols *symbols = (TileSymbols *) data;
+
+    size_t size = tile -> size - 1;
+
+    symbols -> shapes = (unsigned int *) realloc(symbols -> shapes, (symbols -> size + size) * sizeof(unsigned int));
+    symbols -> colors = (Pixel *) realloc(symbols -> colors, (symbols -> size + size) * sizeof(Pixel));
+
+    memcpy(symbols -> shapes + symbols -> size, tile -> shapes, size * sizeof(unsigned int));
+    memcpy(symbols -> colors + symbols -> size, tile -> colors, size * sizeof(Pixel));
+
+    symbols -> size += size;
+    symbols -> tiles++;
+}
+
+
+int check_tiles(const char *name, int blank_rows, int scale, int tile_scale, int expected) {
+    int width = TEST_WIDTH * OFFSET * scale, height = TEST_HEIGHT * OFFSET * scale;
+
+    unsigned char *data = create_test_image(blank_rows, scale);
+
+    FILE *file = fopen(TEST_IMAGE, "wb");
+
+    if (!file) {
+        printf("%-45s FAILED, can't write %s\n", name, TEST_IMAGE);
+        free(data);
+        return 1;
+    }
+
+    fprintf(file, "P6\n%i %i\n255\n", width, height);
+    fwrite(data, sizeof(unsigned char), (size_t) width * height * 3, file);
+    fclose(file);
+
+    SymbolBuffer reference = parse_image_data(width, height, 3, data, 1, scale);
+
+    TileSymbols symbols = {};
+
+    int result = read_symbol_tiles(TEST_IMAGE, 1, 1, &collect_tile, &symbols, tile_scale);
+
+    int error = 0;
+
+    if (result != expected) {
+        printf("%-45s FAILED, reader returned %i instead of %i\n", name, result, expected);
+        error = 1;
+    }
+    else if (result && symbols.tiles) {
+        printf("%-45s FAILED, handler is called before fall back\n", name);
+        error = 1;
+    }
+    else if (!result && (symbols.size != reference.size - 1 || memcmp(symbols.shapes, reference.shapes, symbols.size * sizeof(unsigned int)) ||
+                         memcmp(symbols.colors, reference.colors, symbols.size * sizeof(Pixel)))) {
+        printf("%-45s FAILED, symbols differ from the whole image\n", name);
+        error = 1;
+    }
+    else {
+        printf("%-45s OK\n", name);
+    }
+
+    free(symbols.shapes);
+    free(symbols.colors);
+
+    free_symbol_buffer(&reference);
+    free(data);
+
+    return error;
+}
@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "../source/libs/tree.hpp"
+#include "../source/libs/ident.hpp"
+#include "../source/symbolic.hpp"
+
+
+/// Relative precision of comparing results
+const double TEST_EPSILON = 1e-9;
+
+
+/// Amount of points that expressions are compared in
+const int TEST_POINTS = 1000;
+
+
+/// Expression that is differentiated, its denominators are near one at test points, so derivatives of high orders don't overflow
+const char *const NESTED_EXPRESSION = "x * x * y / (x - 1) + y * y / (x * y - 1)";
+
+
+/// Amount of sums of the same sum, tree of such DAG has 2^SHARED_DEPTH leaves
+const int SHARED_DEPTH = 30;
+
+
+/// Order of nested derivative, simplification of its DAG as a tree takes minutes
+const int NESTED_ORDER = 10;
+
+
+/// Variables of test expressions in order of point arrays
+const char *const TEST_VARS[] = {"x", "y"};
+
+
+/**
+ * \brief Fills arrays with points near x = 2 and y = 1
+ * \param [out] xs Values of x
+ * \param [out] ys Values of y
+*/
+void get_test_points(double *xs, double *ys);
+
+
+/**
+ * \brief Compiles expression and evaluates it in test points
+ * \param [in]  expression Expression to evaluate
+ * \param [out] results    Values in every test point
+ * \param [out] size       Amount of program instructions
+ * \return Non zero value means error
+*/
+int eval_test_expression(const Node *expression, double *results, int *size);
+
+
+/**
+ * \brief Simplifies expression and checks that it is not bigger and has the same values
+ * \param [in] name       Test name
+ * \param [in] context    Context of expression
+ * \param [in] expression Expression to simplify
+ * \param [in] max_size   Max amount of instructions of simplified expression or -1 if it must be just not bigger
+ * \return Non zero value means error
+*/
+int check_simplified(const char *name, SymbolContext *context, Node *expression, int max_size);
+
+
+
+
+int main() {
+    int errors = 0;
+
+    SymbolContext context = {};
+
+    errors += check_simplified("x * 1 + 0 * y + x", &context, parse_symbolic(&context, "x * 1 + 0 * y + x"), 3);
+    errors += check_simplified("x / 2 + x / 3 - x * 5 / 6", &context, parse_symbolic(&context, "x / 2 + x / 3 - x * 5 / 6"), 1);
+    errors += check_simplified("(x + y) * 2 - y", &context, parse_symbolic(&context, "(x + y) * 2 - y"), 5);
+
+    // Every sum is used twice by the next one, so simplification has to keep it shared
+    Node *shared = parse_symbolic(&context, "x * y - 1");
+
+    for (int depth = 0; depth < SHARED_DEPTH; depth++) shared = create_symbolic_op(&context, OP_ADD, shared, shared);
+
+    errors += check_simplified("shared sums", &context, shared, -1);
+
+    Node *nested = parse_symbolic(&context, NESTED_EXPRESSION);
+
+    for (int order = 1; order <= NESTED_ORDER; order++) nested = diff_symbolic(&context, nested, (order % 3)? "x" : "y");
+
+    errors += check_simplified("nested derivative", &context, nested, -1);
+
+    free_symbol_context(&context);
+    free_ident_table();
+
+    return (errors)? 1 : 0;
+}
+
+
+void get_test_points(double *xs, double *ys) {
+    for (int i = 0; i < TEST_POINTS; i++) {
+        xs[i] = 2 + 0.001 * sin(i);
+        ys[i] = 1 + 0.001 * cos(3 * i);
+    }
+}
+
+
+int eval_test_expression(const Node *expression, double *results, int *size) {
+    double *xs = (double *) calloc(TEST_POINTS, sizeof(double));
+    double *ys = (double *) calloc(TEST_POINTS, sizeof(double));
+
+    get_test_points(xs, ys);
+
+    const double *points[] = {xs, ys};
+
+    SymbolProgram program = {};
+
+    int error = compile_symbolic(&program, expression, TEST_VARS, 2) || eval_symbolic(&program, points, results, TEST_POINTS);
+
+    *size = program.size;
+
+    free_symbolic_program(&program);
+
+    free(xs);
+    free(ys);
+
+    return error;
+}
+
+
+int check_simplified(const char *name, SymbolContext *context, Node *expression, int max_size) {
+    double *expected = (double *) calloc(TEST_POINTS, sizeof(double));
+    double *results = (double *) calloc(TEST_POINTS, sizeof(double));
+
+    int size = 0, simplified_size = 0;
+
+    int error = !expression || eval_test_expression(expression, expected, &size);
+
+    if (!error) error = eval_test_expression(simplify_symbolic(context, expression), results, &simplified_size);
+
+    if (error) {
+        printf("%-40s FAILED, expression is not evaluated\n", name);
+    }
+    else if (simplified_size > ((max_size == -1)? size : max_size)) {
+        printf("%-40s FAILED, %i instructions instead of %i\n", name, simplified_size, size);
+        error = 1;
+    }
+    else {
+        for (int i = 0; i < TEST_POINTS && !error; i++) {
+            if (!(fabs(results[i] - expected[i]) <= TEST_EPSILON * fmax(1, fabs(expected[i])))) {
+                printf("%-40s FAILED, %g instead of %g\n", name, results[i], expected[i]);
+                error = 1;
+            }
+        }
+
+        if (!error) printf("%-40s OK, %i instructions instead of %i\n", name, simplified_size, size);
+    }
+
+    free(expected);
+    free(results);
+
+    return error;
+}
@@ -0,0 +1,254 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "../source/image_parser.hpp"
+#include "../source/tile_kernel.hpp"
+
+
+/// Amount of random images of every kind for every kernel
+const int TEST_IMAGES = 50;
+
+
+/// Distance between top left corners of neighbour symbols
+const int OFFSET = SYMBOL_SIZE + 1;
+
+
+/**
+ * \brief Fills pixels with random symbols, some of not white pixels have two white channels
+ * \param [out] pixels Array of width * height pixels
+ * \param [in]  width  Image width in pixels
+ * \param [in]  height Image height in pixels
+*/
+void fill_random_pixels(Pixel *pixels, int width, int height);
+
+
+/**
+ * \brief Copies pixels to raw data
+ * \param [in]  pixels Array of width * height pixels
+ * \param [in]  width  Image width in pixels
+ * \param [in]  height Image height in pixels
+ * \param [in]  comp   Amount of channels, 3 or 4
+ * \param [in]  scale  Every pixel is copied as scale x scale block
+ * \param [out] data   Array of width * height * scale * scale * comp bytes
+*/
+void get_raw_data(const Pixel *pixels, int width, int height, int comp, int scale, unsigned char *data);
+
+
+/**
+ * \brief Compares symbol buffer with symbols that get_image_symbol finds in the image
+ * \param [in] buffer Symbols to check
+ * \param [in] image  Reference image, not upscaled
+ * \param [in] comp   Amount of channels in parsed data, alpha of RGB data is 255
+ * \return Non zero value means that some symbol differs
+*/
+int compare_symbols(const SymbolBuffer *buffer, const Image *image, int comp);
+
+
+/**
+ * \brief Parses random RGB or RGBA image by get_row_mask and compares it with get_image_symbol
+ * \param [in] comp  Amount of channels, 3 or 4
+ * \param [in] scale Integer scale of parsed image
+ * \return Non zero value means error
+*/
+int test_raw_image(int comp, int scale);
+
+
+/**
+ * \brief Parses random image of packed palette indices by get_packed_row_mask and compares it with get_image_symbol
+ * \param [in] depth Bits per pixel, 1, 2, 4 or 8
+ * \return Non zero value means error
+*/
+int test_packed_image(int depth);
+
+
+
+
+int main() {
+    const char *const KERNELS[] = {"scalar", "sse2", "avx2"};
+
+    int errors = 0;
+
+    for (int i = 0; i < (int)(sizeof(KERNELS) / sizeof(KERNELS[0])); i++) {
+        if (set_row_mask_kernel(KERNELS[i])) {
+            printf("%-6s is not supported, skipped\n", KERNELS[i]);
+            continue;
+        }
+
+        srand(1);
+
+        int kernel_errors = 0;
+
+        kernel_errors += test_raw_image(4, 1);
+        kernel_errors += test_raw_image(3, 1);
+
+        for (int scale = 2; scale <= 4; scale++) {
+            kernel_errors += test_raw_image(4, scale);
+            kernel_errors += test_raw_image(3, scale);
+        }
+
+        for (int depth = 1; depth <= 8; depth *= 2)
+            kernel_errors += test_packed_image(depth);
+
+        printf("%-6s %s\n", KERNELS[i], (kernel_errors)? "FAILED" : "OK");
+
+        errors += kernel_errors;
+    }
+
+    return (errors)? 1 : 0;
+}
+
+
+void fill_random_pixels(Pixel *pixels, int width, int height) {
+    int density = rand() % 4 + 1;
+
+    for (int i = 0; i < width * height; i++) {
+        if (rand() % 5 >= density) {
+            pixels[i] = {255, 255, 255, (unsigned char) rand()};
+            continue;
+        }
+
+        pixels[i] = {(unsigned char) rand(), (unsigned char) rand(), (unsigned char) rand(), (unsigned char) rand()};
+
+        if (rand() % 4 == 0) pixels[i].r = pixels[i].g = 255;
+    }
+}
+
+
+void get_raw_data(const Pixel *pixels, int width, int height, int comp, int scale, unsigned char *data) {
+    for (int y = 0; y < height * scale; y++) {
+        for (int x = 0; x < width * scale; x++) {
+            const Pixel *pixel = pixels + (size_t) (y / scale) * width + x / scale;
+            unsigned char *channels = data + ((size_t) y * width * scale + x) * comp;
+
+            channels[0] = pixel -> r;
+            channels[1] = pixel -> g;
+            channels[2] = pixel -> b;
+
+            if (comp == 4) channels[3] = pixel -> a;
+        }
+    }
+}
+
+
+int compare_symbols(const SymbolBuffer *buffer, const Image *image, int comp) {
+    if (buffer -> width != image -> width / OFFSET || buffer -> height != image -> height / OFFSET) return 1;
+
+    for (int y = 0; y < buffer -> height; y++) {
+        for (int x = 0; x < buffer -> width; x++) {
+            Symbol expected = get_image_symbol(image, x * OFFSET, y * OFFSET);
+            Symbol symbol = get_buffer_symbol(buffer, (size_t) y * buffer -> width + x);
+
+            if (comp == 3 && expected.shape) expected.color.a = 255;
+
+            if (memcmp(&expected, &symbol, sizeof(Symbol))) {
+                printf("Symbol (%i, %i) differs: shape %08X instead of %08X\n", x, y, symbol.shape, expected.shape);
+                return 1;
+            }
+        }
+    }
+
+    return buffer -> shapes[buffer -> size - 1] != TERMINATOR;
+}
+
+
+int test_raw_image(int comp, int scale) {
+    for (int i = 0; i < TEST_IMAGES; i++) {
+        // Width crosses mask words and vector widths at different places
+        int width = OFFSET * (rand() % 24 + 1), height = OFFSET * (rand() % 6 + 1);
+
+        Image image = {(Pixel *) calloc((size_t) width * height, sizeof(Pixel)), width, height};
+
+        fill_random_pixels(image.pixels, width, height);
+
+        // Edge after the first pixel makes detected scale exact
+        image.pixels[0] = {255, 255, 255, 255};
+        image.pixels[1] = {0, 0, 0, 255};
+
+        unsigned char *data = (unsigned char *) calloc((size_t) width * height * scale * scale * comp, sizeof(unsigned char));
+
+        get_raw_data(image.pixels, width, height, comp, scale, data);
+
+        SymbolBuffer buffer = parse_image_data(width * scale, height * scale, comp, data, rand() % 3 + 1);
+
+        int error = compare_symbols(&buffer, &image, comp);
+
+        if (error) printf("Image %ix%i with %i channels and scale %i is parsed wrong\n", width, height, comp, scale);
+
+        free_symbol_buffer(&buffer);
+        free(data);
+        free_image(&image);
+
+        if (error) return 1;
+    }
+
+    return 0;
+}
+
+
+int test_packed_image(int depth) {
+    for (int i = 0; i < TEST_IMAGES; i++) {
+        int width = OFFSET * (rand() % 24 + 1), height = OFFSET * (rand() % 6 + 1);
+
+        Pixel palette[256] = {};
+        fill_random_pixels(palette, 256, 1);
+
+        PaletteLut lut = {};
+        get_palette_lut(palette, depth, &lut);
+
+        size_t row_size = ((size_t) width * depth + 7) / 8;
+
+        unsigned char *data = (unsigned char *) calloc(row_size * height, sizeof(unsigned char));
+        Image image = {(Pixel *) calloc((size_t) width * height, sizeof(Pixel)), width, height};
+
+        // The leftmost pixel takes the highest bits of byte like in png
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                int index = rand() % (1 << depth), shift = 8 - depth - (x * depth) % 8;
+
+                data[(size_t) y * row_size + (size_t) (x * depth / 8)] |= (unsigned char) (index << shift);
+                image.pixels[(size_t) y * width + x] = palette[index];
+            }
+        }
+
+        int mask_size = get_row_mask_size(width), symbols = width / OFFSET;
+
+        RowMask *masks = (RowMask *) calloc((size_t) SYMBOL_SIZE * mask_size, sizeof(RowMask));
+        RowMask *occupancy = (RowMask *) calloc((size_t) get_row_mask_size(symbols), sizeof(RowMask));
+        unsigned int *shapes = (unsigned int *) calloc((size_t) symbols, sizeof(unsigned int));
+        Pixel *colors = (Pixel *) calloc((size_t) symbols, sizeof(Pixel));
+
+        int error = 0;
+
+        for (int y = 0; y < height && !error; y += OFFSET) {
+            for (int row = 0; row < SYMBOL_SIZE; row++)
+                get_packed_row_mask(data + (size_t) (y + row) * row_size, width, &lut, masks + row * mask_size);
+
+            memset(occupancy, 0, (size_t) get_row_mask_size(symbols) * sizeof(RowMask));
+
+            get_packed_row_symbols(data, row_size, width, &lut, 1, y, masks, shapes, colors, occupancy);
+
+            for (int x = 0; x < symbols && !error; x++) {
+                Symbol expected = get_image_symbol(&image, x * OFFSET, y);
+
+                int occupied = (int) (occupancy[x / ROW_MASK_BITS] >> (x % ROW_MASK_BITS) & 1);
+
+                error = expected.shape != shapes[x] || occupied != (expected.shape != 0) ||
+                        (expected.shape && memcmp(&expected.color, colors + x, sizeof(Pixel)));
+            }
+        }
+
+        if (error) printf("Palette image %ix%i with depth %i is parsed wrong\n", width, height, depth);
+
+        free(masks);
+        free(occupancy);
+        free(shapes);
+        free(colors);
+        free(data);
+        free_image(&image);
+
+        if (error) return 1;
+    }
+
+    return 0;
+}